@@ -17,6 +17,8 @@
 
 #include <stdio.h>
 
+#include "boot.h"
+
 #include "sensor.h"
 #include "ssd1306.h"
 
@@ -88,29 +90,43 @@ void Init_Screen(void)
 
 void board_init(void)
 {
+    // Start the boot trace clock
+    boot_trace_init();
+
     /* Initialize STM32F412 HAL library.  */
     HAL_Init();
+    boot_trace("hal");
 
     /* Configure the system clock to 96 MHz.  */
     SystemClock_Config();
+    boot_trace("clock");
 
     // Initialize console
     UART_Console_Init();
+    boot_trace("console");
 
     // Initialize timer
     TIM_Init();
 
     // Initialize GPIO
     GPIO_Init();
+    boot_trace("gpio");
 
     // Initialize I2C
     I2C1_Init();
+    boot_trace("i2c");
+}
 
+// Slow I2C work, left to run in a thread while Wi-Fi associates
+void board_peripherals_init(void)
+{
     // Discover and intialize sensors
     Init_MEM1_Sensors();
+    boot_trace("sensors");
 
     // Discover and intialize OLED screen
     Init_Screen();
+    boot_trace("screen");
 }
 
 /**
@@ -41,5 +41,6 @@
  
  /* Define prototypes. */
  void board_init(void);
+ void board_peripherals_init(void);
  
  #endif // _BOARD_INIT_H
\ No newline at end of file
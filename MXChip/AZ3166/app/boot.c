@@ -0,0 +1,279 @@
+/* 
+ * Copyright (c) Microsoft
+ * Copyright (c) 2024 Eclipse Foundation
+ * 
+ *  This program and the accompanying materials are made available 
+ *  under the terms of the MIT license which is available at
+ *  https://opensource.org/license/mit.
+ * 
+ *  SPDX-License-Identifier: MIT
+ * 
+ *  Contributors: 
+ *     Microsoft         - Initial version
+ *     Frédéric Desbiens - 2024 version.
+ */
+
+#include "boot.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef BOOT_TRACE_HOST
+#include "stm32f4xx_hal.h"
+#endif
+
+// Phases run in their own threads and signal completion here, so each one waits only for what it needs
+static TX_EVENT_FLAGS_GROUP boot_events;
+
+static const char* boot_phase_names[BOOT_PHASE_COUNT] = {
+    "peripherals",
+    "wifi",
+    "ip",
+    "dns",
+    "time",
+    "mqtt",
+};
+
+// Ticks since the kernel started, for the first run of each phase only
+static ULONG boot_phase_start_ticks[BOOT_PHASE_COUNT];
+static ULONG boot_phase_done_ticks[BOOT_PHASE_COUNT];
+static UINT boot_phase_started[BOOT_PHASE_COUNT];
+
+// Boot trace, filled from board_init on, before the kernel starts, and by every thread after it
+typedef struct BOOT_TRACE_ENTRY_STRUCT
+{
+    const char* milestone;
+    uint32_t cycles;
+    uint32_t clock_hz; // The core clock changes once board_init configures the PLL
+    ULONG ticks;       // Tells how often the cycle counter wrapped between two milestones
+} BOOT_TRACE_ENTRY;
+
+static BOOT_TRACE_ENTRY boot_trace_log[BOOT_TRACE_SIZE];
+static UINT boot_trace_count;
+
+static ULONG ticks_to_ms(ULONG ticks)
+{
+    return ticks * 1000 / TX_TIMER_TICKS_PER_SECOND;
+}
+
+static UINT boot_phase_index(ULONG phase)
+{
+    UINT index = 0;
+
+    while (phase >>= 1)
+    {
+        index++;
+    }
+
+    return index;
+}
+
+static UINT boot_phase_is_done(ULONG phases)
+{
+    ULONG actual;
+
+    return tx_event_flags_get(&boot_events, phases, TX_AND, &actual, TX_NO_WAIT) == TX_SUCCESS;
+}
+
+UINT boot_init()
+{
+    UINT status;
+
+    if ((status = tx_event_flags_create(&boot_events, "Boot")))
+    {
+        printf("ERROR: Create boot event flags (0x%08x)\r\n", status);
+    }
+
+    return status;
+}
+
+// Marks the start of a phase; later runs, such as a rejoin after a Wi-Fi drop, are not timed
+void boot_phase_start(ULONG phase)
+{
+    UINT index = boot_phase_index(phase);
+
+    if (boot_phase_started[index] || boot_phase_is_done(phase))
+    {
+        return;
+    }
+
+    boot_phase_start_ticks[index] = tx_time_get();
+    boot_phase_started[index]     = TX_TRUE;
+}
+
+// Marks a phase complete, releasing the phases waiting for it, and reports once every phase is done
+void boot_phase_done(ULONG phase)
+{
+    UINT index = boot_phase_index(phase);
+
+    if (boot_phase_is_done(phase))
+    {
+        return;
+    }
+
+    boot_phase_done_ticks[index] = tx_time_get();
+    if (!boot_phase_started[index])
+    {
+        boot_phase_start_ticks[index] = boot_phase_done_ticks[index];
+    }
+
+    tx_event_flags_set(&boot_events, phase, TX_OR);
+
+    printf("BOOT: %s done in %lu ms, at %lu ms\r\n",
+        boot_phase_names[index],
+        ticks_to_ms(boot_phase_done_ticks[index] - boot_phase_start_ticks[index]),
+        ticks_to_ms(boot_phase_done_ticks[index]));
+
+    if (boot_phase_is_done(BOOT_ALL))
+    {
+        boot_report();
+    }
+}
+
+// Waits until all the given phases are done
+UINT boot_phase_wait(ULONG phases, ULONG wait_option)
+{
+    ULONG actual;
+
+    return tx_event_flags_get(&boot_events, phases, TX_AND, &actual, wait_option);
+}
+
+// Starts the cycle counter from zero; called first thing in board_init
+void boot_trace_init()
+{
+    BOOT_TRACE_ENABLE();
+    boot_trace_count = 0;
+
+    boot_trace("reset");
+}
+
+// Records the first time a milestone is reached, and returns whether it was recorded
+UINT boot_trace(const char* milestone)
+{
+    TX_INTERRUPT_SAVE_AREA
+    BOOT_TRACE_ENTRY* entry = NULL;
+    UINT index;
+
+    TX_DISABLE
+    for (index = 0; index < boot_trace_count; index++)
+    {
+        if (strcmp(boot_trace_log[index].milestone, milestone) == 0)
+        {
+            break;
+        }
+    }
+    if ((index == boot_trace_count) && (boot_trace_count < BOOT_TRACE_SIZE))
+    {
+        entry            = &boot_trace_log[boot_trace_count++];
+        entry->milestone = milestone;
+        entry->cycles    = BOOT_TRACE_CYCLES();
+        entry->clock_hz  = BOOT_TRACE_CLOCK_HZ;
+        entry->ticks     = tx_time_get();
+    }
+    TX_RESTORE
+
+    return entry != NULL;
+}
+
+// Cycles between two milestones. The core runs at the clock of the earlier one until the next milestone: the clock
+// only changes in SystemClock_Config, which the "clock" milestone follows
+static uint64_t boot_trace_delta(const BOOT_TRACE_ENTRY* previous, const BOOT_TRACE_ENTRY* entry)
+{
+    uint64_t delta    = (uint32_t)(entry->cycles - previous->cycles);
+    uint64_t estimate = (uint64_t)(entry->ticks - previous->ticks) * (previous->clock_hz / TX_TIMER_TICKS_PER_SECOND);
+
+    // The counter wraps every 2^32 cycles, 44 s at 96 MHz, and the kernel ticks tell how many times it did
+    if (estimate > delta + (1ULL << 31))
+    {
+        delta += ((estimate - delta + (1ULL << 31)) >> 32) << 32;
+    }
+
+    return delta;
+}
+
+// Microseconds from reset to each milestone
+static void boot_trace_times(uint64_t* times_us)
+{
+    uint64_t time_us = 0;
+    UINT index;
+
+    for (index = 0; index < boot_trace_count; index++)
+    {
+        if (index > 0)
+        {
+            time_us += boot_trace_delta(&boot_trace_log[index - 1], &boot_trace_log[index]) * 1000000 /
+                       boot_trace_log[index - 1].clock_hz;
+        }
+        times_us[index] = time_us;
+    }
+}
+
+// Prints each milestone, in us since reset and since the one before
+void boot_trace_dump()
+{
+    uint64_t times_us[BOOT_TRACE_SIZE];
+    UINT index;
+
+    boot_trace_times(times_us);
+
+    printf("\r\nBOOT TRACE: milestone          us    delta\r\n");
+    for (index = 0; index < boot_trace_count; index++)
+    {
+        printf("            %-14s %9lu %8lu\r\n",
+            boot_trace_log[index].milestone,
+            (ULONG)times_us[index],
+            (ULONG)(index ? times_us[index] - times_us[index - 1] : 0));
+    }
+    printf("\r\n");
+}
+
+// Writes the trace as a JSON object of us since reset, and returns its length, or zero if it does not fit
+UINT boot_trace_json(char* buffer, UINT buffer_size)
+{
+    uint64_t times_us[BOOT_TRACE_SIZE];
+    UINT length;
+    UINT index;
+
+    boot_trace_times(times_us);
+
+    length = snprintf(buffer, buffer_size, "{");
+    for (index = 0; (index < boot_trace_count) && (length < buffer_size); index++)
+    {
+        length += snprintf(&buffer[length], buffer_size - length, "%s\"%s\":%lu",
+            index ? "," : "", boot_trace_log[index].milestone, (ULONG)times_us[index]);
+    }
+    if (length < buffer_size)
+    {
+        length += snprintf(&buffer[length], buffer_size - length, "}");
+    }
+
+    return (length < buffer_size) ? length : 0;
+}
+
+// Prints when each phase started and ended, in ms since the kernel started
+void boot_report()
+{
+    UINT index;
+
+    printf("\r\nBOOT: phase        start      end duration\r\n");
+
+    for (index = 0; index < BOOT_PHASE_COUNT; index++)
+    {
+        if (!boot_phase_is_done(1 << index))
+        {
+            printf("      %-11s %6lu  pending\r\n",
+                boot_phase_names[index],
+                boot_phase_started[index] ? ticks_to_ms(boot_phase_start_ticks[index]) : 0);
+            continue;
+        }
+
+        printf("      %-11s %6lu   %6lu   %6lu\r\n",
+            boot_phase_names[index],
+            ticks_to_ms(boot_phase_start_ticks[index]),
+            ticks_to_ms(boot_phase_done_ticks[index]),
+            ticks_to_ms(boot_phase_done_ticks[index] - boot_phase_start_ticks[index]));
+    }
+
+    printf("\r\n");
+}
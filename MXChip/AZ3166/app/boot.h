@@ -0,0 +1,57 @@
+/* 
+ * Copyright (c) Microsoft
+ * Copyright (c) 2024 Eclipse Foundation
+ * 
+ *  This program and the accompanying materials are made available 
+ *  under the terms of the MIT license which is available at
+ *  https://opensource.org/license/mit.
+ * 
+ *  SPDX-License-Identifier: MIT
+ * 
+ *  Contributors: 
+ *     Microsoft         - Initial version
+ *     Frédéric Desbiens - 2024 version.
+ */
+
+#ifndef _BOOT_H
+#define _BOOT_H
+
+#include "tx_api.h"
+
+// Boot phases, each an event flag set once the phase has completed
+#define BOOT_PERIPHERALS 0x01 // Sensors and screen
+#define BOOT_WIFI        0x02 // Associated with the access point
+#define BOOT_IP          0x04 // Address from DHCP, or the static fallback
+#define BOOT_DNS         0x08 // DNS server configured
+#define BOOT_TIME        0x10 // Clock set by SNTP
+#define BOOT_MQTT        0x20 // First CONNACK from the broker
+#define BOOT_PHASE_COUNT 6
+#define BOOT_ALL         ((1 << BOOT_PHASE_COUNT) - 1)
+
+// Milestones kept by the boot trace, from reset to the first acknowledged publish
+#define BOOT_TRACE_SIZE  32
+
+// The trace reads the DWT cycle counter. A host build defines BOOT_TRACE_HOST to read the simulated one of the
+// host port instead; another target defines these three itself
+#if defined(BOOT_TRACE_HOST)
+#define BOOT_TRACE_ENABLE()  host_cycles_reset()
+#define BOOT_TRACE_CYCLES()  host_cycles_get()
+#define BOOT_TRACE_CLOCK_HZ  (host_core_clock_hz)
+#elif !defined(BOOT_TRACE_CYCLES)
+#define BOOT_TRACE_ENABLE()  (CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk, DWT->CYCCNT = 0, DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk)
+#define BOOT_TRACE_CYCLES()  (DWT->CYCCNT)
+#define BOOT_TRACE_CLOCK_HZ  (SystemCoreClock)
+#endif
+
+UINT boot_init();
+void boot_phase_start(ULONG phase);
+void boot_phase_done(ULONG phase);
+UINT boot_phase_wait(ULONG phases, ULONG wait_option);
+void boot_report();
+
+void boot_trace_init();
+UINT boot_trace(const char* milestone);
+void boot_trace_dump();
+UINT boot_trace_json(char* buffer, UINT buffer_size);
+
+#endif
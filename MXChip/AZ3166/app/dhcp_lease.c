@@ -0,0 +1,381 @@
+/* 
+ * Copyright (c) Microsoft
+ * Copyright (c) 2024 Eclipse Foundation
+ * 
+ *  This program and the accompanying materials are made available 
+ *  under the terms of the MIT license which is available at
+ *  https://opensource.org/license/mit.
+ * 
+ *  SPDX-License-Identifier: MIT
+ * 
+ *  Contributors: 
+ *     Microsoft         - Initial version
+ *     Frédéric Desbiens - 2024 version.
+ */
+
+#include "dhcp_lease.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "stm32f4xx_hal.h"
+
+// The lease area is the last flash sector, kept out of FLASH by the linker script
+#define DHCP_LEASE_SECTOR  FLASH_SECTOR_11
+// Records of the first layout, which also kept the lease times, carry other magics and are skipped
+#define DHCP_LEASE_MAGIC   0x4C454132 // "LEA2"
+#define DNS_HOST_MAGIC     0x484F5332 // "HOS2"
+
+// The erase stalls the core for about a second. It is left to a thread below every other one,
+// woken while a few slots are still erased, so the DHCP and MQTT threads that save do not wait on it
+#define DHCP_LEASE_SPARE               4
+#define DHCP_LEASE_THREAD_STACK_SIZE   1024
+#define DHCP_LEASE_THREAD_PRIORITY     10
+
+// The address a host name resolved to, shares the sector with the lease
+typedef struct DNS_HOST_STRUCT
+{
+    ULONG name_hash;
+    ULONG address;
+} DNS_HOST;
+
+// Records are appended and the latest one of each kind wins, so the sector is erased only once it
+// is full. The magic tells the kind and is programmed last: a record cut short by a reset is
+// skipped on the next scan
+typedef struct DHCP_LEASE_RECORD_STRUCT
+{
+    union
+    {
+        DHCP_LEASE lease;
+        DNS_HOST host;
+    } data;
+    ULONG checksum;
+    ULONG magic;
+} DHCP_LEASE_RECORD;
+
+extern DHCP_LEASE_RECORD _slease[];
+extern DHCP_LEASE_RECORD _elease[];
+
+// The DHCP thread saves leases and the MQTT thread host addresses. Two writers scanning at once
+// would program the same erased slot, or one would erase the sector under the other
+static TX_MUTEX dhcp_lease_mutex;
+
+static TX_THREAD dhcp_lease_thread;
+static ULONG dhcp_lease_thread_stack[DHCP_LEASE_THREAD_STACK_SIZE / sizeof(ULONG)];
+static TX_SEMAPHORE dhcp_lease_compact_semaphore;
+
+// Flash is read and programmed in 32-bit words
+static ULONG dhcp_lease_checksum(const DHCP_LEASE_RECORD* record)
+{
+    const uint32_t* word = (const uint32_t*)&record->data;
+    uint32_t sum = 0;
+
+    for (UINT i = 0; i < sizeof(record->data) / sizeof(uint32_t); i++)
+    {
+        sum = (sum << 1 | sum >> 31) ^ word[i];
+    }
+
+    return ~sum;
+}
+
+static UINT dhcp_lease_is_erased(const DHCP_LEASE_RECORD* record)
+{
+    const uint32_t* word = (const uint32_t*)record;
+
+    for (UINT i = 0; i < sizeof(DHCP_LEASE_RECORD) / sizeof(uint32_t); i++)
+    {
+        if (word[i] != 0xFFFFFFFF)
+        {
+            return NX_FALSE;
+        }
+    }
+
+    return NX_TRUE;
+}
+
+// Finds the latest valid record of a kind and the first erased slot, either of which may be NULL
+static void dhcp_lease_scan(ULONG magic, const DHCP_LEASE_RECORD** latest, DHCP_LEASE_RECORD** free_slot)
+{
+    DHCP_LEASE_RECORD* record;
+
+    *latest    = NULL;
+    *free_slot = NULL;
+
+    for (record = _slease; record + 1 <= _elease; record++)
+    {
+        if (dhcp_lease_is_erased(record))
+        {
+            *free_slot = record;
+            return;
+        }
+
+        if ((record->magic == magic) && (record->checksum == dhcp_lease_checksum(record)))
+        {
+            *latest = record;
+        }
+    }
+}
+
+UINT dhcp_lease_load(DHCP_LEASE* lease)
+{
+    const DHCP_LEASE_RECORD* latest;
+    DHCP_LEASE_RECORD* free_slot;
+    UINT status = NX_NOT_FOUND;
+
+    tx_mutex_get(&dhcp_lease_mutex, TX_WAIT_FOREVER);
+
+    dhcp_lease_scan(DHCP_LEASE_MAGIC, &latest, &free_slot);
+
+    if (latest != NULL)
+    {
+        *lease = latest->data.lease;
+        status = NX_SUCCESS;
+    }
+
+    tx_mutex_put(&dhcp_lease_mutex);
+
+    return status;
+}
+
+static HAL_StatusTypeDef dhcp_lease_program(DHCP_LEASE_RECORD* slot, const DHCP_LEASE_RECORD* record)
+{
+    const uint32_t* word = (const uint32_t*)record;
+    HAL_StatusTypeDef status = HAL_OK;
+
+    for (UINT i = 0; (status == HAL_OK) && (i < sizeof(DHCP_LEASE_RECORD) / sizeof(uint32_t)); i++)
+    {
+        status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, (uint32_t)(uintptr_t)((uint32_t*)slot + i), word[i]);
+    }
+
+    return status;
+}
+
+static void dhcp_lease_flash_lock()
+{
+    HAL_FLASH_Lock();
+
+    // The data cache may still hold the erased slot from the scan
+    __HAL_FLASH_DATA_CACHE_DISABLE();
+    __HAL_FLASH_DATA_CACHE_RESET();
+    __HAL_FLASH_DATA_CACHE_ENABLE();
+}
+
+// Erases the sector and writes back the latest record of each kind, returning the first erased slot
+// after them. The caller holds the mutex and has unlocked the flash
+static HAL_StatusTypeDef dhcp_lease_erase_locked(DHCP_LEASE_RECORD** free_slot)
+{
+    static const ULONG magics[] = {DHCP_LEASE_MAGIC, DNS_HOST_MAGIC};
+    const DHCP_LEASE_RECORD* latest;
+    DHCP_LEASE_RECORD* unused;
+    DHCP_LEASE_RECORD kept[sizeof(magics) / sizeof(magics[0])];
+    UINT kept_count = 0;
+    FLASH_EraseInitTypeDef erase = {0};
+    uint32_t sector_error;
+    HAL_StatusTypeDef status;
+
+    for (UINT i = 0; i < sizeof(magics) / sizeof(magics[0]); i++)
+    {
+        dhcp_lease_scan(magics[i], &latest, &unused);
+        if (latest != NULL)
+        {
+            kept[kept_count++] = *latest;
+        }
+    }
+
+    erase.TypeErase    = FLASH_TYPEERASE_SECTORS;
+    erase.Sector       = DHCP_LEASE_SECTOR;
+    erase.NbSectors    = 1;
+    erase.VoltageRange = FLASH_VOLTAGE_RANGE_3;
+
+    status     = HAL_FLASHEx_Erase(&erase, &sector_error);
+    *free_slot = _slease;
+
+    for (UINT i = 0; (status == HAL_OK) && (i < kept_count); i++)
+    {
+        status = dhcp_lease_program((*free_slot)++, &kept[i]);
+    }
+
+    return status;
+}
+
+// Starts the sector over with only the latest records, run by the lease thread
+static UINT dhcp_lease_compact()
+{
+    DHCP_LEASE_RECORD* free_slot;
+    HAL_StatusTypeDef status;
+
+    tx_mutex_get(&dhcp_lease_mutex, TX_WAIT_FOREVER);
+
+    HAL_FLASH_Unlock();
+    status = dhcp_lease_erase_locked(&free_slot);
+    dhcp_lease_flash_lock();
+
+    tx_mutex_put(&dhcp_lease_mutex);
+
+    if (status != HAL_OK)
+    {
+        printf("ERROR: Failed to erase the lease sector (%d)\r\n", status);
+        return NX_NOT_SUCCESSFUL;
+    }
+
+    return NX_SUCCESS;
+}
+
+// Runs one compaction each time a write leaves few erased slots
+static void dhcp_lease_thread_entry(ULONG parameter)
+{
+    (void)parameter;
+
+    while (tx_semaphore_get(&dhcp_lease_compact_semaphore, TX_WAIT_FOREVER) == TX_SUCCESS)
+    {
+        dhcp_lease_compact();
+    }
+}
+
+UINT dhcp_lease_init()
+{
+    UINT status;
+
+    if ((status = tx_mutex_create(&dhcp_lease_mutex, "DHCP lease", TX_INHERIT)))
+    {
+        printf("ERROR: DHCP lease mutex create failed (0x%08x)\r\n", status);
+    }
+
+    else if ((status = tx_semaphore_create(&dhcp_lease_compact_semaphore, "DHCP lease compact", 0)))
+    {
+        printf("ERROR: DHCP lease semaphore create failed (0x%08x)\r\n", status);
+        tx_mutex_delete(&dhcp_lease_mutex);
+    }
+
+    else if ((status = tx_thread_create(&dhcp_lease_thread,
+                  "DHCP lease",
+                  dhcp_lease_thread_entry,
+                  0,
+                  dhcp_lease_thread_stack,
+                  DHCP_LEASE_THREAD_STACK_SIZE,
+                  DHCP_LEASE_THREAD_PRIORITY,
+                  DHCP_LEASE_THREAD_PRIORITY,
+                  TX_NO_TIME_SLICE,
+                  TX_AUTO_START)))
+    {
+        printf("ERROR: DHCP lease thread create failed (0x%08x)\r\n", status);
+        tx_semaphore_delete(&dhcp_lease_compact_semaphore);
+        tx_mutex_delete(&dhcp_lease_mutex);
+    }
+
+    return status;
+}
+
+// Appends a record unless the latest one of its kind holds the same data. The caller holds the mutex
+static UINT dhcp_lease_write_locked(DHCP_LEASE_RECORD* record)
+{
+    const DHCP_LEASE_RECORD* latest;
+    DHCP_LEASE_RECORD* slot;
+    HAL_StatusTypeDef status = HAL_OK;
+
+    dhcp_lease_scan(record->magic, &latest, &slot);
+
+    // Renewals bind the same lease again, and most lookups return the same address, which needs no write
+    if ((latest != NULL) && (memcmp(&latest->data, &record->data, sizeof(record->data)) == 0))
+    {
+        return NX_SUCCESS;
+    }
+
+    record->checksum = dhcp_lease_checksum(record);
+
+    HAL_FLASH_Unlock();
+
+    // Full sector, as the lease thread has not caught up. Start over here, stalling the caller
+    if (slot == NULL)
+    {
+        status = dhcp_lease_erase_locked(&slot);
+    }
+
+    if (status == HAL_OK)
+    {
+        status = dhcp_lease_program(slot, record);
+    }
+
+    dhcp_lease_flash_lock();
+
+    if (status != HAL_OK)
+    {
+        printf("ERROR: Failed to write the lease sector (%d)\r\n", status);
+        return NX_NOT_SUCCESSFUL;
+    }
+
+    // Counted in bytes, as the sector need not be a whole number of records
+    if ((ULONG)((UCHAR*)_elease - (UCHAR*)(slot + 1)) < DHCP_LEASE_SPARE * sizeof(DHCP_LEASE_RECORD))
+    {
+        tx_semaphore_ceiling_put(&dhcp_lease_compact_semaphore, 1);
+    }
+
+    return NX_SUCCESS;
+}
+
+static UINT dhcp_lease_write(DHCP_LEASE_RECORD* record)
+{
+    UINT status;
+
+    tx_mutex_get(&dhcp_lease_mutex, TX_WAIT_FOREVER);
+    status = dhcp_lease_write_locked(record);
+    tx_mutex_put(&dhcp_lease_mutex);
+
+    return status;
+}
+
+// Host names are told apart by a hash, so the record keeps a fixed size
+static ULONG dns_host_name_hash(const CHAR* host_name)
+{
+    ULONG hash = 2166136261UL;
+
+    while (*host_name != '\0')
+    {
+        hash = (hash ^ (UCHAR)*host_name++) * 16777619UL;
+    }
+
+    return hash;
+}
+
+UINT dhcp_lease_save(const DHCP_LEASE* lease)
+{
+    DHCP_LEASE_RECORD record = {0};
+
+    record.data.lease = *lease;
+    record.magic      = DHCP_LEASE_MAGIC;
+
+    return dhcp_lease_write(&record);
+}
+
+UINT dns_host_load(const CHAR* host_name, ULONG* address)
+{
+    const DHCP_LEASE_RECORD* latest;
+    DHCP_LEASE_RECORD* free_slot;
+    UINT status = NX_NOT_FOUND;
+
+    tx_mutex_get(&dhcp_lease_mutex, TX_WAIT_FOREVER);
+
+    dhcp_lease_scan(DNS_HOST_MAGIC, &latest, &free_slot);
+
+    // Only the latest host is kept, and it may be the one of an older configuration
+    if ((latest != NULL) && (latest->data.host.name_hash == dns_host_name_hash(host_name)))
+    {
+        *address = latest->data.host.address;
+        status   = NX_SUCCESS;
+    }
+
+    tx_mutex_put(&dhcp_lease_mutex);
+
+    return status;
+}
+
+UINT dns_host_save(const CHAR* host_name, ULONG address)
+{
+    DHCP_LEASE_RECORD record = {0};
+
+    record.data.host.name_hash = dns_host_name_hash(host_name);
+    record.data.host.address   = address;
+    record.magic               = DNS_HOST_MAGIC;
+
+    return dhcp_lease_write(&record);
+}
@@ -0,0 +1,40 @@
+/* 
+ * Copyright (c) Microsoft
+ * Copyright (c) 2024 Eclipse Foundation
+ * 
+ *  This program and the accompanying materials are made available 
+ *  under the terms of the MIT license which is available at
+ *  https://opensource.org/license/mit.
+ * 
+ *  SPDX-License-Identifier: MIT
+ * 
+ *  Contributors: 
+ *     Microsoft         - Initial version
+ *     Frédéric Desbiens - 2024 version.
+ */
+
+#ifndef _DHCP_LEASE_H
+#define _DHCP_LEASE_H
+
+#include "nx_api.h"
+
+// The lease as bound, saved so the next boot can ask for the same address with a single REQUEST.
+// The lease times are not kept: nothing tells the time at boot before DHCP, so they could not be
+// aged, and the ACK to the REQUEST brings new ones
+typedef struct DHCP_LEASE_STRUCT
+{
+    ULONG ip_address;
+    ULONG network_mask;
+    ULONG gateway_address;
+    ULONG server_ip;
+} DHCP_LEASE;
+
+UINT dhcp_lease_init();
+UINT dhcp_lease_load(DHCP_LEASE* lease);
+UINT dhcp_lease_save(const DHCP_LEASE* lease);
+
+// The address a host name last resolved to, so a boot without a DNS server can still reach the host
+UINT dns_host_load(const CHAR* host_name, ULONG* address);
+UINT dns_host_save(const CHAR* host_name, ULONG address);
+
+#endif
@@ -6,16 +6,32 @@
 #include "wwd_networking.h"
 #include "mqtt_client.h"
 #include "screen.h"
+#include "boot.h"
 
 #define ECLIPSETX_THREAD_STACK_SIZE 4096
 #define ECLIPSETX_THREAD_PRIORITY   4
 
+#define PERIPHERALS_THREAD_STACK_SIZE 2048
+#define PERIPHERALS_THREAD_PRIORITY   5 // Runs while the network thread waits on Wi-Fi
+
 TX_THREAD eclipsetx_thread;
 ULONG eclipsetx_thread_stack[ECLIPSETX_THREAD_STACK_SIZE / sizeof(ULONG)];
 
+TX_THREAD peripherals_thread;
+ULONG peripherals_thread_stack[PERIPHERALS_THREAD_STACK_SIZE / sizeof(ULONG)];
+
+// Initializes the sensors and screen alongside the network bring-up
+static void peripherals_thread_entry(ULONG parameter)
+{
+    boot_phase_start(BOOT_PERIPHERALS);
+    board_peripherals_init();
+    boot_phase_done(BOOT_PERIPHERALS);
+}
+
 static void eclipsetx_thread_entry(ULONG parameter)
 {
     UINT status;
+    MQTT_RECEIVED_MESSAGE *message;
 
     printf("Starting Eclipse ThreadX thread\n\n");
 
@@ -26,7 +42,7 @@ static void eclipsetx_thread_entry(ULONG parameter)
         return;
     }
 
-    // Connect to the Wi-Fi
+    // Connect to the Wi-Fi, leaving the SNTP sync to run in the background
     if ((status = wwd_network_connect()))
     {
         printf("ERROR: Failed to connect to the network (0x%08x)\n", status);
@@ -36,10 +52,14 @@ static void eclipsetx_thread_entry(ULONG parameter)
     // Initialize and connect to MQTT
     mqtt_init();
     mqtt_connect();
+
+    boot_phase_wait(BOOT_PERIPHERALS, TX_WAIT_FOREVER);
     screen_print("  MQTT",L0);
 
     screen_print(" Connected",L1);
 
+    // Subscribe once; the subscription is restored after a reconnect
+    mqtt_subscribe("message", 0);
 
     // Main loop: check buttons and publish JSON messages
     while (1)
@@ -47,7 +67,7 @@ static void eclipsetx_thread_entry(ULONG parameter)
         if (BUTTON_A_IS_PRESSED)
         {
             printf("Button A Pressed: Hello My Friend \n");
-            mqtt_publish("Arnold", "Hi Lesley");
+            mqtt_publish("Arnold", "Hi Lesley", 0);
             screen_print("ON",L1);
             tx_thread_sleep(TX_TIMER_TICKS_PER_SECOND); // Prevent rapid re-triggering
         }
@@ -55,15 +75,18 @@ static void eclipsetx_thread_entry(ULONG parameter)
         if (BUTTON_B_IS_PRESSED)
         {
             printf("Button B Pressed: Turning socket OFF\n");
-            mqtt_publish("office/smart_extension", "{\"socket1\": \"OFF\"}");
+            mqtt_socket_publish("{\"socket1\": \"OFF\"}"); // Exactly once
             screen_print("OFF",L1);
 
             tx_thread_sleep(TX_TIMER_TICKS_PER_SECOND); // Prevent rapid re-triggering
         }
 
-        printf(mqtt_subscribe("message"));
-        // Sleep to reduce CPU usage
-        tx_thread_sleep(100);
+        // Wait for a received message instead of sleeping, so messages are handled as they arrive
+        if (mqtt_message_receive(&message, 100) == TX_SUCCESS)
+        {
+            printf("Message on %s: %s\n", message->topic, message->payload);
+            mqtt_message_release(message);
+        }
     }
 }
 
@@ -72,6 +95,11 @@ void tx_application_define(void* first_unused_memory)
 {
     systick_interval_set(TX_TIMER_TICKS_PER_SECOND);
 
+    if (boot_init() != TX_SUCCESS)
+    {
+        return;
+    }
+
     // Create ThreadX thread
     UINT status = tx_thread_create(&eclipsetx_thread,
         "Eclipse ThreadX Thread",
@@ -88,12 +116,28 @@ void tx_application_define(void* first_unused_memory)
     {
         printf("ERROR: Eclipse ThreadX thread creation failed\n");
     }
+
+    status = tx_thread_create(&peripherals_thread,
+        "Peripherals Thread",
+        peripherals_thread_entry,
+        0,
+        peripherals_thread_stack,
+        PERIPHERALS_THREAD_STACK_SIZE,
+        PERIPHERALS_THREAD_PRIORITY,
+        PERIPHERALS_THREAD_PRIORITY,
+        TX_NO_TIME_SLICE,
+        TX_AUTO_START);
+
+    if (status != TX_SUCCESS)
+    {
+        printf("ERROR: Peripherals thread creation failed\n");
+    }
 }
 
 // Main function
 int main(void)
 {
-    // Initialize the board
+    // Initialize the board; sensors and screen follow in their own thread
     board_init();
     tx_kernel_enter(); // Start ThreadX
     return 0;
@@ -5,26 +5,474 @@
 #include "wwd_networking.h"
 #include "mqtt_client.h"
 #include "cloud_config.h"  // Ensure this is included for MQTT_CLIENT_ID
+#include "dhcp_lease.h"
+
+#define MQTT_RECONNECT_EVENT 0x1
+#define MQTT_CONNACK_EVENT   0x2
 
 static NXD_MQTT_CLIENT mqtt_client;
 static UCHAR mqtt_stack[MQTT_STACK_SIZE];
-static char received_message[256];  // Store received message
+static NXD_ADDRESS mqtt_broker_address;
+
+// The supervisor thread reconnects after the connection is lost
+static TX_THREAD mqtt_supervisor_thread;
+static UCHAR mqtt_supervisor_stack[MQTT_SUPERVISOR_STACK_SIZE];
+static TX_EVENT_FLAGS_GROUP mqtt_supervisor_events;
+static UINT mqtt_connect_status;
+
+// Time to recover, in ticks from losing the connection to the next CONNACK
+static ULONG mqtt_outage_start;
+static ULONG mqtt_recover_count;
+static ULONG mqtt_recover_time_last;
+static ULONG mqtt_recover_time_max;
+
+#ifdef MQTT_METRICS_TOPIC
+// Time the client metrics were last published
+static ULONG mqtt_metrics_time;
+#endif
+
+#ifdef MQTT_BOOT_TRACE_TOPIC
+// Set once the boot trace is complete, and cleared once published
+static UINT mqtt_boot_trace_pending;
+#endif
+
+// Topic filters to keep subscribed, sent again with each connect
+static struct
+{
+    const char *topic;
+    UINT qos;
+    UINT pending;   // A SUBSCRIBE is queued or waiting for SUBACK
+} mqtt_subscriptions[MQTT_SUBSCRIPTION_MAX];
+
+// Received messages are copied into slots, and slot indexes are passed through two queues:
+// free slots to the MQTT thread, filled slots to the application
+static MQTT_RECEIVED_MESSAGE mqtt_messages[MQTT_MESSAGE_SLOTS];
+static TX_QUEUE mqtt_free_queue;
+static TX_QUEUE mqtt_message_queue;
+static ULONG mqtt_free_queue_storage[MQTT_MESSAGE_SLOTS];
+static ULONG mqtt_message_queue_storage[MQTT_MESSAGE_SLOTS];
+static ULONG mqtt_messages_dropped;
+
+// Messages published while disconnected wait here; CCM RAM is otherwise unused
+static UCHAR mqtt_journal[MQTT_JOURNAL_SIZE] __attribute__((section(".ccmbss")));
+
+// Encoded once, so each button press only writes the header length and packet id
+static NXD_MQTT_TOPIC mqtt_socket_topic;
 
 // Function to initialize MQTT
 void mqtt_init()
 {
+    ULONG slot;
+
     printf("Initializing MQTT client...\n");
+
+    tx_queue_create(&mqtt_free_queue, "MQTT free slots", TX_1_ULONG,
+                    mqtt_free_queue_storage, sizeof(mqtt_free_queue_storage));
+    tx_queue_create(&mqtt_message_queue, "MQTT messages", TX_1_ULONG,
+                    mqtt_message_queue_storage, sizeof(mqtt_message_queue_storage));
+
+    for (slot = 0; slot < MQTT_MESSAGE_SLOTS; slot++)
+    {
+        tx_queue_send(&mqtt_free_queue, &slot, TX_NO_WAIT);
+    }
+}
+
+// Sends SUBSCRIBE for a filter and registers its handler
+static UINT mqtt_subscription_send(UINT index)
+{
+    return nxd_mqtt_client_subscription_add(&mqtt_client,
+                                            (CHAR *)mqtt_subscriptions[index].topic,
+                                            strlen(mqtt_subscriptions[index].topic),
+                                            mqtt_subscriptions[index].qos,
+                                            mqtt_message_handler, NX_NULL);
+}
+
+// Called from the MQTT thread once a queued SUBSCRIBE is acknowledged, refused, or lost with the connection
+static void mqtt_subscribe_complete(NXD_MQTT_CLIENT *client, UINT handle, UINT status, VOID *context)
+{
+    UINT index = (UINT)(ULONG)context;
+
+    (void)client;
+    (void)handle;
+
+    mqtt_subscriptions[index].pending = NX_FALSE;
+
+    if (status != NX_SUCCESS)
+    {
+        printf("ERROR: MQTT resubscribe to %s failed (0x%08x)\n", mqtt_subscriptions[index].topic, status);
+    }
+}
+
+// Queues SUBSCRIBE for every filter before connecting, so the MQTT thread sends them right behind CONNECT
+// The broker may not have kept the session, and subscribing again to a kept one is harmless
+// Matching messages reach mqtt_message_handler through mqtt_callback until a handler is registered
+static void mqtt_subscriptions_queue()
+{
+    UINT index;
+    UINT handle;
+    UINT status;
+
+    for (index = 0; index < MQTT_SUBSCRIPTION_MAX; index++)
+    {
+        // A request left from a failed attempt goes out with this one
+        if ((mqtt_subscriptions[index].topic == NULL) || mqtt_subscriptions[index].pending)
+        {
+            continue;
+        }
+
+        status = nxd_mqtt_client_subscribe_async(&mqtt_client, (CHAR *)mqtt_subscriptions[index].topic,
+                                                 strlen(mqtt_subscriptions[index].topic), mqtt_subscriptions[index].qos,
+                                                 mqtt_subscribe_complete, (VOID *)(ULONG)index, &handle);
+        if (status != NX_SUCCESS)
+        {
+            printf("ERROR: MQTT resubscribe to %s failed (0x%08x)\n", mqtt_subscriptions[index].topic, status);
+            continue;
+        }
+
+        mqtt_subscriptions[index].pending = NX_TRUE;
+    }
+}
+
+// Called from the MQTT thread once the TCP connection to the broker is up
+static VOID mqtt_tcp_establish_notify(NXD_MQTT_CLIENT *client)
+{
+    (void)client;
+
+    boot_trace("tcp");
+}
+
+// Called from the MQTT thread for each acknowledgement; the first one for a publish ends the boot trace
+static VOID mqtt_ack_notify(NXD_MQTT_CLIENT *client, UINT type, USHORT packet_id, NX_PACKET *transmit_packet_ptr, VOID *context)
+{
+    (void)client;
+    (void)packet_id;
+    (void)transmit_packet_ptr;
+    (void)context;
+
+    if (((type == MQTT_CONTROL_PACKET_TYPE_PUBACK) || (type == MQTT_CONTROL_PACKET_TYPE_PUBREC)) && boot_trace("puback"))
+    {
+        boot_trace_dump();
+#ifdef MQTT_BOOT_TRACE_TOPIC
+        mqtt_boot_trace_pending = NX_TRUE;
+#endif
+    }
+}
+
+// Called from the MQTT thread with the outcome of a non-blocking connect
+static VOID mqtt_connect_notify(NXD_MQTT_CLIENT *client, UINT status, VOID *context)
+{
+    (void)client;
+    (void)context;
+
+    if (status == NX_SUCCESS)
+    {
+        boot_trace("connack");
+        boot_phase_done(BOOT_MQTT);
+    }
+
+    mqtt_connect_status = status;
+    tx_event_flags_set(&mqtt_supervisor_events, MQTT_CONNACK_EVENT, TX_OR);
+}
+
+#ifdef MQTT_BROKER_HOST
+// Looks the broker up before each connect, so a moved broker is followed. The DNS cache answers while
+// the record is fresh, and with the last address while no DNS server answers
+static void mqtt_broker_resolve()
+{
+    ULONG address;
+    UINT status;
+
+    status = nx_dns_host_by_name_get(&nx_dns_client, (UCHAR*)MQTT_BROKER_HOST, &address, MQTT_BROKER_DNS_WAIT);
+    if (status != NX_SUCCESS)
+    {
+        // Try the last address
+        printf("ERROR: Unable to resolve %s (0x%08x)\n", MQTT_BROKER_HOST, status);
+        return;
+    }
+
+    mqtt_broker_address.nxd_ip_address.v4 = address;
+
+    // Kept for the next boot, which may find no DNS server; an unchanged address is not written again
+    dns_host_save(MQTT_BROKER_HOST, address);
+}
+#endif
+
+// Connects with a persistent session, so the broker keeps subscriptions and undelivered messages
+// The connect is pipelined: unacknowledged messages, subscriptions and the journal follow CONNECT
+// without waiting for CONNACK, so the session is running one round trip after the TCP handshake
+static UINT mqtt_connect_attempt()
+{
+    ULONG events;
+    UINT status;
+
+    tx_event_flags_set(&mqtt_supervisor_events, ~MQTT_CONNACK_EVENT, TX_AND);
+
+    boot_phase_start(BOOT_MQTT);
+#ifdef MQTT_BROKER_HOST
+    mqtt_broker_resolve();
+#endif
+    mqtt_subscriptions_queue();
+
+    status = nxd_mqtt_client_connect(&mqtt_client, &mqtt_broker_address,
+                                     MQTT_BROKER_PORT, MQTT_KEEPALIVE, NX_FALSE, NX_NO_WAIT);
+    if (status == NX_IN_PROGRESS)
+    {
+        if (tx_event_flags_get(&mqtt_supervisor_events, MQTT_CONNACK_EVENT, TX_OR_CLEAR, &events,
+                               MQTT_CONNECT_WAIT) == TX_SUCCESS)
+        {
+            status = mqtt_connect_status;
+        }
+        else
+        {
+            // No CONNACK in time: abandon the connection
+            nxd_mqtt_client_disconnect(&mqtt_client);
+            status = NXD_MQTT_CONNECT_FAILURE;
+        }
+    }
+
+    if (status != NX_SUCCESS)
+    {
+        printf("ERROR: MQTT connection failed (0x%08x)\n", status);
+        return status;
+    }
+
+    printf("MQTT connected successfully!\n");
+
+    return NX_SUCCESS;
+}
+
+// Whether the client is connected; the state may change right after
+static UINT mqtt_is_connected()
+{
+    UINT state;
+
+    return (nxd_mqtt_client_state_get(&mqtt_client, &state) == NX_SUCCESS) &&
+           (state == NXD_MQTT_CLIENT_STATE_CONNECTED);
+}
+
+// Called from the MQTT thread when the broker, the network or a ping timeout ends the connection
+static VOID mqtt_disconnect_notify(NXD_MQTT_CLIENT *client)
+{
+    (void)client;
+
+    printf("MQTT connection lost\n");
+
+    mqtt_outage_start = tx_time_get();
+    tx_event_flags_set(&mqtt_supervisor_events, MQTT_RECONNECT_EVENT, TX_OR);
+}
+
+// Retries until connected, with capped exponential backoff
+// Each delay is drawn between half and all of the backoff, so devices that lost the broker together
+// do not all come back at once
+static void mqtt_reconnect()
+{
+    ULONG backoff = MQTT_RECONNECT_DELAY_MIN;
+    ULONG delay;
+    ULONG recover_time;
+    UINT attempts = 0;
+    UINT status;
+
+    do
+    {
+        delay = backoff / 2 + (ULONG)NX_RAND() % (backoff / 2 + 1);
+        backoff = (backoff < MQTT_RECONNECT_DELAY_MAX / 2) ? backoff * 2 : MQTT_RECONNECT_DELAY_MAX;
+
+        printf("MQTT reconnecting in %lu ms\n", delay * 1000 / TX_TIMER_TICKS_PER_SECOND);
+        tx_thread_sleep(delay);
+        attempts++;
+
+        // Rejoin the Wi-Fi first if the link is down
+        if (!wwd_network_is_connected())
+        {
+            wwd_network_connect();
+            if (!wwd_network_is_connected())
+            {
+                status = NX_NOT_CONNECTED;
+                continue;
+            }
+        }
+
+        status = mqtt_connect_attempt();
+    } while (status != NX_SUCCESS);
+
+    recover_time = tx_time_get() - mqtt_outage_start;
+    mqtt_recover_count++;
+    mqtt_recover_time_last = recover_time;
+    if (recover_time > mqtt_recover_time_max)
+    {
+        mqtt_recover_time_max = recover_time;
+    }
+
+    printf("MQTT recovered in %lu ms after %u attempts (longest %lu ms over %lu recoveries)\n",
+           recover_time * 1000 / TX_TIMER_TICKS_PER_SECOND, attempts,
+           mqtt_recover_time_max * 1000 / TX_TIMER_TICKS_PER_SECOND, mqtt_recover_count);
+}
+
+#ifdef MQTT_METRICS_TOPIC
+// Appends a latency histogram to the metrics JSON, and returns the new length
+// Bucket n counts latencies of 2^(n-1) to 2^n - 1 ticks, bucket 0 those under a tick
+static UINT mqtt_metrics_histogram_print(char *json, UINT length, const char *name, const UINT *histogram)
+{
+    UINT i;
+
+    length += snprintf(&json[length], MQTT_METRICS_JSON_SIZE - length, ",\"%s\":[", name);
+    for (i = 0; (i < NXD_MQTT_METRICS_HISTOGRAM_SIZE) && (length < MQTT_METRICS_JSON_SIZE); i++)
+    {
+        length += snprintf(&json[length], MQTT_METRICS_JSON_SIZE - length, i ? ",%u" : "%u", histogram[i]);
+    }
+    if (length < MQTT_METRICS_JSON_SIZE)
+    {
+        length += snprintf(&json[length], MQTT_METRICS_JSON_SIZE - length, "]");
+    }
+
+    return length;
+}
+
+// Publishes a snapshot of the client metrics as compact JSON, with QoS 0 since the next one follows
+// The message is copied into the packet, so the buffer is free again on return
+static void mqtt_metrics_publish(void)
+{
+    static char json[MQTT_METRICS_JSON_SIZE];
+    NXD_MQTT_METRICS metrics;
+    UINT length;
+    UINT status;
+
+    if (nxd_mqtt_client_metrics_get(&mqtt_client, &metrics) != NX_SUCCESS)
+    {
+        return;
+    }
+
+    length = snprintf(json, sizeof(json),
+                      "{\"tick_hz\":%u,\"sent\":%u,\"received\":%u,\"retransmits\":%u,\"pool_failures\":%u,"
+                      "\"control_drops\":%u,\"pings\":%u,\"ping_timeouts\":%u,\"connections\":%u,\"receive_peak\":%u,\"inflight_peak\":%u,"
+                      "\"long_topics\":%u,\"handler_overflows\":%u,\"recoveries\":%lu,\"recover_max_ms\":%lu",
+                      TX_TIMER_TICKS_PER_SECOND, metrics.nxd_mqtt_metrics_publishes_sent,
+                      metrics.nxd_mqtt_metrics_publishes_received, metrics.nxd_mqtt_metrics_retransmits,
+                      metrics.nxd_mqtt_metrics_pool_failures, metrics.nxd_mqtt_metrics_control_drops,
+                      metrics.nxd_mqtt_metrics_pings_sent,
+                      metrics.nxd_mqtt_metrics_ping_timeouts, metrics.nxd_mqtt_metrics_connections,
+                      metrics.nxd_mqtt_metrics_receive_queue_peak, metrics.nxd_mqtt_metrics_inflight_peak,
+                      metrics.nxd_mqtt_metrics_dispatch_long_topics, metrics.nxd_mqtt_metrics_dispatch_overflows,
+                      mqtt_recover_count, mqtt_recover_time_max * 1000 / TX_TIMER_TICKS_PER_SECOND);
+    if (length < sizeof(json))
+    {
+        length = mqtt_metrics_histogram_print(json, length, "ack_ticks", metrics.nxd_mqtt_metrics_ack_latency);
+    }
+    if (length < sizeof(json))
+    {
+        length = mqtt_metrics_histogram_print(json, length, "ping_ticks", metrics.nxd_mqtt_metrics_ping_latency);
+    }
+    if (length < sizeof(json))
+    {
+        length += snprintf(&json[length], sizeof(json) - length, "}");
+    }
+    if (length >= sizeof(json))
+    {
+        printf("ERROR: MQTT metrics do not fit %u bytes\n", MQTT_METRICS_JSON_SIZE);
+        return;
+    }
+
+    status = nxd_mqtt_client_publish(&mqtt_client, MQTT_METRICS_TOPIC, strlen(MQTT_METRICS_TOPIC),
+                                     json, length, NX_FALSE, 0, NX_NO_WAIT);
+    if (status != NX_SUCCESS)
+    {
+        printf("ERROR: MQTT metrics publish failed (0x%08x)\n", status);
+    }
+}
+#endif
+
+#ifdef MQTT_BOOT_TRACE_TOPIC
+// Publishes the boot trace as JSON of microseconds since reset per milestone
+static void mqtt_boot_trace_publish(void)
+{
+    static char json[MQTT_BOOT_TRACE_JSON_SIZE];
+    UINT length;
+    UINT status;
+
+    length = boot_trace_json(json, sizeof(json));
+    if (length == 0)
+    {
+        printf("ERROR: Boot trace does not fit %u bytes\n", MQTT_BOOT_TRACE_JSON_SIZE);
+        return;
+    }
+
+    status = nxd_mqtt_client_publish(&mqtt_client, MQTT_BOOT_TRACE_TOPIC, strlen(MQTT_BOOT_TRACE_TOPIC),
+                                     json, length, NX_FALSE, 0, NX_NO_WAIT);
+    if (status != NX_SUCCESS)
+    {
+        printf("ERROR: Boot trace publish failed (0x%08x)\n", status);
+    }
+}
+#endif
+
+// Reconnects on a lost connection, and ends the connection itself when the Wi-Fi link drops,
+// rather than waiting for the keepalive to time out
+static void mqtt_supervisor_entry(ULONG parameter)
+{
+    ULONG events;
+
+    (void)parameter;
+
+    while (1)
+    {
+        tx_event_flags_get(&mqtt_supervisor_events, MQTT_RECONNECT_EVENT, TX_OR_CLEAR, &events, MQTT_LINK_CHECK_INTERVAL);
+
+        if (mqtt_is_connected())
+        {
+            if (wwd_network_is_connected())
+            {
+#ifdef MQTT_METRICS_TOPIC
+                if ((tx_time_get() - mqtt_metrics_time) >= MQTT_METRICS_INTERVAL)
+                {
+                    mqtt_metrics_time = tx_time_get();
+                    mqtt_metrics_publish();
+                }
+#endif
+#ifdef MQTT_BOOT_TRACE_TOPIC
+                if (mqtt_boot_trace_pending)
+                {
+                    mqtt_boot_trace_pending = NX_FALSE;
+                    mqtt_boot_trace_publish();
+                }
+#endif
+                continue;
+            }
+
+            printf("Wi-Fi link lost\n");
+
+            // The session is kept by the broker, and notifying the loss sets the outage start
+            nxd_mqtt_client_disconnect(&mqtt_client);
+        }
+
+        mqtt_reconnect();
+    }
 }
 
 // Function to connect to MQTT broker
 void mqtt_connect()
 {
     UINT status;
-    NXD_ADDRESS broker_address;
+#ifdef MQTT_BROKER_HOST
+    ULONG address;
+#endif
+
+    // Connect as soon as the network phases the broker needs are done
+    boot_phase_wait(MQTT_BOOT_PHASES, TX_WAIT_FOREVER);
 
     // Set MQTT broker IP
-    broker_address.nxd_ip_version = NX_IP_VERSION_V4;
-    broker_address.nxd_ip_address.v4 = IP_ADDRESS(18, 134, 118, 11);
+    mqtt_broker_address.nxd_ip_version = NX_IP_VERSION_V4;
+    mqtt_broker_address.nxd_ip_address.v4 = IP_ADDRESS(18, 134, 118, 11);
+
+#ifdef MQTT_BROKER_HOST
+    // The address saved by an earlier boot is cached as expired, so it is only served while no DNS server answers
+    if (dns_host_load(MQTT_BROKER_HOST, &address) == NX_SUCCESS)
+    {
+        mqtt_broker_address.nxd_ip_address.v4 = address;
+#ifdef NX_DNS_CACHE_ENABLE
+        nx_dns_cache_host_add(&nx_dns_client, (UCHAR*)MQTT_BROKER_HOST, address, 0);
+#endif
+    }
+#endif
 
     // Create MQTT client
     status = nxd_mqtt_client_create(
@@ -43,70 +491,265 @@ void mqtt_connect()
         return;
     }
 
-    // Connect to broker
-    status = nxd_mqtt_client_connect(&mqtt_client, &broker_address, 
-                                     MQTT_BROKER_PORT, 60, NX_TRUE, NX_WAIT_FOREVER);
+    // Messages no subscription handler matched
+    nxd_mqtt_client_receive_notify_set(&mqtt_client, mqtt_callback);
+    nxd_mqtt_client_disconnect_notify_set(&mqtt_client, mqtt_disconnect_notify);
+
+    // Send subscriptions and queued messages behind CONNECT, and learn the CONNACK outcome here
+    nxd_mqtt_client_pipeline_set(&mqtt_client, NX_TRUE);
+    nxd_mqtt_client_connect_notify_set(&mqtt_client, mqtt_connect_notify, NX_NULL);
+
+    // Trace the connection milestones of the boot
+    nxd_mqtt_client_tcp_establish_notify_set(&mqtt_client, mqtt_tcp_establish_notify);
+    nxd_mqtt_client_ack_receive_notify_set(&mqtt_client, mqtt_ack_notify, NX_NULL);
+
+    // Pack bursts, such as the journal drain and its acknowledgements, into shared TCP segments
+    nxd_mqtt_client_cork_set(&mqtt_client, MQTT_CORK_DELAY);
+
+#ifdef MQTT_V5_RECEIVE_MAXIMUM
+    // Topic aliases shorten queued QoS 0 messages, and the broker never sends more than fits a message slot
+    nxd_mqtt_client_v5_set(&mqtt_client, MQTT_V5_RECEIVE_MAXIMUM, MQTT_V5_PACKET_SIZE_MAX);
+#endif
+
+    // Keep publishing through Wi-Fi drops
+    nxd_mqtt_client_journal_set(&mqtt_client, mqtt_journal, sizeof(mqtt_journal), MQTT_JOURNAL_RATE);
+
+    // Only the latest socket state is worth sending after a drop
+    nxd_mqtt_client_journal_topic_set(&mqtt_client, MQTT_SOCKET_TOPIC, strlen(MQTT_SOCKET_TOPIC),
+                                      NXD_MQTT_JOURNAL_LAST_VALUE);
+
+    nxd_mqtt_client_topic_prepare(&mqtt_socket_topic, MQTT_SOCKET_TOPIC, strlen(MQTT_SOCKET_TOPIC));
+
+    tx_event_flags_create(&mqtt_supervisor_events, "MQTT supervisor");
+
+    // Connect to broker, leaving retries to the supervisor
+    if (mqtt_connect_attempt() != NX_SUCCESS)
+    {
+        mqtt_outage_start = tx_time_get();
+        tx_event_flags_set(&mqtt_supervisor_events, MQTT_RECONNECT_EVENT, TX_OR);
+    }
+
+    // Started after the first attempt, so only one thread connects at a time
+    tx_thread_create(&mqtt_supervisor_thread, "MQTT supervisor", mqtt_supervisor_entry, 0,
+                     mqtt_supervisor_stack, MQTT_SUPERVISOR_STACK_SIZE,
+                     MQTT_SUPERVISOR_PRIORITY, MQTT_SUPERVISOR_PRIORITY, TX_NO_TIME_SLICE, TX_AUTO_START);
+}
+
+// Called from the MQTT thread once a published message is delivered or given up
+static void mqtt_publish_complete(NXD_MQTT_CLIENT *client, UINT handle, UINT status, VOID *context)
+{
+    (void)client;
+
     if (status != NX_SUCCESS)
     {
-        printf("ERROR: MQTT connection failed (0x%08x)\n", status);
+        printf("ERROR: MQTT publish %u failed (0x%08x)\n", handle, status);
+    }
+    else
+    {
+        printf("MQTT message %u published to %s\n", handle, (const char *)context);
+    }
+}
+
+// Function to publish a message to a given topic
+// QoS 2 delivers exactly once, for commands that must not be repeated
+// The message is queued for the MQTT thread, so topic and msg must stay valid until it completes
+void mqtt_publish(const char *topic, const char *msg, UINT qos)
+{
+    ULONG journal_used;
+    UINT handle;
+    UINT status;
+
+    // While offline, or behind messages still in the journal, the message is copied to the journal
+    nxd_mqtt_client_journal_used_get(&mqtt_client, &journal_used);
+    if (!mqtt_is_connected() || journal_used)
+    {
+        status = nxd_mqtt_client_publish(&mqtt_client, (CHAR *)topic, strlen(topic),
+                                         (CHAR *)msg, strlen(msg), NX_FALSE, qos, NX_NO_WAIT);
+        if (status != NX_SUCCESS)
+        {
+            printf("ERROR: MQTT publish failed (0x%08x)\n", status);
+        }
+        else
+        {
+            printf("MQTT message for %s kept until connected: %s\n", topic, msg);
+        }
         return;
     }
 
-    printf("MQTT connected successfully!\n");
+    status = nxd_mqtt_client_publish_async(&mqtt_client, 
+                                           (CHAR *)topic, strlen(topic),  // Cast `topic` to `CHAR *`
+                                           (CHAR *)msg, strlen(msg),      // Cast `msg` to `CHAR *`
+                                           NX_FALSE, qos, mqtt_publish_complete, (VOID *)topic, &handle);
+
+    if (status == NXD_MQTT_REQUEST_QUEUE_FULL)
+    {
+        printf("MQTT publish queue full, dropped message to %s\n", topic);
+    }
+    else if (status != NX_SUCCESS)
+    {
+        printf("ERROR: MQTT publish failed (0x%08x)\n", status);
+    }
+    else
+    {
+        printf("MQTT message %u queued for %s: %s\n", handle, topic, msg);
+    }
 }
 
-// Function to publish a message to a given topic
-void mqtt_publish(const char *topic, const char *msg)
+// Publishes a smart extension command on the prepared topic with QoS 2
+// Sent from the calling thread, or kept in the journal while offline
+void mqtt_socket_publish(const char *msg)
 {
-    UINT status = nxd_mqtt_client_publish(&mqtt_client, 
-                                          (CHAR *)topic, strlen(topic),  // Cast `topic` to `CHAR *`
-                                          (CHAR *)msg, strlen(msg),      // Cast `msg` to `CHAR *`
-                                          NX_FALSE, 0, NX_WAIT_FOREVER);
+    UINT status;
 
+    status = nxd_mqtt_client_topic_publish(&mqtt_client, &mqtt_socket_topic,
+                                           (CHAR *)msg, strlen(msg), NX_FALSE, 2, NX_NO_WAIT);
     if (status != NX_SUCCESS)
     {
         printf("ERROR: MQTT publish failed (0x%08x)\n", status);
     }
     else
     {
-        printf("MQTT message published to %s: %s\n", topic, msg);
+        printf("MQTT message for %s sent: %s\n", MQTT_SOCKET_TOPIC, msg);
     }
 }
 
 
-// Callback function to handle received messages
-void mqtt_callback(NXD_MQTT_CLIENT *client, UINT num_messages)
+// Copies one part of a message as a string, and returns its length
+static UINT mqtt_message_copy(NXD_MQTT_MESSAGE *message, UINT part, char *buffer, UINT buffer_size)
 {
-    UINT topic_length, message_length;
-    CHAR topic_buffer[100];
+    UCHAR *data;
+    ULONG data_length;
+    ULONG offset;
+    UINT copied = 0;
+
+    // The part is read in place from the packet, one span at a time
+    for (offset = 0;
+         (nxd_mqtt_client_message_span_get(message, part, offset, &data, &data_length) == NXD_MQTT_SUCCESS) &&
+         data_length && (copied < buffer_size - 1);
+         offset += data_length)
+    {
+        if (data_length > buffer_size - 1 - copied)
+        {
+            data_length = buffer_size - 1 - copied;
+        }
+        memcpy(&buffer[copied], data, data_length);
+        copied += data_length;
+    }
+    buffer[copied] = '\0';
+
+    return copied;
+}
+
+// Handler for messages matching a subscribed topic filter, called from the MQTT thread
+void mqtt_message_handler(NXD_MQTT_CLIENT *client, NXD_MQTT_MESSAGE *message, VOID *context)
+{
+    ULONG slot;
+    MQTT_RECEIVED_MESSAGE *received;
+
+    (void)client;
+    (void)context;
+
+    // Never block the MQTT thread: drop the message if the application has no slot free
+    if (tx_queue_receive(&mqtt_free_queue, &slot, TX_NO_WAIT) != TX_SUCCESS)
+    {
+        mqtt_messages_dropped++;
+        printf("MQTT message dropped, %lu so far\n", mqtt_messages_dropped);
+        return;
+    }
+
+    received = &mqtt_messages[slot];
+    mqtt_message_copy(message, NXD_MQTT_MESSAGE_TOPIC, received->topic, sizeof(received->topic));
+    received->payload_length = mqtt_message_copy(message, NXD_MQTT_MESSAGE_PAYLOAD,
+                                                 received->payload, sizeof(received->payload));
+
+    // There are as many queue entries as slots, so this cannot fail
+    tx_queue_send(&mqtt_message_queue, &slot, TX_NO_WAIT);
+}
 
-    // Read the received message
-    nxd_mqtt_client_message_get(client, (UCHAR*)topic_buffer, sizeof(topic_buffer), &topic_length,
-                                (UCHAR*)received_message, sizeof(received_message), &message_length);
+// Callback function to handle received messages no subscription handler matched
+void mqtt_callback(NXD_MQTT_CLIENT *client, UINT num_messages)
+{
+    NXD_MQTT_MESSAGE message;
 
-    // Ensure strings are null-terminated
-    topic_buffer[topic_length] = '\0';
-    received_message[message_length] = '\0';
+    (void)num_messages;
 
-    printf("Received message on topic %s: %s\n", topic_buffer, received_message);
+    while (nxd_mqtt_client_message_borrow(client, &message) == NXD_MQTT_SUCCESS)
+    {
+        mqtt_message_handler(client, &message, NX_NULL);
+        nxd_mqtt_client_message_release(client, &message);
+    }
 }
 
-// Function to subscribe to a given topic and return the received message
-char* mqtt_subscribe(const char *topic)
+// Function to subscribe to a topic filter once
+// A filter already subscribed is not sent again, and every filter is resubscribed with each reconnect
+// The topic filter is not copied, so it must stay valid
+UINT mqtt_subscribe(const char *topic, UINT qos)
 {
-    UINT status = nxd_mqtt_client_subscribe(&mqtt_client, 
-                                            (CHAR *)topic, strlen(topic), 0); // Cast `topic` to `CHAR *`
+    UINT index;
+    UINT free_index = MQTT_SUBSCRIPTION_MAX;
+    UINT status = NX_SUCCESS;
+
+    for (index = 0; index < MQTT_SUBSCRIPTION_MAX; index++)
+    {
+        if (mqtt_subscriptions[index].topic == NULL)
+        {
+            if (free_index == MQTT_SUBSCRIPTION_MAX)
+            {
+                free_index = index;
+            }
+        }
+        else if (strcmp(mqtt_subscriptions[index].topic, topic) == 0)
+        {
+            return NX_SUCCESS;
+        }
+    }
+
+    if (free_index == MQTT_SUBSCRIPTION_MAX)
+    {
+        printf("ERROR: No room to subscribe to %s\n", topic);
+        return NXD_MQTT_INSUFFICIENT_BUFFER_SPACE;
+    }
+
+    mqtt_subscriptions[free_index].topic = topic;
+    mqtt_subscriptions[free_index].qos = qos;
+
+    // While disconnected, the filter is subscribed on the next connect
+    if (mqtt_is_connected())
+    {
+        status = mqtt_subscription_send(free_index);
+    }
 
     if (status != NX_SUCCESS)
     {
+        mqtt_subscriptions[free_index].topic = NULL;
         printf("ERROR: MQTT subscribe failed (0x%08x)\n", status);
-        return NULL;
     }
     else
     {
         printf("Subscribed to topic: %s\n", topic);
-        nxd_mqtt_client_receive_notify_set(&mqtt_client, mqtt_callback);
-        return received_message;  // Return received message after callback
     }
+
+    return status;
 }
 
+// Function to take the oldest received message, waiting up to wait_option ticks for one
+UINT mqtt_message_receive(MQTT_RECEIVED_MESSAGE **message, ULONG wait_option)
+{
+    ULONG slot;
+    UINT status = tx_queue_receive(&mqtt_message_queue, &slot, wait_option);
+
+    if (status == TX_SUCCESS)
+    {
+        *message = &mqtt_messages[slot];
+    }
+
+    return status;
+}
+
+// Function to return the slot of a received message once it has been handled
+void mqtt_message_release(MQTT_RECEIVED_MESSAGE *message)
+{
+    ULONG slot = (ULONG)(message - mqtt_messages);
+
+    tx_queue_send(&mqtt_free_queue, &slot, TX_NO_WAIT);
+}
@@ -3,18 +3,68 @@
 
 #include "nxd_mqtt_client.h"
 #include "cloud_config.h"  // ✅ Ensure cloud_config.h is included
+#include "boot.h"
 
 // #define MQTT_BROKER_IP       "18.134.118.11"
 #define MQTT_BROKER_PORT     1883
+// #define MQTT_BROKER_HOST     "broker.example.com" // Look the broker up before each connect instead of the fixed address
 
 #define MQTT_STACK_SIZE 4096
 #define MQTT_THREAD_PRIORITY 3
 
+#define MQTT_SUPERVISOR_STACK_SIZE  2048
+#define MQTT_SUPERVISOR_PRIORITY    4
+
+#define MQTT_KEEPALIVE              60                                // Seconds
+#define MQTT_CONNECT_WAIT           (10 * TX_TIMER_TICKS_PER_SECOND)  // Limit of one connect attempt
+#define MQTT_RECONNECT_DELAY_MIN    (1 * TX_TIMER_TICKS_PER_SECOND)   // First backoff after a drop
+#define MQTT_RECONNECT_DELAY_MAX    (60 * TX_TIMER_TICKS_PER_SECOND)  // Backoff cap
+#define MQTT_LINK_CHECK_INTERVAL    (5 * TX_TIMER_TICKS_PER_SECOND)   // Wi-Fi link polling while connected
+#define MQTT_CORK_DELAY             (TX_TIMER_TICKS_PER_SECOND / 50)  // Packets held to share a TCP segment
+#define MQTT_BROKER_DNS_WAIT        (2 * TX_TIMER_TICKS_PER_SECOND)   // First query timeout of a broker lookup
+#ifdef MQTT_BROKER_HOST
+#define MQTT_BOOT_PHASES            (BOOT_IP | BOOT_DNS)              // The broker is looked up; TLS would also need BOOT_TIME
+#else
+#define MQTT_BOOT_PHASES            (BOOT_IP)                         // The broker is an address; TLS would also need BOOT_TIME
+#endif
+
+#define MQTT_SOCKET_TOPIC           "office/smart_extension"          // Smart extension control topic
+
+#define MQTT_SUBSCRIPTION_MAX   4    // Topic filters kept subscribed
+#define MQTT_MESSAGE_SLOTS      4    // Received messages waiting for the application
+#define MQTT_TOPIC_SIZE         64
+#define MQTT_PAYLOAD_SIZE       256
+
+#define MQTT_JOURNAL_SIZE       (60 * 1024) // Messages kept in CCM RAM while disconnected
+#define MQTT_JOURNAL_RATE       10          // Journal messages sent per second after reconnecting
+
+// #define MQTT_V5_RECEIVE_MAXIMUM 8        // Connect with MQTT 5, allowing this many QoS 2 messages in flight
+#define MQTT_V5_PACKET_SIZE_MAX (MQTT_TOPIC_SIZE + MQTT_PAYLOAD_SIZE + 16) // Larger messages are dropped by the broker
+
+// #define MQTT_METRICS_TOPIC   "status/" MQTT_CLIENT_ID "/metrics" // Publish the client metrics here as JSON
+#define MQTT_METRICS_INTERVAL   (60 * TX_TIMER_TICKS_PER_SECOND)   // Time between metrics publishes
+#define MQTT_METRICS_JSON_SIZE  512
+
+// #define MQTT_BOOT_TRACE_TOPIC "status/" MQTT_CLIENT_ID "/boot" // Publish the boot trace here once, as JSON
+#define MQTT_BOOT_TRACE_JSON_SIZE 512
+
+// A received message, held in its slot until the application releases it
+typedef struct MQTT_RECEIVED_MESSAGE_STRUCT
+{
+    char topic[MQTT_TOPIC_SIZE];
+    char payload[MQTT_PAYLOAD_SIZE];
+    UINT payload_length;
+} MQTT_RECEIVED_MESSAGE;
+
 // Function declarations
 void mqtt_init();                               // Initializes MQTT client
-void mqtt_connect();                            // Connects to MQTT broker
-void mqtt_publish(const char *topic, const char *msg);  // Publishes to any topic
-char* mqtt_subscribe(const char *topic);        // Subscribes and returns received message
+void mqtt_connect();                            // Connects to MQTT broker, and reconnects whenever the connection is lost
+void mqtt_publish(const char *topic, const char *msg, UINT qos);  // Queues a publish to any topic, or journals it while offline
+void mqtt_socket_publish(const char *msg);                        // Publishes to the smart extension, exactly once
+UINT mqtt_subscribe(const char *topic, UINT qos);                 // Subscribes once, kept across reconnects
+UINT mqtt_message_receive(MQTT_RECEIVED_MESSAGE **message, ULONG wait_option); // Takes the oldest received message
+void mqtt_message_release(MQTT_RECEIVED_MESSAGE *message);        // Returns a message slot
+void mqtt_message_handler(NXD_MQTT_CLIENT *client, NXD_MQTT_MESSAGE *message, VOID *context); // Handler for subscribed topics
 void mqtt_callback(NXD_MQTT_CLIENT *client, UINT num_messages); // Callback for messages
 
 #endif /* MQTT_CLIENT_H */
@@ -41,6 +41,7 @@
                                
 /* Define the DHCP Internal Function.  */
 static VOID        _nx_dhcp_thread_entry(ULONG ip_instance);
+static VOID        _nx_dhcp_event_process(NX_DHCP *dhcp_ptr, ULONG events);
 static UINT        _nx_dhcp_extract_information(NX_DHCP *dhcp_ptr, NX_DHCP_INTERFACE_RECORD *interface_record, UCHAR *dhcp_message, UINT length);
 static UINT        _nx_dhcp_get_option_value(UCHAR *bootp_message, UINT option, ULONG *value, UINT length);
 static UINT        _nx_dhcp_add_option_value(UCHAR *bootp_message, UINT option, UINT size, ULONG value, UINT *index);
@@ -57,6 +58,7 @@ static UINT        _nx_dhcp_client_send_with_zero_source_address(NX_DHCP *dhcp_p
 static ULONG       _nx_dhcp_add_randomize(ULONG timeout);
 static VOID        _nx_dhcp_udp_receive_notify(NX_UDP_SOCKET *socket_ptr);
 static VOID        _nx_dhcp_packet_process(NX_DHCP *dhcp_ptr, NX_DHCP_INTERFACE_RECORD *dhcp_interface, NX_PACKET *packet_ptr);
+static VOID        _nx_dhcp_address_accept(NX_DHCP *dhcp_ptr, NX_DHCP_INTERFACE_RECORD *interface_record);
 static VOID        _nx_dhcp_timeout_entry(ULONG dhcp);
 static VOID        _nx_dhcp_timeout_process(NX_DHCP *dhcp_ptr);
 static UINT        _nx_dhcp_interface_record_find(NX_DHCP *dhcp_ptr, UINT iface_index, NX_DHCP_INTERFACE_RECORD **interface_record);
@@ -5080,9 +5082,8 @@ NX_DHCP     *dhcp_ptr;
 /*                                                                        */ 
 /*    This function is the processing thread for the DHCP Client.         */
 /*    Its processing consists of executing a while-forever loop that      */ 
-/*    checks for events (e.g. packet receive, timer expiration). For      */ 
-/*    received packets, some initial packet validation is done before     */
-/*    calling _nx_dhcp_packet_process.                                    */
+/*    waits for events (e.g. packet receive, timer expiration) and hands  */ 
+/*    them to _nx_dhcp_event_process.                                     */
 /*                                                                        */ 
 /*  INPUT                                                                 */ 
 /*                                                                        */ 
@@ -5095,12 +5096,9 @@ NX_DHCP     *dhcp_ptr;
 /*  CALLS                                                                 */ 
 /*                                                                        */ 
 /*    tx_event_flags_get                    Check for events              */
-/*    _nx_udp_socket_receive                Retrieve packet from socket   */
-/*    _nx_dhcp_interface_record_find        Find record of this interface */
 /*    tx_mutex_get                          Get the DHCP mutex            */ 
 /*    tx_mutex_put                          Release the DHCP mutex        */ 
-/*    _nx_dhcp_packet_process               Process received packet       */ 
-/*    _nx_dhcp_timout_entry                 Process timer expiration      */
+/*    _nx_dhcp_event_process                Process the events            */
 /*                                                                        */ 
 /*  CALLED BY                                                             */ 
 /*                                                                        */ 
@@ -5119,14 +5117,7 @@ static VOID  _nx_dhcp_thread_entry(ULONG dhcp_instance)
 {
 
 NX_DHCP                  *dhcp_ptr;
-NX_PACKET                *packet_ptr;
 ULONG                     events;
-UINT                      status;
-UINT                      iface_index;
-UINT                      source_port;
-ULONG                     source_ip_address;
-UINT                      protocol;
-NX_DHCP_INTERFACE_RECORD *interface_record = NX_NULL;
 
     /* Setup the DHCP pointer.  */
     NX_THREAD_EXTENSION_PTR_GET(dhcp_ptr, NX_DHCP, dhcp_instance)
@@ -5148,89 +5139,141 @@ NX_DHCP_INTERFACE_RECORD *interface_record = NX_NULL;
         /* Obtain the DHCP mutex before processing an.  */
         tx_mutex_get(&(dhcp_ptr -> nx_dhcp_mutex), TX_WAIT_FOREVER);
 
-        /* Check for DHCP data received event.  */
-        if  (events & NX_DHCP_CLIENT_RECEIVE_EVENT)
-        {
+        /* Process the events.  */
+        _nx_dhcp_event_process(dhcp_ptr, events);
 
-            /* Loop to receive DHCP message.  */
-            while(1)
-            {
+    } while (1);
+}
 
-                /* Check for an incoming DHCP packet with non blocking option. */
-                status = _nx_udp_socket_receive(&dhcp_ptr -> nx_dhcp_socket, &packet_ptr, NX_NO_WAIT);
 
-                /* Check for packet receive errors. */
-                if (status != NX_SUCCESS)
-                {
-                    break;
-                }
+/**************************************************************************/ 
+/*                                                                        */ 
+/*  FUNCTION                                               RELEASE        */ 
+/*                                                                        */ 
+/*    _nx_dhcp_event_process                              PORTABLE C      */ 
+/*                                                           6.3.0        */
+/*                                                                        */
+/*  DESCRIPTION                                                           */ 
+/*                                                                        */ 
+/*    This function processes the events of the DHCP Client thread, with  */
+/*    the DHCP mutex held. For received packets, some initial packet      */
+/*    validation is done before calling _nx_dhcp_packet_process.          */
+/*                                                                        */ 
+/*  INPUT                                                                 */ 
+/*                                                                        */ 
+/*    dhcp_ptr                              Pointer to DHCP instance      */ 
+/*    events                                Events to process             */ 
+/*                                                                        */ 
+/*  OUTPUT                                                                */ 
+/*                                                                        */ 
+/*    None                                                                */ 
+/*                                                                        */ 
+/*  CALLS                                                                 */ 
+/*                                                                        */ 
+/*    _nx_udp_socket_receive                Retrieve packet from socket   */
+/*    nx_udp_packet_info_extract            Find source of the packet     */
+/*    _nx_dhcp_interface_record_find        Find record of this interface */
+/*    _nx_dhcp_packet_process               Process received packet       */ 
+/*    _nx_dhcp_timeout_process              Process timer expiration      */
+/*    _nx_dhcp_interface_decline            Decline a conflicting address */
+/*                                                                        */ 
+/*  CALLED BY                                                             */ 
+/*                                                                        */ 
+/*    _nx_dhcp_thread_entry                 DHCP Client thread            */ 
+/*                                                                        */ 
+/**************************************************************************/
+static VOID  _nx_dhcp_event_process(NX_DHCP *dhcp_ptr, ULONG events)
+{
 
-                /* Find the source IP address, port, interface this packet is on. */
-                status = nx_udp_packet_info_extract(packet_ptr, &source_ip_address, &protocol, &source_port, &iface_index);
+NX_PACKET                *packet_ptr;
+UINT                      status;
+UINT                      iface_index;
+UINT                      source_port;
+ULONG                     source_ip_address;
+UINT                      protocol;
+NX_DHCP_INTERFACE_RECORD *interface_record = NX_NULL;
 
-                /* Check status.  */
-                if (status != NX_SUCCESS) 
-                {
+    /* Check for DHCP data received event.  */
+    if  (events & NX_DHCP_CLIENT_RECEIVE_EVENT)
+    {
 
-                    nx_packet_release(packet_ptr); 
-                    continue;
-                }
+        /* Loop to receive DHCP message.  */
+        while(1)
+        {
 
-                /* Find the interface record.  */
-                status = _nx_dhcp_interface_record_find(dhcp_ptr, iface_index, &interface_record);
+            /* Check for an incoming DHCP packet with non blocking option. */
+            status = _nx_udp_socket_receive(&dhcp_ptr -> nx_dhcp_socket, &packet_ptr, NX_NO_WAIT);
 
-                /* Check status.  */
-                if (status != NX_SUCCESS)
-                {
+            /* Check for packet receive errors. */
+            if (status != NX_SUCCESS)
+            {
+                break;
+            }
 
-                    /* Release the original packet . */
-                    nx_packet_release(packet_ptr);
-                    continue;
-                }
-                
-                /* Process DHCP packet.  */
-                _nx_dhcp_packet_process(dhcp_ptr, interface_record, packet_ptr);
+            /* Find the source IP address, port, interface this packet is on. */
+            status = nx_udp_packet_info_extract(packet_ptr, &source_ip_address, &protocol, &source_port, &iface_index);
+
+            /* Check status.  */
+            if (status != NX_SUCCESS) 
+            {
+
+                nx_packet_release(packet_ptr); 
+                continue;
             }
-        }
 
-        /* Timer event.  */
-        if (events & NX_DHCP_CLIENT_TIMER_EVENT)
-        {
-            _nx_dhcp_timeout_process(dhcp_ptr);
+            /* Find the interface record.  */
+            status = _nx_dhcp_interface_record_find(dhcp_ptr, iface_index, &interface_record);
+
+            /* Check status.  */
+            if (status != NX_SUCCESS)
+            {
+
+                /* Release the original packet . */
+                nx_packet_release(packet_ptr);
+                continue;
+            }
+            
+            /* Process DHCP packet.  */
+            _nx_dhcp_packet_process(dhcp_ptr, interface_record, packet_ptr);
         }
+    }
+
+    /* Timer event.  */
+    if (events & NX_DHCP_CLIENT_TIMER_EVENT)
+    {
+        _nx_dhcp_timeout_process(dhcp_ptr);
+    }
 
 #ifdef NX_DHCP_CLIENT_SEND_ARP_PROBE
 
-        /* IP address conflict event.  */
-        if (events & NX_DHCP_CLIENT_CONFLICT_EVENT)
+    /* IP address conflict event.  */
+    if (events & NX_DHCP_CLIENT_CONFLICT_EVENT)
+    {
+
+        /* Loop to check the interface.  */
+        for (iface_index = 0; iface_index < NX_MAX_PHYSICAL_INTERFACES; iface_index++)
         {
 
-            /* Loop to check the interface.  */
-            for (iface_index = 0; iface_index < NX_MAX_PHYSICAL_INTERFACES; iface_index++)
+            /* Check the flag.  */
+            if (dhcp_ptr -> nx_dhcp_interface_conflict_flag == 0)
             {
+                break;
+            }
 
-                /* Check the flag.  */
-                if (dhcp_ptr -> nx_dhcp_interface_conflict_flag == 0)
-                {
-                    break;
-                }
-
-                /* Check if IP address conflict for this interface.  */
-                if (dhcp_ptr -> nx_dhcp_interface_conflict_flag & ((UINT)(1 << iface_index)))
-                {
+            /* Check if IP address conflict for this interface.  */
+            if (dhcp_ptr -> nx_dhcp_interface_conflict_flag & ((UINT)(1 << iface_index)))
+            {
 
-                    /* Handle notice of address conflict event. Let the server know we
-                       did not get assigned a unique IP address. */
-                    _nx_dhcp_interface_decline(dhcp_ptr, iface_index);
+                /* Handle notice of address conflict event. Let the server know we
+                   did not get assigned a unique IP address. */
+                _nx_dhcp_interface_decline(dhcp_ptr, iface_index);
 
-                    /* Clear the flag.  */
-                    dhcp_ptr -> nx_dhcp_interface_conflict_flag &= (UINT)(~(1 << iface_index));
-                }
+                /* Clear the flag.  */
+                dhcp_ptr -> nx_dhcp_interface_conflict_flag &= (UINT)(~(1 << iface_index));
             }
         }
+    }
 #endif /* NX_DHCP_CLIENT_SEND_ARP_PROBE  */
-
-    } while (1);
 }
 
 
@@ -5273,6 +5316,7 @@ NX_DHCP_INTERFACE_RECORD *interface_record = NX_NULL;
 /*   _nx_dhcp_get_option_value              Get data for input option     */
 /*   _nx_dhcp_extract_information           Extract basic info from packet*/
 /*   _nx_dhcp_send_request_internal         Send DHCP message             */
+/*   _nx_dhcp_address_accept                Probe or bind the address     */
 /*   nx_ip_interface_address_set            Set IP interface address      */
 /*   nx_ip_gateway_address_set              Set IP gateway address        */
 /*   _nx_dhcp_interface_reinitialize        Clear DHCP interface data     */
@@ -5309,8 +5353,8 @@ ULONG       packet_client_mac_msw, packet_client_mac_lsw;
 ULONG       dhcp_client_mac_msw, dhcp_client_mac_lsw;
 UINT        original_state;
 UCHAR       *buffer;
-#ifdef NX_DHCP_CLIENT_SEND_ARP_PROBE
-ULONG       probing_delay;
+#ifdef NX_DHCP_CLIENT_RAPID_COMMIT
+ULONG       rapid_commit;
 #endif
 
     /* Set the IP pointer and interface index.  */
@@ -5445,6 +5489,24 @@ ULONG       probing_delay;
                 /* Update the state to Requesting state.  */
                 interface_record -> nx_dhcp_state = NX_DHCP_STATE_REQUESTING;
            }
+#ifdef NX_DHCP_CLIENT_RAPID_COMMIT
+
+            /* An ACK to the Discover is only valid with the Rapid Commit option. RFC 4039, Section 4.  */
+            else if ((status == NX_SUCCESS) && (dhcp_type == NX_DHCP_TYPE_DHCPACK) &&
+                     (_nx_dhcp_get_option_value(buffer, NX_DHCP_OPTION_RAPID_COMMIT, &rapid_commit, new_packet_ptr -> nx_packet_length) == NX_SUCCESS))
+            {
+
+                /* Increment the number of ACKs received.  */
+                interface_record -> nx_dhcp_acks_received++;
+
+                /* Update the parameters (IP address, server IP, lease, renewal and rebind times */
+                if (_nx_dhcp_extract_information(dhcp_ptr, interface_record, buffer, new_packet_ptr -> nx_packet_length))
+                    break;
+
+                /* The server committed the address, skip the Request.  */
+                _nx_dhcp_address_accept(dhcp_ptr, interface_record);
+            }
+#endif /* NX_DHCP_CLIENT_RAPID_COMMIT */
 
            /* Let the timeout processing handle retransmissions. We're done here */
            break;
@@ -5486,55 +5548,8 @@ ULONG       probing_delay;
                     if (_nx_dhcp_extract_information(dhcp_ptr, interface_record, buffer, new_packet_ptr -> nx_packet_length))
                         break;
 
-                    /* If the host is configured to send an ARP probe to verify Client address is 
-                       not in use, do so now. */
-
-#ifdef NX_DHCP_CLIENT_SEND_ARP_PROBE
-
-                    /* Change to the Address Probing state.  */
-                    interface_record -> nx_dhcp_state =  NX_DHCP_STATE_ADDRESS_PROBING;
-
-                    /* Initalize the time for probing.  */        
-                    probing_delay = (ULONG)NX_RAND() % (NX_DHCP_ARP_PROBE_WAIT);
-
-                    /* Check the probing_delay for timer interval.  */
-                    if (probing_delay)
-                        interface_record -> nx_dhcp_timeout = probing_delay;
-                    else
-                        interface_record -> nx_dhcp_timeout = 1;
-
-                    /* Set the probing count.  */
-                    interface_record -> nx_dhcp_probe_count = NX_DHCP_ARP_PROBE_NUM;
-
-                    /* Setup the handler to indicate the we want collision notification.  */
-                    ip_ptr -> nx_ip_interface[iface_index].nx_interface_ip_conflict_notify_handler = _nx_dhcp_ip_conflict;
-
-#else    /* NX_DHCP_CLIENT_SEND_ARP_PROBE not defined: */
-
-                    nx_ip_interface_address_set(ip_ptr, iface_index, 
-                                                interface_record -> nx_dhcp_ip_address,
-                                                interface_record -> nx_dhcp_network_mask);
-
-                    /* Check if the gateway address is valid.  */
-                    if (interface_record -> nx_dhcp_gateway_address)
-                    {
-
-                        /* Set the gateway address.  */
-                        nx_ip_gateway_address_set(dhcp_ptr -> nx_dhcp_ip_ptr, interface_record -> nx_dhcp_gateway_address);
-                    }
-
-                    /* No ARP probe performed. OK to change to the Bound state.  */
-                    interface_record -> nx_dhcp_state =  NX_DHCP_STATE_BOUND;
-
-#ifdef NX_DHCP_ENABLE_BOOTP
-                    /* BOOTP does not use timeouts.  For the life of this DHCP Client application, keep the same IP address. */
-                    interface_record -> nx_dhcp_timeout = NX_WAIT_FOREVER; 
-#else
-                    /* Set the renewal time received from the server.  */
-                    interface_record -> nx_dhcp_timeout = interface_record -> nx_dhcp_renewal_time;
-#endif /* NX_DHCP_ENABLE_BOOTP  */
-
-#endif /* NX_DHCP_CLIENT_SEND_ARP_PROBE*/
+                    /* Probe the address or bind to it.  */
+                    _nx_dhcp_address_accept(dhcp_ptr, interface_record);
 
                     break;
                 }
@@ -5746,6 +5761,111 @@ ULONG       probing_delay;
 }
 
 
+/**************************************************************************/ 
+/*                                                                        */ 
+/*  FUNCTION                                               RELEASE        */ 
+/*                                                                        */ 
+/*    _nx_dhcp_address_accept                             PORTABLE C      */ 
+/*                                                           6.3.0        */
+/*                                                                        */
+/*  DESCRIPTION                                                           */ 
+/*                                                                        */ 
+/*    This function is called once a server has acknowledged the address, */
+/*    either in answer to a Request or to a Rapid Commit Discover. It     */
+/*    starts the ARP probe if enabled, or else sets the address and moves */
+/*    to the Bound state. With NX_DHCP_CLIENT_ARP_PROBE_CONCURRENT the    */
+/*    address is set before the probe, so it is usable while probing.     */
+/*                                                                        */ 
+/*  INPUT                                                                 */ 
+/*                                                                        */ 
+/*    dhcp_ptr                              Pointer to DHCP instance      */ 
+/*    interface_record                      Pointer to DHCP interface     */
+/*                                                                        */ 
+/*  OUTPUT                                                                */ 
+/*                                                                        */ 
+/*    None                                                                */ 
+/*                                                                        */ 
+/*  CALLS                                                                 */ 
+/*                                                                        */ 
+/*   nx_ip_interface_address_set            Set IP interface address      */
+/*   nx_ip_gateway_address_set              Set IP gateway address        */
+/*                                                                        */ 
+/*  CALLED BY                                                             */ 
+/*                                                                        */ 
+/*    _nx_dhcp_packet_process               Process received packets      */ 
+/*                                                                        */ 
+/**************************************************************************/
+static VOID  _nx_dhcp_address_accept(NX_DHCP *dhcp_ptr, NX_DHCP_INTERFACE_RECORD *interface_record)
+{
+
+NX_IP       *ip_ptr;
+UINT        iface_index;
+#ifdef NX_DHCP_CLIENT_SEND_ARP_PROBE
+ULONG       probing_delay;
+#endif
+
+
+    /* Set the IP pointer and interface index.  */
+    ip_ptr = dhcp_ptr -> nx_dhcp_ip_ptr;
+    iface_index = interface_record -> nx_dhcp_interface_index;
+
+#if !defined(NX_DHCP_CLIENT_SEND_ARP_PROBE) || defined(NX_DHCP_CLIENT_ARP_PROBE_CONCURRENT)
+
+    /* Set the IP address and gateway address from the value extracted from the Server's DHCP response. */
+    nx_ip_interface_address_set(ip_ptr, iface_index, 
+                                interface_record -> nx_dhcp_ip_address,
+                                interface_record -> nx_dhcp_network_mask);
+
+    /* Check if the gateway address is valid.  */
+    if (interface_record -> nx_dhcp_gateway_address)
+    {
+
+        /* Set the gateway address.  */
+        nx_ip_gateway_address_set(ip_ptr, interface_record -> nx_dhcp_gateway_address);
+    }
+#endif
+
+    /* If the host is configured to send an ARP probe to verify Client address is 
+       not in use, do so now. */
+
+#ifdef NX_DHCP_CLIENT_SEND_ARP_PROBE
+
+    /* Change to the Address Probing state.  */
+    interface_record -> nx_dhcp_state =  NX_DHCP_STATE_ADDRESS_PROBING;
+
+    /* Initalize the time for probing.  */        
+    probing_delay = (ULONG)NX_RAND() % (NX_DHCP_ARP_PROBE_WAIT);
+
+    /* Check the probing_delay for timer interval.  */
+    if (probing_delay)
+        interface_record -> nx_dhcp_timeout = probing_delay;
+    else
+        interface_record -> nx_dhcp_timeout = 1;
+
+    /* Set the probing count.  */
+    interface_record -> nx_dhcp_probe_count = NX_DHCP_ARP_PROBE_NUM;
+
+    /* Setup the handler to indicate the we want collision notification. With the address already set,
+       a conflict is reported by any host answering for it, and the address is declined.  */
+    ip_ptr -> nx_ip_interface[iface_index].nx_interface_ip_conflict_notify_handler = _nx_dhcp_ip_conflict;
+
+#else    /* NX_DHCP_CLIENT_SEND_ARP_PROBE not defined: */
+
+    /* No ARP probe performed. OK to change to the Bound state.  */
+    interface_record -> nx_dhcp_state =  NX_DHCP_STATE_BOUND;
+
+#ifdef NX_DHCP_ENABLE_BOOTP
+    /* BOOTP does not use timeouts.  For the life of this DHCP Client application, keep the same IP address. */
+    interface_record -> nx_dhcp_timeout = NX_WAIT_FOREVER; 
+#else
+    /* Set the renewal time received from the server.  */
+    interface_record -> nx_dhcp_timeout = interface_record -> nx_dhcp_renewal_time;
+#endif /* NX_DHCP_ENABLE_BOOTP  */
+
+#endif /* NX_DHCP_CLIENT_SEND_ARP_PROBE*/
+}
+
+
 /**************************************************************************/ 
 /*                                                                        */ 
 /*  FUNCTION                                               RELEASE        */ 
@@ -6764,6 +6884,12 @@ UINT            name_length;
             _nx_dhcp_add_option_value(buffer, NX_DHCP_OPTION_MAX_DHCP_MESSAGE, 2, dhcp_ptr -> nx_dhcp_max_dhcp_message_size, &index);
 #endif
 
+#ifdef NX_DHCP_CLIENT_RAPID_COMMIT
+
+            /* Ask the server to commit the address with an ACK to this Discover. RFC 4039, Section 4.  */
+            _nx_dhcp_add_option_value(buffer, NX_DHCP_OPTION_RAPID_COMMIT, NX_DHCP_OPTION_RAPID_COMMIT_SIZE, 0, &index);
+#endif
+
             /* Increment the number of Discovery messages sent.  */
             interface_record -> nx_dhcp_discoveries_sent++;
             break;
@@ -7391,6 +7517,9 @@ static UINT  _nx_dhcp_extract_information(NX_DHCP *dhcp_ptr, NX_DHCP_INTERFACE_R
 {
 
 ULONG       value;
+#ifdef NX_DHCP_CLIENT_RAPID_COMMIT
+ULONG       dhcp_type = 0;
+#endif
 
 
     /* Extract the IP address.  */
@@ -7583,9 +7712,21 @@ ULONG       value;
         }
     }
 
+#ifdef NX_DHCP_CLIENT_RAPID_COMMIT
+
+    /* A Rapid Commit ACK answers the Discover, so it comes in the Selecting state.  */
+    if (interface_record -> nx_dhcp_state == NX_DHCP_STATE_SELECTING)
+    {
+        _nx_dhcp_get_option_value(dhcp_message, NX_DHCP_OPTION_DHCP_TYPE, &dhcp_type, length);
+    }
+#endif /* NX_DHCP_CLIENT_RAPID_COMMIT */
+
     /* Determine if this is an ACK from a server response, which can only happen from a handful of states.  */
     if ((interface_record -> nx_dhcp_state == NX_DHCP_STATE_REQUESTING) ||
         (interface_record -> nx_dhcp_state == NX_DHCP_STATE_RENEWING) ||
+#ifdef NX_DHCP_CLIENT_RAPID_COMMIT
+        (dhcp_type == NX_DHCP_TYPE_DHCPACK) ||
+#endif /* NX_DHCP_CLIENT_RAPID_COMMIT */
         (interface_record -> nx_dhcp_state == NX_DHCP_STATE_REBINDING))
     {
 
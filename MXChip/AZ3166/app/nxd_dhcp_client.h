@@ -89,6 +89,18 @@ extern   "C" {
 #define NX_DHCP_CLIENT_SEND_ARP_PROBE
 */
 
+/* Defined with NX_DHCP_CLIENT_SEND_ARP_PROBE, the address is set as soon as the server
+   acknowledges it and the ARP probe runs in the background instead of delaying it. A conflict
+   found by the probe still declines the address and restarts DHCP.
+#define NX_DHCP_CLIENT_ARP_PROBE_CONCURRENT
+*/
+
+/* Enables the Rapid Commit option in the Discover message (RFC 4039). A server supporting it
+   answers with an ACK, binding in two messages instead of four. Other servers answer with an
+   Offer as usual.
+#define NX_DHCP_CLIENT_RAPID_COMMIT
+*/
+
 /* Enables DHCP Client send Maximum DHCP Message Size Option. RFC2132, Section9.10, Page29.
 #define NX_DHCP_CLIENT_SEND_MAX_DHCP_MESSAGE_OPTION
 */
@@ -302,6 +314,8 @@ extern   "C" {
 #define NX_DHCP_OPTION_REBIND_SIZE      4
 #define NX_DHCP_OPTION_CLIENT_ID        61
 #define NX_DHCP_OPTION_CLIENT_ID_SIZE   7 /* 1 byte for address type (01 = Ethernet), 6 bytes for address */ 
+#define NX_DHCP_OPTION_RAPID_COMMIT     80
+#define NX_DHCP_OPTION_RAPID_COMMIT_SIZE 0
 #define NX_DHCP_OPTION_FDQN             81
 #define NX_DHCP_OPTION_FDQN_FLAG_N      8
 #define NX_DHCP_OPTION_FDQN_FLAG_E      4
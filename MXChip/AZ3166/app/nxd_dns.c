@@ -79,11 +79,13 @@ static UINT        _nx_dns_process_soa_type(NX_DNS *dns_ptr, NX_PACKET *packet_p
 #ifdef NX_DNS_CACHE_ENABLE   
 static UINT        _nx_dns_name_match(UCHAR *src, UCHAR *dst, UINT length);
 static UINT        _nx_dns_cache_add_rr(NX_DNS *dns_ptr, VOID *cache_ptr, UINT cache_size, NX_DNS_RR *record_ptr, NX_DNS_RR **insert_ptr);     
-static UINT        _nx_dns_cache_find_answer(NX_DNS *dns_ptr, VOID *cache_ptr, UCHAR *query_name, USHORT query_type, UCHAR *buffer, UINT buffer_size, UINT *record_count);
+static UINT        _nx_dns_cache_find_answer(NX_DNS *dns_ptr, VOID *cache_ptr, UCHAR *query_name, USHORT query_type, UCHAR *buffer, UINT buffer_size, UINT *record_count, UINT stale);
 static UINT        _nx_dns_cache_delete_rr(NX_DNS *dns_ptr, VOID *cache_ptr, UINT cache_size, NX_DNS_RR *record_ptr);   
 static UINT        _nx_dns_cache_delete_rr_string(NX_DNS *dns_ptr, VOID *cache_ptr, UINT cache_size, NX_DNS_RR *record_ptr);
 static UINT        _nx_dns_cache_add_string(NX_DNS *dns_ptr, VOID *cache_ptr, UINT cache_size, VOID *string_ptr, UINT string_size, VOID **insert_ptr);
 static UINT        _nx_dns_cache_delete_string(NX_DNS *dns_ptr, VOID *cache_ptr, UINT cache_size, VOID *string_ptr, UINT string_len);  
+static UINT        _nx_dns_cache_record_add(NX_DNS *dns_ptr, UCHAR *name, USHORT type, USHORT rr_class, ULONG ttl, ULONG value);
+static UINT        _nx_dns_cache_name_hash(UCHAR *name);
 static UINT        _nx_dns_resource_time_to_live_get(UCHAR *resource, NX_PACKET *packet_ptr, ULONG *rr_ttl);
 #endif /* NX_DNS_CACHE_ENABLE  */
 
@@ -3938,7 +3940,8 @@ UINT        i;
 #ifdef NX_DNS_CACHE_ENABLE
 
     /* Find the answer in local cache.  */
-    if(_nx_dns_cache_find_answer(dns_ptr, dns_ptr -> nx_dns_cache, host_name, (USHORT)lookup_type, buffer, buffer_size, record_count) == NX_DNS_SUCCESS)
+    status = _nx_dns_cache_find_answer(dns_ptr, dns_ptr -> nx_dns_cache, host_name, (USHORT)lookup_type, buffer, buffer_size, record_count, NX_FALSE);
+    if (status == NX_DNS_SUCCESS)
     {           
 
         /* Put the DNS mutex.  */
@@ -3946,6 +3949,23 @@ UINT        i;
 
         return (NX_DNS_SUCCESS);
     }
+
+    /* Check whether the last query for this name failed recently.  */
+    if ((status == NX_DNS_NAME_ERROR) || (status == NX_DNS_QUERY_FAILED))
+    {
+
+        /* The servers were not reachable, an expired answer is better than none.  */
+        if ((status == NX_DNS_QUERY_FAILED) &&
+            (_nx_dns_cache_find_answer(dns_ptr, dns_ptr -> nx_dns_cache, host_name, (USHORT)lookup_type, buffer, buffer_size, record_count, NX_TRUE) == NX_DNS_SUCCESS))
+        {
+            status = NX_DNS_SUCCESS;
+        }
+
+        /* Put the DNS mutex.  */
+        tx_mutex_put(&dns_ptr -> nx_dns_mutex);
+
+        return(status);
+    }
 #endif /*NX_DNS_CACHE_ENABLE.  */
 
     /* Determine if there is at least one DNS server. Is there anything in the first slot? */
@@ -4031,9 +4051,17 @@ UINT        i;
                         return(status);
                     }
                 }
+
+                /* The name does not exist, asking the other servers will not change that.  */
+                if (status == NX_DNS_NAME_ERROR)
+                    break;
             }
         }
 
+        /* Check whether the server answered that the name does not exist.  */
+        if (status == NX_DNS_NAME_ERROR)
+            break;
+
         /* Timed out for querying all DNS servers in this cycle, double the timeout, limited to NX_DNS_MAX_RETRANS_TIMEOUT.  */
         if (wait_option <= (NX_DNS_MAX_RETRANS_TIMEOUT >> 1))
             wait_option =  (wait_option << 1);
@@ -4044,11 +4072,29 @@ UINT        i;
     /* Unbind the socket.  */
     nx_udp_socket_unbind(&(dns_ptr -> nx_dns_socket));
 
+    /* Only a nonexistent name is reported as such, any other failure means no server answered.  */
+    if (status != NX_DNS_NAME_ERROR)
+        status = NX_DNS_QUERY_FAILED;
+
+#ifdef NX_DNS_CACHE_ENABLE
+
+    /* Record the failure, so the next queries for this name do not wait on the servers again.  */
+    _nx_dns_cache_record_add(dns_ptr, host_name, (USHORT)lookup_type, NX_DNS_RR_CLASS_NEGATIVE,
+                             (status == NX_DNS_NAME_ERROR) ? NX_DNS_CACHE_NEGATIVE_TTL : NX_DNS_CACHE_FAILURE_TTL, status);
+
+    /* The servers were not reachable, an expired answer is better than none.  */
+    if ((status == NX_DNS_QUERY_FAILED) &&
+        (_nx_dns_cache_find_answer(dns_ptr, dns_ptr -> nx_dns_cache, host_name, (USHORT)lookup_type, buffer, buffer_size, record_count, NX_TRUE) == NX_DNS_SUCCESS))
+    {
+        status = NX_DNS_SUCCESS;
+    }
+#endif /* NX_DNS_CACHE_ENABLE  */
+
     /* Release protection.  */
     tx_mutex_put(&dns_ptr -> nx_dns_mutex);
 
     /* Failed on all servers, return DNS lookup failed status.  */
-    return(NX_DNS_QUERY_FAILED);
+    return(status);
 }
 
 
@@ -4940,6 +4986,16 @@ UINT                host_name_size;
     /* Check that the packet has a valid response record.  */
     status =  _nx_dns_network_to_short_convert(packet_ptr -> nx_packet_prepend_ptr + NX_DNS_FLAGS_OFFSET);
 
+    /* Check whether the server answered that the name does not exist.  */
+    if ((status & (NX_DNS_RESPONSE_FLAG | NX_DNS_RCODE_MASK)) == (NX_DNS_RESPONSE_FLAG | NX_DNS_RCODE_NAME_ERR))
+    {
+
+        /* Release the source packet.  */
+        nx_packet_release(packet_ptr);
+
+        return NX_DNS_NAME_ERROR;
+    }
+
     /* Check for indication of DNS server error (cannot authenticate answer or authority portion 
        of the DNS data. */
     if ((status & NX_DNS_ERROR_MASK) == NX_DNS_ERROR_MASK)
@@ -5323,7 +5379,7 @@ ULONG           rr_ttl;
 
             /* Get data address and check if it is valid. */ 
             data_ptr = _nx_dns_resource_data_address_get(data_ptr, packet_ptr);
-            if ((!data_ptr) || ((data_ptr + sizeof(ULONG)) > packet_ptr -> nx_packet_append_ptr))
+            if ((!data_ptr) || ((data_ptr + 4) > packet_ptr -> nx_packet_append_ptr))
             {
 
                 /* Return!  */
@@ -5460,7 +5516,7 @@ ULONG           rr_ttl;
 
                         /* Get data address and check if it is valid. */ 
                         data_ptr = _nx_dns_resource_data_address_get(data_ptr, packet_ptr);
-                        if ((!data_ptr) || ((data_ptr + sizeof(ULONG)) > packet_ptr -> nx_packet_append_ptr))
+                        if ((!data_ptr) || ((data_ptr + 4) > packet_ptr -> nx_packet_append_ptr))
                         {
 
                             /* Return!  */
@@ -5551,7 +5607,7 @@ ULONG           rr_ttl;
 
                         /* Get data address and check if it is valid. */ 
                         data_ptr = _nx_dns_resource_data_address_get(data_ptr, packet_ptr);
-                        if ((!data_ptr) || ((data_ptr + sizeof(ULONG)) > packet_ptr -> nx_packet_append_ptr))
+                        if ((!data_ptr) || ((data_ptr + 4) > packet_ptr -> nx_packet_append_ptr))
                         {
 
                             /* Return!  */
@@ -5641,7 +5697,7 @@ ULONG           rr_ttl;
 
                         /* Get data address and check if it is valid. */ 
                         data_ptr = _nx_dns_resource_data_address_get(data_ptr, packet_ptr);
-                        if ((!data_ptr) || ((data_ptr + sizeof(ULONG)) > packet_ptr -> nx_packet_append_ptr))
+                        if ((!data_ptr) || ((data_ptr + 4) > packet_ptr -> nx_packet_append_ptr))
                         {
 
                             /* Return!  */
@@ -7760,7 +7816,7 @@ UINT        length, index;
 #ifdef NX_DNS_CACHE_ENABLE
                           
     /* Find the answer in local cache.  */
-    if(_nx_dns_cache_find_answer(dns_ptr, dns_ptr -> nx_dns_cache, ip_question, NX_DNS_RR_TYPE_PTR, host_name_ptr, host_name_buffer_size, NX_NULL) == NX_DNS_SUCCESS)
+    if(_nx_dns_cache_find_answer(dns_ptr, dns_ptr -> nx_dns_cache, ip_question, NX_DNS_RR_TYPE_PTR, host_name_ptr, host_name_buffer_size, NX_NULL, NX_FALSE) == NX_DNS_SUCCESS)
     {           
 
         /* Release the mutex. */
@@ -9459,6 +9515,9 @@ ALIGN_TYPE *tail;
     dns_ptr -> nx_dns_string_count = 0;
     dns_ptr -> nx_dns_string_bytes = 0;
 
+    /* Clear the name index.  */
+    memset(dns_ptr -> nx_dns_cache_hash, 0, sizeof(dns_ptr -> nx_dns_cache_hash));
+
     /* Put the DNS mutex.  */
     tx_mutex_put(&dns_ptr -> nx_dns_mutex);
 
@@ -9719,6 +9778,126 @@ UINT _nx_dns_cache_notify_clear(NX_DNS *dns_ptr)
 }       
 #endif /* NX_DNS_CACHE_ENABLE  */
 
+#ifdef NX_DNS_CACHE_ENABLE
+/**************************************************************************/ 
+/*                                                                        */ 
+/*  FUNCTION                                               RELEASE        */ 
+/*                                                                        */ 
+/*    _nxe_dns_cache_host_add                             PORTABLE C      */ 
+/*                                                           6.3.0        */
+/*                                                                        */
+/*  DESCRIPTION                                                           */ 
+/*                                                                        */ 
+/*    This function checks for errors in the DNS cache host add function  */ 
+/*    call.                                                               */
+/*                                                                        */ 
+/*  INPUT                                                                 */ 
+/*                                                                        */ 
+/*    dns_ptr                           Pointer to DNS instance           */ 
+/*    host_name                         Name of the host                  */ 
+/*    host_address                      IPv4 address of the host          */ 
+/*    ttl                               Time to live in seconds           */ 
+/*                                                                        */ 
+/*  OUTPUT                                                                */ 
+/*                                                                        */ 
+/*    status                                Completion status             */ 
+/*                                                                        */ 
+/*  CALLS                                                                 */ 
+/*                                                                        */ 
+/*    _nx_dns_cache_host_add            Actual cache host add function    */ 
+/*                                                                        */ 
+/*  CALLED BY                                                             */ 
+/*                                                                        */ 
+/*    Application Code                                                    */ 
+/*                                                                        */ 
+/**************************************************************************/
+UINT _nxe_dns_cache_host_add(NX_DNS *dns_ptr, UCHAR *host_name, ULONG host_address, ULONG ttl)
+{
+
+UINT    status;
+
+
+    /* Check for invalid input pointers.  */
+    if ((!dns_ptr) || (!host_name))
+    {    
+        return(NX_PTR_ERROR);
+    }
+        
+    /* Check for invalid non pointer input. */
+    if ((dns_ptr -> nx_dns_id != NX_DNS_ID) || (host_address == 0))
+    {
+        return(NX_DNS_PARAM_ERROR);
+    }
+
+    /* Check that the cache is initialized.  */
+    if (!dns_ptr -> nx_dns_cache)
+    {
+        return(NX_DNS_CACHE_ERROR);
+    }
+
+    /* Call actual DNS cache host add function.  */
+    status =  _nx_dns_cache_host_add(dns_ptr, host_name, host_address, ttl);
+
+    /* Return status.  */
+    return(status);
+}
+
+
+/**************************************************************************/ 
+/*                                                                        */ 
+/*  FUNCTION                                               RELEASE        */ 
+/*                                                                        */ 
+/*    _nx_dns_cache_host_add                              PORTABLE C      */ 
+/*                                                           6.3.0        */
+/*                                                                        */
+/*  DESCRIPTION                                                           */ 
+/*                                                                        */ 
+/*    This function adds an IPv4 address for a host name to the cache, as */ 
+/*    if a server had answered with it. A record added with a TTL of zero */ 
+/*    is expired, and is only served when no DNS server answers. This     */ 
+/*    lets the application restore an address it saved before a reboot.  */ 
+/*                                                                        */ 
+/*  INPUT                                                                 */ 
+/*                                                                        */ 
+/*    dns_ptr                           Pointer to DNS instance           */ 
+/*    host_name                         Name of the host                  */ 
+/*    host_address                      IPv4 address of the host          */ 
+/*    ttl                               Time to live in seconds           */ 
+/*                                                                        */ 
+/*  OUTPUT                                                                */ 
+/*                                                                        */ 
+/*    status                                Completion status             */ 
+/*                                                                        */ 
+/*  CALLS                                                                 */ 
+/*                                                                        */ 
+/*    tx_mutex_get                      Get the DNS mutex                 */ 
+/*    tx_mutex_put                      Put the DNS mutex                 */ 
+/*    _nx_dns_cache_record_add          Add a record to the cache         */ 
+/*                                                                        */ 
+/*  CALLED BY                                                             */ 
+/*                                                                        */ 
+/*    Application Code                                                    */ 
+/*                                                                        */ 
+/**************************************************************************/
+UINT _nx_dns_cache_host_add(NX_DNS *dns_ptr, UCHAR *host_name, ULONG host_address, ULONG ttl)
+{
+
+UINT    status;
+
+
+    /* Get the DNS mutex.  */
+    tx_mutex_get(&(dns_ptr -> nx_dns_mutex), TX_WAIT_FOREVER);
+
+    /* Add the address record.  */
+    status = _nx_dns_cache_record_add(dns_ptr, host_name, NX_DNS_RR_TYPE_A, NX_DNS_RR_CLASS_IN, ttl, host_address);
+
+    /* Release the DNS mutex.  */
+    tx_mutex_put(&(dns_ptr -> nx_dns_mutex));
+
+    return(status);
+}
+#endif /* NX_DNS_CACHE_ENABLE  */
+
 
 #ifdef NX_DNS_CACHE_ENABLE
 /**************************************************************************/ 
@@ -9765,24 +9944,66 @@ ALIGN_TYPE  *tail;
 ALIGN_TYPE  *head;
 NX_DNS_RR   *p;
 NX_DNS_RR   *rr;       
+NX_DNS_RR   *next;
+NX_DNS_RR   **link_ptr;
 ULONG       elapsed_time;
 ULONG       current_time;
 ULONG       max_elapsed_time;
+UINT        name_length;
                             
                                    
     /* Check the cache.  */
     if (cache_ptr == NX_NULL)
         return(NX_DNS_CACHE_ERROR);
+
+    /* Check the name string.  */
+    if (_nx_utility_string_length_check((CHAR *)record_ptr -> nx_dns_rr_name, &name_length, NX_DNS_NAME_MAX))
+        return(NX_DNS_CACHE_ERROR);
                    
     /* Initialize the parameters.  */
     max_elapsed_time = 0;
     current_time = tx_time_get();
 
-    /* Get head and tail. */
-    tail = (ALIGN_TYPE*)((UCHAR*)cache_ptr + cache_size) - 1;
-    tail = (ALIGN_TYPE*)(*tail);
+    /* Get the name index bucket.  */
+    link_ptr = &(dns_ptr -> nx_dns_cache_hash[_nx_dns_cache_name_hash(record_ptr -> nx_dns_rr_name)]);
+
+    /* Delete the records of the same name and type this one replaces.  */
+    for (p = *link_ptr; p; p = next)
+    {
+
+        /* Get the next record before this one is deleted.  */
+        next = p -> nx_dns_rr_hash_next;
+
+        if ((p -> nx_dns_rr_type != record_ptr -> nx_dns_rr_type) ||
+            _nx_dns_name_match(p -> nx_dns_rr_name, record_ptr -> nx_dns_rr_name, name_length) ||
+            (p -> nx_dns_rr_name[name_length] != '\0'))
+            continue;
+
+        /* A recorded failure is replaced by any new record.  */
+        if (p -> nx_dns_rr_class != NX_DNS_RR_CLASS_NEGATIVE)
+        {
+
+            /* A failure does not replace the answers kept to be served stale.  */
+            if (record_ptr -> nx_dns_rr_class == NX_DNS_RR_CLASS_NEGATIVE)
+                continue;
+
+            /* An answer replaces the expired answers and its own previous copy.  */
+            if ((((current_time - p -> nx_dns_rr_last_used_time) / NX_IP_PERIODIC_RATE) < p -> nx_dns_rr_ttl) &&
+                memcmp(&(p -> nx_dns_rr_rdata), &(record_ptr -> nx_dns_rr_rdata), sizeof(p -> nx_dns_rr_rdata)))
+                continue;
+        }
+
+        /* Delete this record.  */
+        _nx_dns_cache_delete_rr(dns_ptr, cache_ptr, cache_size, p);
+    }
+
+    /* Update the head, the records deleted above may have moved it.  */
     head = (ALIGN_TYPE*)cache_ptr;
     head = (ALIGN_TYPE*)(*head);
+
+    /* Get tail. */
+    tail = (ALIGN_TYPE*)((UCHAR*)cache_ptr + cache_size) - 1;
+    tail = (ALIGN_TYPE*)(*tail);
                  
     /* Set the pointer.  */
     rr = NX_NULL;
@@ -9862,6 +10083,12 @@ ULONG       max_elapsed_time;
     /* Get the current time to set the elapsed time.  */
     rr -> nx_dns_rr_last_used_time = current_time;
 
+    /* Link the record at the end of its name index bucket.  */
+    while (*link_ptr)
+        link_ptr = &((*link_ptr) -> nx_dns_rr_hash_next);
+    rr -> nx_dns_rr_hash_next = NX_NULL;
+    *link_ptr = rr;
+
     /* Set the insert ptr.  */
     if(insert_ptr != NX_NULL)
         *insert_ptr = rr;
@@ -9903,6 +10130,7 @@ ULONG       max_elapsed_time;
 /*    buffer                            Pointer to buffer                 */ 
 /*    buffer_size                       The size of record_buffer         */
 /*    record_count                      The count of RR stored            */
+/*    stale                             Also serve expired answers        */
 /*                                                                        */ 
 /*  OUTPUT                                                                */ 
 /*                                                                        */  
@@ -9925,13 +10153,14 @@ ULONG       max_elapsed_time;
 /*                                            resulting in version 6.1    */
 /*                                                                        */
 /**************************************************************************/
-static UINT _nx_dns_cache_find_answer(NX_DNS *dns_ptr, VOID *cache_ptr, UCHAR *query_name, USHORT query_type, UCHAR *buffer, UINT buffer_size, UINT *record_count)
+static UINT _nx_dns_cache_find_answer(NX_DNS *dns_ptr, VOID *cache_ptr, UCHAR *query_name, USHORT query_type, UCHAR *buffer, UINT buffer_size, UINT *record_count, UINT stale)
 {
 
-ALIGN_TYPE          *head;
 NX_DNS_RR           *p;      
+NX_DNS_RR           *next;
 ULONG               current_time;   
 ULONG               elasped_ttl;    
+UINT                negative_status;
 UINT                old_count;
 UINT                answer_count;
 UCHAR               *buffer_prepend_ptr;
@@ -9961,6 +10190,7 @@ UINT                 mname_string_length;
         return(NX_DNS_CACHE_ERROR);
 
     /* Initialize the value.  */  
+    negative_status = NX_DNS_SUCCESS;
     old_count = 0;
     answer_count = 0;   
     if(record_count)
@@ -9975,17 +10205,12 @@ UINT                 mname_string_length;
     /* Get the current time.  */
     current_time = tx_time_get();
 
-    /* Get head. */
-    head = (ALIGN_TYPE*)cache_ptr;
-    head = (ALIGN_TYPE*)(*head);
-
-    /* Lookup the cache to delete the expired resource record and find the answer.  */ 
-    for(p = (NX_DNS_RR*)((UCHAR*)cache_ptr + sizeof(ALIGN_TYPE)); (ALIGN_TYPE*)p < head; p++)
+    /* Lookup the name index bucket to delete the expired resource record and find the answer.  */ 
+    for(p = dns_ptr -> nx_dns_cache_hash[_nx_dns_cache_name_hash(query_name)]; p; p = next)
     {
 
-        /* Check whether the resource record is valid. */
-        if (!p -> nx_dns_rr_name)
-            continue;  
+        /* Get the next record before this one is deleted.  */
+        next = p -> nx_dns_rr_hash_next;
 
         /* Calucate the elapsed time.  */
         elasped_ttl = (current_time - p -> nx_dns_rr_last_used_time) / NX_IP_PERIODIC_RATE;
@@ -9994,9 +10219,19 @@ UINT                 mname_string_length;
         if (elasped_ttl >= p -> nx_dns_rr_ttl)
         {
 
-            /* The resource record is expired, Delete the resource record.  */ 
-            _nx_dns_cache_delete_rr(dns_ptr, dns_ptr -> nx_dns_cache, dns_ptr -> nx_dns_cache_size, p); 
-            continue;
+            /* An expired answer is kept to be served stale for NX_DNS_CACHE_STALE_TIME, a failure is not.  */ 
+            if ((p -> nx_dns_rr_class == NX_DNS_RR_CLASS_NEGATIVE) ||
+                ((elasped_ttl - p -> nx_dns_rr_ttl) >= NX_DNS_CACHE_STALE_TIME))
+            {
+
+                /* The resource record is expired, Delete the resource record.  */ 
+                _nx_dns_cache_delete_rr(dns_ptr, dns_ptr -> nx_dns_cache, dns_ptr -> nx_dns_cache_size, p); 
+                continue;
+            }
+
+            /* Expired answers are only served when asked for.  */
+            if (!stale)
+                continue;
         }
 
         /* Check the resource record type.  */
@@ -10004,12 +10239,26 @@ UINT                 mname_string_length;
             continue;
 
         /* Check the resource record name.  */
-        if (_nx_dns_name_match(p -> nx_dns_rr_name, query_name, query_name_length))
+        if (_nx_dns_name_match(p -> nx_dns_rr_name, query_name, query_name_length) ||
+            (p -> nx_dns_rr_name[query_name_length] != '\0'))
             continue;      
 
-        /* Update the elasped time and ttl.  */
-        p -> nx_dns_rr_last_used_time = current_time;
-        p -> nx_dns_rr_ttl -= elasped_ttl;
+        /* Check whether the record is a failure of the last query.  */
+        if (p -> nx_dns_rr_class == NX_DNS_RR_CLASS_NEGATIVE)
+        {
+
+            /* Report the failure unless an answer is found.  */
+            if (!stale)
+                negative_status = (UINT)(p -> nx_dns_rr_rdata.nx_dns_rr_rdata_status);
+            continue;
+        }
+
+        /* Update the elasped time and ttl, an expired answer keeps aging.  */
+        if (elasped_ttl < p -> nx_dns_rr_ttl)
+        {
+            p -> nx_dns_rr_last_used_time = current_time;
+            p -> nx_dns_rr_ttl -= elasped_ttl;
+        }
         
         /* Yes, get the answer.  */
         
@@ -10266,6 +10515,12 @@ UINT                 mname_string_length;
             *record_count = answer_count;
         return (NX_DNS_SUCCESS);
     }
+    else if (negative_status != NX_DNS_SUCCESS)
+    {
+
+        /* Return the status of the failed query.  */
+        return(negative_status);
+    }
     else
     {
         return(NX_DNS_ERROR);
@@ -10315,12 +10570,28 @@ static UINT _nx_dns_cache_delete_rr(NX_DNS *dns_ptr, VOID *cache_ptr, UINT cache
 {
 
 ALIGN_TYPE  *head;
+NX_DNS_RR   **link_ptr;
 
 
     /* Check the cache.  */
     if (cache_ptr == NX_NULL)
         return(NX_DNS_CACHE_ERROR);
 
+    /* Unlink the record from its name index bucket. A record that was never added is not found.  */
+    if (record_ptr -> nx_dns_rr_name)
+    {
+        link_ptr = &(dns_ptr -> nx_dns_cache_hash[_nx_dns_cache_name_hash(record_ptr -> nx_dns_rr_name)]);
+        while (*link_ptr)
+        {
+            if (*link_ptr == record_ptr)
+            {
+                *link_ptr = record_ptr -> nx_dns_rr_hash_next;
+                break;
+            }
+            link_ptr = &((*link_ptr) -> nx_dns_rr_hash_next);
+        }
+    }
+
     /* Delete the resource record strings. */
     _nx_dns_cache_delete_rr_string(dns_ptr, cache_ptr,cache_size, record_ptr);
     
@@ -10404,6 +10675,16 @@ UINT    size;
     if (cache_ptr == NX_NULL)
         return(NX_DNS_CACHE_ERROR);
 
+    /* A recorded failure holds a status instead of rdata strings.  */
+    if (record_ptr -> nx_dns_rr_class == NX_DNS_RR_CLASS_NEGATIVE)
+    {
+
+        /* Delete the name string. */                      
+        _nx_dns_cache_delete_string(dns_ptr, cache_ptr, cache_size, record_ptr -> nx_dns_rr_name, 0);
+
+        return(NX_DNS_SUCCESS);
+    }
+
     /* Compare the resource record type.  */ 
     if((record_ptr -> nx_dns_rr_type == NX_DNS_RR_TYPE_PTR)
 #ifdef NX_DNS_ENABLE_EXTENDED_RR_TYPES
@@ -10636,7 +10917,7 @@ UCHAR       *p, *available, *start;
     *((USHORT*)(available - 4)) = 1;
 
     /* Clear last 4 bytes. */
-    *((ULONG*)(available - 8)) = 0;
+    *((UINT*)(available - 8)) = 0;
 
     /* Insert string to cache. */
     memcpy(available - string_len, string_ptr, string_size); /* Use case of memcpy is verified. */
@@ -10776,7 +11057,7 @@ USHORT      cnt;
                 {
                     
                     /* This slot is cleared. */
-                    while(*((ULONG*)string_ptr) == 0)
+                    while(*((UINT*)string_ptr) == 0)
                         string_ptr = (UCHAR*)string_ptr + 4;
                     
                     end = (ALIGN_TYPE*)((UCHAR*)string_ptr + 4);
@@ -10885,3 +11166,147 @@ UINT    index = 0;
     return(NX_DNS_SUCCESS);
 }
 #endif /* NX_DNS_CACHE_ENABLE  */       
+
+
+#ifdef NX_DNS_CACHE_ENABLE
+/**************************************************************************/ 
+/*                                                                        */ 
+/*  FUNCTION                                               RELEASE        */ 
+/*                                                                        */ 
+/*    _nx_dns_cache_record_add                            PORTABLE C      */ 
+/*                                                           6.3.0        */
+/*                                                                        */
+/*  DESCRIPTION                                                           */ 
+/*                                                                        */ 
+/*    This function adds a record holding a single value to the cache:    */ 
+/*    the address of an A record, or the query status of a record of      */ 
+/*    class NX_DNS_RR_CLASS_NEGATIVE. The caller holds the DNS mutex.     */ 
+/*                                                                        */ 
+/*  INPUT                                                                 */ 
+/*                                                                        */ 
+/*    dns_ptr                           Pointer to DNS instance           */ 
+/*    name                              Owner name of the record          */ 
+/*    type                              Record type                       */ 
+/*    rr_class                          Record class                      */ 
+/*    ttl                               Time to live in seconds           */ 
+/*    value                             Address or query status           */ 
+/*                                                                        */ 
+/*  OUTPUT                                                                */ 
+/*                                                                        */ 
+/*    status                                Completion status             */ 
+/*                                                                        */ 
+/*  CALLS                                                                 */ 
+/*                                                                        */ 
+/*    _nx_dns_cache_add_string          Add the name to the string table  */ 
+/*    _nx_dns_cache_delete_string       Delete the name string            */ 
+/*    _nx_dns_cache_add_rr              Add the record to the cache       */ 
+/*                                                                        */ 
+/*  CALLED BY                                                             */ 
+/*                                                                        */ 
+/*    _nx_dns_host_resource_data_by_name_get                              */ 
+/*                                      Get the resource data by name     */ 
+/*    _nx_dns_cache_host_add            Add a host address to the cache   */ 
+/*                                                                        */ 
+/**************************************************************************/
+static UINT _nx_dns_cache_record_add(NX_DNS *dns_ptr, UCHAR *name, USHORT type, USHORT rr_class, ULONG ttl, ULONG value)
+{
+
+NX_DNS_RR   temp_rr;
+UINT        name_length;
+
+
+    /* Check the cache.  */
+    if (dns_ptr -> nx_dns_cache == NX_NULL)
+        return(NX_DNS_CACHE_ERROR);
+
+    /* Check the name string.  */
+    if (_nx_utility_string_length_check((CHAR *)name, &name_length, NX_DNS_NAME_MAX))
+        return(NX_DNS_CACHE_ERROR);
+
+    /* Initialize the resource record.  */
+    memset(&temp_rr, 0, sizeof(NX_DNS_RR));
+    temp_rr.nx_dns_rr_type = type;
+    temp_rr.nx_dns_rr_class = rr_class;
+    temp_rr.nx_dns_rr_ttl = ttl;
+
+    /* Set the value.  */
+    if (rr_class == NX_DNS_RR_CLASS_NEGATIVE)
+        temp_rr.nx_dns_rr_rdata.nx_dns_rr_rdata_status = value;
+    else
+        temp_rr.nx_dns_rr_rdata.nx_dns_rr_rdata_a.nx_dns_rr_a_address = value;
+
+    /* Add the name string.  */
+    if (_nx_dns_cache_add_string(dns_ptr, dns_ptr -> nx_dns_cache, dns_ptr -> nx_dns_cache_size, name, name_length, (VOID **)(&(temp_rr.nx_dns_rr_name))))
+        return(NX_DNS_CACHE_ERROR);
+
+    /* Add the resource record.  */
+    if (_nx_dns_cache_add_rr(dns_ptr, dns_ptr -> nx_dns_cache, dns_ptr -> nx_dns_cache_size, &temp_rr, NX_NULL))
+    {
+
+        /* Delete the name string.  */
+        _nx_dns_cache_delete_string(dns_ptr, dns_ptr -> nx_dns_cache, dns_ptr -> nx_dns_cache_size, temp_rr.nx_dns_rr_name, 0);
+        return(NX_DNS_CACHE_ERROR);
+    }
+
+    return(NX_DNS_SUCCESS);
+}
+#endif /* NX_DNS_CACHE_ENABLE  */
+
+
+#ifdef NX_DNS_CACHE_ENABLE
+/**************************************************************************/ 
+/*                                                                        */ 
+/*  FUNCTION                                               RELEASE        */ 
+/*                                                                        */ 
+/*    _nx_dns_cache_name_hash                             PORTABLE C      */ 
+/*                                                           6.3.0        */
+/*                                                                        */
+/*  DESCRIPTION                                                           */ 
+/*                                                                        */ 
+/*    This function returns the name index bucket of a name. The letters  */ 
+/*    are hashed in lowercase, so that names _nx_dns_name_match considers */ 
+/*    equal share a bucket.                                               */ 
+/*                                                                        */ 
+/*  INPUT                                                                 */ 
+/*                                                                        */ 
+/*    name                                  Name string                   */ 
+/*                                                                        */ 
+/*  OUTPUT                                                                */ 
+/*                                                                        */ 
+/*    bucket                                Index in nx_dns_cache_hash    */ 
+/*                                                                        */ 
+/*  CALLS                                                                 */ 
+/*                                                                        */ 
+/*    None                                                                */ 
+/*                                                                        */ 
+/*  CALLED BY                                                             */ 
+/*                                                                        */ 
+/*    _nx_dns_cache_add_rr                  Add a record to the cache     */ 
+/*    _nx_dns_cache_find_answer             Find an answer in the cache   */ 
+/*    _nx_dns_cache_delete_rr               Delete a record from cache    */ 
+/*                                                                        */ 
+/**************************************************************************/
+static UINT  _nx_dns_cache_name_hash(UCHAR *name)
+{
+
+ULONG   hash = 2166136261UL;
+UCHAR   c;
+
+
+    /* FNV-1a over the name.  */
+    while (*name != '\0')
+    {
+        c = *name;
+        if (((c | 0x20) >= 'a') && ((c | 0x20) <= 'z'))
+            c = (UCHAR)(c | 0x20);
+
+        hash = (hash ^ c) * 16777619UL;
+        name ++;
+    }
+
+    /* Fold the high bits in, the low bits of FNV mix less.  */
+    hash ^= hash >> 16;
+
+    return((UINT)(hash & (NX_DNS_CACHE_HASH_SIZE - 1)));
+}
+#endif /* NX_DNS_CACHE_ENABLE  */
@@ -122,6 +122,7 @@ extern   "C" {
 #define NX_DNS_FEATURE_NOT_SUPPORTED    0xB5        /* The requested feature is not supported in this build */
 #define NX_DNS_NAME_MISMATCH            0xB6        /* The name mismatch.                                   */
 #define NX_DNS_CACHE_ERROR              0xB7        /* The Cache size is not enough.                        */ 
+#define NX_DNS_NAME_ERROR               0xB8        /* The server answered that the name does not exist.    */
 
 
 /* Define constants for the flags word.  */
@@ -307,6 +308,30 @@ extern   "C" {
 #define NX_DNS_MAX_COMPRESSION_POINTERS        16
 #endif
 
+/* Define the number of buckets in the cache name index. The value must be a power of two.  */
+#ifndef NX_DNS_CACHE_HASH_SIZE
+#define NX_DNS_CACHE_HASH_SIZE                  16
+#endif
+
+/* Define the time in seconds an expired answer is kept after its TTL. It is served
+   only when no DNS server answers the query.  */
+#ifndef NX_DNS_CACHE_STALE_TIME
+#define NX_DNS_CACHE_STALE_TIME                 86400
+#endif
+
+/* Define the time in seconds a name the server reported as nonexistent is cached.  */
+#ifndef NX_DNS_CACHE_NEGATIVE_TTL
+#define NX_DNS_CACHE_NEGATIVE_TTL               60
+#endif
+
+/* Define the time in seconds a query that no DNS server answered is cached.  */
+#ifndef NX_DNS_CACHE_FAILURE_TTL
+#define NX_DNS_CACHE_FAILURE_TTL                5
+#endif
+
+/* Define the class of the cache entries recording a failed query.  */
+#define NX_DNS_RR_CLASS_NEGATIVE                0xFFFF
+
 /* Define the basic DNS data structure.  */
 
 typedef struct NX_IP_DNS_STRUCT 
@@ -332,6 +357,8 @@ typedef struct NX_IP_DNS_STRUCT
     ULONG           nx_dns_string_count;                            /* The number of strings in the cache.                      */         
     ULONG           nx_dns_string_bytes;                            /* The number of total bytes in string table in the cache.  */ 
     VOID            (*nx_dns_cache_full_notify)(struct NX_IP_DNS_STRUCT *);
+    struct NX_DNS_RR_STRUCT
+                    *nx_dns_cache_hash[NX_DNS_CACHE_HASH_SIZE];     /* Resource records in the cache, chained by name hash.     */
 #endif /* NX_DNS_CACHE_ENABLE  */
 } NX_DNS;
 
@@ -815,8 +842,14 @@ typedef struct NX_DNS_RR_STRUCT
         NX_DNS_RR_NS        nx_dns_rr_rdata_ns;
         NX_DNS_RR_MX        nx_dns_rr_rdata_mx;  
         NX_DNS_RR_SOA       nx_dns_rr_rdata_soa; 
+        ULONG               nx_dns_rr_rdata_status;     /* Query status of a NX_DNS_RR_CLASS_NEGATIVE record.  */
     } nx_dns_rr_rdata;
 
+#ifdef NX_DNS_CACHE_ENABLE
+    struct NX_DNS_RR_STRUCT
+            *nx_dns_rr_hash_next;               /* Next resource record in the same name index bucket.      */
+#endif /* NX_DNS_CACHE_ENABLE  */
+
 }NX_DNS_RR;
 
 
@@ -867,6 +900,7 @@ typedef struct NX_DNS_RR_STRUCT
 #define nx_dns_cache_initialize                     _nx_dns_cache_initialize   
 #define nx_dns_cache_notify_set                     _nx_dns_cache_notify_set
 #define nx_dns_cache_notify_clear                   _nx_dns_cache_notify_clear
+#define nx_dns_cache_host_add                       _nx_dns_cache_host_add
 #endif /* NX_DNS_CACHE_ENABLE  */
 
 #else
@@ -907,6 +941,7 @@ typedef struct NX_DNS_RR_STRUCT
 #define nx_dns_cache_initialize                     _nxe_dns_cache_initialize   
 #define nx_dns_cache_notify_set                     _nxe_dns_cache_notify_set
 #define nx_dns_cache_notify_clear                   _nxe_dns_cache_notify_clear
+#define nx_dns_cache_host_add                       _nxe_dns_cache_host_add
 #endif /* NX_DNS_CACHE_ENABLE  */
 
 #endif
@@ -946,6 +981,7 @@ UINT        nxd_dns_server_get(NX_DNS *dns_ptr, UINT index, NXD_ADDRESS *dns_ser
 UINT        nx_dns_cache_initialize(NX_DNS *dns_ptr, VOID *cache_ptr, UINT cache_size); 
 UINT        nx_dns_cache_notify_set(NX_DNS *dns_ptr, VOID (*cache_full_notify_cb)(NX_DNS *dns_ptr));
 UINT        nx_dns_cache_notify_clear(NX_DNS *dns_ptr);    
+UINT        nx_dns_cache_host_add(NX_DNS *dns_ptr, UCHAR *host_name, ULONG host_address, ULONG ttl);
 #endif /* NX_DNS_CACHE_ENABLE  */
 
 #else
@@ -1012,6 +1048,8 @@ UINT        _nxe_dns_cache_notify_set(NX_DNS *dns_ptr, VOID (*cache_full_notify_
 UINT        _nx_dns_cache_notify_set(NX_DNS *dns_ptr, VOID (*cache_full_notify_cb)(NX_DNS *dns_ptr)); 
 UINT        _nxe_dns_cache_notify_clear(NX_DNS *dns_ptr);     
 UINT        _nx_dns_cache_notify_clear(NX_DNS *dns_ptr);    
+UINT        _nxe_dns_cache_host_add(NX_DNS *dns_ptr, UCHAR *host_name, ULONG host_address, ULONG ttl);
+UINT        _nx_dns_cache_host_add(NX_DNS *dns_ptr, UCHAR *host_name, ULONG host_address, ULONG ttl);
 #endif /* NX_DNS_CACHE_ENABLE  */
 
 #endif
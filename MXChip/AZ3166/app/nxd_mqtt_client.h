@@ -97,11 +97,155 @@ extern   "C" {
 #include "nx_websocket_client.h"
 #endif /* NXD_MQTT_OVER_WEBSOCKET */
 
-/* Defined, MQTT transmit queue depth is enabled. It must be positive integer.  */
+/* Defined, it gives the default upper bound of the in-flight window. It must be positive integer.  */
 /*
 #define NXD_MQTT_MAXIMUM_TRANSMIT_QUEUE_DEPTH                          20
 */
 
+/* Define the number of entries in the in-flight table that indexes the transmit queue by packet ID.
+   It must be a power of two, and it bounds the number of packets awaiting acknowledgement.  */
+#ifndef NXD_MQTT_INFLIGHT_TABLE_SIZE
+#define NXD_MQTT_INFLIGHT_TABLE_SIZE                                   32
+#endif /* NXD_MQTT_INFLIGHT_TABLE_SIZE */
+
+#if (NXD_MQTT_INFLIGHT_TABLE_SIZE & (NXD_MQTT_INFLIGHT_TABLE_SIZE - 1))
+#error "NXD_MQTT_INFLIGHT_TABLE_SIZE must be a power of two."
+#endif /* NXD_MQTT_INFLIGHT_TABLE_SIZE */
+
+/* Define the bounds of the in-flight window, the number of stored QoS 1 and QoS 2 messages that
+   may await acknowledgement.  The window starts at NXD_MQTT_WINDOW_INITIAL and adapts to the
+   acknowledgement latency between the bounds, which nxd_mqtt_client_window_set can change.  */
+#ifndef NXD_MQTT_WINDOW_MINIMUM
+#define NXD_MQTT_WINDOW_MINIMUM                                        1
+#endif /* NXD_MQTT_WINDOW_MINIMUM */
+
+#ifndef NXD_MQTT_WINDOW_MAXIMUM
+#ifdef NXD_MQTT_MAXIMUM_TRANSMIT_QUEUE_DEPTH
+#define NXD_MQTT_WINDOW_MAXIMUM                                        NXD_MQTT_MAXIMUM_TRANSMIT_QUEUE_DEPTH
+#else
+#define NXD_MQTT_WINDOW_MAXIMUM                                        (NXD_MQTT_INFLIGHT_TABLE_SIZE / 2)
+#endif /* NXD_MQTT_MAXIMUM_TRANSMIT_QUEUE_DEPTH */
+#endif /* NXD_MQTT_WINDOW_MAXIMUM */
+
+#ifndef NXD_MQTT_WINDOW_INITIAL
+#define NXD_MQTT_WINDOW_INITIAL                                        4
+#endif /* NXD_MQTT_WINDOW_INITIAL */
+
+#if (NXD_MQTT_WINDOW_MINIMUM < 1) || (NXD_MQTT_WINDOW_MAXIMUM > NXD_MQTT_INFLIGHT_TABLE_SIZE) || \
+    (NXD_MQTT_WINDOW_INITIAL < NXD_MQTT_WINDOW_MINIMUM) || (NXD_MQTT_WINDOW_INITIAL > NXD_MQTT_WINDOW_MAXIMUM)
+#error "The in-flight window must satisfy 1 <= MINIMUM <= INITIAL <= MAXIMUM <= NXD_MQTT_INFLIGHT_TABLE_SIZE."
+#endif /* NXD_MQTT_WINDOW_MINIMUM */
+
+/* Define the number of entries in the set of received QoS 2 packet IDs awaiting PUBREL, used to
+   suppress duplicate deliveries.  It must be a power of two.  */
+#ifndef NXD_MQTT_QOS2_RECEIVE_SET_SIZE
+#define NXD_MQTT_QOS2_RECEIVE_SET_SIZE                                 16
+#endif /* NXD_MQTT_QOS2_RECEIVE_SET_SIZE */
+
+#if (NXD_MQTT_QOS2_RECEIVE_SET_SIZE & (NXD_MQTT_QOS2_RECEIVE_SET_SIZE - 1))
+#error "NXD_MQTT_QOS2_RECEIVE_SET_SIZE must be a power of two."
+#endif /* NXD_MQTT_QOS2_RECEIVE_SET_SIZE */
+
+/* Define the number of asynchronous requests that can be outstanding, queued, awaiting acknowledgement
+   or awaiting collection of their completion.  Further requests are refused with
+   NXD_MQTT_REQUEST_QUEUE_FULL.  It must be a power of two, and it sizes the request rings.  */
+#ifndef NXD_MQTT_REQUEST_QUEUE_DEPTH
+#define NXD_MQTT_REQUEST_QUEUE_DEPTH                                   8
+#endif /* NXD_MQTT_REQUEST_QUEUE_DEPTH */
+
+#if (NXD_MQTT_REQUEST_QUEUE_DEPTH & (NXD_MQTT_REQUEST_QUEUE_DEPTH - 1))
+#error "NXD_MQTT_REQUEST_QUEUE_DEPTH must be a power of two."
+#endif /* NXD_MQTT_REQUEST_QUEUE_DEPTH */
+
+/* Define the maximum number of received messages waiting to be retrieved by the application.
+   Queued messages refer to the segment they arrived in, so messages of one segment share its packet.  */
+#ifndef NXD_MQTT_RECEIVE_VIEW_COUNT
+#define NXD_MQTT_RECEIVE_VIEW_COUNT                                    16
+#endif /* NXD_MQTT_RECEIVE_VIEW_COUNT */
+
+/* Define the number of nodes of the subscription trie.  Each level of a topic filter registered
+   with a handler takes one node, and filters sharing leading levels share their nodes.  */
+#ifndef NXD_MQTT_SUBSCRIPTION_NODE_COUNT
+#define NXD_MQTT_SUBSCRIPTION_NODE_COUNT                               32
+#endif /* NXD_MQTT_SUBSCRIPTION_NODE_COUNT */
+
+/* Define the longest level of a topic filter registered with a handler.  The level is copied into
+   its node, since nodes are shared by filters that may be removed while others still use them.  */
+#ifndef NXD_MQTT_SUBSCRIPTION_LEVEL_SIZE
+#define NXD_MQTT_SUBSCRIPTION_LEVEL_SIZE                               16
+#endif /* NXD_MQTT_SUBSCRIPTION_LEVEL_SIZE */
+
+/* Define the size of the buffer a received topic is gathered into when it is split across the
+   packets of a chain.  Longer split topics are not dispatched; the message is queued instead, and
+   counted in the metrics.  */
+#ifndef NXD_MQTT_SUBSCRIPTION_TOPIC_BUFFER_SIZE
+#define NXD_MQTT_SUBSCRIPTION_TOPIC_BUFFER_SIZE                        128
+#endif /* NXD_MQTT_SUBSCRIPTION_TOPIC_BUFFER_SIZE */
+
+/* Define the most handlers a received message is passed to.  The handlers of the matching filters
+   are gathered under the client mutex and called once it is released; a message matching more
+   filters is passed to the first ones found only, and counted in the metrics.  */
+#ifndef NXD_MQTT_SUBSCRIPTION_MATCH_COUNT
+#define NXD_MQTT_SUBSCRIPTION_MATCH_COUNT                              8
+#endif /* NXD_MQTT_SUBSCRIPTION_MATCH_COUNT */
+
+/* Define the topic table of the offline journal, which is kept at the start of the journal buffer.
+   A journal holds messages of up to NXD_MQTT_JOURNAL_TOPIC_COUNT distinct topics, each at most
+   NXD_MQTT_JOURNAL_TOPIC_SIZE bytes long.  */
+#ifndef NXD_MQTT_JOURNAL_TOPIC_COUNT
+#define NXD_MQTT_JOURNAL_TOPIC_COUNT                                   8
+#endif /* NXD_MQTT_JOURNAL_TOPIC_COUNT */
+
+#ifndef NXD_MQTT_JOURNAL_TOPIC_SIZE
+#define NXD_MQTT_JOURNAL_TOPIC_SIZE                                    64
+#endif /* NXD_MQTT_JOURNAL_TOPIC_SIZE */
+
+#if (NXD_MQTT_JOURNAL_TOPIC_COUNT > 255)
+#error "NXD_MQTT_JOURNAL_TOPIC_COUNT must not exceed 255."
+#endif /* NXD_MQTT_JOURNAL_TOPIC_COUNT */
+
+/* Define the bytes of the MSS left for the TLS record or websocket frame around a corked segment,
+   so that it still fits one TCP segment.  */
+#ifndef NXD_MQTT_CORK_RECORD_RESERVE
+#define NXD_MQTT_CORK_RECORD_RESERVE                                   64
+#endif /* NXD_MQTT_CORK_RECORD_RESERVE */
+
+/* Define the number of packets set aside from the client pool on each connection for
+   PUBACK, PUBREC, PUBREL, PUBCOMP and PINGREQ, so that a publish burst that drains the
+   pool cannot hold back acknowledgements and pings.  The reserved packets are not available
+   to publishers, so the pool should be sized with them on top.  Zero disables the reserve.  */
+#ifndef NXD_MQTT_CONTROL_PACKET_RESERVE
+#define NXD_MQTT_CONTROL_PACKET_RESERVE                                2
+#endif /* NXD_MQTT_CONTROL_PACKET_RESERVE */
+
+/* Define the number of buckets in a latency histogram of the client metrics.  Bucket 0 counts
+   latencies under one timer tick, bucket n those of 2^(n-1) to 2^n - 1 ticks, and the last
+   bucket also every longer one.  */
+#ifndef NXD_MQTT_METRICS_HISTOGRAM_SIZE
+#define NXD_MQTT_METRICS_HISTOGRAM_SIZE                                12
+#endif /* NXD_MQTT_METRICS_HISTOGRAM_SIZE */
+
+/* Define the longest topic name, in bytes, of a prepared topic.  */
+#ifndef NXD_MQTT_TOPIC_PREPARED_SIZE
+#define NXD_MQTT_TOPIC_PREPARED_SIZE                                   64
+#endif /* NXD_MQTT_TOPIC_PREPARED_SIZE */
+
+/* Define the number of MQTT 5 topic aliases kept in each direction, and the longest topic name
+   an alias stands for.  The receive size must hold any topic the broker may alias.  */
+#ifndef NXD_MQTT_V5_TOPIC_ALIAS_COUNT
+#define NXD_MQTT_V5_TOPIC_ALIAS_COUNT                                  4
+#endif /* NXD_MQTT_V5_TOPIC_ALIAS_COUNT */
+
+#ifndef NXD_MQTT_V5_TOPIC_ALIAS_SIZE
+#define NXD_MQTT_V5_TOPIC_ALIAS_SIZE                                   64
+#endif /* NXD_MQTT_V5_TOPIC_ALIAS_SIZE */
+
+/* Define the Session Expiry Interval, in seconds, an MQTT 5 client asks for when it does not
+   start with a clean session.  The default keeps the session, as MQTT 3.1.1 does.  */
+#ifndef NXD_MQTT_V5_SESSION_EXPIRY
+#define NXD_MQTT_V5_SESSION_EXPIRY                                     0xFFFFFFFF
+#endif /* NXD_MQTT_V5_SESSION_EXPIRY */
+
 /* Define MQTT protocol for websocket.  */
 #define NXD_MQTT_OVER_WEBSOCKET_PROTOCOL                               "mqtt"
 
@@ -122,6 +266,16 @@ extern   "C" {
 #define NXD_MQTT_SECURE_MEMMOVE                                        memmove
 #endif /* NXD_MQTT_SECURE_MEMMOVE */
 
+/* Define the atomic operations on UINT used by the request rings.  GCC and Clang builtins are used
+   by default.  Without them, the client falls back to short interrupt lockouts.  */
+#if !defined(NXD_MQTT_ATOMIC_FETCH_ADD) && defined(__GNUC__)
+#define NXD_MQTT_ATOMIC_FETCH_ADD(ptr, value)                          __atomic_fetch_add((ptr), (value), __ATOMIC_ACQ_REL)
+#define NXD_MQTT_ATOMIC_COMPARE_EXCHANGE(ptr, expected_ptr, desired)   __atomic_compare_exchange_n((ptr), (expected_ptr), (desired), 0, \
+                                                                                                   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#define NXD_MQTT_ATOMIC_LOAD(ptr)                                      __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define NXD_MQTT_ATOMIC_STORE(ptr, value)                              __atomic_store_n((ptr), (value), __ATOMIC_RELEASE)
+#endif /* NXD_MQTT_ATOMIC_FETCH_ADD */
+
 /* Define the default MQTT Non-TLS (Non-secure) port number */
 #define NXD_MQTT_PORT                                                  1883
 
@@ -177,6 +331,20 @@ extern   "C" {
 
 
 #define MQTT_PROTOCOL_LEVEL                                            4
+#define MQTT_PROTOCOL_LEVEL_5                                          5
+
+/* Define the MQTT 5 properties used by the client. */
+#define MQTT_PROPERTY_SESSION_EXPIRY_INTERVAL                          0x11
+#define MQTT_PROPERTY_RECEIVE_MAXIMUM                                  0x21
+#define MQTT_PROPERTY_TOPIC_ALIAS_MAXIMUM                              0x22
+#define MQTT_PROPERTY_TOPIC_ALIAS                                      0x23
+#define MQTT_PROPERTY_MAXIMUM_PACKET_SIZE                              0x27
+
+/* Define the MQTT 5 reason codes the client sends when it closes a connection. */
+#define MQTT_REASON_CODE_PROTOCOL_ERROR                                0x82
+#define MQTT_REASON_CODE_RECEIVE_MAXIMUM_EXCEEDED                      0x93
+#define MQTT_REASON_CODE_TOPIC_ALIAS_INVALID                           0x94
+#define MQTT_REASON_CODE_PACKET_TOO_LARGE                              0x95
 
 /* Define bit fields and constant values used in the CONNECT packet. */
 #define MQTT_CONNECT_FLAGS_USERNAME                                    (1 << 7)
@@ -274,6 +442,203 @@ typedef struct MQTT_PACKET_DISCONNECT_STRUCT
 } MQTT_PACKET_DISCONNECT;
 
 
+/* Define the in-flight table entry.  Each used entry indexes one packet on the transmit queue
+   by its packet identifier and control packet type.  */
+typedef struct NXD_MQTT_INFLIGHT_ENTRY_STRUCT
+{
+    NX_PACKET *nxd_mqtt_inflight_packet_ptr;
+    USHORT     nxd_mqtt_inflight_packet_id;
+    UCHAR      nxd_mqtt_inflight_packet_type;
+    UCHAR      nxd_mqtt_inflight_reserved;
+} NXD_MQTT_INFLIGHT_ENTRY;
+
+/* Define the bookkeeping stored at nx_packet_data_start of each packet on the transmit queue.
+   The packet identifier must remain the first field.  Queued packets are copies taken from the
+   retention pool, and each send and retransmission sends a further copy: a sent packet cannot be
+   kept, since NetX releases it once TCP has it acknowledged, packets have no reference count, and
+   TLS encrypts records in place.  */
+typedef struct NXD_MQTT_TRANSMIT_INFO_STRUCT
+{
+    USHORT     nxd_mqtt_transmit_packet_id;
+    USHORT     nxd_mqtt_transmit_request;                 /* Request index plus one, or zero. */
+    NX_PACKET *nxd_mqtt_transmit_previous_ptr;
+    ULONG      nxd_mqtt_transmit_time;                    /* Tick when the packet was stored. */
+} NXD_MQTT_TRANSMIT_INFO;
+
+/* Define a received segment shared by queued messages.  The packet is released when the
+   last reference is dropped.  */
+typedef struct NXD_MQTT_RECEIVE_SEGMENT_STRUCT
+{
+    NX_PACKET *nxd_mqtt_receive_segment_packet_ptr;
+    UINT       nxd_mqtt_receive_segment_reference_count;
+} NXD_MQTT_RECEIVE_SEGMENT;
+
+/* Define a queued message.  It describes the MQTT packet in place: the first byte, the end of
+   the data in the packet holding that byte, the rest of the chain and the total length.  */
+typedef struct NXD_MQTT_RECEIVE_VIEW_STRUCT
+{
+    NXD_MQTT_RECEIVE_SEGMENT            *nxd_mqtt_receive_view_segment_ptr;
+    UCHAR                               *nxd_mqtt_receive_view_start_ptr;
+    UCHAR                               *nxd_mqtt_receive_view_end_ptr;
+    NX_PACKET                           *nxd_mqtt_receive_view_next_ptr;
+    ULONG                                nxd_mqtt_receive_view_length;
+    struct NXD_MQTT_RECEIVE_VIEW_STRUCT *nxd_mqtt_receive_view_queue_next;
+} NXD_MQTT_RECEIVE_VIEW;
+
+/* Define the decoder state of the incomplete MQTT packet waiting for more data.  The fixed header
+   is decoded as it arrives, so later segments are only counted until the packet is complete.  */
+typedef struct NXD_MQTT_FRAME_DECODER_STRUCT
+{
+    ULONG nxd_mqtt_frame_decoder_offset;              /* Bytes of the fixed header decoded.       */
+    UINT  nxd_mqtt_frame_decoder_remaining_length;    /* Remaining length decoded so far.         */
+    ULONG nxd_mqtt_frame_decoder_length;              /* Total length, or zero if not yet known.  */
+} NXD_MQTT_FRAME_DECODER;
+
+/* Define the parts of a borrowed message.  */
+#define NXD_MQTT_MESSAGE_TOPIC                                         0
+#define NXD_MQTT_MESSAGE_PAYLOAD                                       1
+
+/* Define a message borrowed from the receive queue.  The topic and payload are read in place,
+   at offsets from the start of the MQTT packet, until the message is released.  */
+typedef struct NXD_MQTT_MESSAGE_STRUCT
+{
+    NXD_MQTT_RECEIVE_VIEW *nxd_mqtt_message_view_ptr;
+    ULONG                  nxd_mqtt_message_topic_offset;
+    UINT                   nxd_mqtt_message_topic_length;
+    ULONG                  nxd_mqtt_message_payload_offset;
+    ULONG                  nxd_mqtt_message_payload_length;
+} NXD_MQTT_MESSAGE;
+
+/* Define a prepared topic, holding the topic name of PUBLISH packets as it is encoded on the wire:
+   the two-byte length, then the name.  It is set up once by nxd_mqtt_client_topic_prepare.  */
+typedef struct NXD_MQTT_TOPIC_STRUCT
+{
+    UCHAR nxd_mqtt_topic_encoded[NXD_MQTT_TOPIC_PREPARED_SIZE + 2];
+    UINT  nxd_mqtt_topic_encoded_length;
+} NXD_MQTT_TOPIC;
+
+/* Define an MQTT 5 topic alias.  A zero length marks an alias not in use.  */
+typedef struct NXD_MQTT_TOPIC_ALIAS_STRUCT
+{
+    UCHAR  nxd_mqtt_topic_alias_name[NXD_MQTT_V5_TOPIC_ALIAS_SIZE];
+    USHORT nxd_mqtt_topic_alias_length;
+} NXD_MQTT_TOPIC_ALIAS;
+
+/* Define the MQTT 5 properties the client acts on, as read from a received packet.  */
+typedef struct NXD_MQTT_PROPERTIES_STRUCT
+{
+    ULONG  nxd_mqtt_properties_maximum_packet_size;                  /* Zero if absent.  */
+    USHORT nxd_mqtt_properties_receive_maximum;                      /* 65535 if absent. */
+    USHORT nxd_mqtt_properties_topic_alias_maximum;
+    USHORT nxd_mqtt_properties_topic_alias;
+} NXD_MQTT_PROPERTIES;
+
+/* Define the TLS handshake statistics of a client.  Times are in timer ticks.  */
+typedef struct NXD_MQTT_TLS_STATISTICS_STRUCT
+{
+    ULONG nxd_mqtt_tls_statistics_handshakes;                        /* Completed handshakes.          */
+    ULONG nxd_mqtt_tls_statistics_reused;                            /* Of them, on a cached session.  */
+    ULONG nxd_mqtt_tls_statistics_failures;
+    ULONG nxd_mqtt_tls_statistics_last;
+    ULONG nxd_mqtt_tls_statistics_minimum;
+    ULONG nxd_mqtt_tls_statistics_maximum;
+} NXD_MQTT_TLS_STATISTICS;
+
+/* Define the metrics of a client.  Counters and peaks only grow, across connections.  */
+typedef struct NXD_MQTT_METRICS_STRUCT
+{
+    UINT nxd_mqtt_metrics_publishes_sent;                            /* First transmissions.           */
+    UINT nxd_mqtt_metrics_publishes_received;
+    UINT nxd_mqtt_metrics_retransmits;                               /* Publishes and PUBRELs resent.  */
+    UINT nxd_mqtt_metrics_pool_failures;                             /* Allocations the pool refused.   */
+    UINT nxd_mqtt_metrics_control_drops;                             /* Acks and pings with no packet.  */
+    UINT nxd_mqtt_metrics_pings_sent;
+    UINT nxd_mqtt_metrics_ping_timeouts;
+    UINT nxd_mqtt_metrics_connections;                               /* Accepted CONNACKs.             */
+    UINT nxd_mqtt_metrics_receive_queue_peak;                        /* Most messages waiting.         */
+    UINT nxd_mqtt_metrics_inflight_peak;                             /* Most messages unacknowledged.  */
+    UINT nxd_mqtt_metrics_dispatch_long_topics;                      /* Split topics not matched.      */
+    UINT nxd_mqtt_metrics_dispatch_overflows;                        /* Handlers past the match list.  */
+    UINT nxd_mqtt_metrics_ack_latency[NXD_MQTT_METRICS_HISTOGRAM_SIZE];  /* PUBLISH to PUBACK or PUBREC.  */
+    UINT nxd_mqtt_metrics_ping_latency[NXD_MQTT_METRICS_HISTOGRAM_SIZE]; /* PINGREQ to PINGRESP.          */
+} NXD_MQTT_METRICS;
+
+struct NXD_MQTT_CLIENT_STRUCT;
+
+/* Define an asynchronous publish, subscribe or unsubscribe request.  The topic and message are not
+   copied; they must stay valid until the request completes.  A free request has no handle.  Requests
+   are claimed and queued by the application without the client mutex, so the handle is only
+   changed atomically.  */
+typedef struct NXD_MQTT_REQUEST_STRUCT
+{
+    CHAR                                   *nxd_mqtt_request_topic_name;
+    UINT                                    nxd_mqtt_request_topic_name_length;
+    CHAR                                   *nxd_mqtt_request_message;
+    UINT                                    nxd_mqtt_request_message_length;
+    UINT                                    nxd_mqtt_request_retain;
+    UINT                                    nxd_mqtt_request_QoS;
+    UINT                                    nxd_mqtt_request_type;
+    UINT                                    nxd_mqtt_request_status;
+    UINT                                    nxd_mqtt_request_handle;
+    VOID                                  (*nxd_mqtt_request_complete_notify)(struct NXD_MQTT_CLIENT_STRUCT *client_ptr,
+                                                                              UINT handle, UINT status, VOID *context);
+    VOID                                   *nxd_mqtt_request_context;
+} NXD_MQTT_REQUEST;
+
+/* Define the eviction policies of a topic in the offline journal.  With DROP_OLDEST every message is
+   kept until the journal is full, then the oldest messages of any topic make room.  With LAST_VALUE
+   a new message supersedes the one of the same topic still waiting.  */
+#define NXD_MQTT_JOURNAL_DROP_OLDEST         0
+#define NXD_MQTT_JOURNAL_LAST_VALUE          1
+
+/* Define an entry of the offline journal topic table.  Records refer to their topic by its index.  */
+typedef struct NXD_MQTT_JOURNAL_TOPIC_STRUCT
+{
+    UCHAR  nxd_mqtt_journal_topic_name[NXD_MQTT_JOURNAL_TOPIC_SIZE];
+    USHORT nxd_mqtt_journal_topic_length;                 /* Zero marks a free entry.             */
+    UCHAR  nxd_mqtt_journal_topic_policy;
+    UCHAR  nxd_mqtt_journal_topic_pinned;                 /* Policy set by the application.       */
+    UINT   nxd_mqtt_journal_topic_records;                /* Records of the topic in the journal. */
+    ULONG  nxd_mqtt_journal_topic_last;                   /* Offset of its newest record.         */
+} NXD_MQTT_JOURNAL_TOPIC;
+
+/* Define the header of a record of the offline journal.  The message follows it, and the record is
+   padded to a multiple of four bytes.  */
+typedef struct NXD_MQTT_JOURNAL_RECORD_STRUCT
+{
+    USHORT nxd_mqtt_journal_record_length;                /* Whole record, with padding.          */
+    USHORT nxd_mqtt_journal_record_message_length;
+    UCHAR  nxd_mqtt_journal_record_topic;                 /* Topic table index.                   */
+    UCHAR  nxd_mqtt_journal_record_flags;                 /* QoS, retain and superseded flags.    */
+    USHORT nxd_mqtt_journal_record_reserved;
+} NXD_MQTT_JOURNAL_RECORD;
+
+/* Define a node of the subscription trie.  A node is one level of a registered topic filter, and
+   holds a copy of the level.  The children of a node are kept on a sibling list and compared by
+   hash first.  */
+typedef struct NXD_MQTT_SUBSCRIPTION_NODE_STRUCT
+{
+    UCHAR                                      nxd_mqtt_subscription_node_level[NXD_MQTT_SUBSCRIPTION_LEVEL_SIZE];
+    USHORT                                     nxd_mqtt_subscription_node_level_length;
+    USHORT                                     nxd_mqtt_subscription_node_level_hash;
+    UINT                                       nxd_mqtt_subscription_node_in_use;
+    struct NXD_MQTT_SUBSCRIPTION_NODE_STRUCT  *nxd_mqtt_subscription_node_child_ptr;
+    struct NXD_MQTT_SUBSCRIPTION_NODE_STRUCT  *nxd_mqtt_subscription_node_sibling_ptr;
+    VOID                                     (*nxd_mqtt_subscription_node_handler)(struct NXD_MQTT_CLIENT_STRUCT *client_ptr,
+                                                                                   NXD_MQTT_MESSAGE *message_ptr, VOID *context);
+    VOID                                      *nxd_mqtt_subscription_node_context;
+} NXD_MQTT_SUBSCRIPTION_NODE;
+
+/* Define a handler of a filter matching a received topic, copied from its node so that it can be
+   called without the client mutex.  */
+typedef struct NXD_MQTT_SUBSCRIPTION_MATCH_STRUCT
+{
+    VOID                                     (*nxd_mqtt_subscription_match_handler)(struct NXD_MQTT_CLIENT_STRUCT *client_ptr,
+                                                                                    NXD_MQTT_MESSAGE *message_ptr, VOID *context);
+    VOID                                      *nxd_mqtt_subscription_match_context;
+} NXD_MQTT_SUBSCRIPTION_MATCH;
+
+
 /* Define the NetX MQTT CLIENT ID.  */
 #define NXD_MQTT_CLIENT_ID                   0x4D515454
 
@@ -309,6 +674,9 @@ typedef struct MQTT_PACKET_DISCONNECT_STRUCT
 #define NXD_MQTT_PARTIAL_PACKET              0x10010
 #define NXD_MQTT_CONNECTING                  0x10011
 #define NXD_MQTT_INVALID_STATE               0x10012
+#define NXD_MQTT_REQUEST_QUEUE_FULL          0x10013
+#define NXD_MQTT_WINDOW_FULL                 0x10014
+#define NXD_MQTT_PACKET_TOO_LARGE            0x10015
 
 /* The following error codes match the Connect Return code in CONNACK message. */
 #define NXD_MQTT_ERROR_CONNECT_RETURN_CODE   0x10080
@@ -318,6 +686,10 @@ typedef struct MQTT_PACKET_DISCONNECT_STRUCT
 #define NXD_MQTT_ERROR_BAD_USERNAME_PASSWORD 0x10084
 #define NXD_MQTT_ERROR_NOT_AUTHORIZED        0x10085
 
+/* MQTT 5 reason codes of 0x80 and above, other than the CONNACK codes above, are returned
+   added to this value. */
+#define NXD_MQTT_ERROR_REASON_CODE           0x10100
+
 
 /* Define the basic MQTT Client control block. */
 typedef struct NXD_MQTT_CLIENT_STRUCT
@@ -336,8 +708,15 @@ typedef struct NXD_MQTT_CLIENT_STRUCT
     UINT                           nxd_mqtt_client_will_message_length;
     NX_IP                         *nxd_mqtt_client_ip_ptr;                          /* Pointer to associated IP structure   */
     NX_PACKET_POOL                *nxd_mqtt_client_packet_pool_ptr;                 /* Pointer to client packet pool        */
+    NX_PACKET_POOL                *nxd_mqtt_client_retention_pool_ptr;              /* Pool holding QoS 1/2 retained copies */
     TX_MUTEX                      *nxd_mqtt_client_mutex_ptr;                       /* Pointer to client mutex              */
     TX_TIMER                       nxd_mqtt_timer;
+    TX_TIMER                       nxd_mqtt_client_cork_timer;                      /* Flushes the cork after its delay.    */
+    NX_PACKET                     *nxd_mqtt_client_cork_packet;                     /* Packets waiting to be sent together. */
+    UINT                           nxd_mqtt_client_cork_delay;                      /* Ticks to hold a packet, or zero.     */
+    NX_PACKET                     *nxd_mqtt_client_control_reserve;                 /* Packets kept for acks and pings.     */
+    UINT                           nxd_mqtt_client_control_reserve_count;           /* Packets in the control reserve.      */
+    NXD_MQTT_METRICS               nxd_mqtt_client_metrics;
 #ifndef NXD_MQTT_CLOUD_ENABLE
     TX_MUTEX                       nxd_mqtt_protection;
     TX_THREAD                      nxd_mqtt_thread;
@@ -354,22 +733,73 @@ typedef struct NXD_MQTT_CLIENT_STRUCT
     UINT                           nxd_mqtt_timer_value;                            /* MQTT Client periodic timer tick value.  */
     UINT                           nxd_mqtt_keepalive;                              /* Keepalive value, converted to TX ticks. */
     UINT                           nxd_mqtt_clean_session;                          /* Clean session flag. */
+    UINT                           nxd_mqtt_session_present;                        /* Server resumed the session, from CONNACK. */
     UINT                           nxd_mqtt_client_state;                           /* Record client state                  */
+    UINT                           nxd_mqtt_client_pipeline;                        /* Send before CONNACK on async connect.*/
+    UINT                           nxd_mqtt_client_pipelining;                      /* CONNECT sent, CONNACK pending.       */
+    UINT                           nxd_mqtt_client_protocol_level;                  /* MQTT_PROTOCOL_LEVEL or LEVEL_5.      */
+    UINT                           nxd_mqtt_client_receive_maximum;                 /* QoS 1/2 messages the broker may send */
+    ULONG                          nxd_mqtt_client_maximum_packet_size;             /* Largest packet accepted, or zero.    */
+    UINT                           nxd_mqtt_client_send_maximum;                    /* Receive Maximum of the broker.       */
+    ULONG                          nxd_mqtt_client_send_packet_size;                /* Maximum Packet Size of the broker.   */
+    UINT                           nxd_mqtt_client_send_alias_maximum;              /* Topic aliases the broker accepts.    */
+    UINT                           nxd_mqtt_client_send_alias_count;                /* Topic aliases assigned so far.       */
+    UINT                           nxd_mqtt_client_reason_code;                     /* Of the last CONNACK or DISCONNECT.   */
+    NXD_MQTT_TOPIC_ALIAS           nxd_mqtt_client_send_aliases[NXD_MQTT_V5_TOPIC_ALIAS_COUNT];
+    NXD_MQTT_TOPIC_ALIAS           nxd_mqtt_client_receive_aliases[NXD_MQTT_V5_TOPIC_ALIAS_COUNT];
     NX_TCP_SOCKET                  nxd_mqtt_client_socket;
     struct NXD_MQTT_CLIENT_STRUCT *nxd_mqtt_client_next;
     UINT                           nxd_mqtt_client_packet_identifier;
     NX_PACKET                     *nxd_mqtt_client_processing_packet;
+    NXD_MQTT_FRAME_DECODER         nxd_mqtt_client_frame_decoder;                   /* State of the processing packet.      */
     NX_PACKET                     *message_transmit_queue_head;
     NX_PACKET                     *message_transmit_queue_tail;
-#ifdef NXD_MQTT_MAXIMUM_TRANSMIT_QUEUE_DEPTH
-    UINT                           message_transmit_queue_depth;
-#endif /* NXD_MQTT_MAXIMUM_TRANSMIT_QUEUE_DEPTH */
-    NX_PACKET                     *message_receive_queue_head;
-    NX_PACKET                     *message_receive_queue_tail;
+    UINT                           nxd_mqtt_client_window;                          /* Stored messages allowed.             */
+    UINT                           nxd_mqtt_client_window_minimum;
+    UINT                           nxd_mqtt_client_window_maximum;
+    UINT                           nxd_mqtt_client_window_used;                     /* Stored packets holding a credit.     */
+    UINT                           nxd_mqtt_client_window_acked;                    /* Acknowledgements since last change.  */
+    UINT                           nxd_mqtt_client_window_limited;                  /* A publisher found the window full.   */
+    ULONG                          nxd_mqtt_client_ack_time_smoothed;               /* Acknowledgement latency, ticks x 8.  */
+    ULONG                          nxd_mqtt_client_ack_time_minimum;                /* Lowest latency of the connection.    */
+    TX_SEMAPHORE                   nxd_mqtt_client_window_semaphore;                /* Put as credits are returned.         */
+    NXD_MQTT_JOURNAL_TOPIC        *nxd_mqtt_client_journal_topics;                  /* Start of the journal buffer.         */
+    UCHAR                         *nxd_mqtt_client_journal_ptr;                     /* Record ring, or NULL if no journal.  */
+    ULONG                          nxd_mqtt_client_journal_size;
+    ULONG                          nxd_mqtt_client_journal_head;                    /* Offset of the oldest record.         */
+    ULONG                          nxd_mqtt_client_journal_tail;                    /* Offset of the next record.           */
+    ULONG                          nxd_mqtt_client_journal_used;                    /* Bytes held, with wrap padding.       */
+    ULONG                          nxd_mqtt_client_journal_dropped;                 /* Messages evicted before being sent.  */
+    UINT                           nxd_mqtt_client_journal_rate;                    /* Messages sent per second, or zero.   */
+    UINT                           nxd_mqtt_client_journal_tokens;
+    ULONG                          nxd_mqtt_client_journal_refill_time;
+    NXD_MQTT_INFLIGHT_ENTRY        nxd_mqtt_client_inflight_table[NXD_MQTT_INFLIGHT_TABLE_SIZE];
+    UINT                           nxd_mqtt_client_inflight_count;                  /* Number of used in-flight entries.    */
+    USHORT                         nxd_mqtt_client_qos2_receive_set[NXD_MQTT_QOS2_RECEIVE_SET_SIZE]; /* Zero marks a free entry.  */
+    UINT                           nxd_mqtt_client_qos2_receive_count;
+    TX_MUTEX                       nxd_mqtt_client_receive_mutex;                   /* Guards the receive queue and views.  */
+    NXD_MQTT_RECEIVE_VIEW         *message_receive_queue_head;
+    NXD_MQTT_RECEIVE_VIEW         *message_receive_queue_tail;
     UINT                           message_receive_queue_depth;
+    NXD_MQTT_RECEIVE_VIEW          nxd_mqtt_client_receive_views[NXD_MQTT_RECEIVE_VIEW_COUNT];
+    NXD_MQTT_RECEIVE_SEGMENT       nxd_mqtt_client_receive_segments[NXD_MQTT_RECEIVE_VIEW_COUNT];
+    NX_PACKET                     *nxd_mqtt_client_receive_packet_ptr;              /* Segment being parsed.                */
+    NXD_MQTT_RECEIVE_SEGMENT      *nxd_mqtt_client_receive_segment_ptr;             /* Its record, once a message is queued.*/
+    NXD_MQTT_SUBSCRIPTION_NODE     nxd_mqtt_client_subscription_nodes[NXD_MQTT_SUBSCRIPTION_NODE_COUNT];
+    NXD_MQTT_SUBSCRIPTION_NODE    *nxd_mqtt_client_subscription_root;               /* First level of the subscription trie.*/
+    NXD_MQTT_REQUEST               nxd_mqtt_client_requests[NXD_MQTT_REQUEST_QUEUE_DEPTH];
+    UINT                           nxd_mqtt_client_request_handle;                  /* Last handle given to a request.      */
+    UINT                           nxd_mqtt_client_submit_ring[NXD_MQTT_REQUEST_QUEUE_DEPTH];   /* Request index plus one. */
+    UINT                           nxd_mqtt_client_submit_head;                     /* Taken by the MQTT thread.            */
+    UINT                           nxd_mqtt_client_submit_tail;                     /* Claimed by application threads.      */
+    UINT                           nxd_mqtt_client_submit_wake;                     /* Requests since the thread woke up.   */
+    UINT                           nxd_mqtt_client_complete_ring[NXD_MQTT_REQUEST_QUEUE_DEPTH]; /* Request index plus one. */
+    UINT                           nxd_mqtt_client_complete_head;                   /* Taken by the application.            */
+    UINT                           nxd_mqtt_client_complete_tail;                   /* Filled under the client mutex.       */
     VOID                         (*nxd_mqtt_client_receive_notify)(struct NXD_MQTT_CLIENT_STRUCT *client_ptr, UINT number_of_messages);
     VOID                         (*nxd_mqtt_connect_notify)(struct NXD_MQTT_CLIENT_STRUCT *client_ptr, UINT status, VOID *context);
     VOID                          *nxd_mqtt_connect_context;
+    VOID                         (*nxd_mqtt_tcp_establish_notify)(struct NXD_MQTT_CLIENT_STRUCT *client_ptr);
     VOID                         (*nxd_mqtt_disconnect_notify)(struct NXD_MQTT_CLIENT_STRUCT *client_ptr);
     UINT                         (*nxd_mqtt_packet_receive_notify)(struct NXD_MQTT_CLIENT_STRUCT *client_ptr, NX_PACKET *packet_ptr, VOID *context);
     VOID                          *nxd_mqtt_packet_receive_context;
@@ -383,6 +813,11 @@ typedef struct NXD_MQTT_CLIENT_STRUCT
     NX_SECURE_X509_CERT            nxd_mqtt_tls_trusted_certificate;
     NX_SECURE_TLS_SESSION          nxd_mqtt_tls_session;
     UINT                           nxd_mqtt_tls_in_progress;
+    UINT                           nxd_mqtt_tls_session_cache;                      /* Keep the session for reconnection.   */
+    UINT                           nxd_mqtt_tls_session_cached;                     /* The session is set up for reuse.     */
+    UINT                           nxd_mqtt_tls_session_reused;                     /* This handshake runs on a kept one.   */
+    ULONG                          nxd_mqtt_tls_handshake_start;                    /* Time the handshake started.          */
+    NXD_MQTT_TLS_STATISTICS        nxd_mqtt_tls_statistics;
 #endif
 #ifdef NXD_MQTT_OVER_WEBSOCKET
     UINT                           nxd_mqtt_client_use_websocket;
@@ -414,12 +849,40 @@ typedef struct NXD_MQTT_CLIENT_STRUCT
 #define nxd_mqtt_client_connect               _nxd_mqtt_client_connect
 #define nxd_mqtt_client_secure_connect        _nxd_mqtt_client_secure_connect
 #define nxd_mqtt_client_publish               _nxd_mqtt_client_publish
+#define nxd_mqtt_client_publish_async         _nxd_mqtt_client_publish_async
+#define nxd_mqtt_client_subscribe_async       _nxd_mqtt_client_subscribe_async
+#define nxd_mqtt_client_unsubscribe_async     _nxd_mqtt_client_unsubscribe_async
+#define nxd_mqtt_client_request_complete_get  _nxd_mqtt_client_request_complete_get
 #define nxd_mqtt_client_subscribe             _nxd_mqtt_client_subscribe
 #define nxd_mqtt_client_unsubscribe           _nxd_mqtt_client_unsubscribe
+#define nxd_mqtt_client_subscription_add      _nxd_mqtt_client_subscription_add
 #define nxd_mqtt_client_disconnect            _nxd_mqtt_client_disconnect
 #define nxd_mqtt_client_receive_notify_set    _nxd_mqtt_client_receive_notify_set
 #define nxd_mqtt_client_message_get           _nxd_mqtt_client_message_get
+#define nxd_mqtt_client_message_borrow        _nxd_mqtt_client_message_borrow
+#define nxd_mqtt_client_message_span_get      _nxd_mqtt_client_message_span_get
+#define nxd_mqtt_client_message_release       _nxd_mqtt_client_message_release
 #define nxd_mqtt_client_disconnect_notify_set _nxd_mqtt_client_disconnect_notify_set
+#define nxd_mqtt_client_retention_pool_set    _nxd_mqtt_client_retention_pool_set
+#define nxd_mqtt_client_window_set            _nxd_mqtt_client_window_set
+#define nxd_mqtt_client_journal_set           _nxd_mqtt_client_journal_set
+#define nxd_mqtt_client_journal_topic_set     _nxd_mqtt_client_journal_topic_set
+#define nxd_mqtt_client_pipeline_set          _nxd_mqtt_client_pipeline_set
+#define nxd_mqtt_client_cork_set              _nxd_mqtt_client_cork_set
+#define nxd_mqtt_client_flush                 _nxd_mqtt_client_flush
+#define nxd_mqtt_client_topic_prepare         _nxd_mqtt_client_topic_prepare
+#define nxd_mqtt_client_topic_publish         _nxd_mqtt_client_topic_publish
+#define nxd_mqtt_client_v5_set                _nxd_mqtt_client_v5_set
+#define nxd_mqtt_client_metrics_get           _nxd_mqtt_client_metrics_get
+#define nxd_mqtt_client_state_get             _nxd_mqtt_client_state_get
+#define nxd_mqtt_client_journal_used_get      _nxd_mqtt_client_journal_used_get
+#define nxd_mqtt_client_connect_notify_set    _nxd_mqtt_client_connect_notify_set
+#define nxd_mqtt_client_tcp_establish_notify_set _nxd_mqtt_client_tcp_establish_notify_set
+#define nxd_mqtt_client_ack_receive_notify_set _nxd_mqtt_client_ack_receive_notify_set
+#ifdef NX_SECURE_ENABLE
+#define nxd_mqtt_client_tls_cache_set         _nxd_mqtt_client_tls_cache_set
+#define nxd_mqtt_client_tls_statistics_get    _nxd_mqtt_client_tls_statistics_get
+#endif /* NX_SECURE_ENABLE */
 #ifdef NXD_MQTT_OVER_WEBSOCKET
 #define nxd_mqtt_client_websocket_set         _nxd_mqtt_client_websocket_set
 #endif /* NXD_MQTT_OVER_WEBSOCKET */
@@ -432,12 +895,40 @@ typedef struct NXD_MQTT_CLIENT_STRUCT
 #define nxd_mqtt_client_connect               _nxde_mqtt_client_connect
 #define nxd_mqtt_client_secure_connect        _nxde_mqtt_client_secure_connect
 #define nxd_mqtt_client_publish               _nxde_mqtt_client_publish
+#define nxd_mqtt_client_publish_async         _nxde_mqtt_client_publish_async
+#define nxd_mqtt_client_subscribe_async       _nxde_mqtt_client_subscribe_async
+#define nxd_mqtt_client_unsubscribe_async     _nxde_mqtt_client_unsubscribe_async
+#define nxd_mqtt_client_request_complete_get  _nxde_mqtt_client_request_complete_get
 #define nxd_mqtt_client_subscribe             _nxde_mqtt_client_subscribe
 #define nxd_mqtt_client_unsubscribe           _nxde_mqtt_client_unsubscribe
+#define nxd_mqtt_client_subscription_add      _nxde_mqtt_client_subscription_add
 #define nxd_mqtt_client_disconnect            _nxde_mqtt_client_disconnect
 #define nxd_mqtt_client_receive_notify_set    _nxde_mqtt_client_receive_notify_set
 #define nxd_mqtt_client_message_get           _nxde_mqtt_client_message_get
+#define nxd_mqtt_client_message_borrow        _nxde_mqtt_client_message_borrow
+#define nxd_mqtt_client_message_span_get      _nxde_mqtt_client_message_span_get
+#define nxd_mqtt_client_message_release       _nxde_mqtt_client_message_release
 #define nxd_mqtt_client_disconnect_notify_set _nxde_mqtt_client_disconnect_notify_set
+#define nxd_mqtt_client_retention_pool_set    _nxde_mqtt_client_retention_pool_set
+#define nxd_mqtt_client_window_set            _nxde_mqtt_client_window_set
+#define nxd_mqtt_client_journal_set           _nxde_mqtt_client_journal_set
+#define nxd_mqtt_client_journal_topic_set     _nxde_mqtt_client_journal_topic_set
+#define nxd_mqtt_client_pipeline_set          _nxde_mqtt_client_pipeline_set
+#define nxd_mqtt_client_cork_set              _nxde_mqtt_client_cork_set
+#define nxd_mqtt_client_flush                 _nxde_mqtt_client_flush
+#define nxd_mqtt_client_topic_prepare         _nxde_mqtt_client_topic_prepare
+#define nxd_mqtt_client_topic_publish         _nxde_mqtt_client_topic_publish
+#define nxd_mqtt_client_v5_set                _nxde_mqtt_client_v5_set
+#define nxd_mqtt_client_metrics_get           _nxde_mqtt_client_metrics_get
+#define nxd_mqtt_client_state_get             _nxde_mqtt_client_state_get
+#define nxd_mqtt_client_journal_used_get      _nxde_mqtt_client_journal_used_get
+#define nxd_mqtt_client_connect_notify_set    _nxde_mqtt_client_connect_notify_set
+#define nxd_mqtt_client_tcp_establish_notify_set _nxde_mqtt_client_tcp_establish_notify_set
+#define nxd_mqtt_client_ack_receive_notify_set _nxde_mqtt_client_ack_receive_notify_set
+#ifdef NX_SECURE_ENABLE
+#define nxd_mqtt_client_tls_cache_set         _nxde_mqtt_client_tls_cache_set
+#define nxd_mqtt_client_tls_statistics_get    _nxde_mqtt_client_tls_statistics_get
+#endif /* NX_SECURE_ENABLE */
 #ifdef NXD_MQTT_OVER_WEBSOCKET
 #define nxd_mqtt_client_websocket_set         _nxde_mqtt_client_websocket_set
 #endif /* NXD_MQTT_OVER_WEBSOCKET */
@@ -461,19 +952,61 @@ UINT nxd_mqtt_client_will_message_set(NXD_MQTT_CLIENT *client_ptr,
 UINT nxd_mqtt_client_secure_connect(NXD_MQTT_CLIENT *client_ptr, NXD_ADDRESS *server_ip, UINT server_port,
                                     UINT (*tls_setup)(NXD_MQTT_CLIENT *client_ptr, NX_SECURE_TLS_SESSION *, NX_SECURE_X509_CERT *, NX_SECURE_X509_CERT *),
                                     UINT keepalive, UINT clean_session, ULONG timeout);
+UINT nxd_mqtt_client_tls_cache_set(NXD_MQTT_CLIENT *client_ptr, UINT enable);
+UINT nxd_mqtt_client_tls_statistics_get(NXD_MQTT_CLIENT *client_ptr, NXD_MQTT_TLS_STATISTICS *statistics_ptr);
 #endif /* NX_SECURE_ENABLE */
 UINT nxd_mqtt_client_publish(NXD_MQTT_CLIENT *client_ptr, CHAR *topic_name, UINT topic_name_length, CHAR *message, UINT message_length,
                              UINT retain, UINT QoS, ULONG timeout);
+UINT nxd_mqtt_client_publish_async(NXD_MQTT_CLIENT *client_ptr, CHAR *topic_name, UINT topic_name_length,
+                                   CHAR *message, UINT message_length, UINT retain, UINT QoS,
+                                   VOID (*complete_notify)(NXD_MQTT_CLIENT *client_ptr, UINT handle, UINT status, VOID *context),
+                                   VOID *context, UINT *handle_ptr);
+UINT nxd_mqtt_client_subscribe_async(NXD_MQTT_CLIENT *client_ptr, CHAR *topic_name, UINT topic_name_length, UINT QoS,
+                                     VOID (*complete_notify)(NXD_MQTT_CLIENT *client_ptr, UINT handle, UINT status, VOID *context),
+                                     VOID *context, UINT *handle_ptr);
+UINT nxd_mqtt_client_unsubscribe_async(NXD_MQTT_CLIENT *client_ptr, CHAR *topic_name, UINT topic_name_length,
+                                       VOID (*complete_notify)(NXD_MQTT_CLIENT *client_ptr, UINT handle, UINT status, VOID *context),
+                                       VOID *context, UINT *handle_ptr);
+UINT nxd_mqtt_client_request_complete_get(NXD_MQTT_CLIENT *client_ptr, UINT *handle_ptr, UINT *status_ptr);
 UINT nxd_mqtt_client_subscribe(NXD_MQTT_CLIENT *mqtt_client_pr, CHAR *topic_name, UINT topic_name_length, UINT QoS);
 UINT nxd_mqtt_client_unsubscribe(NXD_MQTT_CLIENT *mqtt_client_pr, CHAR *topic_name, UINT topic_name_length);
+UINT nxd_mqtt_client_subscription_add(NXD_MQTT_CLIENT *client_ptr, CHAR *topic_name, UINT topic_name_length, UINT QoS,
+                                      VOID (*handler)(NXD_MQTT_CLIENT *client_ptr, NXD_MQTT_MESSAGE *message_ptr, VOID *context),
+                                      VOID *context);
 UINT nxd_mqtt_client_receive_notify_set(NXD_MQTT_CLIENT *client_ptr,
                                         VOID (*receive_notify)(NXD_MQTT_CLIENT *client_ptr, UINT number_of_messages));
 UINT nxd_mqtt_client_message_get(NXD_MQTT_CLIENT *client_ptr, UCHAR *topic_buffer, UINT topic_buffer_size, UINT *actual_topic_length,
                                  UCHAR *message_buffer, UINT message_buffer_size, UINT *actual_message_length);
+UINT nxd_mqtt_client_message_borrow(NXD_MQTT_CLIENT *client_ptr, NXD_MQTT_MESSAGE *message_ptr);
+UINT nxd_mqtt_client_message_span_get(NXD_MQTT_MESSAGE *message_ptr, UINT part, ULONG offset,
+                                      UCHAR **data_ptr, ULONG *data_length);
+UINT nxd_mqtt_client_message_release(NXD_MQTT_CLIENT *client_ptr, NXD_MQTT_MESSAGE *message_ptr);
 UINT nxd_mqtt_client_disconnect(NXD_MQTT_CLIENT *client_ptr);
 
 UINT nxd_mqtt_client_delete(NXD_MQTT_CLIENT *client_ptr);
 UINT nxd_mqtt_client_disconnect_notify_set(NXD_MQTT_CLIENT *client_ptr, VOID (*disconnect_notify)(NXD_MQTT_CLIENT *));
+UINT nxd_mqtt_client_retention_pool_set(NXD_MQTT_CLIENT *client_ptr, NX_PACKET_POOL *pool_ptr);
+UINT nxd_mqtt_client_window_set(NXD_MQTT_CLIENT *client_ptr, UINT window_minimum, UINT window_maximum);
+UINT nxd_mqtt_client_journal_set(NXD_MQTT_CLIENT *client_ptr, VOID *buffer_ptr, ULONG buffer_size, UINT drain_rate);
+UINT nxd_mqtt_client_journal_topic_set(NXD_MQTT_CLIENT *client_ptr, CHAR *topic_name, UINT topic_name_length, UINT policy);
+UINT nxd_mqtt_client_pipeline_set(NXD_MQTT_CLIENT *client_ptr, UINT enable);
+UINT nxd_mqtt_client_cork_set(NXD_MQTT_CLIENT *client_ptr, UINT delay);
+UINT nxd_mqtt_client_flush(NXD_MQTT_CLIENT *client_ptr);
+UINT nxd_mqtt_client_topic_prepare(NXD_MQTT_TOPIC *topic_ptr, CHAR *topic_name, UINT topic_name_length);
+UINT nxd_mqtt_client_topic_publish(NXD_MQTT_CLIENT *client_ptr, NXD_MQTT_TOPIC *topic_ptr, CHAR *message, UINT message_length,
+                                   UINT retain, UINT QoS, ULONG wait_option);
+UINT nxd_mqtt_client_v5_set(NXD_MQTT_CLIENT *client_ptr, UINT receive_maximum, ULONG maximum_packet_size);
+UINT nxd_mqtt_client_metrics_get(NXD_MQTT_CLIENT *client_ptr, NXD_MQTT_METRICS *metrics_ptr);
+UINT nxd_mqtt_client_state_get(NXD_MQTT_CLIENT *client_ptr, UINT *state_ptr);
+UINT nxd_mqtt_client_journal_used_get(NXD_MQTT_CLIENT *client_ptr, ULONG *used_ptr);
+UINT nxd_mqtt_client_connect_notify_set(NXD_MQTT_CLIENT *client_ptr,
+                                       VOID (*connect_notify)(NXD_MQTT_CLIENT *client_ptr, UINT status, VOID *context),
+                                       VOID *context);
+UINT nxd_mqtt_client_tcp_establish_notify_set(NXD_MQTT_CLIENT *client_ptr, VOID (*tcp_establish_notify)(NXD_MQTT_CLIENT *client_ptr));
+UINT nxd_mqtt_client_ack_receive_notify_set(NXD_MQTT_CLIENT *client_ptr,
+                                           VOID (*ack_receive_notify)(NXD_MQTT_CLIENT *client_ptr, UINT type, USHORT packet_id,
+                                                                      NX_PACKET *transmit_packet_ptr, VOID *context),
+                                           VOID *context);
 #ifdef NXD_MQTT_OVER_WEBSOCKET
 UINT nxd_mqtt_client_websocket_set(NXD_MQTT_CLIENT *client_ptr, UCHAR *host, UINT host_length, UCHAR *uri_path, UINT uri_path_length);
 #endif /* NXD_MQTT_OVER_WEBSOCKET */
@@ -494,18 +1027,58 @@ UINT _nxd_mqtt_client_login_set(NXD_MQTT_CLIENT *client_ptr,
                                 CHAR *username, UINT username_length, CHAR *password, UINT password_length);
 UINT _nxd_mqtt_client_message_get(NXD_MQTT_CLIENT *client_ptr, UCHAR *topic_buffer, UINT topic_buffer_size, UINT *actual_topic_length,
                                   UCHAR *message_buffer, UINT message_buffer_size, UINT *actual_message_length);
+UINT _nxd_mqtt_client_message_borrow(NXD_MQTT_CLIENT *client_ptr, NXD_MQTT_MESSAGE *message_ptr);
+UINT _nxd_mqtt_client_message_span_get(NXD_MQTT_MESSAGE *message_ptr, UINT part, ULONG offset,
+                                       UCHAR **data_ptr, ULONG *data_length);
+UINT _nxd_mqtt_client_message_release(NXD_MQTT_CLIENT *client_ptr, NXD_MQTT_MESSAGE *message_ptr);
 UINT _nxd_mqtt_client_packet_allocate(NXD_MQTT_CLIENT *client_ptr, NX_PACKET **packet_ptr, ULONG wait_option);
 UINT _nxd_mqtt_client_publish_packet_send(NXD_MQTT_CLIENT *client_ptr, NX_PACKET *packet_ptr,
                                           USHORT packet_id, UINT QoS, ULONG wait_option);
 UINT _nxd_mqtt_client_publish(NXD_MQTT_CLIENT *client_ptr, CHAR *topic_name, UINT topic_name_length,
                               CHAR *message, UINT message_length, UINT retain, UINT QoS, ULONG timeout);
+UINT _nxd_mqtt_client_publish_async(NXD_MQTT_CLIENT *client_ptr, CHAR *topic_name, UINT topic_name_length,
+                                    CHAR *message, UINT message_length, UINT retain, UINT QoS,
+                                    VOID (*complete_notify)(NXD_MQTT_CLIENT *client_ptr, UINT handle, UINT status, VOID *context),
+                                    VOID *context, UINT *handle_ptr);
+UINT _nxd_mqtt_client_subscribe_async(NXD_MQTT_CLIENT *client_ptr, CHAR *topic_name, UINT topic_name_length, UINT QoS,
+                                      VOID (*complete_notify)(NXD_MQTT_CLIENT *client_ptr, UINT handle, UINT status, VOID *context),
+                                      VOID *context, UINT *handle_ptr);
+UINT _nxd_mqtt_client_unsubscribe_async(NXD_MQTT_CLIENT *client_ptr, CHAR *topic_name, UINT topic_name_length,
+                                        VOID (*complete_notify)(NXD_MQTT_CLIENT *client_ptr, UINT handle, UINT status, VOID *context),
+                                        VOID *context, UINT *handle_ptr);
+UINT _nxd_mqtt_client_request_complete_get(NXD_MQTT_CLIENT *client_ptr, UINT *handle_ptr, UINT *status_ptr);
 UINT _nxd_mqtt_client_receive_notify_set(NXD_MQTT_CLIENT *client_ptr,
                                          VOID (*receive_notify)(NXD_MQTT_CLIENT *client_ptr, UINT message_count));
+UINT _nxd_mqtt_client_retention_pool_set(NXD_MQTT_CLIENT *client_ptr, NX_PACKET_POOL *pool_ptr);
+UINT _nxd_mqtt_client_window_set(NXD_MQTT_CLIENT *client_ptr, UINT window_minimum, UINT window_maximum);
+UINT _nxd_mqtt_client_journal_set(NXD_MQTT_CLIENT *client_ptr, VOID *buffer_ptr, ULONG buffer_size, UINT drain_rate);
+UINT _nxd_mqtt_client_journal_topic_set(NXD_MQTT_CLIENT *client_ptr, CHAR *topic_name, UINT topic_name_length, UINT policy);
+UINT _nxd_mqtt_client_pipeline_set(NXD_MQTT_CLIENT *client_ptr, UINT enable);
+UINT _nxd_mqtt_client_cork_set(NXD_MQTT_CLIENT *client_ptr, UINT delay);
+UINT _nxd_mqtt_client_flush(NXD_MQTT_CLIENT *client_ptr);
+UINT _nxd_mqtt_client_topic_prepare(NXD_MQTT_TOPIC *topic_ptr, CHAR *topic_name, UINT topic_name_length);
+UINT _nxd_mqtt_client_topic_publish(NXD_MQTT_CLIENT *client_ptr, NXD_MQTT_TOPIC *topic_ptr, CHAR *message, UINT message_length,
+                                    UINT retain, UINT QoS, ULONG wait_option);
+UINT _nxd_mqtt_client_v5_set(NXD_MQTT_CLIENT *client_ptr, UINT receive_maximum, ULONG maximum_packet_size);
+UINT _nxd_mqtt_client_metrics_get(NXD_MQTT_CLIENT *client_ptr, NXD_MQTT_METRICS *metrics_ptr);
+UINT _nxd_mqtt_client_state_get(NXD_MQTT_CLIENT *client_ptr, UINT *state_ptr);
+UINT _nxd_mqtt_client_journal_used_get(NXD_MQTT_CLIENT *client_ptr, ULONG *used_ptr);
+UINT _nxd_mqtt_client_connect_notify_set(NXD_MQTT_CLIENT *client_ptr,
+                                        VOID (*connect_notify)(NXD_MQTT_CLIENT *client_ptr, UINT status, VOID *context),
+                                        VOID *context);
+UINT _nxd_mqtt_client_tcp_establish_notify_set(NXD_MQTT_CLIENT *client_ptr, VOID (*tcp_establish_notify)(NXD_MQTT_CLIENT *client_ptr));
+UINT _nxd_mqtt_client_ack_receive_notify_set(NXD_MQTT_CLIENT *client_ptr,
+                                            VOID (*ack_receive_notify)(NXD_MQTT_CLIENT *client_ptr, UINT type, USHORT packet_id,
+                                                                       NX_PACKET *transmit_packet_ptr, VOID *context),
+                                            VOID *context);
 UINT _nxd_mqtt_client_release_callback_set(NXD_MQTT_CLIENT *client_ptr, VOID (*memory_release_function)(CHAR *, UINT));
 UINT _nxd_mqtt_client_sub_unsub(NXD_MQTT_CLIENT *client_ptr, UINT op,
                                 CHAR *topic_name, UINT topic_name_length, USHORT *packet_id_ptr, UINT QoS);
 UINT _nxd_mqtt_client_subscribe(NXD_MQTT_CLIENT *client_ptr, CHAR *topic_name, UINT topic_name_length, UINT QoS);
 UINT _nxd_mqtt_client_unsubscribe(NXD_MQTT_CLIENT *client_ptr, CHAR *topic_name, UINT topic_name_length);
+UINT _nxd_mqtt_client_subscription_add(NXD_MQTT_CLIENT *client_ptr, CHAR *topic_name, UINT topic_name_length, UINT QoS,
+                                       VOID (*handler)(NXD_MQTT_CLIENT *client_ptr, NXD_MQTT_MESSAGE *message_ptr, VOID *context),
+                                       VOID *context);
 UINT _nxd_mqtt_client_will_message_set(NXD_MQTT_CLIENT *client_ptr,
                                        const UCHAR *will_topic, UINT will_topic_length, const UCHAR *will_message,
                                        UINT will_message_length, UINT will_retain_flag, UINT will_QoS);
@@ -513,7 +1086,8 @@ UINT _nxd_mqtt_read_remaining_length(NX_PACKET *packet_ptr, UINT *remaining_leng
 UINT _nxd_mqtt_client_set_fixed_header(NXD_MQTT_CLIENT *client_ptr, NX_PACKET *packet_ptr, UCHAR control_header, UINT length, UINT wait_option);
 UINT _nxd_mqtt_client_append_message(NXD_MQTT_CLIENT *client_ptr, NX_PACKET *packet_ptr, CHAR *message, UINT length, ULONG wait_option);
 VOID _nxd_mqtt_client_connection_end(NXD_MQTT_CLIENT *client_ptr, ULONG wait_option);
-UINT _nxd_mqtt_process_publish_packet(NX_PACKET *packet_ptr, ULONG *topic_offset_ptr, USHORT *topic_length_ptr,
+UINT _nxd_mqtt_process_publish_packet(NXD_MQTT_CLIENT *client_ptr, NX_PACKET *packet_ptr,
+                                      ULONG *topic_offset_ptr, USHORT *topic_length_ptr,
                                       ULONG *message_offset_ptr, ULONG *message_length_ptr);
 
 UINT _nxde_mqtt_client_connect(NXD_MQTT_CLIENT *client_ptr, NXD_ADDRESS *server_ip, UINT server_port,
@@ -524,18 +1098,58 @@ UINT _nxde_mqtt_client_create(NXD_MQTT_CLIENT *client_ptr, CHAR *client_name, CH
                               VOID *memory_ptr, ULONG memory_size);
 UINT _nxde_mqtt_client_delete(NXD_MQTT_CLIENT *client_ptr);
 UINT _nxde_mqtt_client_disconnect_notify_set(NXD_MQTT_CLIENT *client_ptr, VOID (*disconnect_notify)(NXD_MQTT_CLIENT *));
+UINT _nxde_mqtt_client_retention_pool_set(NXD_MQTT_CLIENT *client_ptr, NX_PACKET_POOL *pool_ptr);
+UINT _nxde_mqtt_client_window_set(NXD_MQTT_CLIENT *client_ptr, UINT window_minimum, UINT window_maximum);
+UINT _nxde_mqtt_client_journal_set(NXD_MQTT_CLIENT *client_ptr, VOID *buffer_ptr, ULONG buffer_size, UINT drain_rate);
+UINT _nxde_mqtt_client_journal_topic_set(NXD_MQTT_CLIENT *client_ptr, CHAR *topic_name, UINT topic_name_length, UINT policy);
+UINT _nxde_mqtt_client_pipeline_set(NXD_MQTT_CLIENT *client_ptr, UINT enable);
+UINT _nxde_mqtt_client_cork_set(NXD_MQTT_CLIENT *client_ptr, UINT delay);
+UINT _nxde_mqtt_client_flush(NXD_MQTT_CLIENT *client_ptr);
+UINT _nxde_mqtt_client_topic_prepare(NXD_MQTT_TOPIC *topic_ptr, CHAR *topic_name, UINT topic_name_length);
+UINT _nxde_mqtt_client_topic_publish(NXD_MQTT_CLIENT *client_ptr, NXD_MQTT_TOPIC *topic_ptr, CHAR *message, UINT message_length,
+                                     UINT retain, UINT QoS, ULONG wait_option);
+UINT _nxde_mqtt_client_v5_set(NXD_MQTT_CLIENT *client_ptr, UINT receive_maximum, ULONG maximum_packet_size);
+UINT _nxde_mqtt_client_metrics_get(NXD_MQTT_CLIENT *client_ptr, NXD_MQTT_METRICS *metrics_ptr);
+UINT _nxde_mqtt_client_state_get(NXD_MQTT_CLIENT *client_ptr, UINT *state_ptr);
+UINT _nxde_mqtt_client_journal_used_get(NXD_MQTT_CLIENT *client_ptr, ULONG *used_ptr);
+UINT _nxde_mqtt_client_connect_notify_set(NXD_MQTT_CLIENT *client_ptr,
+                                         VOID (*connect_notify)(NXD_MQTT_CLIENT *client_ptr, UINT status, VOID *context),
+                                         VOID *context);
+UINT _nxde_mqtt_client_tcp_establish_notify_set(NXD_MQTT_CLIENT *client_ptr, VOID (*tcp_establish_notify)(NXD_MQTT_CLIENT *client_ptr));
+UINT _nxde_mqtt_client_ack_receive_notify_set(NXD_MQTT_CLIENT *client_ptr,
+                                             VOID (*ack_receive_notify)(NXD_MQTT_CLIENT *client_ptr, UINT type, USHORT packet_id,
+                                                                        NX_PACKET *transmit_packet_ptr, VOID *context),
+                                             VOID *context);
 UINT _nxde_mqtt_client_disconnect(NXD_MQTT_CLIENT *client_ptr);
 UINT _nxde_mqtt_client_login_set(NXD_MQTT_CLIENT *client_ptr,
                                  CHAR *username, UINT username_length, CHAR *password, UINT password_length);
 UINT _nxde_mqtt_client_message_get(NXD_MQTT_CLIENT *client_ptr, UCHAR *topic_buffer, UINT topic_buffer_size, UINT *actual_topic_length,
                                    UCHAR *message_buffer, UINT message_buffer_size, UINT *actual_message_length);
+UINT _nxde_mqtt_client_message_borrow(NXD_MQTT_CLIENT *client_ptr, NXD_MQTT_MESSAGE *message_ptr);
+UINT _nxde_mqtt_client_message_span_get(NXD_MQTT_MESSAGE *message_ptr, UINT part, ULONG offset,
+                                        UCHAR **data_ptr, ULONG *data_length);
+UINT _nxde_mqtt_client_message_release(NXD_MQTT_CLIENT *client_ptr, NXD_MQTT_MESSAGE *message_ptr);
 UINT _nxde_mqtt_client_publish(NXD_MQTT_CLIENT *client_ptr, CHAR *topic_name, UINT topic_name_length,
                                CHAR *message, UINT message_length, UINT retain, UINT QoS, ULONG timeout);
+UINT _nxde_mqtt_client_publish_async(NXD_MQTT_CLIENT *client_ptr, CHAR *topic_name, UINT topic_name_length,
+                                     CHAR *message, UINT message_length, UINT retain, UINT QoS,
+                                     VOID (*complete_notify)(NXD_MQTT_CLIENT *client_ptr, UINT handle, UINT status, VOID *context),
+                                     VOID *context, UINT *handle_ptr);
+UINT _nxde_mqtt_client_subscribe_async(NXD_MQTT_CLIENT *client_ptr, CHAR *topic_name, UINT topic_name_length, UINT QoS,
+                                       VOID (*complete_notify)(NXD_MQTT_CLIENT *client_ptr, UINT handle, UINT status, VOID *context),
+                                       VOID *context, UINT *handle_ptr);
+UINT _nxde_mqtt_client_unsubscribe_async(NXD_MQTT_CLIENT *client_ptr, CHAR *topic_name, UINT topic_name_length,
+                                         VOID (*complete_notify)(NXD_MQTT_CLIENT *client_ptr, UINT handle, UINT status, VOID *context),
+                                         VOID *context, UINT *handle_ptr);
+UINT _nxde_mqtt_client_request_complete_get(NXD_MQTT_CLIENT *client_ptr, UINT *handle_ptr, UINT *status_ptr);
 UINT _nxde_mqtt_client_receive_notify_set(NXD_MQTT_CLIENT *client_ptr,
                                           VOID (*receive_notify)(NXD_MQTT_CLIENT *client_ptr, UINT message_count));
 UINT _nxde_mqtt_client_release_callback_set(NXD_MQTT_CLIENT *client_ptr, VOID (*release_callback)(CHAR *, UINT));
 UINT _nxde_mqtt_client_subscribe(NXD_MQTT_CLIENT *client_ptr, CHAR *topic_name, UINT topic_name_length, UINT QoS);
 UINT _nxde_mqtt_client_unsubscribe(NXD_MQTT_CLIENT *client_ptr, CHAR *topic_name, UINT topic_name_length);
+UINT _nxde_mqtt_client_subscription_add(NXD_MQTT_CLIENT *client_ptr, CHAR *topic_name, UINT topic_name_length, UINT QoS,
+                                        VOID (*handler)(NXD_MQTT_CLIENT *client_ptr, NXD_MQTT_MESSAGE *message_ptr, VOID *context),
+                                        VOID *context);
 UINT _nxde_mqtt_client_will_message_set(NXD_MQTT_CLIENT *client_ptr,
                                         const UCHAR *will_topic, UINT will_topic_length, const UCHAR *will_message,
                                         UINT will_message_length, UINT will_retain_flag, UINT will_QoS);
@@ -549,6 +1163,10 @@ UINT _nxde_mqtt_client_secure_connect(NXD_MQTT_CLIENT *client_ptr, NXD_ADDRESS *
                                       UINT (*tls_setup)(NXD_MQTT_CLIENT *client_ptr, NX_SECURE_TLS_SESSION *,
                                                         NX_SECURE_X509_CERT *, NX_SECURE_X509_CERT *),
                                       UINT keepalive, UINT clean_session, ULONG timeout);
+UINT _nxd_mqtt_client_tls_cache_set(NXD_MQTT_CLIENT *client_ptr, UINT enable);
+UINT _nxde_mqtt_client_tls_cache_set(NXD_MQTT_CLIENT *client_ptr, UINT enable);
+UINT _nxd_mqtt_client_tls_statistics_get(NXD_MQTT_CLIENT *client_ptr, NXD_MQTT_TLS_STATISTICS *statistics_ptr);
+UINT _nxde_mqtt_client_tls_statistics_get(NXD_MQTT_CLIENT *client_ptr, NXD_MQTT_TLS_STATISTICS *statistics_ptr);
 #endif /* NX_SECURE_ENABLE */
 
 #ifdef NXD_MQTT_OVER_WEBSOCKET
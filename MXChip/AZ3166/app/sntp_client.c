@@ -23,9 +23,13 @@
 #include "nxd_sntp_client.h"
 
 #include "wwd_networking.h"
+#include "boot.h"
 
 #define SNTP_UPDATE_EVENT 1
 
+#define SNTP_THREAD_STACK_SIZE 2048
+#define SNTP_THREAD_PRIORITY   5
+
 // Time to wait for each server poll
 #define SNTP_WAIT_TIME (10 * NX_IP_PERIODIC_RATE)
 
@@ -44,6 +48,10 @@ static NX_SNTP_CLIENT sntp_client;
 
 static TX_EVENT_FLAGS_GROUP sntp_flags;
 
+// Syncs in the background, so connecting to a broker without TLS does not wait for the time
+static TX_THREAD sntp_thread;
+static ULONG sntp_thread_stack[SNTP_THREAD_STACK_SIZE / sizeof(ULONG)];
+
 // Variables to keep track of time
 static ULONG sntp_last_time = 0;
 static ULONG tx_last_ticks  = 0;
@@ -140,6 +148,19 @@ UINT sntp_time(ULONG* unix_time)
     return NX_SUCCESS;
 }
 
+// Runs one sync each time it is resumed
+static void sntp_thread_entry(ULONG parameter)
+{
+    while (NX_TRUE)
+    {
+        sntp_sync();
+        boot_trace("sntp_synced");
+        boot_phase_done(BOOT_TIME);
+
+        tx_thread_suspend(&sntp_thread);
+    }
+}
+
 UINT sntp_init()
 {
     UINT status;
@@ -168,6 +189,22 @@ UINT sntp_init()
         nx_sntp_client_delete(&sntp_client);
     }
 
+    // Create the sync thread, started by sntp_sync_start
+    else if ((status = tx_thread_create(&sntp_thread,
+                  "SNTP",
+                  sntp_thread_entry,
+                  0,
+                  sntp_thread_stack,
+                  SNTP_THREAD_STACK_SIZE,
+                  SNTP_THREAD_PRIORITY,
+                  SNTP_THREAD_PRIORITY,
+                  TX_NO_TIME_SLICE,
+                  TX_DONT_START)))
+    {
+        printf("ERROR: SNTP thread create failed (0x%08x)\r\n", status);
+        nx_sntp_client_delete(&sntp_client);
+    }
+
     return status;
 }
 
@@ -209,3 +246,19 @@ UINT sntp_sync()
 
     return status;
 }
+
+// Starts a sync in the background, unless one is already running
+UINT sntp_sync_start()
+{
+    UINT status;
+
+    boot_phase_start(BOOT_TIME);
+
+    status = tx_thread_resume(&sntp_thread);
+    if (status == TX_RESUME_ERROR)
+    {
+        status = NX_SUCCESS;
+    }
+
+    return status;
+}
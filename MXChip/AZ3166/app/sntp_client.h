@@ -23,5 +23,6 @@ UINT sntp_time(ULONG* unix_time);
 
 UINT sntp_init();
 UINT sntp_sync();
+UINT sntp_sync_start();
 
 #endif
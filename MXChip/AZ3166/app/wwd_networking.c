@@ -13,9 +13,12 @@
  *     Frédéric Desbiens - 2024 version.
  */
 
+#include <stdlib.h>
+
 #include "wwd_networking.h"
 #include "nx_api.h"
 #include "nx_secure_tls_api.h"
+#include "nxd_mqtt_client.h"
 #include "nxd_dhcp_client.h"
 #include "nxd_dns.h"
 #include "board_init.h"
@@ -23,20 +26,24 @@
 #include "wiced_sdk.h"
 
 #include "sntp_client.h"
+#include "boot.h"
+#include "dhcp_lease.h"
 
 #define NETX_IP_STACK_SIZE   2048
-#define NETX_TX_PACKET_COUNT 16
+#define NETX_TX_PACKET_COUNT (16 + NXD_MQTT_CONTROL_PACKET_RESERVE) // The MQTT client keeps some for acks and pings
 #define NETX_RX_PACKET_COUNT 12
 #define NETX_PACKET_SIZE     (WICED_LINK_MTU)
 #define NETX_TX_POOL_SIZE    ((NETX_PACKET_SIZE + sizeof(NX_PACKET)) * NETX_TX_PACKET_COUNT)
 #define NETX_RX_POOL_SIZE    ((NETX_PACKET_SIZE + sizeof(NX_PACKET)) * NETX_RX_PACKET_COUNT)
 #define NETX_ARP_CACHE_SIZE  512
 #define NETX_DNS_COUNT       6
+#define NETX_DNS_CACHE_SIZE  2048
 
 #define NETX_IPV4_ADDRESS IP_ADDRESS(0, 0, 0, 0)
 #define NETX_IPV4_MASK    IP_ADDRESS(255, 255, 255, 0)
 
 #define DHCP_WAIT_TIME_TICKS (60 * TX_TIMER_TICKS_PER_SECOND)  // Wait 60 seconds for DHCP
+#define DHCP_REBOOT_WAIT_TICKS (5 * TX_TIMER_TICKS_PER_SECOND) // Wait 5 seconds for the saved lease before a full DISCOVER
 
 #define WIFI_COUNTRY WICED_COUNTRY_WORLD_WIDE_XX
 
@@ -44,6 +51,9 @@ static UCHAR netx_ip_stack[NETX_IP_STACK_SIZE];
 static UCHAR netx_tx_pool_stack[NETX_TX_POOL_SIZE];
 static UCHAR netx_rx_pool_stack[NETX_RX_POOL_SIZE];
 static UCHAR netx_arp_cache_area[NETX_ARP_CACHE_SIZE];
+#ifdef NX_DNS_CACHE_ENABLE
+static ULONG netx_dns_cache_area[NETX_DNS_CACHE_SIZE / sizeof(ULONG)];
+#endif
 
 static CHAR* netx_ssid;
 static CHAR* netx_password;
@@ -91,6 +101,7 @@ static UINT wifi_init()
         printf("ERROR: wwd_management_wifi_on\r\n");
         return NX_NOT_SUCCESSFUL;
     }
+    boot_trace("wifi_on");
 
     wwd_wifi_get_mac_address(&mac, WWD_STA_INTERFACE);
     printf("\tMAC address: %02X:%02X:%02X:%02X:%02X:%02X\r\n",
@@ -101,11 +112,34 @@ static UINT wifi_init()
         mac.octet[4],
         mac.octet[5]);
 
+    // Seed the random numbers from the MAC address, so devices booting together do not pick the same
+    // DHCP transaction IDs or reconnect delays
+    srand(((UINT)mac.octet[2] << 24) | ((UINT)mac.octet[3] << 16) | ((UINT)mac.octet[4] << 8) | mac.octet[5]);
+
     printf("SUCCESS: WiFi initialized\r\n");
 
     return NX_SUCCESS;
 }
 
+// Saves the lease on every bind, so the next boot can skip DISCOVER
+static void dhcp_state_change_notify(NX_DHCP* dhcp_ptr, UCHAR new_state)
+{
+    NX_DHCP_INTERFACE_RECORD* record = &dhcp_ptr->nx_dhcp_interface_record[0];
+    DHCP_LEASE lease;
+
+    if (new_state != NX_DHCP_STATE_BOUND)
+    {
+        return;
+    }
+
+    lease.ip_address      = record->nx_dhcp_ip_address;
+    lease.network_mask    = record->nx_dhcp_network_mask;
+    lease.gateway_address = record->nx_dhcp_gateway_address;
+    lease.server_ip       = record->nx_dhcp_server_ip;
+
+    dhcp_lease_save(&lease);
+}
+
 static UINT dhcp_connect(void)
 {
     UINT status;
@@ -113,17 +147,47 @@ static UINT dhcp_connect(void)
     ULONG ip_address;
     ULONG network_mask;
     ULONG gateway_address;
+    DHCP_LEASE lease;
+    UINT reboot = NX_FALSE;
 
     printf("\r\nInitializing DHCP...\n");
 
-    // Start DHCP client
+    // On a fresh start, ask for the saved address (INIT-REBOOT): a single REQUEST/ACK instead of
+    // DISCOVER, OFFER, REQUEST, ACK
+    if ((nx_dhcp_client.nx_dhcp_interface_record[0].nx_dhcp_state == NX_DHCP_STATE_NOT_STARTED) &&
+        (dhcp_lease_load(&lease) == NX_SUCCESS))
+    {
+        print_address("Saved lease", lease.ip_address);
+        nx_dhcp_request_client_ip(&nx_dhcp_client, lease.ip_address, NX_TRUE);
+        reboot = NX_TRUE;
+    }
+
+    nx_dhcp_state_change_notify(&nx_dhcp_client, dhcp_state_change_notify);
+
+    // Start DHCP client, already running after a rejoin
     status = nx_dhcp_start(&nx_dhcp_client);
-    if (status != NX_SUCCESS)
+    if ((status != NX_SUCCESS) && (status != NX_DHCP_ALREADY_STARTED))
     {
         printf("ERROR: DHCP client start failed (0x%08x)\n", status);
         return status;
     }
 
+    // The client retries an unanswered REQUEST forever, so bound the wait and fall back to DISCOVER. A NAK
+    // for the saved address already sends the client back to DISCOVER on its own
+    if (reboot &&
+        (nx_ip_status_check(&nx_ip, NX_IP_ADDRESS_RESOLVED, &actual_status, DHCP_REBOOT_WAIT_TICKS) != NX_SUCCESS))
+    {
+        printf("WARNING: Saved DHCP lease not confirmed, discovering...\n");
+        nx_dhcp_stop(&nx_dhcp_client);
+        nx_dhcp_reinitialize(&nx_dhcp_client);
+        status = nx_dhcp_start(&nx_dhcp_client);
+        if (status != NX_SUCCESS)
+        {
+            printf("ERROR: DHCP client restart failed (0x%08x)\n", status);
+            return status;
+        }
+    }
+
     // Wait for DHCP lease (retry 3 times)
     int retries = 3;
     while (retries--)
@@ -140,6 +204,7 @@ static UINT dhcp_connect(void)
             print_address("Gateway", gateway_address);
 
             printf("SUCCESS: DHCP initialized\n");
+            boot_trace("dhcp_bound");
             return NX_SUCCESS;
         }
 
@@ -173,6 +238,7 @@ static UINT dns_connect()
     }
 
     print_address("DNS Server", IP_ADDRESS(8, 8, 8, 8));
+    boot_trace("dns_ready");
     return NX_SUCCESS;
 }
 
@@ -203,8 +269,14 @@ UINT wwd_network_init(CHAR* ssid, CHAR* password, WiFi_Mode mode)
     // Initialize the NetX system.
     nx_system_initialize();
 
+    // Guard the lease sector, written by the DHCP and MQTT threads
+    if ((status = dhcp_lease_init()))
+    {
+        printf("ERROR: dhcp_lease_init (0x%08x)\r\n", status);
+    }
+
     // Create a packet pool for TX.
-    if ((status = nx_packet_pool_create(
+    else if ((status = nx_packet_pool_create(
              &nx_pool[0], "NetX TX Packet Pool", NETX_PACKET_SIZE, netx_tx_pool_stack, NETX_TX_POOL_SIZE)))
     {
         printf("ERROR: nx_packet_pool_create TX (0x%08x)\r\n", status);
@@ -287,16 +359,6 @@ UINT wwd_network_init(CHAR* ssid, CHAR* password, WiFi_Mode mode)
         printf("ERROR: nx_dhcp_create (0x%08x)\r\n", status);
     }
 
-    // Start the DHCP Client.
-    else if ((status = nx_dhcp_start(&nx_dhcp_client)))
-    {
-        nx_dhcp_delete(&nx_dhcp_client);
-        nx_ip_delete(&nx_ip);
-        nx_packet_pool_delete(&nx_pool[0]);
-        nx_packet_pool_delete(&nx_pool[1]);
-        printf("ERROR: nx_dhcp_start (0x%08x)\r\n", status);
-    }
-
     // Create DNS
     else if ((status = nx_dns_create(&nx_dns_client, &nx_ip, (UCHAR*)"DNS Client")))
     {
@@ -320,6 +382,19 @@ UINT wwd_network_init(CHAR* ssid, CHAR* password, WiFi_Mode mode)
     }
 #endif
 
+#ifdef NX_DNS_CACHE_ENABLE
+    // Answers are reused for their TTL, and served past it while no DNS server answers
+    else if ((status = nx_dns_cache_initialize(&nx_dns_client, netx_dns_cache_area, sizeof(netx_dns_cache_area))))
+    {
+        nx_dns_delete(&nx_dns_client);
+        nx_dhcp_delete(&nx_dhcp_client);
+        nx_ip_delete(&nx_ip);
+        nx_packet_pool_delete(&nx_pool[0]);
+        nx_packet_pool_delete(&nx_pool[1]);
+        printf("ERROR: nx_dns_cache_initialize (0x%08x)\r\n", status);
+    }
+#endif
+
     // Initialize the SNTP client
     else if ((status = sntp_init()))
     {
@@ -340,6 +415,11 @@ UINT wwd_network_init(CHAR* ssid, CHAR* password, WiFi_Mode mode)
     return status;
 }
 
+UINT wwd_network_is_connected()
+{
+    return (wwd_wifi_is_ready_to_transceive(WWD_STA_INTERFACE) == WWD_SUCCESS) ? NX_TRUE : NX_FALSE;
+}
+
 UINT wwd_network_connect()
 {
     UINT status;
@@ -347,6 +427,8 @@ UINT wwd_network_connect()
     wiced_ssid_t wiced_ssid = {0};
     wwd_result_t join_result;
 
+    boot_phase_start(BOOT_WIFI);
+
     // Check if Wi-Fi is already connected
     if (wwd_wifi_is_ready_to_transceive(WWD_STA_INTERFACE) != WWD_SUCCESS)
     {
@@ -373,6 +455,7 @@ UINT wwd_network_connect()
             if (join_result == WWD_SUCCESS)
             {
                 printf("SUCCESS: Wi-Fi connected\n");
+                boot_trace("wifi_joined");
                 WIFI_LED_ON();
                 break;
             }
@@ -389,25 +472,30 @@ UINT wwd_network_connect()
         }
     }
 
-    // Fetch IP details
+    boot_phase_done(BOOT_WIFI);
+
+    // Fetch IP details, with DHCP started only now that its messages can reach the network
+    boot_phase_start(BOOT_IP);
     status = dhcp_connect();
     if (status != NX_SUCCESS)
     {
         printf("ERROR: DHCP failed\n");
+        return status;
     }
+    boot_phase_done(BOOT_IP);
 
     // Create DNS client
-    status = dns_connect();
-    if (status != NX_SUCCESS)
+    boot_phase_start(BOOT_DNS);
+    if (dns_connect() != NX_SUCCESS)
     {
         printf("ERROR: DNS client setup failed\n");
     }
+    boot_phase_done(BOOT_DNS);
 
-    // Sync SNTP time
-    status = sntp_sync();
-    if (status != NX_SUCCESS)
+    // Sync SNTP time in the background
+    if (sntp_sync_start() != NX_SUCCESS)
     {
-        printf("ERROR: Failed to sync SNTP time (0x%08x)\n", status);
+        printf("ERROR: Failed to start SNTP time sync\n");
     }
 
     return status;
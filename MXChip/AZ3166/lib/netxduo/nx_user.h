@@ -23,6 +23,10 @@
 #define NX_DNS_CLIENT_USER_CREATE_PACKET_POOL
 #define NX_DHCP_CLIENT_ENABLE 1  // ✅ Must be enabled for DHCP
 #define NX_DNS_CLIENT_ENABLE 1  // ✅ Needed for hostname resolution
+#define NX_DNS_CACHE_ENABLE     // Answers are reused for their TTL, failures for a short while
+#define NX_DHCP_CLIENT_RAPID_COMMIT          // DISCOVER/ACK when the server supports it
+#define NX_DHCP_CLIENT_SEND_ARP_PROBE
+#define NX_DHCP_CLIENT_ARP_PROBE_CONCURRENT  // The address is usable while the probe runs
 
 #define NX_SNTP_CLIENT_MIN_SERVER_STRATUM 3
 
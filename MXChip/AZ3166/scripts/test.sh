@@ -0,0 +1,20 @@
+#  Copyright (c) 2024 Eclipse Foundation
+#
+#  This program and the accompanying materials are made available
+#  under the terms of the MIT license which is available at
+#  https://opensource.org/license/mit.
+#
+#  SPDX-License-Identifier: MIT
+
+#!/bin/bash
+
+# Build and run the host tests of the application modules
+
+# Use paths relative to this script's location
+SCRIPT=$(readlink -f "$0")
+SCRIPTDIR=$(dirname "$SCRIPT")
+BASEDIR=$(dirname "$SCRIPTDIR")
+
+BUILDDIR="$BASEDIR/build-tests"
+
+cmake -B"$BUILDDIR" "$BASEDIR/tests" && cmake --build "$BUILDDIR" && ctest --test-dir "$BUILDDIR" --output-on-failure
@@ -0,0 +1,413 @@
+// A scripted MQTT broker stand-in for the host tests. See broker.h.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "broker.h"
+
+UINT broker_length_encode(UCHAR *buffer, ULONG value)
+{
+    UINT length = 0;
+
+    do
+    {
+        buffer[length] = (UCHAR)(value & 0x7F);
+        value >>= 7;
+        if (value)
+        {
+            buffer[length] |= 0x80;
+        }
+        length++;
+    } while (value);
+
+    return length;
+}
+
+// Decode the fixed header at data, returning its length, or 0 if it is incomplete
+static UINT broker_header_decode(const UCHAR *data, ULONG length, ULONG *remaining_length)
+{
+    UINT offset = 1;
+    UINT shift = 0;
+
+    *remaining_length = 0;
+    for (;;)
+    {
+        if (offset >= length)
+        {
+            return 0;
+        }
+        if (offset > 4)
+        {
+            fprintf(stderr, "broker: remaining length longer than four bytes\n");
+            abort();
+        }
+        *remaining_length += (ULONG)(data[offset] & 0x7F) << shift;
+        shift += 7;
+        if ((data[offset++] & 0x80) == 0)
+        {
+            return offset;
+        }
+    }
+}
+
+// Skip the MQTT 5 properties at offset
+static ULONG broker_properties_skip(const UCHAR *data, ULONG offset)
+{
+    ULONG properties_length;
+    UINT header_length;
+
+    // A property length decodes as a remaining length one byte later
+    header_length = broker_header_decode(data + offset - 1, 5, &properties_length);
+    return offset + header_length - 1 + properties_length;
+}
+
+static USHORT broker_short(const UCHAR *data)
+{
+    return (USHORT)((data[0] << 8) | data[1]);
+}
+
+VOID broker_send(BROKER *broker_ptr, const UCHAR *data, ULONG length)
+{
+    if (host_tcp_deliver(broker_ptr->socket_ptr, data, length, broker_ptr->segment_size) != NX_SUCCESS)
+    {
+        fprintf(stderr, "broker: send without a connection\n");
+        abort();
+    }
+}
+
+VOID broker_ack(BROKER *broker_ptr, UCHAR type, USHORT packet_id)
+{
+    UCHAR packet[4];
+
+    packet[0] = (UCHAR)((type << 4) | ((type == BROKER_PUBREL) ? 0x02 : 0));
+    packet[1] = 2;
+    packet[2] = (UCHAR)(packet_id >> 8);
+    packet[3] = (UCHAR)packet_id;
+    broker_send(broker_ptr, packet, sizeof(packet));
+}
+
+ULONG broker_publish_encode(BROKER *broker_ptr, UCHAR *buffer, const CHAR *topic, const UCHAR *payload,
+                            UINT payload_length, UINT qos, USHORT packet_id, UINT dup)
+{
+    UINT topic_length = (UINT)strlen(topic);
+    ULONG remaining_length = 2 + topic_length + ((qos) ? 2 : 0) + ((broker_ptr->protocol_level == 5) ? 1 : 0) + payload_length;
+    ULONG length;
+
+    buffer[0] = (UCHAR)((BROKER_PUBLISH << 4) | ((dup) ? 0x08 : 0) | (qos << 1));
+    length = 1 + broker_length_encode(buffer + 1, remaining_length);
+    buffer[length++] = (UCHAR)(topic_length >> 8);
+    buffer[length++] = (UCHAR)topic_length;
+    memcpy(buffer + length, topic, topic_length);
+    length += topic_length;
+    if (qos)
+    {
+        buffer[length++] = (UCHAR)(packet_id >> 8);
+        buffer[length++] = (UCHAR)packet_id;
+    }
+    if (broker_ptr->protocol_level == 5)
+    {
+        // No properties
+        buffer[length++] = 0;
+    }
+    memcpy(buffer + length, payload, payload_length);
+    return length + payload_length;
+}
+
+VOID broker_publish(BROKER *broker_ptr, const CHAR *topic, const UCHAR *payload, UINT payload_length,
+                    UINT qos, USHORT packet_id, UINT dup)
+{
+    UCHAR *buffer = malloc(payload_length + strlen(topic) + 16);
+
+    broker_send(broker_ptr, buffer,
+                broker_publish_encode(broker_ptr, buffer, topic, payload, payload_length, qos, packet_id, dup));
+    free(buffer);
+}
+
+static VOID broker_connack(BROKER *broker_ptr)
+{
+    UCHAR packet[80];
+    ULONG length = 0;
+    ULONG remaining_length = 2;
+
+    if (broker_ptr->protocol_level == 5)
+    {
+        remaining_length += (broker_ptr->connack_properties_length) ? broker_ptr->connack_properties_length : 1;
+    }
+    packet[length++] = BROKER_CONNACK << 4;
+    length += broker_length_encode(packet + length, remaining_length);
+    packet[length++] = broker_ptr->session_present;
+    packet[length++] = broker_ptr->connack_return_code;
+    if (broker_ptr->protocol_level == 5)
+    {
+        if (broker_ptr->connack_properties_length == 0)
+        {
+            // No properties
+            packet[length++] = 0;
+        }
+        memcpy(packet + length, broker_ptr->connack_properties, broker_ptr->connack_properties_length);
+        length += broker_ptr->connack_properties_length;
+    }
+    broker_send(broker_ptr, packet, length);
+}
+
+// SUBACK or UNSUBACK, granting each filter the QoS asked for
+static VOID broker_sub_unsub_ack(BROKER *broker_ptr, UCHAR type, USHORT packet_id, const UCHAR *codes, UINT count)
+{
+    UCHAR packet[64];
+    ULONG length = 0;
+    UINT v5 = (broker_ptr->protocol_level == 5);
+
+    // An MQTT 3.1.1 UNSUBACK has no reason codes
+    if ((type == BROKER_UNSUBACK) && !v5)
+    {
+        count = 0;
+    }
+    packet[length++] = (UCHAR)(type << 4);
+    length += broker_length_encode(packet + length, 2 + v5 + count);
+    packet[length++] = (UCHAR)(packet_id >> 8);
+    packet[length++] = (UCHAR)packet_id;
+    if (v5)
+    {
+        packet[length++] = 0;
+    }
+    memcpy(packet + length, codes, count);
+    broker_send(broker_ptr, packet, length + count);
+}
+
+// Log one packet from the client and answer it
+static VOID broker_process(BROKER *broker_ptr, const UCHAR *data, ULONG header_length, ULONG remaining_length)
+{
+    BROKER_PACKET *log_ptr;
+    const UCHAR *body = data + header_length;
+    ULONG offset = 0;
+    ULONG end = remaining_length;
+    UCHAR codes[16];
+    UINT count = 0;
+    UINT v5;
+
+    if ((broker_ptr->log_count == BROKER_LOG_SIZE) && broker_ptr->log_wrap)
+    {
+        broker_ptr->log_count = 0;
+    }
+    if (broker_ptr->log_count == BROKER_LOG_SIZE)
+    {
+        fprintf(stderr, "broker: log full\n");
+        abort();
+    }
+    log_ptr = &broker_ptr->log[broker_ptr->log_count++];
+    memset(log_ptr, 0, sizeof(BROKER_PACKET));
+    log_ptr->type = data[0] >> 4;
+    log_ptr->flags = data[0] & 0x0F;
+    log_ptr->length = header_length + remaining_length;
+
+    switch (log_ptr->type)
+    {
+    case BROKER_CONNECT:
+        // Protocol name, then the level
+        offset = 2 + broker_short(body);
+        broker_ptr->protocol_level = body[offset];
+        broker_ptr->connections++;
+        broker_ptr->connected = (broker_ptr->connack_return_code == 0);
+        broker_connack(broker_ptr);
+        return;
+
+    case BROKER_PUBLISH:
+        v5 = (broker_ptr->protocol_level == 5);
+        log_ptr->topic_length = broker_short(body);
+        memcpy(log_ptr->topic, body + 2, log_ptr->topic_length);
+        offset = 2 + log_ptr->topic_length;
+        if (log_ptr->flags & 0x06)
+        {
+            log_ptr->packet_id = broker_short(body + offset);
+            offset += 2;
+        }
+        if (v5)
+        {
+            offset = broker_properties_skip(body, offset);
+        }
+        log_ptr->payload_length = (UINT)(end - offset);
+        memcpy(log_ptr->payload, body + offset, log_ptr->payload_length);
+        if (broker_ptr->publish_notify)
+        {
+            broker_ptr->publish_notify(broker_ptr, log_ptr);
+        }
+        if (!broker_ptr->hold && (log_ptr->flags & 0x06))
+        {
+            broker_ack(broker_ptr, ((log_ptr->flags & 0x06) == 0x02) ? BROKER_PUBACK : BROKER_PUBREC, log_ptr->packet_id);
+        }
+        return;
+
+    case BROKER_PUBACK:
+    case BROKER_PUBREC:
+    case BROKER_PUBREL:
+    case BROKER_PUBCOMP:
+        log_ptr->packet_id = broker_short(body);
+        if (remaining_length > 2)
+        {
+            log_ptr->reason_code = body[2];
+        }
+        if (!broker_ptr->hold && (log_ptr->type == BROKER_PUBREC))
+        {
+            broker_ack(broker_ptr, BROKER_PUBREL, log_ptr->packet_id);
+        }
+        else if (!broker_ptr->hold && (log_ptr->type == BROKER_PUBREL))
+        {
+            broker_ack(broker_ptr, BROKER_PUBCOMP, log_ptr->packet_id);
+        }
+        return;
+
+    case BROKER_SUBSCRIBE:
+    case BROKER_UNSUBSCRIBE:
+        log_ptr->packet_id = broker_short(body);
+        offset = 2;
+        if (broker_ptr->protocol_level == 5)
+        {
+            offset = broker_properties_skip(body, offset);
+        }
+        while ((offset < end) && (count < sizeof(codes)))
+        {
+            // Log the first filter as the topic
+            if (count == 0)
+            {
+                log_ptr->topic_length = broker_short(body + offset);
+                memcpy(log_ptr->topic, body + offset + 2, log_ptr->topic_length);
+            }
+            offset += 2 + broker_short(body + offset);
+            if (log_ptr->type == BROKER_SUBSCRIBE)
+            {
+                codes[count] = body[offset++] & 0x03;
+            }
+            else
+            {
+                codes[count] = 0;
+            }
+            count++;
+        }
+        if (!broker_ptr->hold)
+        {
+            broker_sub_unsub_ack(broker_ptr, (log_ptr->type == BROKER_SUBSCRIBE) ? BROKER_SUBACK : BROKER_UNSUBACK,
+                                 log_ptr->packet_id, codes, count);
+        }
+        return;
+
+    case BROKER_PINGREQ:
+        if (!broker_ptr->hold)
+        {
+            codes[0] = BROKER_PINGRESP << 4;
+            codes[1] = 0;
+            broker_send(broker_ptr, codes, 2);
+        }
+        return;
+
+    case BROKER_DISCONNECT:
+        if (remaining_length)
+        {
+            log_ptr->reason_code = body[0];
+        }
+        return;
+
+    default:
+        return;
+    }
+}
+
+static UINT broker_connect(HOST_TCP_PEER *peer_ptr, NX_TCP_SOCKET *socket_ptr)
+{
+    BROKER *broker_ptr = (BROKER *)peer_ptr;
+
+    (void)socket_ptr;
+    if (broker_ptr->refuse_connection)
+    {
+        return NX_NOT_CONNECTED;
+    }
+    broker_ptr->stream_length = 0;
+    return NX_SUCCESS;
+}
+
+static VOID broker_receive(HOST_TCP_PEER *peer_ptr, NX_TCP_SOCKET *socket_ptr, const UCHAR *data, ULONG length)
+{
+    BROKER *broker_ptr = (BROKER *)peer_ptr;
+    ULONG header_length;
+    ULONG remaining_length;
+    ULONG packet_length;
+
+    (void)socket_ptr;
+    if (broker_ptr->stream_length + length > BROKER_STREAM_SIZE)
+    {
+        fprintf(stderr, "broker: stream buffer full\n");
+        abort();
+    }
+    memcpy(broker_ptr->stream + broker_ptr->stream_length, data, length);
+    broker_ptr->stream_length += length;
+
+    // Answers may make the client send again, so take each packet out of the stream first
+    for (;;)
+    {
+        UCHAR packet[BROKER_STREAM_SIZE];
+
+        header_length = broker_header_decode(broker_ptr->stream, broker_ptr->stream_length, &remaining_length);
+        packet_length = header_length + remaining_length;
+        if ((header_length == 0) || (packet_length > broker_ptr->stream_length))
+        {
+            return;
+        }
+        memcpy(packet, broker_ptr->stream, packet_length);
+        broker_ptr->stream_length -= packet_length;
+        memmove(broker_ptr->stream, broker_ptr->stream + packet_length, broker_ptr->stream_length);
+        broker_process(broker_ptr, packet, header_length, remaining_length);
+    }
+}
+
+static VOID broker_disconnect(HOST_TCP_PEER *peer_ptr, NX_TCP_SOCKET *socket_ptr)
+{
+    BROKER *broker_ptr = (BROKER *)peer_ptr;
+
+    (void)socket_ptr;
+    broker_ptr->connected = NX_FALSE;
+    broker_ptr->stream_length = 0;
+}
+
+VOID broker_attach(BROKER *broker_ptr, NX_TCP_SOCKET *socket_ptr)
+{
+    broker_ptr->peer.host_tcp_peer_connect = broker_connect;
+    broker_ptr->peer.host_tcp_peer_receive = broker_receive;
+    broker_ptr->peer.host_tcp_peer_disconnect = broker_disconnect;
+    broker_ptr->socket_ptr = socket_ptr;
+    socket_ptr->host_tcp_peer = &broker_ptr->peer;
+}
+
+VOID broker_close(BROKER *broker_ptr)
+{
+    broker_ptr->connected = NX_FALSE;
+    host_tcp_close(broker_ptr->socket_ptr);
+}
+
+UINT broker_count(BROKER *broker_ptr, UCHAR type)
+{
+    UINT count = 0;
+    UINT i;
+
+    for (i = 0; i < broker_ptr->log_count; i++)
+    {
+        if (broker_ptr->log[i].type == type)
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+BROKER_PACKET *broker_last(BROKER *broker_ptr, UCHAR type)
+{
+    UINT i;
+
+    for (i = broker_ptr->log_count; i > 0; i--)
+    {
+        if (broker_ptr->log[i - 1].type == type)
+        {
+            return &broker_ptr->log[i - 1];
+        }
+    }
+    return NX_NULL;
+}
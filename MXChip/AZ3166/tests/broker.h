@@ -0,0 +1,109 @@
+// A scripted MQTT broker stand-in for the host tests.
+//
+// It is the peer of the client's TCP socket: it parses each packet the client
+// sends into a log, and answers as a broker would unless the test holds the
+// answers back to send its own.
+
+#ifndef BROKER_H
+#define BROKER_H
+
+#include "nx_api.h"
+
+#define BROKER_LOG_SIZE        256
+#define BROKER_TOPIC_SIZE      128
+#define BROKER_PAYLOAD_SIZE    1024
+#define BROKER_STREAM_SIZE     8192
+
+// MQTT control packet types
+#define BROKER_CONNECT         1
+#define BROKER_CONNACK         2
+#define BROKER_PUBLISH         3
+#define BROKER_PUBACK          4
+#define BROKER_PUBREC          5
+#define BROKER_PUBREL          6
+#define BROKER_PUBCOMP         7
+#define BROKER_SUBSCRIBE       8
+#define BROKER_SUBACK          9
+#define BROKER_UNSUBSCRIBE     10
+#define BROKER_UNSUBACK        11
+#define BROKER_PINGREQ         12
+#define BROKER_PINGRESP        13
+#define BROKER_DISCONNECT      14
+
+// A packet received from the client
+typedef struct BROKER_PACKET_STRUCT
+{
+    UCHAR type;
+    UCHAR flags;
+    USHORT packet_id;
+    UCHAR reason_code;
+    UCHAR topic[BROKER_TOPIC_SIZE];
+    UINT topic_length;
+    UCHAR payload[BROKER_PAYLOAD_SIZE];
+    UINT payload_length;
+    ULONG length;
+} BROKER_PACKET;
+
+typedef struct BROKER_STRUCT
+{
+    HOST_TCP_PEER peer;
+    NX_TCP_SOCKET *socket_ptr;
+
+    // Answers: CONNACK to CONNECT, PUBACK or PUBREC to PUBLISH, PUBREL to PUBREC,
+    // PUBCOMP to PUBREL, SUBACK, UNSUBACK and PINGRESP. Only CONNACK is sent while held.
+    UINT hold;
+    UINT refuse_connection;
+    UCHAR connack_return_code;
+    UCHAR session_present;
+
+    // MQTT 5 property block of the CONNACK, its length first; empty for no properties
+    UCHAR connack_properties[64];
+    UINT connack_properties_length;
+
+    // Largest segment the broker sends, 0 for a whole write per segment
+    ULONG segment_size;
+
+    UCHAR protocol_level;
+    UINT connections;
+    UINT connected;
+
+    // Bytes of the client's stream not yet parsed
+    UCHAR stream[BROKER_STREAM_SIZE];
+    ULONG stream_length;
+
+    BROKER_PACKET log[BROKER_LOG_SIZE];
+    UINT log_count;
+
+    // For long runs: start the log over when it is full, and see each PUBLISH as it is logged
+    UINT log_wrap;
+    VOID (*publish_notify)(struct BROKER_STRUCT *broker_ptr, BROKER_PACKET *packet_ptr);
+} BROKER;
+
+// Attach the broker to the client socket, before connecting
+VOID broker_attach(BROKER *broker_ptr, NX_TCP_SOCKET *socket_ptr);
+
+// Send bytes to the client as they are
+VOID broker_send(BROKER *broker_ptr, const UCHAR *data, ULONG length);
+
+// Send a PUBLISH, with a packet ID for QoS 1 and 2
+VOID broker_publish(BROKER *broker_ptr, const CHAR *topic, const UCHAR *payload, UINT payload_length,
+                    UINT qos, USHORT packet_id, UINT dup);
+
+// Encode a PUBLISH into buffer, returning its length
+ULONG broker_publish_encode(BROKER *broker_ptr, UCHAR *buffer, const CHAR *topic, const UCHAR *payload,
+                            UINT payload_length, UINT qos, USHORT packet_id, UINT dup);
+
+// Send a PUBACK, PUBREC, PUBREL or PUBCOMP
+VOID broker_ack(BROKER *broker_ptr, UCHAR type, USHORT packet_id);
+
+// Close the connection from the broker side
+VOID broker_close(BROKER *broker_ptr);
+
+// Count the logged packets of a type, and find the last one
+UINT broker_count(BROKER *broker_ptr, UCHAR type);
+BROKER_PACKET *broker_last(BROKER *broker_ptr, UCHAR type);
+
+// Encode a variable byte integer, returning its length
+UINT broker_length_encode(UCHAR *buffer, ULONG value);
+
+#endif // BROKER_H
@@ -0,0 +1,14 @@
+// The MQTT client built as its own unit, with a way to run its thread. See client_thread.h.
+
+#include "nxd_mqtt_client.c"
+#include "client_thread.h"
+
+VOID client_thread_run(NXD_MQTT_CLIENT *client_ptr)
+{
+    ULONG events;
+
+    while (tx_event_flags_get(&client_ptr->nxd_mqtt_events, MQTT_ALL_EVENTS, TX_OR_CLEAR, &events, TX_NO_WAIT) == TX_SUCCESS)
+    {
+        _nxd_mqtt_client_event_process(client_ptr, NX_NULL, events);
+    }
+}
@@ -0,0 +1,16 @@
+// The MQTT thread of a client, for tests of application modules that use the
+// client through nxd_mqtt_client.h rather than including its source.
+//
+// client_thread.c is where the client is built for such a test. The thread is
+// not started: client_thread_run does its work, processing the events set so
+// far on the caller's thread, as test_client_run does for tests that include
+// nxd_mqtt_client.c.
+
+#ifndef CLIENT_THREAD_H
+#define CLIENT_THREAD_H
+
+#include "nxd_mqtt_client.h"
+
+VOID client_thread_run(NXD_MQTT_CLIENT *client_ptr);
+
+#endif // CLIENT_THREAD_H
@@ -0,0 +1,317 @@
+// A DHCP server stand-in for the host tests. See dhcp_server.h.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dhcp_server.h"
+#include "nxd_dhcp_client.h"
+
+// What a client message carries
+typedef struct DHCP_SERVER_MESSAGE_STRUCT
+{
+    UINT type;
+    ULONG xid;
+    const UCHAR *client_hw;
+    ULONG requested_ip;
+    ULONG server_id;
+    UINT rapid_commit;
+} DHCP_SERVER_MESSAGE;
+
+static ULONG dhcp_server_get_ulong(const UCHAR *data)
+{
+    return ((ULONG)data[0] << 24) | ((ULONG)data[1] << 16) | ((ULONG)data[2] << 8) | data[3];
+}
+
+static VOID dhcp_server_put_ulong(UCHAR *data, ULONG value)
+{
+    data[0] = (UCHAR)(value >> 24);
+    data[1] = (UCHAR)(value >> 16);
+    data[2] = (UCHAR)(value >> 8);
+    data[3] = (UCHAR)value;
+}
+
+static DHCP_SERVER_REPLY *dhcp_server_queue(DHCP_SERVER *server_ptr, UINT interface_index)
+{
+    DHCP_SERVER_REPLY *reply_ptr;
+
+    if (server_ptr->queue_count == DHCP_SERVER_QUEUE_SIZE)
+    {
+        fprintf(stderr, "dhcp server: answer queue full\n");
+        abort();
+    }
+    reply_ptr = &server_ptr->queue[server_ptr->queue_count++];
+    memset(reply_ptr, 0, sizeof(DHCP_SERVER_REPLY));
+    reply_ptr->due = tx_time_get() + server_ptr->round_trip_ticks;
+    reply_ptr->interface_index = interface_index;
+    return reply_ptr;
+}
+
+static UINT dhcp_server_parse(const UCHAR *data, ULONG length, DHCP_SERVER_MESSAGE *message_ptr)
+{
+    ULONG offset = NX_BOOTP_OFFSET_OPTIONS;
+    UINT option;
+    UINT option_length;
+
+    memset(message_ptr, 0, sizeof(DHCP_SERVER_MESSAGE));
+    if ((length < NX_BOOTP_OFFSET_OPTIONS) || (data[NX_BOOTP_OFFSET_OP] != NX_BOOTP_OP_REQUEST) ||
+        (dhcp_server_get_ulong(data + NX_BOOTP_OFFSET_VENDOR) != NX_BOOTP_MAGIC_COOKIE))
+    {
+        return NX_FALSE;
+    }
+    message_ptr->xid = dhcp_server_get_ulong(data + NX_BOOTP_OFFSET_XID);
+    message_ptr->client_hw = data + NX_BOOTP_OFFSET_CLIENT_HW;
+
+    while ((offset < length) && (data[offset] != NX_DHCP_OPTION_END))
+    {
+        option = data[offset++];
+        if (option == NX_DHCP_OPTION_PAD)
+        {
+            continue;
+        }
+        if ((offset >= length) || (offset + 1 + data[offset] > length))
+        {
+            return NX_FALSE;
+        }
+        option_length = data[offset++];
+        switch (option)
+        {
+        case NX_DHCP_OPTION_DHCP_TYPE:
+            message_ptr->type = (option_length == NX_DHCP_OPTION_DHCP_TYPE_SIZE) ? data[offset] : 0;
+            break;
+        case NX_DHCP_OPTION_DHCP_IP_REQ:
+            message_ptr->requested_ip = (option_length == 4) ? dhcp_server_get_ulong(data + offset) : 0;
+            break;
+        case NX_DHCP_OPTION_DHCP_SERVER:
+            message_ptr->server_id = (option_length == 4) ? dhcp_server_get_ulong(data + offset) : 0;
+            break;
+        case NX_DHCP_OPTION_RAPID_COMMIT:
+            message_ptr->rapid_commit = (option_length == NX_DHCP_OPTION_RAPID_COMMIT_SIZE);
+            break;
+        default:
+            break;
+        }
+        offset += option_length;
+    }
+    return message_ptr->type != 0;
+}
+
+// The first pool address not declined
+static ULONG dhcp_server_address(DHCP_SERVER *server_ptr)
+{
+    UINT i;
+
+    for (i = 0; i < server_ptr->address_count; i++)
+    {
+        if (!(server_ptr->declined & (1UL << i)))
+        {
+            return server_ptr->first_address + i;
+        }
+    }
+    return 0;
+}
+
+static UINT dhcp_server_option(UCHAR *data, UINT index, UINT option, UINT size, ULONG value)
+{
+    data[index++] = (UCHAR)option;
+    data[index++] = (UCHAR)size;
+    if (size == 1)
+    {
+        data[index] = (UCHAR)value;
+    }
+    else if (size == 4)
+    {
+        dhcp_server_put_ulong(data + index, value);
+    }
+    return index + size;
+}
+
+// Queue an Offer, Ack or Nak to the client, broadcast
+static VOID dhcp_server_reply(DHCP_SERVER *server_ptr, UINT interface_index, DHCP_SERVER_MESSAGE *message_ptr,
+                              UINT type, ULONG address, UINT rapid_commit)
+{
+    DHCP_SERVER_REPLY *reply_ptr = dhcp_server_queue(server_ptr, interface_index);
+    UCHAR *data = reply_ptr->data;
+    UINT index = NX_BOOTP_OFFSET_OPTIONS;
+
+    data[NX_BOOTP_OFFSET_OP] = NX_BOOTP_OP_REPLY;
+    data[NX_BOOTP_OFFSET_HTYPE] = NX_BOOTP_TYPE_ETHERNET;
+    data[NX_BOOTP_OFFSET_HLEN] = NX_BOOTP_HLEN_ETHERNET;
+    dhcp_server_put_ulong(data + NX_BOOTP_OFFSET_XID, message_ptr->xid);
+    data[NX_BOOTP_OFFSET_FLAGS] = NX_BOOTP_FLAGS_BROADCAST;
+    dhcp_server_put_ulong(data + NX_BOOTP_OFFSET_YOUR_IP, address);
+    memcpy(data + NX_BOOTP_OFFSET_CLIENT_HW, message_ptr->client_hw, NX_BOOTP_HLEN_ETHERNET);
+    dhcp_server_put_ulong(data + NX_BOOTP_OFFSET_VENDOR, NX_BOOTP_MAGIC_COOKIE);
+
+    index = dhcp_server_option(data, index, NX_DHCP_OPTION_DHCP_TYPE, NX_DHCP_OPTION_DHCP_TYPE_SIZE, type);
+    index = dhcp_server_option(data, index, NX_DHCP_OPTION_DHCP_SERVER, 4, server_ptr->server_ip);
+    if (type != NX_DHCP_TYPE_DHCPNACK)
+    {
+        index = dhcp_server_option(data, index, NX_DHCP_OPTION_DHCP_LEASE, 4, server_ptr->lease_seconds);
+        index = dhcp_server_option(data, index, NX_DHCP_OPTION_SUBNET_MASK, 4, server_ptr->network_mask);
+        index = dhcp_server_option(data, index, NX_DHCP_OPTION_GATEWAYS, 4, server_ptr->gateway);
+    }
+    if (rapid_commit)
+    {
+        index = dhcp_server_option(data, index, NX_DHCP_OPTION_RAPID_COMMIT, NX_DHCP_OPTION_RAPID_COMMIT_SIZE, 0);
+    }
+    data[index++] = NX_DHCP_OPTION_END;
+
+    // Padded to the size of a BOOTP message
+    reply_ptr->length = (index < NX_BOOTP_OFFSET_END) ? NX_BOOTP_OFFSET_END : index;
+}
+
+static VOID dhcp_server_discover(DHCP_SERVER *server_ptr, UINT interface_index, DHCP_SERVER_MESSAGE *message_ptr)
+{
+    ULONG address = dhcp_server_address(server_ptr);
+
+    server_ptr->discovers++;
+    if (address == 0)
+    {
+        return;
+    }
+    server_ptr->offered = address;
+    if (server_ptr->rapid_commit && message_ptr->rapid_commit)
+    {
+        server_ptr->rapid_acks++;
+        dhcp_server_reply(server_ptr, interface_index, message_ptr, NX_DHCP_TYPE_DHCPACK, address, NX_TRUE);
+    }
+    else
+    {
+        server_ptr->offers++;
+        dhcp_server_reply(server_ptr, interface_index, message_ptr, NX_DHCP_TYPE_DHCPOFFER, address, NX_FALSE);
+    }
+}
+
+static VOID dhcp_server_request(DHCP_SERVER *server_ptr, UINT interface_index, DHCP_SERVER_MESSAGE *message_ptr)
+{
+    server_ptr->requests++;
+
+    // A Request selecting another server is not for this one
+    if (message_ptr->server_id && (message_ptr->server_id != server_ptr->server_ip))
+    {
+        return;
+    }
+    if (server_ptr->offered && (message_ptr->requested_ip == server_ptr->offered))
+    {
+        server_ptr->acks++;
+        dhcp_server_reply(server_ptr, interface_index, message_ptr, NX_DHCP_TYPE_DHCPACK, server_ptr->offered, NX_FALSE);
+    }
+    else
+    {
+        server_ptr->naks++;
+        dhcp_server_reply(server_ptr, interface_index, message_ptr, NX_DHCP_TYPE_DHCPNACK, 0, NX_FALSE);
+    }
+}
+
+static VOID dhcp_server_decline(DHCP_SERVER *server_ptr, DHCP_SERVER_MESSAGE *message_ptr)
+{
+    server_ptr->declines++;
+    if ((message_ptr->requested_ip >= server_ptr->first_address) &&
+        (message_ptr->requested_ip < server_ptr->first_address + server_ptr->address_count))
+    {
+        server_ptr->declined |= 1UL << (message_ptr->requested_ip - server_ptr->first_address);
+    }
+    if (message_ptr->requested_ip == server_ptr->offered)
+    {
+        server_ptr->offered = 0;
+    }
+}
+
+static VOID dhcp_server_udp(HOST_NETWORK_PEER *peer_ptr, NX_IP *ip_ptr, UINT interface_index, ULONG source_ip,
+                            UINT source_port, ULONG destination_ip, UINT destination_port, const UCHAR *data,
+                            ULONG length)
+{
+    DHCP_SERVER *server_ptr = (DHCP_SERVER *)peer_ptr;
+    DHCP_SERVER_MESSAGE message;
+
+    (void)ip_ptr;
+    (void)source_ip;
+    (void)destination_ip;
+
+    if ((source_port != NX_DHCP_CLIENT_UDP_PORT) || (destination_port != NX_DHCP_SERVER_UDP_PORT) ||
+        !dhcp_server_parse(data, length, &message))
+    {
+        fprintf(stderr, "dhcp server: malformed message from the client\n");
+        abort();
+    }
+
+    switch (message.type)
+    {
+    case NX_DHCP_TYPE_DHCPDISCOVER:
+        dhcp_server_discover(server_ptr, interface_index, &message);
+        break;
+    case NX_DHCP_TYPE_DHCPREQUEST:
+        dhcp_server_request(server_ptr, interface_index, &message);
+        break;
+    case NX_DHCP_TYPE_DHCPDECLINE:
+        dhcp_server_decline(server_ptr, &message);
+        break;
+    default:
+        break;
+    }
+}
+
+static VOID dhcp_server_arp_probe(HOST_NETWORK_PEER *peer_ptr, NX_IP *ip_ptr, UINT interface_index,
+                                  ULONG ip_address)
+{
+    DHCP_SERVER *server_ptr = (DHCP_SERVER *)peer_ptr;
+    DHCP_SERVER_REPLY *reply_ptr;
+
+    (void)ip_ptr;
+
+    server_ptr->probes++;
+    if (server_ptr->conflict_address && (ip_address == server_ptr->conflict_address))
+    {
+        server_ptr->conflicts++;
+        reply_ptr = dhcp_server_queue(server_ptr, interface_index);
+        reply_ptr->arp = NX_TRUE;
+        reply_ptr->address = ip_address;
+    }
+}
+
+VOID dhcp_server_attach(DHCP_SERVER *server_ptr, NX_IP *ip_ptr, NX_UDP_SOCKET *client_socket_ptr,
+                        ULONG round_trip_ticks)
+{
+    memset(server_ptr, 0, sizeof(DHCP_SERVER));
+    server_ptr->peer.host_network_peer_udp = dhcp_server_udp;
+    server_ptr->peer.host_network_peer_arp_probe = dhcp_server_arp_probe;
+    server_ptr->ip_ptr = ip_ptr;
+    server_ptr->client_socket_ptr = client_socket_ptr;
+    server_ptr->server_ip = IP_ADDRESS(192, 168, 0, 1);
+    server_ptr->network_mask = IP_ADDRESS(255, 255, 255, 0);
+    server_ptr->gateway = IP_ADDRESS(192, 168, 0, 1);
+    server_ptr->first_address = IP_ADDRESS(192, 168, 0, 100);
+    server_ptr->address_count = 10;
+    server_ptr->lease_seconds = 86400;
+    server_ptr->rapid_commit = NX_TRUE;
+    server_ptr->round_trip_ticks = round_trip_ticks;
+    ip_ptr->host_network_peer = &server_ptr->peer;
+}
+
+UINT dhcp_server_poll(DHCP_SERVER *server_ptr)
+{
+    DHCP_SERVER_REPLY reply;
+    UINT delivered = 0;
+
+    while (server_ptr->queue_count && (tx_time_get() >= server_ptr->queue[0].due))
+    {
+        // Taken off the queue first, as the client may send again while handling it
+        reply = server_ptr->queue[0];
+        server_ptr->queue_count--;
+        memmove(&server_ptr->queue[0], &server_ptr->queue[1], server_ptr->queue_count * sizeof(DHCP_SERVER_REPLY));
+
+        if (reply.arp)
+        {
+            host_arp_conflict(server_ptr->ip_ptr, reply.interface_index, reply.address,
+                              DHCP_SERVER_CONFLICT_MSW, DHCP_SERVER_CONFLICT_LSW);
+        }
+        else
+        {
+            host_udp_deliver(server_ptr->client_socket_ptr, reply.interface_index, server_ptr->server_ip,
+                             NX_DHCP_SERVER_UDP_PORT, NX_BOOTP_BC_ADDRESS, reply.data, reply.length);
+        }
+        delivered++;
+    }
+    return delivered;
+}
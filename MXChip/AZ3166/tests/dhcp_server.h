@@ -0,0 +1,78 @@
+// A DHCP server stand-in for the host tests, on the network of an IP instance.
+//
+// It is the network peer of the IP instance: it answers the client's Discover
+// with an Offer, or with an Ack when it honours Rapid Commit (RFC 4039) and
+// the client asked for it, and the client's Request with an Ack or a Nak. It
+// leases the addresses of its pool in order, skipping those declined. Another
+// host on the network may already use conflict_address, and answers the ARP
+// probes for it. The network is modelled in ticks of the simulated clock:
+// each answer arrives round_trip_ticks after the message it answers, when
+// dhcp_server_poll is called at or past that tick.
+
+#ifndef DHCP_SERVER_H
+#define DHCP_SERVER_H
+
+#include "nx_api.h"
+
+#define DHCP_SERVER_QUEUE_SIZE     8
+#define DHCP_SERVER_MESSAGE_SIZE   548
+
+// The hardware address of the host using conflict_address
+#define DHCP_SERVER_CONFLICT_MSW   0x0002
+#define DHCP_SERVER_CONFLICT_LSW   0xC0FFEE01
+
+// An answer on its way to the client
+typedef struct DHCP_SERVER_REPLY_STRUCT
+{
+    ULONG due;
+    UINT arp;
+    UINT interface_index;
+    ULONG address;
+    UCHAR data[DHCP_SERVER_MESSAGE_SIZE];
+    ULONG length;
+} DHCP_SERVER_REPLY;
+
+typedef struct DHCP_SERVER_STRUCT
+{
+    HOST_NETWORK_PEER peer;
+    NX_IP *ip_ptr;
+    NX_UDP_SOCKET *client_socket_ptr;
+
+    // The network, the pool leased from, and whether to answer a Discover with an Ack
+    ULONG server_ip;
+    ULONG network_mask;
+    ULONG gateway;
+    ULONG first_address;
+    UINT address_count;
+    ULONG lease_seconds;
+    UINT rapid_commit;
+    ULONG round_trip_ticks;
+    ULONG conflict_address;
+
+    // Pool addresses declined, the address last offered, and answers not yet delivered
+    ULONG declined;
+    ULONG offered;
+    DHCP_SERVER_REPLY queue[DHCP_SERVER_QUEUE_SIZE];
+    UINT queue_count;
+
+    // Messages received, answers sent, and probes answered with a conflict
+    UINT discovers;
+    UINT requests;
+    UINT declines;
+    UINT offers;
+    UINT acks;
+    UINT rapid_acks;
+    UINT naks;
+    UINT probes;
+    UINT conflicts;
+} DHCP_SERVER;
+
+// Put the server on the network of the IP instance, serving 192.168.0.100 to 192.168.0.109
+// from 192.168.0.1 to the client bound to client_socket_ptr; Rapid Commit is honoured
+VOID dhcp_server_attach(DHCP_SERVER *server_ptr, NX_IP *ip_ptr, NX_UDP_SOCKET *client_socket_ptr,
+                        ULONG round_trip_ticks);
+
+// Deliver the answers due by now, in the order they were sent; returns how many
+UINT dhcp_server_poll(DHCP_SERVER *server_ptr);
+
+#endif // DHCP_SERVER_H
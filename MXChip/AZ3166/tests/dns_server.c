@@ -0,0 +1,148 @@
+// A DNS server stand-in for the host tests. See dns_server.h.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dns_server.h"
+
+#define DNS_SERVER_HEADER_SIZE     12
+#define DNS_SERVER_FLAGS_ANSWER    0x8180
+#define DNS_SERVER_FLAGS_NXDOMAIN  0x8183
+#define DNS_SERVER_TYPE_A          1
+#define DNS_SERVER_CLASS_IN        1
+
+static VOID dns_server_put_ushort(UCHAR *data, UINT value)
+{
+    data[0] = (UCHAR)(value >> 8);
+    data[1] = (UCHAR)value;
+}
+
+static VOID dns_server_put_ulong(UCHAR *data, ULONG value)
+{
+    data[0] = (UCHAR)(value >> 24);
+    data[1] = (UCHAR)(value >> 16);
+    data[2] = (UCHAR)(value >> 8);
+    data[3] = (UCHAR)value;
+}
+
+// The dotted name of the question, and its length in the message; 0 for a malformed one
+static ULONG dns_server_name_get(const UCHAR *data, ULONG length, CHAR *name)
+{
+    ULONG offset = DNS_SERVER_HEADER_SIZE;
+    UINT name_length = 0;
+    UINT label;
+
+    while ((offset < length) && data[offset])
+    {
+        label = data[offset++];
+        if ((label & 0xC0) || (offset + label > length) || (name_length + label + 1 >= DNS_SERVER_NAME_SIZE))
+        {
+            return 0;
+        }
+        if (name_length)
+        {
+            name[name_length++] = '.';
+        }
+        memcpy(name + name_length, data + offset, label);
+        name_length += label;
+        offset += label;
+    }
+    name[name_length] = '\0';
+    if (offset + 5 > length)
+    {
+        return 0;
+    }
+    return offset + 1 - DNS_SERVER_HEADER_SIZE;
+}
+
+static VOID dns_server_udp(HOST_NETWORK_PEER *peer_ptr, NX_IP *ip_ptr, UINT interface_index, ULONG source_ip,
+                           UINT source_port, ULONG destination_ip, UINT destination_port, const UCHAR *data,
+                           ULONG length)
+{
+    DNS_SERVER *server_ptr = (DNS_SERVER *)peer_ptr;
+    CHAR name[DNS_SERVER_NAME_SIZE];
+    UCHAR reply[DNS_SERVER_MESSAGE_SIZE];
+    ULONG question_length;
+    ULONG reply_length;
+    UINT type;
+    UINT i;
+
+    (void)ip_ptr;
+    if ((destination_port != 53) || (length < DNS_SERVER_HEADER_SIZE) ||
+        (source_port != server_ptr->client_socket_ptr->nx_udp_socket_port))
+    {
+        return;
+    }
+    server_ptr->queries++;
+    if (server_ptr->down)
+    {
+        return;
+    }
+    question_length = dns_server_name_get(data, length, name);
+    if ((question_length == 0) || (DNS_SERVER_HEADER_SIZE + question_length + 4 + 16 > sizeof(reply)))
+    {
+        fprintf(stderr, "dns server: malformed query\n");
+        abort();
+    }
+    type = ((UINT)data[DNS_SERVER_HEADER_SIZE + question_length] << 8) | data[DNS_SERVER_HEADER_SIZE + question_length + 1];
+
+    // The header and the question, as asked
+    memset(reply, 0, DNS_SERVER_HEADER_SIZE);
+    memcpy(reply, data, 2);
+    dns_server_put_ushort(reply + 4, 1);
+    memcpy(reply + DNS_SERVER_HEADER_SIZE, data + DNS_SERVER_HEADER_SIZE, question_length + 4);
+    reply_length = DNS_SERVER_HEADER_SIZE + question_length + 4;
+
+    for (i = 0; i < server_ptr->name_count; i++)
+    {
+        if ((type == DNS_SERVER_TYPE_A) && (strcmp(server_ptr->names[i].name, name) == 0))
+        {
+            break;
+        }
+    }
+    if (i == server_ptr->name_count)
+    {
+        dns_server_put_ushort(reply + 2, DNS_SERVER_FLAGS_NXDOMAIN);
+        server_ptr->name_errors++;
+    }
+    else
+    {
+        // One answer, its name pointing at the question's
+        dns_server_put_ushort(reply + 2, DNS_SERVER_FLAGS_ANSWER);
+        dns_server_put_ushort(reply + 6, 1);
+        dns_server_put_ushort(reply + reply_length, 0xC000 | DNS_SERVER_HEADER_SIZE);
+        dns_server_put_ushort(reply + reply_length + 2, DNS_SERVER_TYPE_A);
+        dns_server_put_ushort(reply + reply_length + 4, DNS_SERVER_CLASS_IN);
+        dns_server_put_ulong(reply + reply_length + 6, server_ptr->names[i].ttl);
+        dns_server_put_ushort(reply + reply_length + 10, 4);
+        dns_server_put_ulong(reply + reply_length + 12, server_ptr->names[i].address);
+        reply_length += 16;
+        server_ptr->answers++;
+    }
+    host_udp_deliver(server_ptr->client_socket_ptr, interface_index, destination_ip, destination_port, source_ip,
+                     reply, reply_length);
+}
+
+VOID dns_server_attach(DNS_SERVER *server_ptr, NX_IP *ip_ptr, NX_UDP_SOCKET *client_socket_ptr)
+{
+    memset(server_ptr, 0, sizeof(DNS_SERVER));
+    server_ptr->peer.host_network_peer_udp = dns_server_udp;
+    server_ptr->client_socket_ptr = client_socket_ptr;
+    ip_ptr->host_network_peer = &server_ptr->peer;
+}
+
+VOID dns_server_name_add(DNS_SERVER *server_ptr, const CHAR *name, ULONG address, ULONG ttl)
+{
+    DNS_SERVER_NAME *entry_ptr;
+
+    if ((server_ptr->name_count == DNS_SERVER_NAMES) || (strlen(name) >= DNS_SERVER_NAME_SIZE))
+    {
+        fprintf(stderr, "dns server: too many names\n");
+        abort();
+    }
+    entry_ptr = &server_ptr->names[server_ptr->name_count++];
+    strcpy(entry_ptr->name, name);
+    entry_ptr->address = address;
+    entry_ptr->ttl = ttl;
+}
@@ -0,0 +1,47 @@
+// A DNS server stand-in for the host tests, on the network of an IP instance.
+//
+// It is the network peer of the IP instance: it answers an A query for one of
+// its names with the name's address and TTL, and any other query with
+// NXDOMAIN. While down, it answers nothing, and the client's receive waits
+// out its timeout on the simulated clock. Answers are delivered while the
+// query is sent, so the lookup finds them on its first receive.
+
+#ifndef DNS_SERVER_H
+#define DNS_SERVER_H
+
+#include "nx_api.h"
+
+#define DNS_SERVER_NAMES           4
+#define DNS_SERVER_NAME_SIZE       64
+#define DNS_SERVER_MESSAGE_SIZE    512
+
+typedef struct DNS_SERVER_NAME_STRUCT
+{
+    CHAR name[DNS_SERVER_NAME_SIZE];
+    ULONG address;
+    ULONG ttl;
+} DNS_SERVER_NAME;
+
+typedef struct DNS_SERVER_STRUCT
+{
+    HOST_NETWORK_PEER peer;
+    NX_UDP_SOCKET *client_socket_ptr;
+
+    // The names answered, and whether the server is unreachable
+    DNS_SERVER_NAME names[DNS_SERVER_NAMES];
+    UINT name_count;
+    UINT down;
+
+    // Queries received, and those answered with an address or with NXDOMAIN
+    UINT queries;
+    UINT answers;
+    UINT name_errors;
+} DNS_SERVER;
+
+// Put the server on the network of the IP instance, answering the client bound to client_socket_ptr
+VOID dns_server_attach(DNS_SERVER *server_ptr, NX_IP *ip_ptr, NX_UDP_SOCKET *client_socket_ptr);
+
+// Answer A queries for the name with the address, for ttl seconds
+VOID dns_server_name_add(DNS_SERVER *server_ptr, const CHAR *name, ULONG address, ULONG ttl);
+
+#endif // DNS_SERVER_H
@@ -0,0 +1,71 @@
+// Host port of the STM32F4 HAL flash services. See stm32f4xx_hal.h.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stm32f4xx_hal.h"
+
+uint32_t host_flash_sector[HOST_FLASH_SECTOR_SIZE / sizeof(uint32_t)];
+UINT host_flash_programs;
+UINT host_flash_erases;
+static UINT host_flash_unlocked;
+
+VOID host_flash_reset(VOID)
+{
+    memset(host_flash_sector, 0xFF, sizeof(host_flash_sector));
+    host_flash_programs = 0;
+    host_flash_erases = 0;
+    host_flash_unlocked = 0;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void)
+{
+    host_flash_unlocked = 1;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Lock(void)
+{
+    host_flash_unlocked = 0;
+    return HAL_OK;
+}
+
+// Only words of the sector can be programmed; anywhere else is a bug in the caller
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data)
+{
+    uintptr_t offset = (uintptr_t)Address - (uintptr_t)host_flash_sector;
+
+    if ((TypeProgram != FLASH_TYPEPROGRAM_WORD) || (offset % sizeof(uint32_t)) ||
+        (offset >= sizeof(host_flash_sector)))
+    {
+        fprintf(stderr, "host flash: program outside the sector at 0x%08x\n", (unsigned)Address);
+        abort();
+    }
+    if (!host_flash_unlocked)
+    {
+        return HAL_ERROR;
+    }
+    host_flash_sector[offset / sizeof(uint32_t)] &= (uint32_t)Data;
+    host_flash_programs++;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *SectorError)
+{
+    if ((pEraseInit->TypeErase != FLASH_TYPEERASE_SECTORS) || (pEraseInit->Sector != FLASH_SECTOR_11) ||
+        (pEraseInit->NbSectors != 1))
+    {
+        fprintf(stderr, "host flash: erase of another sector\n");
+        abort();
+    }
+    if (!host_flash_unlocked)
+    {
+        *SectorError = pEraseInit->Sector;
+        return HAL_ERROR;
+    }
+    memset(host_flash_sector, 0xFF, sizeof(host_flash_sector));
+    host_flash_erases++;
+    *SectorError = 0xFFFFFFFFU;
+    return HAL_OK;
+}
@@ -0,0 +1,1755 @@
+// Host port of the ThreadX and NetX Duo services used by the application.
+// See tx_api.h and nx_api.h for what is modelled.
+
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tx_api.h"
+#include "nx_api.h"
+#include "nx_arp.h"
+#include "nx_ip.h"
+
+#define HOST_TIMER_ID  0x4154494D
+#define HOST_POOL_ID   0x5041434B
+#define HOST_TCP_ID    0x54435020
+#define HOST_UDP_ID    0x55445020
+
+UINT host_thread_start_enable;
+VOID (*host_idle_hook)(VOID);
+NX_PACKET_POOL host_network_pool;
+
+// One lock guards every object, and waiters share one condition
+static pthread_mutex_t host_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t host_cond = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t host_send_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t host_interrupt_lock;
+static pthread_once_t host_interrupt_once = PTHREAD_ONCE_INIT;
+
+static ULONG host_time;
+static TX_TIMER *host_timer_list;
+static TX_THREAD host_main_thread = { .tx_thread_name = "main" };
+static __thread TX_THREAD *host_current_thread;
+
+static VOID host_interrupt_init(VOID)
+{
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&host_interrupt_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+VOID host_interrupt_disable(VOID)
+{
+    pthread_once(&host_interrupt_once, host_interrupt_init);
+    pthread_mutex_lock(&host_interrupt_lock);
+}
+
+VOID host_interrupt_restore(VOID)
+{
+    pthread_mutex_unlock(&host_interrupt_lock);
+}
+
+ULONG64 host_clock_ns(VOID)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (ULONG64)now.tv_sec * 1000000000ULL + (ULONG64)now.tv_nsec;
+}
+
+// Wait on the shared condition, with host_lock held, counted as suspended on
+// the object. Returns non-zero once the wait option is spent. Without started
+// threads no one else can make progress, so a wait gives up at once.
+static UINT host_wait(UINT *suspended_ptr, ULONG wait_option, const struct timespec *deadline)
+{
+    int status;
+
+    if ((wait_option == TX_NO_WAIT) || !host_thread_start_enable)
+    {
+        return 1;
+    }
+
+    (*suspended_ptr)++;
+    if (wait_option == TX_WAIT_FOREVER)
+    {
+        status = pthread_cond_wait(&host_cond, &host_lock);
+    }
+    else
+    {
+        status = pthread_cond_timedwait(&host_cond, &host_lock, deadline);
+    }
+    (*suspended_ptr)--;
+    return status == ETIMEDOUT;
+}
+
+// As ThreadX resumes only the threads suspended on an object, the shared
+// condition is only signalled when some thread waits on the object changed.
+static VOID host_wake(UINT suspended)
+{
+    if (suspended)
+    {
+        pthread_cond_broadcast(&host_cond);
+    }
+}
+
+// A tick of a waiting thread lasts a millisecond of real time
+static VOID host_deadline(ULONG wait_option, struct timespec *deadline)
+{
+    ULONG64 ns;
+
+    clock_gettime(CLOCK_REALTIME, deadline);
+    if ((wait_option == TX_NO_WAIT) || (wait_option == TX_WAIT_FOREVER))
+    {
+        return;
+    }
+    ns = (ULONG64)deadline->tv_nsec + (ULONG64)wait_option * 1000000ULL;
+    deadline->tv_sec += (time_t)(ns / 1000000000ULL);
+    deadline->tv_nsec = (long)(ns % 1000000000ULL);
+}
+
+// Threads
+
+static VOID *host_thread_trampoline(VOID *arg)
+{
+    TX_THREAD *thread_ptr = arg;
+
+    host_current_thread = thread_ptr;
+    thread_ptr->tx_thread_entry(thread_ptr->tx_thread_entry_parameter);
+    return NULL;
+}
+
+static UINT host_thread_start(TX_THREAD *thread_ptr)
+{
+    if (thread_ptr->tx_thread_started || !host_thread_start_enable)
+    {
+        return TX_SUCCESS;
+    }
+    if (pthread_create(&thread_ptr->tx_thread_host, NULL, host_thread_trampoline, thread_ptr))
+    {
+        return TX_THREAD_ERROR;
+    }
+    thread_ptr->tx_thread_started = TX_TRUE;
+    return TX_SUCCESS;
+}
+
+UINT tx_thread_create(TX_THREAD *thread_ptr, CHAR *name_ptr, VOID (*entry_function)(ULONG), ULONG entry_input,
+                      VOID *stack_start, ULONG stack_size, UINT priority, UINT preempt_threshold,
+                      ULONG time_slice, UINT auto_start)
+{
+    (void)stack_start;
+    (void)stack_size;
+    (void)preempt_threshold;
+    (void)time_slice;
+
+    memset(thread_ptr, 0, sizeof(TX_THREAD));
+    thread_ptr->tx_thread_name = name_ptr;
+    thread_ptr->tx_thread_entry = entry_function;
+    thread_ptr->tx_thread_entry_parameter = entry_input;
+    thread_ptr->tx_thread_priority = priority;
+
+    return auto_start ? host_thread_start(thread_ptr) : TX_SUCCESS;
+}
+
+UINT tx_thread_delete(TX_THREAD *thread_ptr)
+{
+    if (thread_ptr->tx_thread_started)
+    {
+        pthread_detach(thread_ptr->tx_thread_host);
+    }
+    thread_ptr->tx_thread_started = TX_FALSE;
+    return TX_SUCCESS;
+}
+
+UINT tx_thread_resume(TX_THREAD *thread_ptr)
+{
+    return host_thread_start(thread_ptr);
+}
+
+UINT tx_thread_suspend(TX_THREAD *thread_ptr)
+{
+    (void)thread_ptr;
+    return TX_SUCCESS;
+}
+
+UINT tx_thread_terminate(TX_THREAD *thread_ptr)
+{
+    (void)thread_ptr;
+    return TX_SUCCESS;
+}
+
+// A sleep of no ticks returns at once on ThreadX. Here it yields instead, so a
+// thread polling with it lets the others run, without the timer slack of usleep.
+UINT tx_thread_sleep(ULONG timer_ticks)
+{
+    if (host_thread_start_enable && (timer_ticks == 0))
+    {
+        sched_yield();
+    }
+    else if (host_thread_start_enable)
+    {
+        usleep((useconds_t)(timer_ticks * 1000));
+    }
+    else
+    {
+        if (host_idle_hook)
+        {
+            host_idle_hook();
+        }
+        host_time_advance(timer_ticks);
+    }
+    return TX_SUCCESS;
+}
+
+VOID tx_thread_relinquish(VOID)
+{
+    if (host_thread_start_enable)
+    {
+        sched_yield();
+    }
+}
+
+TX_THREAD *tx_thread_identify(VOID)
+{
+    return host_current_thread ? host_current_thread : &host_main_thread;
+}
+
+UINT tx_thread_priority_change(TX_THREAD *thread_ptr, UINT new_priority, UINT *old_priority)
+{
+    *old_priority = thread_ptr->tx_thread_priority;
+    thread_ptr->tx_thread_priority = new_priority;
+    return TX_SUCCESS;
+}
+
+UINT tx_thread_info_get(TX_THREAD *thread_ptr, CHAR **name, UINT *state, ULONG *run_count,
+                        UINT *priority, UINT *preemption_threshold, ULONG *time_slice,
+                        TX_THREAD **next_thread, TX_THREAD **next_suspended_thread)
+{
+    (void)state;
+    (void)run_count;
+    (void)preemption_threshold;
+    (void)time_slice;
+    (void)next_thread;
+    (void)next_suspended_thread;
+
+    if (name)
+    {
+        *name = thread_ptr->tx_thread_name;
+    }
+    if (priority)
+    {
+        *priority = thread_ptr->tx_thread_priority;
+    }
+    return TX_SUCCESS;
+}
+
+// Mutexes, which like ThreadX's may be taken again by their owner
+
+UINT tx_mutex_create(TX_MUTEX *mutex_ptr, CHAR *name_ptr, UINT inherit)
+{
+    pthread_mutexattr_t attr;
+
+    (void)inherit;
+    mutex_ptr->tx_mutex_name = name_ptr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&mutex_ptr->tx_mutex_host, &attr);
+    pthread_mutexattr_destroy(&attr);
+    return TX_SUCCESS;
+}
+
+UINT tx_mutex_delete(TX_MUTEX *mutex_ptr)
+{
+    pthread_mutex_destroy(&mutex_ptr->tx_mutex_host);
+    return TX_SUCCESS;
+}
+
+UINT tx_mutex_get(TX_MUTEX *mutex_ptr, ULONG wait_option)
+{
+    struct timespec deadline;
+
+    if (wait_option == TX_WAIT_FOREVER)
+    {
+        pthread_mutex_lock(&mutex_ptr->tx_mutex_host);
+        return TX_SUCCESS;
+    }
+    if (pthread_mutex_trylock(&mutex_ptr->tx_mutex_host) == 0)
+    {
+        return TX_SUCCESS;
+    }
+    if ((wait_option == TX_NO_WAIT) || !host_thread_start_enable)
+    {
+        return TX_NOT_AVAILABLE;
+    }
+    host_deadline(wait_option, &deadline);
+    return pthread_mutex_timedlock(&mutex_ptr->tx_mutex_host, &deadline) ? TX_NOT_AVAILABLE : TX_SUCCESS;
+}
+
+UINT tx_mutex_put(TX_MUTEX *mutex_ptr)
+{
+    return pthread_mutex_unlock(&mutex_ptr->tx_mutex_host) ? TX_NOT_OWNED : TX_SUCCESS;
+}
+
+// Semaphores
+
+UINT tx_semaphore_create(TX_SEMAPHORE *semaphore_ptr, CHAR *name_ptr, ULONG initial_count)
+{
+    semaphore_ptr->tx_semaphore_name = name_ptr;
+    semaphore_ptr->tx_semaphore_count = initial_count;
+    return TX_SUCCESS;
+}
+
+UINT tx_semaphore_delete(TX_SEMAPHORE *semaphore_ptr)
+{
+    (void)semaphore_ptr;
+    return TX_SUCCESS;
+}
+
+UINT tx_semaphore_get(TX_SEMAPHORE *semaphore_ptr, ULONG wait_option)
+{
+    struct timespec deadline;
+    UINT status = TX_SUCCESS;
+
+    host_deadline(wait_option, &deadline);
+    pthread_mutex_lock(&host_lock);
+    while (semaphore_ptr->tx_semaphore_count == 0)
+    {
+        if (host_wait(&semaphore_ptr->tx_semaphore_suspended_count, wait_option, &deadline))
+        {
+            status = TX_NO_INSTANCE;
+            break;
+        }
+    }
+    if (status == TX_SUCCESS)
+    {
+        semaphore_ptr->tx_semaphore_count--;
+    }
+    pthread_mutex_unlock(&host_lock);
+    return status;
+}
+
+UINT tx_semaphore_put(TX_SEMAPHORE *semaphore_ptr)
+{
+    pthread_mutex_lock(&host_lock);
+    semaphore_ptr->tx_semaphore_count++;
+    host_wake(semaphore_ptr->tx_semaphore_suspended_count);
+    pthread_mutex_unlock(&host_lock);
+    return TX_SUCCESS;
+}
+
+UINT tx_semaphore_ceiling_put(TX_SEMAPHORE *semaphore_ptr, ULONG ceiling)
+{
+    UINT status = TX_SUCCESS;
+
+    pthread_mutex_lock(&host_lock);
+    if (semaphore_ptr->tx_semaphore_count >= ceiling)
+    {
+        status = TX_CEILING_EXCEEDED;
+    }
+    else
+    {
+        semaphore_ptr->tx_semaphore_count++;
+        host_wake(semaphore_ptr->tx_semaphore_suspended_count);
+    }
+    pthread_mutex_unlock(&host_lock);
+    return status;
+}
+
+// Event flags
+
+UINT tx_event_flags_create(TX_EVENT_FLAGS_GROUP *group_ptr, CHAR *name_ptr)
+{
+    group_ptr->tx_event_flags_group_id = 0x4456444E;
+    group_ptr->tx_event_flags_group_name = name_ptr;
+    group_ptr->tx_event_flags_group_current = 0;
+    return TX_SUCCESS;
+}
+
+UINT tx_event_flags_delete(TX_EVENT_FLAGS_GROUP *group_ptr)
+{
+    group_ptr->tx_event_flags_group_id = 0;
+    return TX_SUCCESS;
+}
+
+UINT tx_event_flags_get(TX_EVENT_FLAGS_GROUP *group_ptr, ULONG requested_flags, UINT get_option,
+                        ULONG *actual_flags_ptr, ULONG wait_option)
+{
+    struct timespec deadline;
+    ULONG current;
+    UINT idled = NX_FALSE;
+    UINT status = TX_SUCCESS;
+
+    host_deadline(wait_option, &deadline);
+    pthread_mutex_lock(&host_lock);
+    for (;;)
+    {
+        current = group_ptr->tx_event_flags_group_current;
+        if ((get_option & TX_AND) ? ((current & requested_flags) == requested_flags) : (current & requested_flags))
+        {
+            break;
+        }
+
+        // Without threads, the work that would set the flags is done once before giving up
+        if (!host_thread_start_enable && host_idle_hook && (wait_option != TX_NO_WAIT) && !idled)
+        {
+            idled = NX_TRUE;
+            pthread_mutex_unlock(&host_lock);
+            host_idle_hook();
+            pthread_mutex_lock(&host_lock);
+            continue;
+        }
+        if (host_wait(&group_ptr->tx_event_flags_group_suspended_count, wait_option, &deadline))
+        {
+            status = TX_NO_EVENTS;
+            break;
+        }
+    }
+    *actual_flags_ptr = current;
+    if ((status == TX_SUCCESS) && (get_option & TX_OR_CLEAR))
+    {
+        group_ptr->tx_event_flags_group_current = current & ~requested_flags;
+    }
+    pthread_mutex_unlock(&host_lock);
+    return status;
+}
+
+UINT tx_event_flags_set(TX_EVENT_FLAGS_GROUP *group_ptr, ULONG flags_to_set, UINT set_option)
+{
+    pthread_mutex_lock(&host_lock);
+    if (set_option == TX_AND)
+    {
+        group_ptr->tx_event_flags_group_current &= flags_to_set;
+    }
+    else
+    {
+        group_ptr->tx_event_flags_group_current |= flags_to_set;
+    }
+    host_wake(group_ptr->tx_event_flags_group_suspended_count);
+    pthread_mutex_unlock(&host_lock);
+    return TX_SUCCESS;
+}
+
+// Queues of messages of one to sixteen words
+
+UINT tx_queue_create(TX_QUEUE *queue_ptr, CHAR *name_ptr, UINT message_size, VOID *queue_start, ULONG queue_size)
+{
+    queue_ptr->tx_queue_name = name_ptr;
+    queue_ptr->tx_queue_message_size = message_size;
+    queue_ptr->tx_queue_start = queue_start;
+    queue_ptr->tx_queue_capacity = queue_size / (message_size * sizeof(ULONG));
+    queue_ptr->tx_queue_enqueued = 0;
+    queue_ptr->tx_queue_read = 0;
+    return TX_SUCCESS;
+}
+
+UINT tx_queue_delete(TX_QUEUE *queue_ptr)
+{
+    queue_ptr->tx_queue_capacity = 0;
+    return TX_SUCCESS;
+}
+
+UINT tx_queue_send(TX_QUEUE *queue_ptr, VOID *source_ptr, ULONG wait_option)
+{
+    struct timespec deadline;
+    ULONG slot;
+    UINT status = TX_SUCCESS;
+
+    host_deadline(wait_option, &deadline);
+    pthread_mutex_lock(&host_lock);
+    while (queue_ptr->tx_queue_enqueued == queue_ptr->tx_queue_capacity)
+    {
+        if (host_wait(&queue_ptr->tx_queue_suspended_count, wait_option, &deadline))
+        {
+            status = TX_QUEUE_FULL;
+            break;
+        }
+    }
+    if (status == TX_SUCCESS)
+    {
+        slot = (queue_ptr->tx_queue_read + queue_ptr->tx_queue_enqueued) % queue_ptr->tx_queue_capacity;
+        memcpy(queue_ptr->tx_queue_start + slot * queue_ptr->tx_queue_message_size, source_ptr,
+               queue_ptr->tx_queue_message_size * sizeof(ULONG));
+        queue_ptr->tx_queue_enqueued++;
+        host_wake(queue_ptr->tx_queue_suspended_count);
+    }
+    pthread_mutex_unlock(&host_lock);
+    return status;
+}
+
+UINT tx_queue_receive(TX_QUEUE *queue_ptr, VOID *destination_ptr, ULONG wait_option)
+{
+    struct timespec deadline;
+    UINT status = TX_SUCCESS;
+
+    host_deadline(wait_option, &deadline);
+    pthread_mutex_lock(&host_lock);
+    while (queue_ptr->tx_queue_enqueued == 0)
+    {
+        if (host_wait(&queue_ptr->tx_queue_suspended_count, wait_option, &deadline))
+        {
+            status = TX_QUEUE_EMPTY;
+            break;
+        }
+    }
+    if (status == TX_SUCCESS)
+    {
+        memcpy(destination_ptr, queue_ptr->tx_queue_start + queue_ptr->tx_queue_read * queue_ptr->tx_queue_message_size,
+               queue_ptr->tx_queue_message_size * sizeof(ULONG));
+        queue_ptr->tx_queue_read = (queue_ptr->tx_queue_read + 1) % queue_ptr->tx_queue_capacity;
+        queue_ptr->tx_queue_enqueued--;
+        host_wake(queue_ptr->tx_queue_suspended_count);
+    }
+    pthread_mutex_unlock(&host_lock);
+    return status;
+}
+
+// Timers and simulated time
+
+static VOID host_timer_unlink(TX_TIMER *timer_ptr)
+{
+    TX_TIMER **link_ptr;
+
+    for (link_ptr = &host_timer_list; *link_ptr; link_ptr = &(*link_ptr)->tx_timer_next)
+    {
+        if (*link_ptr == timer_ptr)
+        {
+            *link_ptr = timer_ptr->tx_timer_next;
+            break;
+        }
+    }
+}
+
+UINT tx_timer_create(TX_TIMER *timer_ptr, CHAR *name_ptr, VOID (*expiration_function)(ULONG),
+                     ULONG expiration_input, ULONG initial_ticks, ULONG reschedule_ticks, UINT auto_activate)
+{
+    memset(timer_ptr, 0, sizeof(TX_TIMER));
+    timer_ptr->tx_timer_id = HOST_TIMER_ID;
+    timer_ptr->tx_timer_name = name_ptr;
+    timer_ptr->tx_timer_expiration_function = expiration_function;
+    timer_ptr->tx_timer_expiration_input = expiration_input;
+    timer_ptr->tx_timer_initial_ticks = initial_ticks;
+    timer_ptr->tx_timer_reschedule_ticks = reschedule_ticks;
+
+    pthread_mutex_lock(&host_lock);
+    timer_ptr->tx_timer_next = host_timer_list;
+    host_timer_list = timer_ptr;
+    pthread_mutex_unlock(&host_lock);
+
+    return auto_activate ? tx_timer_activate(timer_ptr) : TX_SUCCESS;
+}
+
+UINT tx_timer_delete(TX_TIMER *timer_ptr)
+{
+    pthread_mutex_lock(&host_lock);
+    host_timer_unlink(timer_ptr);
+    timer_ptr->tx_timer_id = 0;
+    timer_ptr->tx_timer_active = TX_FALSE;
+    pthread_mutex_unlock(&host_lock);
+    return TX_SUCCESS;
+}
+
+UINT tx_timer_activate(TX_TIMER *timer_ptr)
+{
+    pthread_mutex_lock(&host_lock);
+    if (!timer_ptr->tx_timer_active && timer_ptr->tx_timer_initial_ticks)
+    {
+        timer_ptr->tx_timer_expires = host_time + timer_ptr->tx_timer_initial_ticks;
+        timer_ptr->tx_timer_active = TX_TRUE;
+    }
+    pthread_mutex_unlock(&host_lock);
+    return TX_SUCCESS;
+}
+
+UINT tx_timer_deactivate(TX_TIMER *timer_ptr)
+{
+    pthread_mutex_lock(&host_lock);
+    timer_ptr->tx_timer_active = TX_FALSE;
+    pthread_mutex_unlock(&host_lock);
+    return TX_SUCCESS;
+}
+
+UINT tx_timer_change(TX_TIMER *timer_ptr, ULONG initial_ticks, ULONG reschedule_ticks)
+{
+    pthread_mutex_lock(&host_lock);
+    timer_ptr->tx_timer_initial_ticks = initial_ticks;
+    timer_ptr->tx_timer_reschedule_ticks = reschedule_ticks;
+    pthread_mutex_unlock(&host_lock);
+    return TX_SUCCESS;
+}
+
+ULONG tx_time_get(VOID)
+{
+    ULONG time;
+
+    pthread_mutex_lock(&host_lock);
+    time = host_time;
+    pthread_mutex_unlock(&host_lock);
+    return time;
+}
+
+VOID tx_time_set(ULONG new_time)
+{
+    pthread_mutex_lock(&host_lock);
+    host_time = new_time;
+    pthread_mutex_unlock(&host_lock);
+}
+
+// Move time on tick by tick, calling each timer that expires on the caller's thread
+VOID host_time_advance(ULONG ticks)
+{
+    TX_TIMER *timer_ptr;
+    VOID (*function)(ULONG);
+    ULONG input;
+
+    while (ticks--)
+    {
+        pthread_mutex_lock(&host_lock);
+        host_time++;
+        pthread_mutex_unlock(&host_lock);
+
+        // A callback may change the list, so search again after each one
+        for (;;)
+        {
+            function = NULL;
+            pthread_mutex_lock(&host_lock);
+            for (timer_ptr = host_timer_list; timer_ptr; timer_ptr = timer_ptr->tx_timer_next)
+            {
+                if (timer_ptr->tx_timer_active && (timer_ptr->tx_timer_expires == host_time))
+                {
+                    function = timer_ptr->tx_timer_expiration_function;
+                    input = timer_ptr->tx_timer_expiration_input;
+                    if (timer_ptr->tx_timer_reschedule_ticks)
+                    {
+                        timer_ptr->tx_timer_expires = host_time + timer_ptr->tx_timer_reschedule_ticks;
+                    }
+                    else
+                    {
+                        timer_ptr->tx_timer_active = TX_FALSE;
+                    }
+                    break;
+                }
+            }
+            pthread_mutex_unlock(&host_lock);
+            if (function == NULL)
+            {
+                break;
+            }
+            function(input);
+        }
+    }
+}
+
+// The core cycle counter, and the cycles run since the last tick
+ULONG host_core_clock_hz = 16000000;
+static ULONG64 host_cycles;
+static ULONG64 host_tick_cycles;
+
+VOID host_cycles_reset(VOID)
+{
+    host_cycles = 0;
+}
+
+UINT host_cycles_get(VOID)
+{
+    return (UINT)host_cycles;
+}
+
+VOID host_cycles_advance(ULONG64 cycles)
+{
+    ULONG64 cycles_per_tick = host_core_clock_hz / TX_TIMER_TICKS_PER_SECOND;
+
+    host_cycles += cycles;
+    host_tick_cycles += cycles;
+    host_time_advance((ULONG)(host_tick_cycles / cycles_per_tick));
+    host_tick_cycles %= cycles_per_tick;
+}
+
+// Packet pools
+
+UINT nx_packet_pool_create(NX_PACKET_POOL *pool_ptr, CHAR *name_ptr, ULONG payload_size,
+                           VOID *pool_start, ULONG pool_size)
+{
+    ULONG header_size = (sizeof(NX_PACKET) + sizeof(ALIGN_TYPE) - 1) & ~(sizeof(ALIGN_TYPE) - 1);
+    ULONG block_size;
+    UCHAR *block_ptr = pool_start;
+    NX_PACKET *packet_ptr;
+
+    payload_size = (payload_size + sizeof(ALIGN_TYPE) - 1) & ~(sizeof(ALIGN_TYPE) - 1);
+    block_size = header_size + payload_size;
+
+    memset(pool_ptr, 0, sizeof(NX_PACKET_POOL));
+    pool_ptr->nx_packet_pool_name = name_ptr;
+    pool_ptr->nx_packet_pool_payload_size = payload_size;
+
+    while (pool_size >= block_size)
+    {
+        packet_ptr = (NX_PACKET *)block_ptr;
+        memset(packet_ptr, 0, sizeof(NX_PACKET));
+        packet_ptr->nx_packet_pool_owner = pool_ptr;
+        packet_ptr->nx_packet_data_start = block_ptr + header_size;
+        packet_ptr->nx_packet_data_end = block_ptr + block_size;
+        packet_ptr->nx_packet_free_next = pool_ptr->nx_packet_pool_available_list;
+        pool_ptr->nx_packet_pool_available_list = packet_ptr;
+        pool_ptr->nx_packet_pool_total++;
+        block_ptr += block_size;
+        pool_size -= block_size;
+    }
+    pool_ptr->nx_packet_pool_available = pool_ptr->nx_packet_pool_total;
+    pool_ptr->nx_packet_pool_id = HOST_POOL_ID;
+
+    return pool_ptr->nx_packet_pool_total ? NX_SUCCESS : NX_SIZE_ERROR;
+}
+
+UINT nx_packet_pool_delete(NX_PACKET_POOL *pool_ptr)
+{
+    pool_ptr->nx_packet_pool_id = 0;
+    return NX_SUCCESS;
+}
+
+UINT host_packet_pool_create(NX_PACKET_POOL *pool_ptr, CHAR *name_ptr, ULONG payload_size, UINT packet_count)
+{
+    ULONG block_size = sizeof(NX_PACKET) + payload_size + 2 * sizeof(ALIGN_TYPE);
+    VOID *memory_ptr = malloc(block_size * packet_count);
+
+    if (memory_ptr == NULL)
+    {
+        return NX_POOL_ERROR;
+    }
+    return nx_packet_pool_create(pool_ptr, name_ptr, payload_size, memory_ptr, block_size * packet_count);
+}
+
+VOID host_packet_pool_delete(NX_PACKET_POOL *pool_ptr)
+{
+    UCHAR *lowest = NULL;
+    NX_PACKET *packet_ptr;
+
+    // The lowest packet is the start of the memory
+    for (packet_ptr = pool_ptr->nx_packet_pool_available_list; packet_ptr; packet_ptr = packet_ptr->nx_packet_free_next)
+    {
+        if ((lowest == NULL) || ((UCHAR *)packet_ptr < lowest))
+        {
+            lowest = (UCHAR *)packet_ptr;
+        }
+    }
+    if (pool_ptr->nx_packet_pool_available != pool_ptr->nx_packet_pool_total)
+    {
+        fprintf(stderr, "host port: pool %s deleted with %lu packets in use\n", pool_ptr->nx_packet_pool_name,
+                pool_ptr->nx_packet_pool_total - pool_ptr->nx_packet_pool_available);
+        abort();
+    }
+    nx_packet_pool_delete(pool_ptr);
+    free(lowest);
+}
+
+UINT nx_packet_allocate(NX_PACKET_POOL *pool_ptr, NX_PACKET **packet_ptr, ULONG packet_type, ULONG wait_option)
+{
+    struct timespec deadline;
+    NX_PACKET *work_ptr;
+
+    *packet_ptr = NX_NULL;
+    if (packet_type > pool_ptr->nx_packet_pool_payload_size)
+    {
+        return NX_INVALID_PARAMETERS;
+    }
+
+    host_deadline(wait_option, &deadline);
+    pthread_mutex_lock(&host_lock);
+    while (pool_ptr->nx_packet_pool_available_list == NX_NULL)
+    {
+        if (host_wait(&pool_ptr->nx_packet_pool_suspended_count, wait_option, &deadline))
+        {
+            pool_ptr->nx_packet_pool_empty_requests++;
+            pthread_mutex_unlock(&host_lock);
+            return NX_NO_PACKET;
+        }
+    }
+    work_ptr = pool_ptr->nx_packet_pool_available_list;
+    pool_ptr->nx_packet_pool_available_list = work_ptr->nx_packet_free_next;
+    pool_ptr->nx_packet_pool_available--;
+    pthread_mutex_unlock(&host_lock);
+
+    work_ptr->nx_packet_free_next = NX_NULL;
+    work_ptr->nx_packet_queue_next = NX_NULL;
+    work_ptr->nx_packet_next = NX_NULL;
+    work_ptr->nx_packet_last = NX_NULL;
+    work_ptr->nx_packet_length = 0;
+    work_ptr->nx_packet_ip_interface = NX_NULL;
+    work_ptr->nx_packet_ip_header = NX_NULL;
+    work_ptr->nx_packet_prepend_ptr = work_ptr->nx_packet_data_start + packet_type;
+    work_ptr->nx_packet_append_ptr = work_ptr->nx_packet_prepend_ptr;
+    work_ptr->nx_packet_allocated = NX_TRUE;
+    *packet_ptr = work_ptr;
+    return NX_SUCCESS;
+}
+
+UINT nx_packet_release(NX_PACKET *packet_ptr)
+{
+    NX_PACKET *next_ptr;
+    NX_PACKET_POOL *pool_ptr;
+    UINT suspended = 0;
+
+    if (packet_ptr == NX_NULL)
+    {
+        return NX_PTR_ERROR;
+    }
+
+    pthread_mutex_lock(&host_lock);
+    while (packet_ptr)
+    {
+        if (!packet_ptr->nx_packet_allocated)
+        {
+            fprintf(stderr, "host port: packet %p released twice\n", (void *)packet_ptr);
+            abort();
+        }
+        next_ptr = packet_ptr->nx_packet_next;
+        pool_ptr = packet_ptr->nx_packet_pool_owner;
+        packet_ptr->nx_packet_allocated = NX_FALSE;
+        packet_ptr->nx_packet_free_next = pool_ptr->nx_packet_pool_available_list;
+        pool_ptr->nx_packet_pool_available_list = packet_ptr;
+        pool_ptr->nx_packet_pool_available++;
+        suspended += pool_ptr->nx_packet_pool_suspended_count;
+        packet_ptr = next_ptr;
+    }
+    host_wake(suspended);
+    pthread_mutex_unlock(&host_lock);
+    return NX_SUCCESS;
+}
+
+UINT nx_packet_data_append(NX_PACKET *packet_ptr, VOID *data_start, ULONG data_size,
+                           NX_PACKET_POOL *pool_ptr, ULONG wait_option)
+{
+    NX_PACKET *last_ptr = packet_ptr->nx_packet_last ? packet_ptr->nx_packet_last : packet_ptr;
+    NX_PACKET *chain_head = NX_NULL;
+    NX_PACKET *chain_tail = NX_NULL;
+    NX_PACKET *new_ptr;
+    UCHAR *source_ptr = data_start;
+    ULONG room = (ULONG)(last_ptr->nx_packet_data_end - last_ptr->nx_packet_append_ptr);
+    ULONG needed;
+    ULONG copy_size;
+
+    // Take every packet needed first, so a failure leaves the packet as it was
+    needed = (data_size > room) ? data_size - room : 0;
+    while (needed)
+    {
+        if (nx_packet_allocate(pool_ptr, &new_ptr, NX_RECEIVE_PACKET, wait_option))
+        {
+            if (chain_head)
+            {
+                nx_packet_release(chain_head);
+            }
+            return NX_NO_PACKET;
+        }
+        if (chain_tail)
+        {
+            chain_tail->nx_packet_next = new_ptr;
+        }
+        else
+        {
+            chain_head = new_ptr;
+        }
+        chain_tail = new_ptr;
+        copy_size = (ULONG)(new_ptr->nx_packet_data_end - new_ptr->nx_packet_append_ptr);
+        needed = (needed > copy_size) ? needed - copy_size : 0;
+    }
+
+    packet_ptr->nx_packet_length += data_size;
+    copy_size = (data_size < room) ? data_size : room;
+    memcpy(last_ptr->nx_packet_append_ptr, source_ptr, copy_size);
+    last_ptr->nx_packet_append_ptr += copy_size;
+    source_ptr += copy_size;
+    data_size -= copy_size;
+
+    for (new_ptr = chain_head; new_ptr; new_ptr = new_ptr->nx_packet_next)
+    {
+        copy_size = (ULONG)(new_ptr->nx_packet_data_end - new_ptr->nx_packet_append_ptr);
+        copy_size = (data_size < copy_size) ? data_size : copy_size;
+        memcpy(new_ptr->nx_packet_append_ptr, source_ptr, copy_size);
+        new_ptr->nx_packet_append_ptr += copy_size;
+        source_ptr += copy_size;
+        data_size -= copy_size;
+    }
+    if (chain_head)
+    {
+        last_ptr->nx_packet_next = chain_head;
+        packet_ptr->nx_packet_last = chain_tail;
+    }
+    return NX_SUCCESS;
+}
+
+UINT nx_packet_copy(NX_PACKET *packet_ptr, NX_PACKET **new_packet_ptr, NX_PACKET_POOL *pool_ptr, ULONG wait_option)
+{
+    NX_PACKET *work_ptr;
+    NX_PACKET *source_ptr;
+    UINT status;
+
+    *new_packet_ptr = NX_NULL;
+    status = nx_packet_allocate(pool_ptr, &work_ptr,
+                                (ULONG)(packet_ptr->nx_packet_prepend_ptr - packet_ptr->nx_packet_data_start),
+                                wait_option);
+    if (status)
+    {
+        return status;
+    }
+    for (source_ptr = packet_ptr; source_ptr; source_ptr = source_ptr->nx_packet_next)
+    {
+        status = nx_packet_data_append(work_ptr, source_ptr->nx_packet_prepend_ptr,
+                                       (ULONG)(source_ptr->nx_packet_append_ptr - source_ptr->nx_packet_prepend_ptr),
+                                       pool_ptr, wait_option);
+        if (status)
+        {
+            nx_packet_release(work_ptr);
+            return status;
+        }
+    }
+    *new_packet_ptr = work_ptr;
+    return NX_SUCCESS;
+}
+
+UINT nx_packet_data_extract_offset(NX_PACKET *packet_ptr, ULONG offset, VOID *buffer_start,
+                                   ULONG buffer_length, ULONG *bytes_copied)
+{
+    UCHAR *destination_ptr = buffer_start;
+    ULONG segment_size;
+    ULONG copy_size;
+
+    *bytes_copied = 0;
+    if (offset >= packet_ptr->nx_packet_length)
+    {
+        return NX_PACKET_OFFSET_ERROR;
+    }
+    for (; packet_ptr && buffer_length; packet_ptr = packet_ptr->nx_packet_next)
+    {
+        segment_size = (ULONG)(packet_ptr->nx_packet_append_ptr - packet_ptr->nx_packet_prepend_ptr);
+        if (offset >= segment_size)
+        {
+            offset -= segment_size;
+            continue;
+        }
+        copy_size = segment_size - offset;
+        copy_size = (buffer_length < copy_size) ? buffer_length : copy_size;
+        memcpy(destination_ptr, packet_ptr->nx_packet_prepend_ptr + offset, copy_size);
+        destination_ptr += copy_size;
+        buffer_length -= copy_size;
+        *bytes_copied += copy_size;
+        offset = 0;
+    }
+    return NX_SUCCESS;
+}
+
+UINT nx_packet_data_retrieve(NX_PACKET *packet_ptr, VOID *buffer_start, ULONG *bytes_copied)
+{
+    if (packet_ptr->nx_packet_length == 0)
+    {
+        *bytes_copied = 0;
+        return NX_SUCCESS;
+    }
+    return nx_packet_data_extract_offset(packet_ptr, 0, buffer_start, packet_ptr->nx_packet_length, bytes_copied);
+}
+
+UINT nx_packet_length_get(NX_PACKET *packet_ptr, ULONG *length)
+{
+    *length = packet_ptr->nx_packet_length;
+    return NX_SUCCESS;
+}
+
+// TCP sockets connected to a peer stand-in
+
+VOID host_network_init(ULONG payload_size, UINT packet_count)
+{
+    host_packet_pool_create(&host_network_pool, "host network", payload_size, packet_count);
+}
+
+static VOID host_tcp_flush(NX_TCP_SOCKET *socket_ptr)
+{
+    NX_PACKET *packet_ptr;
+
+    pthread_mutex_lock(&host_lock);
+    packet_ptr = socket_ptr->host_tcp_receive_head;
+    socket_ptr->host_tcp_receive_head = NX_NULL;
+    socket_ptr->host_tcp_receive_tail = NX_NULL;
+    pthread_mutex_unlock(&host_lock);
+
+    while (packet_ptr)
+    {
+        NX_PACKET *next_ptr = packet_ptr->nx_packet_queue_next;
+        nx_packet_release(packet_ptr);
+        packet_ptr = next_ptr;
+    }
+}
+
+UINT nx_tcp_socket_create(NX_IP *ip_ptr, NX_TCP_SOCKET *socket_ptr, CHAR *name,
+                          ULONG type_of_service, ULONG fragment, UINT time_to_live, ULONG window_size,
+                          VOID (*tcp_urgent_data_callback)(NX_TCP_SOCKET *socket_ptr),
+                          VOID (*tcp_disconnect_callback)(NX_TCP_SOCKET *socket_ptr))
+{
+    HOST_TCP_PEER *peer_ptr = socket_ptr->host_tcp_peer;
+
+    (void)type_of_service;
+    (void)fragment;
+    (void)time_to_live;
+    (void)window_size;
+    (void)tcp_urgent_data_callback;
+
+    // A peer may be attached before the application creates the socket
+    memset(socket_ptr, 0, sizeof(NX_TCP_SOCKET));
+    socket_ptr->host_tcp_peer = peer_ptr;
+    socket_ptr->nx_tcp_socket_id = HOST_TCP_ID;
+    socket_ptr->nx_tcp_socket_name = name;
+    socket_ptr->nx_tcp_socket_ip_ptr = ip_ptr;
+    socket_ptr->nx_tcp_disconnect_callback = tcp_disconnect_callback;
+    return NX_SUCCESS;
+}
+
+UINT nx_tcp_socket_delete(NX_TCP_SOCKET *socket_ptr)
+{
+    host_tcp_flush(socket_ptr);
+    socket_ptr->nx_tcp_socket_id = 0;
+    return NX_SUCCESS;
+}
+
+UINT nx_tcp_client_socket_bind(NX_TCP_SOCKET *socket_ptr, UINT port, ULONG wait_option)
+{
+    (void)port;
+    (void)wait_option;
+
+    if (socket_ptr->host_tcp_bound)
+    {
+        return NX_ALREADY_BOUND;
+    }
+    socket_ptr->host_tcp_bound = NX_TRUE;
+    return NX_SUCCESS;
+}
+
+UINT nx_tcp_client_socket_unbind(NX_TCP_SOCKET *socket_ptr)
+{
+    socket_ptr->host_tcp_bound = NX_FALSE;
+    return NX_SUCCESS;
+}
+
+UINT nxd_tcp_client_socket_connect(NX_TCP_SOCKET *socket_ptr, NXD_ADDRESS *server_ip, UINT server_port,
+                                   ULONG wait_option)
+{
+    HOST_TCP_PEER *peer_ptr = socket_ptr->host_tcp_peer;
+
+    if (!socket_ptr->host_tcp_bound)
+    {
+        return NX_NOT_BOUND;
+    }
+    if ((peer_ptr == NX_NULL) ||
+        (peer_ptr->host_tcp_peer_connect && peer_ptr->host_tcp_peer_connect(peer_ptr, socket_ptr)))
+    {
+        return NX_NOT_CONNECTED;
+    }
+
+    socket_ptr->nx_tcp_socket_connect_ip = *server_ip;
+    socket_ptr->nx_tcp_socket_connect_port = server_port;
+    socket_ptr->nx_tcp_socket_connect_mss = 1460;
+    socket_ptr->host_tcp_connected = NX_TRUE;
+
+    if (wait_option == NX_NO_WAIT)
+    {
+        if (socket_ptr->nx_tcp_establish_notify)
+        {
+            socket_ptr->nx_tcp_establish_notify(socket_ptr);
+        }
+        return NX_IN_PROGRESS;
+    }
+    return NX_SUCCESS;
+}
+
+UINT nx_tcp_socket_disconnect(NX_TCP_SOCKET *socket_ptr, ULONG wait_option)
+{
+    HOST_TCP_PEER *peer_ptr = socket_ptr->host_tcp_peer;
+
+    (void)wait_option;
+
+    if (!socket_ptr->host_tcp_connected)
+    {
+        return NX_NOT_CONNECTED;
+    }
+    socket_ptr->host_tcp_connected = NX_FALSE;
+    host_tcp_flush(socket_ptr);
+    if (peer_ptr && peer_ptr->host_tcp_peer_disconnect)
+    {
+        peer_ptr->host_tcp_peer_disconnect(peer_ptr, socket_ptr);
+    }
+    return NX_SUCCESS;
+}
+
+// Sends from several threads reach the peer one at a time, as NetX sends under the IP mutex
+UINT nx_tcp_socket_send(NX_TCP_SOCKET *socket_ptr, NX_PACKET *packet_ptr, ULONG wait_option)
+{
+    HOST_TCP_PEER *peer_ptr = socket_ptr->host_tcp_peer;
+    UCHAR *buffer;
+    ULONG length;
+
+    (void)wait_option;
+
+    pthread_mutex_lock(&host_send_lock);
+
+    // As in NetX, the caller keeps the packet when the send fails
+    if (!socket_ptr->host_tcp_connected)
+    {
+        pthread_mutex_unlock(&host_send_lock);
+        return NX_NOT_CONNECTED;
+    }
+
+    buffer = malloc(packet_ptr->nx_packet_length + 1);
+    nx_packet_data_retrieve(packet_ptr, buffer, &length);
+    nx_packet_release(packet_ptr);
+
+    socket_ptr->host_tcp_segments_sent++;
+    socket_ptr->host_tcp_bytes_sent += length;
+    if (peer_ptr && peer_ptr->host_tcp_peer_receive)
+    {
+        peer_ptr->host_tcp_peer_receive(peer_ptr, socket_ptr, buffer, length);
+    }
+    free(buffer);
+    pthread_mutex_unlock(&host_send_lock);
+    return NX_SUCCESS;
+}
+
+UINT nx_tcp_socket_receive(NX_TCP_SOCKET *socket_ptr, NX_PACKET **packet_ptr, ULONG wait_option)
+{
+    struct timespec deadline;
+    UINT status = NX_SUCCESS;
+
+    *packet_ptr = NX_NULL;
+    host_deadline(wait_option, &deadline);
+    pthread_mutex_lock(&host_lock);
+    while (socket_ptr->host_tcp_receive_head == NX_NULL)
+    {
+        if (!socket_ptr->host_tcp_connected)
+        {
+            status = NX_NOT_CONNECTED;
+            break;
+        }
+        if (host_wait(&socket_ptr->nx_tcp_socket_receive_suspended_count, wait_option, &deadline))
+        {
+            status = NX_NO_PACKET;
+            break;
+        }
+    }
+    if (status == NX_SUCCESS)
+    {
+        *packet_ptr = socket_ptr->host_tcp_receive_head;
+        socket_ptr->host_tcp_receive_head = (*packet_ptr)->nx_packet_queue_next;
+        if (socket_ptr->host_tcp_receive_head == NX_NULL)
+        {
+            socket_ptr->host_tcp_receive_tail = NX_NULL;
+        }
+        (*packet_ptr)->nx_packet_queue_next = NX_NULL;
+    }
+    pthread_mutex_unlock(&host_lock);
+    return status;
+}
+
+UINT nx_tcp_socket_receive_notify(NX_TCP_SOCKET *socket_ptr, VOID (*tcp_receive_notify)(NX_TCP_SOCKET *socket_ptr))
+{
+    socket_ptr->nx_tcp_receive_callback = tcp_receive_notify;
+    return NX_SUCCESS;
+}
+
+UINT nx_tcp_socket_establish_notify(NX_TCP_SOCKET *socket_ptr, VOID (*tcp_establish_notify)(NX_TCP_SOCKET *socket_ptr))
+{
+    socket_ptr->nx_tcp_establish_notify = tcp_establish_notify;
+    return NX_SUCCESS;
+}
+
+UINT host_tcp_deliver(NX_TCP_SOCKET *socket_ptr, const VOID *data, ULONG length, ULONG segment_size)
+{
+    const UCHAR *source_ptr = data;
+    NX_PACKET *packet_ptr;
+    ULONG size;
+
+    if (!socket_ptr->host_tcp_connected)
+    {
+        return NX_NOT_CONNECTED;
+    }
+    if (host_network_pool.nx_packet_pool_id == 0)
+    {
+        host_network_init(1536, 256);
+    }
+
+    while (length)
+    {
+        size = ((segment_size == 0) || (length < segment_size)) ? length : segment_size;
+        if (nx_packet_allocate(&host_network_pool, &packet_ptr, NX_RECEIVE_PACKET, NX_NO_WAIT) ||
+            nx_packet_data_append(packet_ptr, (VOID *)source_ptr, size, &host_network_pool, NX_NO_WAIT))
+        {
+            fprintf(stderr, "host port: network pool exhausted\n");
+            abort();
+        }
+
+        pthread_mutex_lock(&host_lock);
+        if (socket_ptr->host_tcp_receive_tail)
+        {
+            socket_ptr->host_tcp_receive_tail->nx_packet_queue_next = packet_ptr;
+        }
+        else
+        {
+            socket_ptr->host_tcp_receive_head = packet_ptr;
+        }
+        socket_ptr->host_tcp_receive_tail = packet_ptr;
+        host_wake(socket_ptr->nx_tcp_socket_receive_suspended_count);
+        pthread_mutex_unlock(&host_lock);
+
+        if (socket_ptr->nx_tcp_receive_callback)
+        {
+            socket_ptr->nx_tcp_receive_callback(socket_ptr);
+        }
+        source_ptr += size;
+        length -= size;
+    }
+    return NX_SUCCESS;
+}
+
+VOID host_tcp_close(NX_TCP_SOCKET *socket_ptr)
+{
+    if (!socket_ptr->host_tcp_connected)
+    {
+        return;
+    }
+    socket_ptr->host_tcp_connected = NX_FALSE;
+    pthread_mutex_lock(&host_lock);
+    host_wake(socket_ptr->nx_tcp_socket_receive_suspended_count);
+    pthread_mutex_unlock(&host_lock);
+    if (socket_ptr->nx_tcp_disconnect_callback)
+    {
+        socket_ptr->nx_tcp_disconnect_callback(socket_ptr);
+    }
+}
+
+// Random numbers for NX_RAND; a test seeds them with srand
+
+UINT nx_rand16(VOID)
+{
+    return (UINT)rand() & 0xFFFF;
+}
+
+UINT _nx_utility_string_length_check(CHAR *input_string, UINT *string_length, UINT max_string_length)
+{
+    UINT length = 0;
+
+    if (input_string == NX_NULL)
+    {
+        return NX_PTR_ERROR;
+    }
+    while (input_string[length])
+    {
+        if (++length > max_string_length)
+        {
+            return NX_SIZE_ERROR;
+        }
+    }
+    if (string_length)
+    {
+        *string_length = length;
+    }
+    return NX_SUCCESS;
+}
+
+// IP instances, with the primary interface up from creation
+
+UINT nx_ip_create(NX_IP *ip_ptr, CHAR *name, ULONG ip_address, ULONG network_mask, NX_PACKET_POOL *default_pool,
+                  VOID (*ip_link_driver)(NX_IP_DRIVER *driver_req_ptr), VOID *memory_ptr, ULONG memory_size,
+                  UINT priority)
+{
+    HOST_NETWORK_PEER *peer_ptr = ip_ptr->host_network_peer;
+    NX_INTERFACE *interface_ptr = &ip_ptr->nx_ip_interface[0];
+
+    (void)memory_ptr;
+    (void)memory_size;
+    (void)priority;
+
+    // A peer may be attached before the application creates the instance
+    memset(ip_ptr, 0, sizeof(NX_IP));
+    ip_ptr->host_network_peer = peer_ptr;
+    ip_ptr->nx_ip_id = NX_IP_ID;
+    ip_ptr->nx_ip_name = name;
+    ip_ptr->nx_ip_default_packet_pool = default_pool;
+    tx_mutex_create(&ip_ptr->nx_ip_protection, name, TX_INHERIT);
+
+    interface_ptr->nx_interface_name = "PRI";
+    interface_ptr->nx_interface_valid = NX_TRUE;
+    interface_ptr->nx_interface_link_up = NX_TRUE;
+    interface_ptr->nx_interface_ip_instance = ip_ptr;
+    interface_ptr->nx_interface_ip_mtu_size = default_pool->nx_packet_pool_payload_size - NX_PHYSICAL_HEADER;
+    interface_ptr->nx_interface_link_driver_entry = ip_link_driver;
+    nx_ip_interface_address_set(ip_ptr, 0, ip_address, network_mask);
+    return NX_SUCCESS;
+}
+
+UINT nx_ip_delete(NX_IP *ip_ptr)
+{
+    tx_mutex_delete(&ip_ptr->nx_ip_protection);
+    ip_ptr->nx_ip_id = 0;
+    return NX_SUCCESS;
+}
+
+UINT nx_ip_interface_address_get(NX_IP *ip_ptr, UINT interface_index, ULONG *ip_address, ULONG *network_mask)
+{
+    if ((interface_index >= NX_MAX_PHYSICAL_INTERFACES) || !ip_ptr->nx_ip_interface[interface_index].nx_interface_valid)
+    {
+        return NX_INVALID_INTERFACE;
+    }
+    *ip_address = ip_ptr->nx_ip_interface[interface_index].nx_interface_ip_address;
+    *network_mask = ip_ptr->nx_ip_interface[interface_index].nx_interface_ip_network_mask;
+    return NX_SUCCESS;
+}
+
+UINT nx_ip_interface_address_set(NX_IP *ip_ptr, UINT interface_index, ULONG ip_address, ULONG network_mask)
+{
+    NX_INTERFACE *interface_ptr;
+
+    if ((interface_index >= NX_MAX_PHYSICAL_INTERFACES) || !ip_ptr->nx_ip_interface[interface_index].nx_interface_valid)
+    {
+        return NX_INVALID_INTERFACE;
+    }
+    interface_ptr = &ip_ptr->nx_ip_interface[interface_index];
+    interface_ptr->nx_interface_ip_address = ip_address;
+    interface_ptr->nx_interface_ip_network_mask = network_mask;
+    interface_ptr->nx_interface_ip_network = ip_address & network_mask;
+    return NX_SUCCESS;
+}
+
+UINT nx_ip_gateway_address_get(NX_IP *ip_ptr, ULONG *ip_address)
+{
+    if (ip_ptr->nx_ip_gateway_address == 0)
+    {
+        return NX_NOT_FOUND;
+    }
+    *ip_address = ip_ptr->nx_ip_gateway_address;
+    return NX_SUCCESS;
+}
+
+UINT nx_ip_gateway_address_set(NX_IP *ip_ptr, ULONG ip_address)
+{
+    ip_ptr->nx_ip_gateway_address = ip_address;
+    return NX_SUCCESS;
+}
+
+UINT nx_ip_gateway_address_clear(NX_IP *ip_ptr)
+{
+    ip_ptr->nx_ip_gateway_address = 0;
+    return NX_SUCCESS;
+}
+
+// Checksums, over packet data in network byte order
+
+static ULONG host_checksum_add(ULONG sum, const UCHAR *data, ULONG length, UINT *odd)
+{
+    while (length--)
+    {
+        sum += *odd ? *data : ((ULONG)*data << 8);
+        *odd = !*odd;
+        data++;
+    }
+    return sum;
+}
+
+static ULONG host_checksum_fold(ULONG sum)
+{
+    while (sum >> 16)
+    {
+        sum = (sum & NX_LOWER_16_MASK) + (sum >> 16);
+    }
+    return sum;
+}
+
+ULONG _nx_ip_checksum_compute(NX_PACKET *packet_ptr, ULONG protocol, UINT data_length, ULONG *src_ip_addr,
+                              ULONG *dest_ip_addr)
+{
+    NX_PACKET *work_ptr;
+    ULONG sum = 0;
+    ULONG length;
+    UINT odd = NX_FALSE;
+
+    if (protocol == NX_PROTOCOL_UDP)
+    {
+        sum = (*src_ip_addr >> 16) + (*src_ip_addr & NX_LOWER_16_MASK) +
+              (*dest_ip_addr >> 16) + (*dest_ip_addr & NX_LOWER_16_MASK) + protocol + data_length;
+    }
+    for (work_ptr = packet_ptr; work_ptr && data_length; work_ptr = work_ptr->nx_packet_next)
+    {
+        length = (ULONG)(work_ptr->nx_packet_append_ptr - work_ptr->nx_packet_prepend_ptr);
+        if (length > data_length)
+        {
+            length = data_length;
+        }
+        sum = host_checksum_add(sum, work_ptr->nx_packet_prepend_ptr, length, &odd);
+        data_length -= (UINT)length;
+    }
+    return host_checksum_fold(sum);
+}
+
+// UDP sockets, and the network peer of the IP instance behind them
+
+static ULONG host_get_ulong(const UCHAR *data)
+{
+    return ((ULONG)data[0] << 24) | ((ULONG)data[1] << 16) | ((ULONG)data[2] << 8) | data[3];
+}
+
+static VOID host_put_ulong(UCHAR *data, ULONG value)
+{
+    data[0] = (UCHAR)(value >> 24);
+    data[1] = (UCHAR)(value >> 16);
+    data[2] = (UCHAR)(value >> 8);
+    data[3] = (UCHAR)value;
+}
+
+static VOID host_udp_flush(NX_UDP_SOCKET *socket_ptr)
+{
+    NX_PACKET *packet_ptr;
+
+    pthread_mutex_lock(&host_lock);
+    packet_ptr = socket_ptr->host_udp_receive_head;
+    socket_ptr->host_udp_receive_head = NX_NULL;
+    socket_ptr->host_udp_receive_tail = NX_NULL;
+    socket_ptr->host_udp_receive_count = 0;
+    pthread_mutex_unlock(&host_lock);
+
+    while (packet_ptr)
+    {
+        NX_PACKET *next_ptr = packet_ptr->nx_packet_queue_next;
+        nx_packet_release(packet_ptr);
+        packet_ptr = next_ptr;
+    }
+}
+
+UINT nx_udp_socket_create(NX_IP *ip_ptr, NX_UDP_SOCKET *socket_ptr, CHAR *name, ULONG type_of_service,
+                          ULONG fragment, UINT time_to_live, ULONG queue_maximum)
+{
+    memset(socket_ptr, 0, sizeof(NX_UDP_SOCKET));
+    socket_ptr->nx_udp_socket_id = HOST_UDP_ID;
+    socket_ptr->nx_udp_socket_name = name;
+    socket_ptr->nx_udp_socket_ip_ptr = ip_ptr;
+    socket_ptr->nx_udp_socket_type_of_service = type_of_service;
+    socket_ptr->nx_udp_socket_fragment_enable = fragment;
+    socket_ptr->nx_udp_socket_time_to_live = time_to_live;
+    socket_ptr->nx_udp_socket_queue_maximum = queue_maximum;
+    return NX_SUCCESS;
+}
+
+UINT nx_udp_socket_delete(NX_UDP_SOCKET *socket_ptr)
+{
+    if (socket_ptr->host_udp_bound)
+    {
+        return NX_STILL_BOUND;
+    }
+    socket_ptr->nx_udp_socket_id = 0;
+    return NX_SUCCESS;
+}
+
+UINT nx_udp_socket_bind(NX_UDP_SOCKET *socket_ptr, UINT port, ULONG wait_option)
+{
+    (void)wait_option;
+
+    if (socket_ptr->host_udp_bound)
+    {
+        return NX_ALREADY_BOUND;
+    }
+    socket_ptr->nx_udp_socket_port = (port == NX_ANY_PORT) ? 0xC000 : port;
+    socket_ptr->host_udp_bound = NX_TRUE;
+    return NX_SUCCESS;
+}
+
+UINT nx_udp_socket_unbind(NX_UDP_SOCKET *socket_ptr)
+{
+    if (!socket_ptr->host_udp_bound)
+    {
+        return NX_NOT_BOUND;
+    }
+    socket_ptr->host_udp_bound = NX_FALSE;
+    host_udp_flush(socket_ptr);
+    return NX_SUCCESS;
+}
+
+UINT nx_udp_socket_interface_send(NX_UDP_SOCKET *socket_ptr, NX_PACKET *packet_ptr, ULONG ip_address, UINT port,
+                                  UINT interface_index)
+{
+    NX_IP *ip_ptr = socket_ptr->nx_udp_socket_ip_ptr;
+    HOST_NETWORK_PEER *peer_ptr = ip_ptr->host_network_peer;
+    UCHAR *buffer;
+    ULONG length;
+
+    // As in NetX, the caller keeps the packet when the send fails
+    if (!socket_ptr->host_udp_bound)
+    {
+        return NX_NOT_BOUND;
+    }
+    if ((interface_index >= NX_MAX_PHYSICAL_INTERFACES) || !ip_ptr->nx_ip_interface[interface_index].nx_interface_valid)
+    {
+        return NX_INVALID_INTERFACE;
+    }
+
+    pthread_mutex_lock(&host_send_lock);
+    buffer = malloc(packet_ptr->nx_packet_length + 1);
+    nx_packet_data_retrieve(packet_ptr, buffer, &length);
+    nx_packet_release(packet_ptr);
+
+    socket_ptr->nx_udp_socket_packets_sent++;
+    socket_ptr->nx_udp_socket_bytes_sent += length;
+    ip_ptr->nx_ip_udp_packets_sent++;
+    ip_ptr->nx_ip_udp_bytes_sent += length;
+    if (peer_ptr && peer_ptr->host_network_peer_udp)
+    {
+        peer_ptr->host_network_peer_udp(peer_ptr, ip_ptr, interface_index,
+                                        ip_ptr->nx_ip_interface[interface_index].nx_interface_ip_address,
+                                        socket_ptr->nx_udp_socket_port, ip_address, port, buffer, length);
+    }
+    free(buffer);
+    pthread_mutex_unlock(&host_send_lock);
+    return NX_SUCCESS;
+}
+
+// Only IPv4 is modelled, sent on the primary interface
+UINT nxd_udp_socket_send(NX_UDP_SOCKET *socket_ptr, NX_PACKET *packet_ptr, NXD_ADDRESS *ip_address, UINT port)
+{
+    if (ip_address->nxd_ip_version != NX_IP_VERSION_V4)
+    {
+        return NX_NOT_SUPPORTED;
+    }
+    return nx_udp_socket_interface_send(socket_ptr, packet_ptr, ip_address->nxd_ip_address.v4, port, 0);
+}
+
+// Without started threads nothing else can deliver, so a receive that finds no datagram
+// has waited out its timeout: the clock moves on by it, as tx_thread_sleep moves it
+UINT nx_udp_socket_receive(NX_UDP_SOCKET *socket_ptr, NX_PACKET **packet_ptr, ULONG wait_option)
+{
+    struct timespec deadline;
+    UINT status = NX_SUCCESS;
+
+    *packet_ptr = NX_NULL;
+    host_deadline(wait_option, &deadline);
+    pthread_mutex_lock(&host_lock);
+    while (socket_ptr->host_udp_receive_head == NX_NULL)
+    {
+        if (!socket_ptr->host_udp_bound)
+        {
+            status = NX_NOT_BOUND;
+            break;
+        }
+        if (host_wait(&socket_ptr->nx_udp_socket_receive_suspended_count, wait_option, &deadline))
+        {
+            status = NX_NO_PACKET;
+            break;
+        }
+    }
+    if (status == NX_SUCCESS)
+    {
+        *packet_ptr = socket_ptr->host_udp_receive_head;
+        socket_ptr->host_udp_receive_head = (*packet_ptr)->nx_packet_queue_next;
+        if (socket_ptr->host_udp_receive_head == NX_NULL)
+        {
+            socket_ptr->host_udp_receive_tail = NX_NULL;
+        }
+        socket_ptr->host_udp_receive_count--;
+        (*packet_ptr)->nx_packet_queue_next = NX_NULL;
+    }
+    pthread_mutex_unlock(&host_lock);
+    if ((status == NX_NO_PACKET) && !host_thread_start_enable && (wait_option != TX_WAIT_FOREVER))
+    {
+        host_time_advance(wait_option);
+    }
+    return status;
+}
+
+UINT nx_udp_socket_receive_notify(NX_UDP_SOCKET *socket_ptr, VOID (*udp_receive_notify)(NX_UDP_SOCKET *socket_ptr))
+{
+    socket_ptr->nx_udp_receive_callback = udp_receive_notify;
+    return NX_SUCCESS;
+}
+
+// The addresses come from the headers in front of the data, as NetX leaves them
+UINT nx_udp_packet_info_extract(NX_PACKET *packet_ptr, ULONG *ip_address, UINT *protocol, UINT *port,
+                                UINT *interface_index)
+{
+    if ((packet_ptr->nx_packet_ip_header == NX_NULL) || (packet_ptr->nx_packet_ip_interface == NX_NULL))
+    {
+        return NX_INVALID_PACKET;
+    }
+    if (ip_address)
+    {
+        *ip_address = host_get_ulong(packet_ptr->nx_packet_ip_header + 12);
+    }
+    if (protocol)
+    {
+        *protocol = NX_PROTOCOL_UDP;
+    }
+    if (port)
+    {
+        *port = (UINT)(host_get_ulong(packet_ptr->nx_packet_prepend_ptr - sizeof(NX_UDP_HEADER)) >> NX_SHIFT_BY_16);
+    }
+    if (interface_index)
+    {
+        *interface_index = packet_ptr->nx_packet_ip_interface->nx_interface_index;
+    }
+    return NX_SUCCESS;
+}
+
+UINT host_udp_deliver(NX_UDP_SOCKET *socket_ptr, UINT interface_index, ULONG source_ip, UINT source_port,
+                      ULONG destination_ip, const VOID *data, ULONG length)
+{
+    NX_IP *ip_ptr = socket_ptr->nx_udp_socket_ip_ptr;
+    NX_PACKET *packet_ptr;
+    UCHAR *header_ptr;
+    ULONG sum;
+    UINT odd = NX_FALSE;
+
+    if (!socket_ptr->host_udp_bound)
+    {
+        return NX_NOT_BOUND;
+    }
+    if (host_network_pool.nx_packet_pool_id == 0)
+    {
+        host_network_init(1536, 256);
+    }
+    if (nx_packet_allocate(&host_network_pool, &packet_ptr, NX_IPv4_UDP_PACKET, NX_NO_WAIT) ||
+        nx_packet_data_append(packet_ptr, (VOID *)data, length, &host_network_pool, NX_NO_WAIT))
+    {
+        fprintf(stderr, "host port: network pool exhausted\n");
+        abort();
+    }
+
+    // The IPv4 and UDP headers stay in front of the data, where nx_udp_packet_info_extract reads them
+    header_ptr = packet_ptr->nx_packet_prepend_ptr - sizeof(NX_UDP_HEADER) - sizeof(NX_IPV4_HEADER);
+    host_put_ulong(header_ptr, NX_IP_VERSION | (length + sizeof(NX_UDP_HEADER) + sizeof(NX_IPV4_HEADER)));
+    host_put_ulong(header_ptr + 4, 0);
+    host_put_ulong(header_ptr + 8, (0x80UL << NX_IP_TIME_TO_LIVE_SHIFT) | NX_IP_UDP);
+    host_put_ulong(header_ptr + 12, source_ip);
+    host_put_ulong(header_ptr + 16, destination_ip);
+    sum = host_checksum_fold(host_checksum_add(0, header_ptr, sizeof(NX_IPV4_HEADER), &odd));
+    header_ptr[10] = (UCHAR)(~sum >> 8);
+    header_ptr[11] = (UCHAR)~sum;
+    host_put_ulong(header_ptr + 20, ((ULONG)source_port << NX_SHIFT_BY_16) | socket_ptr->nx_udp_socket_port);
+    host_put_ulong(header_ptr + 24, (length + sizeof(NX_UDP_HEADER)) << NX_SHIFT_BY_16);
+    packet_ptr->nx_packet_ip_header = header_ptr;
+    packet_ptr->nx_packet_ip_header_length = sizeof(NX_IPV4_HEADER);
+    packet_ptr->nx_packet_ip_version = NX_IP_VERSION_V4;
+    packet_ptr->nx_packet_ip_interface = &ip_ptr->nx_ip_interface[interface_index];
+
+    pthread_mutex_lock(&host_lock);
+    if (socket_ptr->host_udp_receive_count >= socket_ptr->nx_udp_socket_queue_maximum)
+    {
+        socket_ptr->nx_udp_socket_packets_queue_dropped++;
+        pthread_mutex_unlock(&host_lock);
+        nx_packet_release(packet_ptr);
+        return NX_SUCCESS;
+    }
+    if (socket_ptr->host_udp_receive_tail)
+    {
+        socket_ptr->host_udp_receive_tail->nx_packet_queue_next = packet_ptr;
+    }
+    else
+    {
+        socket_ptr->host_udp_receive_head = packet_ptr;
+    }
+    socket_ptr->host_udp_receive_tail = packet_ptr;
+    socket_ptr->host_udp_receive_count++;
+    socket_ptr->nx_udp_socket_packets_received++;
+    ip_ptr->nx_ip_udp_packets_received++;
+    host_wake(socket_ptr->nx_udp_socket_receive_suspended_count);
+    pthread_mutex_unlock(&host_lock);
+
+    if (socket_ptr->nx_udp_receive_callback)
+    {
+        socket_ptr->nx_udp_receive_callback(socket_ptr);
+    }
+    return NX_SUCCESS;
+}
+
+VOID host_network_driver(NX_IP_DRIVER *driver_req_ptr)
+{
+    NX_IP *ip_ptr = driver_req_ptr->nx_ip_driver_ptr;
+    HOST_NETWORK_PEER *peer_ptr = ip_ptr->host_network_peer;
+    NX_PACKET *packet_ptr = driver_req_ptr->nx_ip_driver_packet;
+    UCHAR *buffer;
+    ULONG length;
+    ULONG header_length;
+    ULONG udp_length;
+    ULONG sum;
+    UINT odd = NX_FALSE;
+
+    driver_req_ptr->nx_ip_driver_status = NX_SUCCESS;
+    if ((driver_req_ptr->nx_ip_driver_command != NX_LINK_PACKET_SEND) &&
+        (driver_req_ptr->nx_ip_driver_command != NX_LINK_PACKET_BROADCAST))
+    {
+        return;
+    }
+
+    buffer = malloc(packet_ptr->nx_packet_length + 1);
+    nx_packet_data_retrieve(packet_ptr, buffer, &length);
+    nx_packet_release(packet_ptr);
+
+    header_length = (ULONG)(buffer[0] & 0x0F) * 4;
+    if ((length < header_length + sizeof(NX_UDP_HEADER)) || ((buffer[0] >> 4) != NX_IP_VERSION_V4) ||
+        (((ULONG)buffer[2] << 8 | buffer[3]) != length) ||
+        (host_checksum_fold(host_checksum_add(0, buffer, header_length, &odd)) != NX_LOWER_16_MASK))
+    {
+        fprintf(stderr, "host port: bad IPv4 header from the stack\n");
+        abort();
+    }
+    if (buffer[9] != NX_PROTOCOL_UDP)
+    {
+        free(buffer);
+        return;
+    }
+
+    // A UDP checksum of zero is not computed; any other covers the pseudo header
+    udp_length = (ULONG)buffer[header_length + 4] << 8 | buffer[header_length + 5];
+    sum = (ULONG)buffer[12] << 8 | buffer[13];
+    sum += (ULONG)buffer[14] << 8 | buffer[15];
+    sum += (ULONG)buffer[16] << 8 | buffer[17];
+    sum += (ULONG)buffer[18] << 8 | buffer[19];
+    sum += NX_PROTOCOL_UDP + udp_length;
+    odd = NX_FALSE;
+    if ((udp_length != length - header_length) ||
+        ((buffer[header_length + 6] | buffer[header_length + 7]) &&
+         (host_checksum_fold(host_checksum_add(sum, buffer + header_length, udp_length, &odd)) != NX_LOWER_16_MASK)))
+    {
+        fprintf(stderr, "host port: bad UDP header from the stack\n");
+        abort();
+    }
+
+    if (peer_ptr && peer_ptr->host_network_peer_udp)
+    {
+        peer_ptr->host_network_peer_udp(peer_ptr, ip_ptr, driver_req_ptr->nx_ip_driver_interface->nx_interface_index,
+                                        host_get_ulong(buffer + 12),
+                                        (UINT)((ULONG)buffer[header_length] << 8 | buffer[header_length + 1]),
+                                        host_get_ulong(buffer + 16),
+                                        (UINT)((ULONG)buffer[header_length + 2] << 8 | buffer[header_length + 3]),
+                                        buffer + header_length + sizeof(NX_UDP_HEADER),
+                                        udp_length - sizeof(NX_UDP_HEADER));
+    }
+    free(buffer);
+}
+
+// ARP probes
+
+UINT _nx_arp_probe_send(NX_IP *ip_ptr, UINT interface_index, ULONG probe_address)
+{
+    HOST_NETWORK_PEER *peer_ptr = ip_ptr->host_network_peer;
+
+    if (peer_ptr && peer_ptr->host_network_peer_arp_probe)
+    {
+        peer_ptr->host_network_peer_arp_probe(peer_ptr, ip_ptr, interface_index, probe_address);
+    }
+    return NX_SUCCESS;
+}
+
+VOID host_arp_conflict(NX_IP *ip_ptr, UINT interface_index, ULONG ip_address, ULONG physical_msw, ULONG physical_lsw)
+{
+    VOID (*handler)(NX_IP *, UINT, ULONG, ULONG, ULONG);
+
+    handler = ip_ptr->nx_ip_interface[interface_index].nx_interface_ip_conflict_notify_handler;
+    if (handler)
+    {
+        handler(ip_ptr, interface_index, ip_address, physical_msw, physical_lsw);
+    }
+}
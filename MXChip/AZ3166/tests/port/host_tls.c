@@ -0,0 +1,294 @@
+// Host port of the NetX Secure TLS session API. See nx_secure_tls_api.h.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nx_secure_tls_api.h"
+
+#define HOST_TLS_ID  0x544C5320
+
+// Handshake steps of a client session
+#define HOST_TLS_IDLE                   0
+#define HOST_TLS_WAIT_SERVER_HELLO      1
+#define HOST_TLS_WAIT_CERTIFICATE       2
+#define HOST_TLS_WAIT_FINISHED          3
+#define HOST_TLS_ESTABLISHED            4
+
+static const NX_SECURE_TLS_CIPHERSUITE_INFO host_tls_ciphersuite = { 0xC02F };
+
+ULONG host_tls_record_encode(UCHAR *buffer, UCHAR content_type, UCHAR message_type, const UCHAR *body, ULONG length)
+{
+    UCHAR description = message_type;
+
+    if (content_type == HOST_TLS_CONTENT_ALERT)
+    {
+        // Fatal, with the message type as the description
+        body = &description;
+        message_type = 2;
+        length = 1;
+    }
+    buffer[0] = content_type;
+    buffer[1] = 3;
+    buffer[2] = 3;
+    buffer[3] = (UCHAR)((length + 1) >> 8);
+    buffer[4] = (UCHAR)(length + 1);
+    buffer[5] = message_type;
+    memcpy(buffer + 6, body, length);
+    return 6 + length;
+}
+
+VOID host_tls_verify_data(const UCHAR *master_secret, UCHAR sender, UCHAR *verify_data)
+{
+    UINT i;
+
+    memset(verify_data, sender, HOST_TLS_VERIFY_DATA_SIZE);
+    for (i = 0; i < NX_SECURE_TLS_MASTER_SIZE; i++)
+    {
+        verify_data[i % HOST_TLS_VERIFY_DATA_SIZE] ^= (UCHAR)(master_secret[i] + i);
+    }
+}
+
+static UINT host_tls_send(NX_SECURE_TLS_SESSION *session_ptr, const UCHAR *data, ULONG length)
+{
+    NX_PACKET *packet_ptr;
+    UINT status;
+
+    if (nx_packet_allocate(&host_network_pool, &packet_ptr, NX_IPv4_TCP_PACKET, NX_NO_WAIT) ||
+        nx_packet_data_append(packet_ptr, (VOID *)data, length, &host_network_pool, NX_NO_WAIT))
+    {
+        fprintf(stderr, "host tls: network pool exhausted\n");
+        abort();
+    }
+    status = nx_tcp_socket_send(session_ptr->nx_secure_tls_tcp_socket, packet_ptr, NX_NO_WAIT);
+    if (status)
+    {
+        nx_packet_release(packet_ptr);
+    }
+    return status;
+}
+
+// Act on one record from the server, returning NX_CONTINUE until the handshake completes
+static UINT host_tls_record_process(NX_SECURE_TLS_SESSION *session_ptr, const UCHAR *record, ULONG length)
+{
+    UCHAR verify_data[HOST_TLS_VERIFY_DATA_SIZE];
+    UCHAR flight[2 * (6 + NX_SECURE_TLS_MASTER_SIZE)];
+    const UCHAR *body = record + 6;
+    ULONG body_length = length - 6;
+    ULONG flight_length;
+    UINT i;
+
+    if (record[0] == HOST_TLS_CONTENT_ALERT)
+    {
+        return NX_SECURE_TLS_ALERT_RECEIVED;
+    }
+    if ((record[0] != HOST_TLS_CONTENT_HANDSHAKE) || (length < 6))
+    {
+        return NX_SECURE_TLS_HANDSHAKE_FAILURE;
+    }
+
+    switch (session_ptr->host_tls_state)
+    {
+    case HOST_TLS_WAIT_SERVER_HELLO:
+        if ((record[5] != HOST_TLS_SERVER_HELLO) || (body_length < 1) || (body[0] > NX_SECURE_TLS_SESSION_ID_SIZE) ||
+            (body_length != 1u + body[0] + 2u))
+        {
+            return NX_SECURE_TLS_HANDSHAKE_FAILURE;
+        }
+
+        // The server starts a session of its own
+        session_ptr->nx_secure_tls_session_id_length = body[0];
+        memcpy(session_ptr->nx_secure_tls_session_id, body + 1, body[0]);
+        session_ptr->nx_secure_tls_session_ciphersuite = &host_tls_ciphersuite;
+        session_ptr->host_tls_state = HOST_TLS_WAIT_CERTIFICATE;
+        return NX_CONTINUE;
+
+    case HOST_TLS_WAIT_CERTIFICATE:
+        if (record[5] != HOST_TLS_CERTIFICATE)
+        {
+            return NX_SECURE_TLS_HANDSHAKE_FAILURE;
+        }
+        for (i = 0; i < NX_SECURE_TLS_MASTER_SIZE; i++)
+        {
+            session_ptr->nx_secure_tls_key_material.nx_secure_tls_master_secret[i] = (UCHAR)rand();
+        }
+        host_tls_verify_data(session_ptr->nx_secure_tls_key_material.nx_secure_tls_master_secret, 'c', verify_data);
+        flight_length = host_tls_record_encode(flight, HOST_TLS_CONTENT_HANDSHAKE, HOST_TLS_CLIENT_KEY_EXCHANGE,
+                                               session_ptr->nx_secure_tls_key_material.nx_secure_tls_master_secret,
+                                               NX_SECURE_TLS_MASTER_SIZE);
+        flight_length += host_tls_record_encode(flight + flight_length, HOST_TLS_CONTENT_HANDSHAKE, HOST_TLS_FINISHED,
+                                                verify_data, sizeof(verify_data));
+        session_ptr->host_tls_state = HOST_TLS_WAIT_FINISHED;
+        return host_tls_send(session_ptr, flight, flight_length) ? NX_SECURE_TLS_HANDSHAKE_FAILURE : NX_CONTINUE;
+
+    case HOST_TLS_WAIT_FINISHED:
+        host_tls_verify_data(session_ptr->nx_secure_tls_key_material.nx_secure_tls_master_secret, 's', verify_data);
+        if ((record[5] != HOST_TLS_FINISHED) || (body_length != sizeof(verify_data)) ||
+            memcmp(body, verify_data, sizeof(verify_data)))
+        {
+            return NX_SECURE_TLS_HANDSHAKE_FAILURE;
+        }
+        session_ptr->host_tls_state = HOST_TLS_ESTABLISHED;
+        session_ptr->nx_secure_tls_local_session_active = NX_TRUE;
+        session_ptr->nx_secure_tls_remote_session_active = NX_TRUE;
+        return NX_SUCCESS;
+
+    default:
+        return NX_SECURE_TLS_HANDSHAKE_FAILURE;
+    }
+}
+
+// Take the server's records off the socket and act on them until the handshake completes
+static UINT host_tls_handshake(NX_SECURE_TLS_SESSION *session_ptr, UINT wait_option)
+{
+    NX_PACKET *packet_ptr;
+    ULONG record_length;
+    ULONG length;
+    UINT status;
+
+    for (;;)
+    {
+        while ((session_ptr->host_tls_buffer_length >= NX_SECURE_TLS_RECORD_HEADER_SIZE) &&
+               (session_ptr->host_tls_buffer_length >=
+                (record_length = NX_SECURE_TLS_RECORD_HEADER_SIZE +
+                                 (ULONG)((session_ptr->host_tls_buffer[3] << 8) | session_ptr->host_tls_buffer[4]))))
+        {
+            status = host_tls_record_process(session_ptr, session_ptr->host_tls_buffer, record_length);
+            session_ptr->host_tls_buffer_length -= record_length;
+            memmove(session_ptr->host_tls_buffer, session_ptr->host_tls_buffer + record_length,
+                    session_ptr->host_tls_buffer_length);
+            if (status == NX_SUCCESS)
+            {
+                if (session_ptr->host_tls_buffer_length)
+                {
+                    fprintf(stderr, "host tls: data behind the server Finished\n");
+                    abort();
+                }
+                return NX_SUCCESS;
+            }
+            if (status != NX_CONTINUE)
+            {
+                session_ptr->host_tls_state = HOST_TLS_IDLE;
+                return status;
+            }
+        }
+
+        status = nx_tcp_socket_receive(session_ptr->nx_secure_tls_tcp_socket, &packet_ptr, wait_option);
+        if (status == NX_NO_PACKET)
+        {
+            return (wait_option == NX_NO_WAIT) ? NX_CONTINUE : NX_SECURE_TLS_HANDSHAKE_FAILURE;
+        }
+        if (status)
+        {
+            session_ptr->host_tls_state = HOST_TLS_IDLE;
+            return status;
+        }
+        if (session_ptr->host_tls_buffer_length + packet_ptr->nx_packet_length > sizeof(session_ptr->host_tls_buffer))
+        {
+            fprintf(stderr, "host tls: handshake buffer full\n");
+            abort();
+        }
+        nx_packet_data_retrieve(packet_ptr, session_ptr->host_tls_buffer + session_ptr->host_tls_buffer_length, &length);
+        session_ptr->host_tls_buffer_length += length;
+        nx_packet_release(packet_ptr);
+    }
+}
+
+UINT nx_secure_tls_session_create(NX_SECURE_TLS_SESSION *session_ptr)
+{
+    memset(session_ptr, 0, sizeof(NX_SECURE_TLS_SESSION));
+    session_ptr->nx_secure_tls_id = HOST_TLS_ID;
+    return NX_SUCCESS;
+}
+
+// Send the ClientHello. As in NetX Secure, the client does not resume sessions: it offers no session ID.
+UINT nx_secure_tls_session_start(NX_SECURE_TLS_SESSION *session_ptr, NX_TCP_SOCKET *tcp_socket, UINT wait_option)
+{
+    UCHAR hello[1] = { 0 };
+    UCHAR record[6 + sizeof(hello)];
+
+    if (session_ptr->nx_secure_tls_id != HOST_TLS_ID)
+    {
+        return NX_SECURE_TLS_SESSION_UNINITIALIZED;
+    }
+    if (host_network_pool.nx_packet_pool_id == 0)
+    {
+        host_network_init(1536, 256);
+    }
+    session_ptr->nx_secure_tls_tcp_socket = tcp_socket;
+    session_ptr->host_tls_buffer_length = 0;
+    session_ptr->host_tls_state = HOST_TLS_WAIT_SERVER_HELLO;
+
+    if (host_tls_send(session_ptr, record,
+                      host_tls_record_encode(record, HOST_TLS_CONTENT_HANDSHAKE, HOST_TLS_CLIENT_HELLO, hello, sizeof(hello))))
+    {
+        session_ptr->host_tls_state = HOST_TLS_IDLE;
+        return NX_NOT_CONNECTED;
+    }
+
+    // Without waiting, the rest of the handshake is done by _nx_secure_tls_handshake_process
+    if (wait_option == NX_NO_WAIT)
+    {
+        return NX_CONTINUE;
+    }
+    return host_tls_handshake(session_ptr, wait_option);
+}
+
+UINT _nx_secure_tls_handshake_process(NX_SECURE_TLS_SESSION *session_ptr, UINT wait_option)
+{
+    if (session_ptr->host_tls_state == HOST_TLS_ESTABLISHED)
+    {
+        return NX_SUCCESS;
+    }
+    if (session_ptr->host_tls_state == HOST_TLS_IDLE)
+    {
+        return NX_SECURE_TLS_SESSION_UNINITIALIZED;
+    }
+    return host_tls_handshake(session_ptr, wait_option);
+}
+
+UINT nx_secure_tls_session_end(NX_SECURE_TLS_SESSION *session_ptr, UINT wait_option)
+{
+    (void)wait_option;
+    session_ptr->host_tls_state = HOST_TLS_IDLE;
+    session_ptr->nx_secure_tls_local_session_active = NX_FALSE;
+    session_ptr->nx_secure_tls_remote_session_active = NX_FALSE;
+    return NX_SUCCESS;
+}
+
+UINT nx_secure_tls_session_delete(NX_SECURE_TLS_SESSION *session_ptr)
+{
+    session_ptr->nx_secure_tls_id = 0;
+    return NX_SUCCESS;
+}
+
+// As in NetX Secure, a reset forgets the session ID and keys along with the connection
+UINT nx_secure_tls_session_reset(NX_SECURE_TLS_SESSION *session_ptr)
+{
+    session_ptr->nx_secure_tls_tcp_socket = NX_NULL;
+    session_ptr->nx_secure_tls_local_session_active = NX_FALSE;
+    session_ptr->nx_secure_tls_remote_session_active = NX_FALSE;
+    session_ptr->nx_secure_tls_session_id_length = 0;
+    memset(&session_ptr->nx_secure_tls_key_material, 0, sizeof(NX_SECURE_TLS_KEY_MATERIAL));
+    session_ptr->nx_secure_tls_session_ciphersuite = NX_NULL;
+    session_ptr->host_tls_state = HOST_TLS_IDLE;
+    session_ptr->host_tls_buffer_length = 0;
+    return NX_SUCCESS;
+}
+
+UINT nx_secure_tls_session_send(NX_SECURE_TLS_SESSION *session_ptr, NX_PACKET *packet_ptr, ULONG wait_option)
+{
+    return nx_tcp_socket_send(session_ptr->nx_secure_tls_tcp_socket, packet_ptr, wait_option);
+}
+
+UINT nx_secure_tls_session_receive(NX_SECURE_TLS_SESSION *session_ptr, NX_PACKET **packet_ptr_ptr, ULONG wait_option)
+{
+    return nx_tcp_socket_receive(session_ptr->nx_secure_tls_tcp_socket, packet_ptr_ptr, wait_option);
+}
+
+UINT nx_secure_tls_packet_allocate(NX_SECURE_TLS_SESSION *session_ptr, NX_PACKET_POOL *pool_ptr,
+                                   NX_PACKET **packet_ptr, ULONG wait_option)
+{
+    (void)session_ptr;
+    return nx_packet_allocate(pool_ptr, packet_ptr, NX_IPv4_TCP_PACKET + NX_SECURE_TLS_RECORD_HEADER_SIZE, wait_option);
+}
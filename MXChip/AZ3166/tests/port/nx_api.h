@@ -0,0 +1,415 @@
+// Host port of the NetX Duo API used by the application.
+//
+// Packets come from real pools, with chaining, header room and the available
+// count kept as NetX keeps them, and a double release aborts the test. A TCP
+// socket has no network behind it: what the application sends is handed to
+// the socket's peer, a stand-in written by the test, which answers through
+// host_tcp_deliver. UDP datagrams and ARP probes go the same way to the
+// network peer of the IP instance, which answers through host_udp_deliver
+// and host_arp_conflict.
+
+#ifndef NX_API_H
+#define NX_API_H
+
+#include <stdlib.h>
+
+#include "tx_api.h"
+
+#ifdef NX_INCLUDE_USER_DEFINE_FILE
+#include "nx_user.h"
+#endif
+
+#define NX_SUCCESS                0x00
+#define NX_NO_PACKET              0x01
+#define NX_UNDERFLOW              0x02
+#define NX_OVERFLOW               0x03
+#define NX_NO_MAPPING             0x04
+#define NX_DELETED                0x05
+#define NX_POOL_ERROR             0x06
+#define NX_PTR_ERROR              0x07
+#define NX_WAIT_ERROR             0x08
+#define NX_SIZE_ERROR             0x09
+#define NX_OPTION_ERROR           0x0A
+#define NX_DELETE_ERROR           0x10
+#define NX_CALLER_ERROR           0x11
+#define NX_INVALID_PACKET         0x12
+#define NX_INVALID_SOCKET         0x13
+#define NX_NOT_ENABLED            0x14
+#define NX_ALREADY_ENABLED        0x15
+#define NX_ENTRY_NOT_FOUND        0x16
+#define NX_NO_MORE_ENTRIES        0x17
+#define NX_IP_ADDRESS_ERROR       0x21
+#define NX_NOT_BOUND              0x24
+#define NX_STILL_BOUND            0x42
+#define NX_NOT_CONNECTED          0x38
+#define NX_IN_PROGRESS            0x37
+#define NX_NOT_CLOSED             0x35
+#define NX_ALREADY_BOUND          0x22
+#define NX_WINDOW_OVERFLOW        0x39
+#define NX_INVALID_PORT           0x46
+#define NX_TX_QUEUE_DEPTH         0x49
+#define NX_NOT_SUCCESSFUL         0x43
+#define NX_INVALID_PARAMETERS     0x4D
+#define NX_NOT_FOUND              0x4E
+#define NX_NOT_SUPPORTED          0x4B
+#define NX_INVALID_INTERFACE      0x4C
+#define NX_DUPLICATED_ENTRY       0x52
+#define NX_PACKET_OFFSET_ERROR    0x53
+#define NX_CONTINUE               0x55
+
+#define NX_NULL                   0
+#define NX_TRUE                   1
+#define NX_FALSE                  0
+#define NX_NO_WAIT                0
+#define NX_WAIT_FOREVER           ((ULONG)0xFFFFFFFF)
+#define NX_IP_PERIODIC_RATE       100
+#define NX_IP_ID                  0x49502020
+#define NX_IP_NORMAL              0x00000000
+#define NX_DONT_FRAGMENT          0x00004000
+#define NX_ANY_PORT               0
+#define NX_IP_VERSION_V4          0x4
+#define NX_IP_VERSION_V6          0x6
+#define NX_PARAMETER_NOT_USED(p)  ((void)(p))
+
+// A failed assertion aborts the test, instead of spinning as on the target
+#define NX_ASSERT(s)              if (!(s)) { abort(); }
+
+#ifndef NX_MAX_PHYSICAL_INTERFACES
+#define NX_MAX_PHYSICAL_INTERFACES 1
+#endif
+
+// Driver commands
+#define NX_LINK_PACKET_SEND       0
+#define NX_LINK_INITIALIZE        1
+#define NX_LINK_ENABLE            2
+#define NX_LINK_DISABLE           3
+#define NX_LINK_PACKET_BROADCAST  4
+
+// IPv4 and UDP headers, as the stack builds them
+#define NX_IP_VERSION             0x45000000UL
+#define NX_IP_UDP                 0x00110000UL
+#define NX_PROTOCOL_UDP           17
+#define NX_IP_TIME_TO_LIVE_SHIFT  24
+#define NX_IP_PACKET_IN           0
+#define NX_IP_PACKET_OUT          1
+#define NX_SHIFT_BY_16            16
+#define NX_LOWER_16_MASK          0x0000FFFFUL
+#define NX_IP_CLASS_A_MASK        0x80000000UL
+#define NX_IP_CLASS_A_TYPE        0x00000000UL
+#define NX_IP_CLASS_B_MASK        0xC0000000UL
+#define NX_IP_CLASS_B_TYPE        0x80000000UL
+#define NX_IP_CLASS_C_MASK        0xE0000000UL
+#define NX_IP_CLASS_C_TYPE        0xC0000000UL
+
+// The host is little endian, as the Cortex-M target
+#define NX_LITTLE_ENDIAN          1
+#define NX_CHANGE_ULONG_ENDIAN(a) (a) = (((a) >> 24) & 0xFFUL) | (((a) >> 8) & 0xFF00UL) | \
+                                        (((a) << 8) & 0xFF0000UL) | (((a) << 24) & 0xFF000000UL)
+
+// Kernel object extensions are not used; the owner is the callback input
+#define NX_THREAD_EXTENSION_PTR_SET(a, b)
+#define NX_THREAD_EXTENSION_PTR_GET(a, b, c)  { a = (b *)(c); }
+#define NX_TIMER_EXTENSION_PTR_SET(a, b)
+#define NX_TIMER_EXTENSION_PTR_GET(a, b, c)   { a = (b *)(c); }
+
+// Services may be called from any context on the host
+#define NX_CALLER_CHECKING_EXTERNS
+#define NX_THREADS_ONLY_CALLER_CHECKING
+#define NX_INIT_AND_THREADS_CALLER_CHECKING
+
+#ifndef NX_PHYSICAL_HEADER
+#define NX_PHYSICAL_HEADER        16
+#endif
+
+#define NX_RECEIVE_PACKET         0
+#define NX_PHYSICAL_PACKET        (NX_PHYSICAL_HEADER)
+#define NX_IPv4_PACKET            (NX_PHYSICAL_PACKET + 20)
+#define NX_IPv6_PACKET            (NX_PHYSICAL_PACKET + 40)
+#define NX_IPv4_TCP_PACKET        (NX_IPv4_PACKET + 20)
+#define NX_IPv6_TCP_PACKET        (NX_IPv6_PACKET + 20)
+#define NX_IPv4_UDP_PACKET        (NX_IPv4_PACKET + 8)
+#define NX_IPv6_UDP_PACKET        (NX_IPv6_PACKET + 8)
+#define NX_TCP_PACKET             NX_IPv4_TCP_PACKET
+#define NX_UDP_PACKET             NX_IPv4_UDP_PACKET
+
+#define IP_ADDRESS(a, b, c, d)    ((((ULONG)(a)) << 24) | (((ULONG)(b)) << 16) | (((ULONG)(c)) << 8) | ((ULONG)(d)))
+
+typedef struct NX_PACKET_POOL_STRUCT NX_PACKET_POOL;
+typedef struct NX_INTERFACE_STRUCT NX_INTERFACE;
+
+typedef struct NX_PACKET_STRUCT
+{
+    NX_PACKET_POOL *nx_packet_pool_owner;
+    struct NX_PACKET_STRUCT *nx_packet_queue_next;
+    struct NX_PACKET_STRUCT *nx_packet_next;
+    struct NX_PACKET_STRUCT *nx_packet_last;
+    UCHAR *nx_packet_data_start;
+    UCHAR *nx_packet_data_end;
+    UCHAR *nx_packet_prepend_ptr;
+    UCHAR *nx_packet_append_ptr;
+    ULONG nx_packet_length;
+    NX_INTERFACE *nx_packet_ip_interface;
+    UCHAR *nx_packet_ip_header;
+    ULONG nx_packet_ip_header_length;
+    UCHAR nx_packet_ip_version;
+    UINT nx_packet_allocated;
+    struct NX_PACKET_STRUCT *nx_packet_free_next;
+} NX_PACKET;
+
+struct NX_PACKET_POOL_STRUCT
+{
+    ULONG nx_packet_pool_id;
+    CHAR *nx_packet_pool_name;
+    ULONG nx_packet_pool_available;
+    ULONG nx_packet_pool_total;
+    ULONG nx_packet_pool_empty_requests;
+    ULONG nx_packet_pool_payload_size;
+    NX_PACKET *nx_packet_pool_available_list;
+    UINT nx_packet_pool_suspended_count;
+};
+
+typedef struct NXD_ADDRESS_STRUCT
+{
+    ULONG nxd_ip_version;
+    union
+    {
+        ULONG v4;
+        ULONG v6[4];
+    } nxd_ip_address;
+} NXD_ADDRESS;
+
+typedef struct NX_IP_STRUCT NX_IP;
+
+// The words of the headers are 32 bits, as on the target
+typedef struct NX_IPV4_HEADER_STRUCT
+{
+    UINT nx_ip_header_word_0;
+    UINT nx_ip_header_word_1;
+    UINT nx_ip_header_word_2;
+    UINT nx_ip_header_source_ip;
+    UINT nx_ip_header_destination_ip;
+} NX_IPV4_HEADER;
+
+typedef struct NX_UDP_HEADER_STRUCT
+{
+    UINT nx_udp_header_word_0;
+    UINT nx_udp_header_word_1;
+} NX_UDP_HEADER;
+
+typedef struct NX_IP_DRIVER_STRUCT
+{
+    UINT nx_ip_driver_command;
+    UINT nx_ip_driver_status;
+    ULONG nx_ip_driver_physical_address_msw;
+    ULONG nx_ip_driver_physical_address_lsw;
+    NX_PACKET *nx_ip_driver_packet;
+    NX_IP *nx_ip_driver_ptr;
+    NX_INTERFACE *nx_ip_driver_interface;
+} NX_IP_DRIVER;
+
+struct NX_INTERFACE_STRUCT
+{
+    CHAR *nx_interface_name;
+    UCHAR nx_interface_valid;
+    UCHAR nx_interface_link_up;
+    UCHAR nx_interface_index;
+    NX_IP *nx_interface_ip_instance;
+    ULONG nx_interface_physical_address_msw;
+    ULONG nx_interface_physical_address_lsw;
+    ULONG nx_interface_ip_address;
+    ULONG nx_interface_ip_network_mask;
+    ULONG nx_interface_ip_network;
+    ULONG nx_interface_ip_mtu_size;
+    VOID (*nx_interface_link_driver_entry)(NX_IP_DRIVER *driver_req_ptr);
+    VOID (*nx_interface_ip_conflict_notify_handler)(NX_IP *ip_ptr, UINT interface_index, ULONG ip_address,
+                                                    ULONG physical_msw, ULONG physical_lsw);
+};
+
+typedef struct NX_UDP_SOCKET_STRUCT NX_UDP_SOCKET;
+
+// The network behind an IP instance, for UDP
+typedef struct HOST_NETWORK_PEER_STRUCT
+{
+    // A datagram the application sent, through a socket or its link driver
+    VOID (*host_network_peer_udp)(struct HOST_NETWORK_PEER_STRUCT *peer_ptr, NX_IP *ip_ptr, UINT interface_index,
+                                  ULONG source_ip, UINT source_port, ULONG destination_ip, UINT destination_port,
+                                  const UCHAR *data, ULONG length);
+
+    // An ARP probe for an address the application is about to use
+    VOID (*host_network_peer_arp_probe)(struct HOST_NETWORK_PEER_STRUCT *peer_ptr, NX_IP *ip_ptr,
+                                        UINT interface_index, ULONG ip_address);
+} HOST_NETWORK_PEER;
+
+struct NX_IP_STRUCT
+{
+    ULONG nx_ip_id;
+    CHAR *nx_ip_name;
+    NX_PACKET_POOL *nx_ip_default_packet_pool;
+    TX_MUTEX nx_ip_protection;
+    NX_INTERFACE nx_ip_interface[NX_MAX_PHYSICAL_INTERFACES];
+    ULONG nx_ip_gateway_address;
+    ULONG nx_ip_packet_id;
+    ULONG nx_ip_total_packets_sent;
+    ULONG nx_ip_total_bytes_sent;
+    ULONG nx_ip_send_packets_dropped;
+    ULONG nx_ip_udp_packets_sent;
+    ULONG nx_ip_udp_bytes_sent;
+    ULONG nx_ip_udp_packets_received;
+    VOID (*nx_ip_fragment_processing)(NX_IP_DRIVER *driver_req_ptr);
+    UINT (*nx_ip_packet_filter)(VOID *ip_header_ptr, UINT direction);
+    UINT (*nx_ip_packet_filter_extended)(NX_IP *ip_ptr, NX_PACKET *packet_ptr, UINT direction);
+
+    // Host port state
+    HOST_NETWORK_PEER *host_network_peer;
+};
+
+struct NX_UDP_SOCKET_STRUCT
+{
+    ULONG nx_udp_socket_id;
+    CHAR *nx_udp_socket_name;
+    NX_IP *nx_udp_socket_ip_ptr;
+    UINT nx_udp_socket_port;
+    ULONG nx_udp_socket_type_of_service;
+    UINT nx_udp_socket_time_to_live;
+    ULONG nx_udp_socket_fragment_enable;
+    ULONG nx_udp_socket_queue_maximum;
+    ULONG nx_udp_socket_packets_sent;
+    ULONG nx_udp_socket_bytes_sent;
+    ULONG nx_udp_socket_packets_received;
+    ULONG nx_udp_socket_packets_queue_dropped;
+    VOID *nx_udp_socket_reserved_ptr;
+    VOID (*nx_udp_receive_callback)(NX_UDP_SOCKET *socket_ptr);
+
+    // Host port state
+    UINT host_udp_bound;
+    ULONG host_udp_receive_count;
+    NX_PACKET *host_udp_receive_head;
+    NX_PACKET *host_udp_receive_tail;
+    UINT nx_udp_socket_receive_suspended_count;
+};
+
+typedef struct NX_TCP_SOCKET_STRUCT NX_TCP_SOCKET;
+
+// The far end of a host TCP connection
+typedef struct HOST_TCP_PEER_STRUCT
+{
+    // Accept or refuse a connection; NX_SUCCESS accepts
+    UINT (*host_tcp_peer_connect)(struct HOST_TCP_PEER_STRUCT *peer_ptr, NX_TCP_SOCKET *socket_ptr);
+
+    // Bytes the application sent, one call per nx_tcp_socket_send
+    VOID (*host_tcp_peer_receive)(struct HOST_TCP_PEER_STRUCT *peer_ptr, NX_TCP_SOCKET *socket_ptr,
+                                  const UCHAR *data, ULONG length);
+
+    // The application closed the connection
+    VOID (*host_tcp_peer_disconnect)(struct HOST_TCP_PEER_STRUCT *peer_ptr, NX_TCP_SOCKET *socket_ptr);
+} HOST_TCP_PEER;
+
+struct NX_TCP_SOCKET_STRUCT
+{
+    ULONG nx_tcp_socket_id;
+    CHAR *nx_tcp_socket_name;
+    NX_IP *nx_tcp_socket_ip_ptr;
+    NXD_ADDRESS nx_tcp_socket_connect_ip;
+    UINT nx_tcp_socket_connect_port;
+    ULONG nx_tcp_socket_connect_mss;
+    VOID *nx_tcp_socket_reserved_ptr;
+    VOID (*nx_tcp_receive_callback)(NX_TCP_SOCKET *socket_ptr);
+    VOID (*nx_tcp_establish_notify)(NX_TCP_SOCKET *socket_ptr);
+    VOID (*nx_tcp_disconnect_callback)(NX_TCP_SOCKET *socket_ptr);
+
+    // Host port state
+    HOST_TCP_PEER *host_tcp_peer;
+    UINT host_tcp_bound;
+    UINT host_tcp_connected;
+    NX_PACKET *host_tcp_receive_head;
+    NX_PACKET *host_tcp_receive_tail;
+    UINT nx_tcp_socket_receive_suspended_count;
+    ULONG host_tcp_segments_sent;
+    ULONG host_tcp_bytes_sent;
+};
+
+UINT nx_packet_pool_create(NX_PACKET_POOL *pool_ptr, CHAR *name_ptr, ULONG payload_size,
+                           VOID *pool_start, ULONG pool_size);
+UINT nx_packet_pool_delete(NX_PACKET_POOL *pool_ptr);
+UINT nx_packet_allocate(NX_PACKET_POOL *pool_ptr, NX_PACKET **packet_ptr, ULONG packet_type, ULONG wait_option);
+UINT nx_packet_release(NX_PACKET *packet_ptr);
+UINT nx_packet_copy(NX_PACKET *packet_ptr, NX_PACKET **new_packet_ptr, NX_PACKET_POOL *pool_ptr, ULONG wait_option);
+UINT nx_packet_data_append(NX_PACKET *packet_ptr, VOID *data_start, ULONG data_size,
+                           NX_PACKET_POOL *pool_ptr, ULONG wait_option);
+UINT nx_packet_data_retrieve(NX_PACKET *packet_ptr, VOID *buffer_start, ULONG *bytes_copied);
+UINT nx_packet_data_extract_offset(NX_PACKET *packet_ptr, ULONG offset, VOID *buffer_start,
+                                   ULONG buffer_length, ULONG *bytes_copied);
+UINT nx_packet_length_get(NX_PACKET *packet_ptr, ULONG *length);
+
+UINT nx_ip_create(NX_IP *ip_ptr, CHAR *name, ULONG ip_address, ULONG network_mask, NX_PACKET_POOL *default_pool,
+                  VOID (*ip_link_driver)(NX_IP_DRIVER *driver_req_ptr), VOID *memory_ptr, ULONG memory_size,
+                  UINT priority);
+UINT nx_ip_delete(NX_IP *ip_ptr);
+UINT nx_ip_interface_address_get(NX_IP *ip_ptr, UINT interface_index, ULONG *ip_address, ULONG *network_mask);
+UINT nx_ip_interface_address_set(NX_IP *ip_ptr, UINT interface_index, ULONG ip_address, ULONG network_mask);
+UINT nx_ip_gateway_address_get(NX_IP *ip_ptr, ULONG *ip_address);
+UINT nx_ip_gateway_address_set(NX_IP *ip_ptr, ULONG ip_address);
+UINT nx_ip_gateway_address_clear(NX_IP *ip_ptr);
+
+UINT nx_udp_socket_create(NX_IP *ip_ptr, NX_UDP_SOCKET *socket_ptr, CHAR *name, ULONG type_of_service,
+                          ULONG fragment, UINT time_to_live, ULONG queue_maximum);
+UINT nx_udp_socket_delete(NX_UDP_SOCKET *socket_ptr);
+UINT nx_udp_socket_bind(NX_UDP_SOCKET *socket_ptr, UINT port, ULONG wait_option);
+UINT nx_udp_socket_unbind(NX_UDP_SOCKET *socket_ptr);
+UINT nx_udp_socket_interface_send(NX_UDP_SOCKET *socket_ptr, NX_PACKET *packet_ptr, ULONG ip_address, UINT port,
+                                  UINT interface_index);
+UINT nxd_udp_socket_send(NX_UDP_SOCKET *socket_ptr, NX_PACKET *packet_ptr, NXD_ADDRESS *ip_address, UINT port);
+UINT nx_udp_socket_receive(NX_UDP_SOCKET *socket_ptr, NX_PACKET **packet_ptr, ULONG wait_option);
+UINT nx_udp_socket_receive_notify(NX_UDP_SOCKET *socket_ptr, VOID (*udp_receive_notify)(NX_UDP_SOCKET *socket_ptr));
+UINT nx_udp_packet_info_extract(NX_PACKET *packet_ptr, ULONG *ip_address, UINT *protocol, UINT *port,
+                                UINT *interface_index);
+
+UINT _nx_utility_string_length_check(CHAR *input_string, UINT *string_length, UINT max_string_length);
+
+UINT nx_tcp_socket_create(NX_IP *ip_ptr, NX_TCP_SOCKET *socket_ptr, CHAR *name,
+                          ULONG type_of_service, ULONG fragment, UINT time_to_live, ULONG window_size,
+                          VOID (*tcp_urgent_data_callback)(NX_TCP_SOCKET *socket_ptr),
+                          VOID (*tcp_disconnect_callback)(NX_TCP_SOCKET *socket_ptr));
+UINT nx_tcp_socket_delete(NX_TCP_SOCKET *socket_ptr);
+UINT nx_tcp_client_socket_bind(NX_TCP_SOCKET *socket_ptr, UINT port, ULONG wait_option);
+UINT nx_tcp_client_socket_unbind(NX_TCP_SOCKET *socket_ptr);
+UINT nxd_tcp_client_socket_connect(NX_TCP_SOCKET *socket_ptr, NXD_ADDRESS *server_ip, UINT server_port,
+                                   ULONG wait_option);
+UINT nx_tcp_socket_disconnect(NX_TCP_SOCKET *socket_ptr, ULONG wait_option);
+UINT nx_tcp_socket_send(NX_TCP_SOCKET *socket_ptr, NX_PACKET *packet_ptr, ULONG wait_option);
+UINT nx_tcp_socket_receive(NX_TCP_SOCKET *socket_ptr, NX_PACKET **packet_ptr, ULONG wait_option);
+UINT nx_tcp_socket_receive_notify(NX_TCP_SOCKET *socket_ptr, VOID (*tcp_receive_notify)(NX_TCP_SOCKET *socket_ptr));
+UINT nx_tcp_socket_establish_notify(NX_TCP_SOCKET *socket_ptr, VOID (*tcp_establish_notify)(NX_TCP_SOCKET *socket_ptr));
+
+// Host port controls
+
+// Create the pool host_tcp_deliver allocates from, as the driver's receive pool
+VOID host_network_init(ULONG payload_size, UINT packet_count);
+extern NX_PACKET_POOL host_network_pool;
+
+// Queue data from the peer on the socket, split into segments of at most segment_size
+// bytes (0 for one segment), and call the receive notify
+UINT host_tcp_deliver(NX_TCP_SOCKET *socket_ptr, const VOID *data, ULONG length, ULONG segment_size);
+
+// The peer closes the connection
+VOID host_tcp_close(NX_TCP_SOCKET *socket_ptr);
+
+// A link driver handing the UDP datagrams it is given to the network peer of the IP
+// instance, for the stack's own sends below the socket layer. The IPv4 and UDP
+// checksums are checked; a bad one aborts the test.
+VOID host_network_driver(NX_IP_DRIVER *driver_req_ptr);
+
+// Queue a datagram from the network on a bound UDP socket, as received on an interface,
+// and call the receive notify. A full queue drops it, as NetX does.
+UINT host_udp_deliver(NX_UDP_SOCKET *socket_ptr, UINT interface_index, ULONG source_ip, UINT source_port,
+                      ULONG destination_ip, const VOID *data, ULONG length);
+
+// A host on the network answers an ARP probe for an address: the conflict handler of
+// the interface, if one is set, is called
+VOID host_arp_conflict(NX_IP *ip_ptr, UINT interface_index, ULONG ip_address, ULONG physical_msw, ULONG physical_lsw);
+
+// Create and release a packet pool backed by heap memory
+UINT host_packet_pool_create(NX_PACKET_POOL *pool_ptr, CHAR *name_ptr, ULONG payload_size, UINT packet_count);
+VOID host_packet_pool_delete(NX_PACKET_POOL *pool_ptr);
+
+#endif // NX_API_H
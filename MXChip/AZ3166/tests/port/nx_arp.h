@@ -0,0 +1,10 @@
+// Host port: ARP probes go to the network peer of the IP instance. See nx_api.h.
+
+#ifndef NX_ARP_H
+#define NX_ARP_H
+
+#include "nx_api.h"
+
+UINT _nx_arp_probe_send(NX_IP *ip_ptr, UINT interface_index, ULONG probe_address);
+
+#endif // NX_ARP_H
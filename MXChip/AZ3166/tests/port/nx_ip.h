@@ -0,0 +1,15 @@
+// Host port: the IP internals are not modelled; nx_api.h carries what the application reads,
+// and this the IP services the stack's own modules call.
+
+#ifndef NX_IP_H
+#define NX_IP_H
+
+#include "nx_api.h"
+
+// The ones' complement sum of the data, folded to 16 bits and not inverted. For
+// NX_PROTOCOL_UDP the pseudo header of the addresses is included; for
+// NX_IP_VERSION_V4 the data is the IPv4 header.
+ULONG _nx_ip_checksum_compute(NX_PACKET *packet_ptr, ULONG protocol, UINT data_length, ULONG *src_ip_addr,
+                              ULONG *dest_ip_addr);
+
+#endif // NX_IP_H
@@ -0,0 +1,8 @@
+// Host port: the IPv4 services are in nx_api.h, under the names the application uses.
+
+#ifndef NX_IPV4_H
+#define NX_IPV4_H
+
+#include "nx_api.h"
+
+#endif // NX_IPV4_H
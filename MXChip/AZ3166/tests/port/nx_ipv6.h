@@ -0,0 +1,8 @@
+// Host port: IPv6 is not modelled; the DNS client includes this for its NXD_ADDRESS forms.
+
+#ifndef NX_IPV6_H
+#define NX_IPV6_H
+
+#include "nx_api.h"
+
+#endif // NX_IPV6_H
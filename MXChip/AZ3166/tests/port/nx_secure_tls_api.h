@@ -0,0 +1,96 @@
+// Host port of the NetX Secure TLS session API.
+//
+// No cryptography is done. A session runs a stand-in TLS 1.2 handshake over
+// the TCP socket, in records of the real layout, so the peer of a test can
+// time it; once it completes, records pass through the socket unchanged, so
+// the peer sees the application protocol.
+
+#ifndef NX_SECURE_TLS_API_H
+#define NX_SECURE_TLS_API_H
+
+#include "nx_api.h"
+
+#define NX_SECURE_TLS_SUCCESS                0x00
+#define NX_SECURE_TLS_HANDSHAKE_FAILURE      0x10F
+#define NX_SECURE_TLS_ALERT_RECEIVED         0x114
+#define NX_SECURE_TLS_SESSION_UNINITIALIZED  0x101
+
+#define NX_SECURE_TLS_RECORD_HEADER_SIZE     5
+#define NX_SECURE_TLS_SESSION_ID_SIZE        32
+#define NX_SECURE_TLS_MASTER_SIZE            48
+
+typedef struct NX_SECURE_X509_CERT_STRUCT
+{
+    UCHAR *nx_secure_x509_certificate_raw_data;
+    UINT nx_secure_x509_certificate_raw_data_length;
+} NX_SECURE_X509_CERT;
+
+typedef struct NX_SECURE_TLS_CIPHERSUITE_INFO_STRUCT
+{
+    USHORT nx_secure_tls_ciphersuite;
+} NX_SECURE_TLS_CIPHERSUITE_INFO;
+
+typedef struct NX_SECURE_TLS_KEY_MATERIAL_STRUCT
+{
+    UCHAR nx_secure_tls_master_secret[NX_SECURE_TLS_MASTER_SIZE];
+} NX_SECURE_TLS_KEY_MATERIAL;
+
+typedef struct NX_SECURE_TLS_SESSION_STRUCT
+{
+    ULONG nx_secure_tls_id;
+    NX_TCP_SOCKET *nx_secure_tls_tcp_socket;
+    UINT nx_secure_tls_local_session_active;
+    UINT nx_secure_tls_remote_session_active;
+
+    // The session ID the server gave
+    UCHAR nx_secure_tls_session_id[NX_SECURE_TLS_SESSION_ID_SIZE];
+    UCHAR nx_secure_tls_session_id_length;
+    NX_SECURE_TLS_KEY_MATERIAL nx_secure_tls_key_material;
+    const NX_SECURE_TLS_CIPHERSUITE_INFO *nx_secure_tls_session_ciphersuite;
+
+    // Host port state: the handshake step, and records not yet processed
+    UINT host_tls_state;
+    UCHAR host_tls_buffer[256];
+    ULONG host_tls_buffer_length;
+} NX_SECURE_TLS_SESSION;
+
+UINT nx_secure_tls_session_create(NX_SECURE_TLS_SESSION *session_ptr);
+UINT nx_secure_tls_session_start(NX_SECURE_TLS_SESSION *session_ptr, NX_TCP_SOCKET *tcp_socket, UINT wait_option);
+UINT nx_secure_tls_session_end(NX_SECURE_TLS_SESSION *session_ptr, UINT wait_option);
+UINT nx_secure_tls_session_delete(NX_SECURE_TLS_SESSION *session_ptr);
+UINT nx_secure_tls_session_reset(NX_SECURE_TLS_SESSION *session_ptr);
+UINT nx_secure_tls_session_send(NX_SECURE_TLS_SESSION *session_ptr, NX_PACKET *packet_ptr, ULONG wait_option);
+UINT nx_secure_tls_session_receive(NX_SECURE_TLS_SESSION *session_ptr, NX_PACKET **packet_ptr_ptr, ULONG wait_option);
+UINT nx_secure_tls_packet_allocate(NX_SECURE_TLS_SESSION *session_ptr, NX_PACKET_POOL *pool_ptr,
+                                   NX_PACKET **packet_ptr, ULONG wait_option);
+UINT _nx_secure_tls_handshake_process(NX_SECURE_TLS_SESSION *session_ptr, UINT wait_option);
+
+// Host port handshake, shared with the server stand-in of a test.
+//
+// Each handshake message is a record of its own. As with the NetX Secure
+// client, every handshake is full:
+//   ClientHello -> ServerHello (new session ID), Certificate
+//   ClientKeyExchange, Finished -> Finished
+// ClientHello and ServerHello carry a session ID, led by its length, empty
+// in the ClientHello; ServerHello then the cipher suite. Certificate stands for everything up
+// to ServerHelloDone and is empty. ClientKeyExchange carries the master
+// secret in the clear. Finished carries host_tls_verify_data.
+
+#define HOST_TLS_CONTENT_ALERT               21
+#define HOST_TLS_CONTENT_HANDSHAKE           22
+
+#define HOST_TLS_CLIENT_HELLO                1
+#define HOST_TLS_SERVER_HELLO                2
+#define HOST_TLS_CERTIFICATE                 11
+#define HOST_TLS_CLIENT_KEY_EXCHANGE         16
+#define HOST_TLS_FINISHED                    20
+
+#define HOST_TLS_VERIFY_DATA_SIZE            12
+
+// Encode a record holding one handshake message, or an alert of two bytes, returning its length
+ULONG host_tls_record_encode(UCHAR *buffer, UCHAR content_type, UCHAR message_type, const UCHAR *body, ULONG length);
+
+// The Finished verify data of the client ('c') or server ('s') for a master secret
+VOID host_tls_verify_data(const UCHAR *master_secret, UCHAR sender, UCHAR *verify_data);
+
+#endif // NX_SECURE_TLS_API_H
@@ -0,0 +1,8 @@
+// Host port: the NetX system internals are not modelled.
+
+#ifndef NX_SYSTEM_H
+#define NX_SYSTEM_H
+
+#include "nx_api.h"
+
+#endif // NX_SYSTEM_H
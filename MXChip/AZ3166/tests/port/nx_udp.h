@@ -0,0 +1,10 @@
+// Host port: the UDP services are in nx_api.h, under the names the application uses.
+
+#ifndef NX_UDP_H
+#define NX_UDP_H
+
+#include "nx_api.h"
+
+#define _nx_udp_socket_receive    nx_udp_socket_receive
+
+#endif // NX_UDP_H
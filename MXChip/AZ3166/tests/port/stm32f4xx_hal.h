@@ -0,0 +1,59 @@
+// Host port of the STM32F4 HAL flash services used by the application.
+//
+// The lease sector is a RAM array, host_flash_sector, which the test links
+// in as _slease to _elease. As on the part, programming can only clear bits,
+// an erase sets the whole sector to 0xFF, and both need the flash unlocked.
+// The test counts the words programmed and the erases.
+
+#ifndef STM32F4XX_HAL_H
+#define STM32F4XX_HAL_H
+
+#include <stdint.h>
+
+#include "tx_api.h"
+
+typedef enum
+{
+    HAL_OK = 0x00U,
+    HAL_ERROR = 0x01U,
+    HAL_BUSY = 0x02U,
+    HAL_TIMEOUT = 0x03U
+} HAL_StatusTypeDef;
+
+typedef struct
+{
+    uint32_t TypeErase;
+    uint32_t Banks;
+    uint32_t Sector;
+    uint32_t NbSectors;
+    uint32_t VoltageRange;
+} FLASH_EraseInitTypeDef;
+
+#define FLASH_TYPEPROGRAM_WORD     0x00000002U
+#define FLASH_TYPEERASE_SECTORS    0x00000000U
+#define FLASH_VOLTAGE_RANGE_3      0x00000002U
+#define FLASH_SECTOR_11            11U
+
+#define __HAL_FLASH_DATA_CACHE_DISABLE()
+#define __HAL_FLASH_DATA_CACHE_RESET()
+#define __HAL_FLASH_DATA_CACHE_ENABLE()
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void);
+HAL_StatusTypeDef HAL_FLASH_Lock(void);
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data);
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *SectorError);
+
+// Host port controls
+
+// The sector; the test target is linked without PIE, so its address fits the HAL's 32 bits
+#define HOST_FLASH_SECTOR_SIZE     512
+extern uint32_t host_flash_sector[HOST_FLASH_SECTOR_SIZE / sizeof(uint32_t)];
+
+// Words programmed and sector erases since the last reset
+extern UINT host_flash_programs;
+extern UINT host_flash_erases;
+
+// Erase the sector and clear the counts
+VOID host_flash_reset(VOID);
+
+#endif // STM32F4XX_HAL_H
@@ -0,0 +1,190 @@
+// Host port of the ThreadX API used by the application, so that its modules
+// can be built and tested on the development machine.
+//
+// Threads are POSIX threads. They start only when the test sets
+// host_thread_start_enable; otherwise tx_thread_create records the entry and
+// the test drives the work itself. Time is simulated: tx_time_get returns a
+// tick count that only host_time_advance moves, and timers expire from there.
+
+#ifndef TX_API_H
+#define TX_API_H
+
+#include <pthread.h>
+#include <string.h>
+
+typedef void VOID;
+typedef char CHAR;
+typedef unsigned char UCHAR;
+typedef int INT;
+typedef unsigned int UINT;
+typedef long LONG;
+typedef unsigned long ULONG;
+typedef short SHORT;
+typedef unsigned short USHORT;
+typedef unsigned long long ULONG64;
+#define ALIGN_TYPE ULONG
+
+#define TX_SUCCESS                0x00
+#define TX_DELETED                0x01
+#define TX_NO_EVENTS              0x07
+#define TX_QUEUE_EMPTY            0x0A
+#define TX_QUEUE_FULL             0x0B
+#define TX_NO_INSTANCE            0x0D
+#define TX_THREAD_ERROR           0x0E
+#define TX_WAIT_ABORTED           0x1A
+#define TX_NOT_AVAILABLE          0x1D
+#define TX_NOT_OWNED              0x1E
+#define TX_RESUME_ERROR           0x12
+#define TX_SUSPEND_LIFTED         0x19
+#define TX_CEILING_EXCEEDED       0x21
+
+#define TX_TRUE                   1
+#define TX_FALSE                  0
+#define TX_NULL                   ((void *)0)
+#define TX_NO_WAIT                0
+#define TX_WAIT_FOREVER           0xFFFFFFFFUL
+#define TX_AND                    2
+#define TX_AND_CLEAR              3
+#define TX_OR                     0
+#define TX_OR_CLEAR               1
+#define TX_NO_INHERIT             0
+#define TX_INHERIT                1
+#define TX_AUTO_START             1
+#define TX_DONT_START             0
+#define TX_AUTO_ACTIVATE          1
+#define TX_NO_ACTIVATE            0
+#define TX_NO_TIME_SLICE          0
+#define TX_1_ULONG                1
+#define TX_2_ULONG                2
+#define TX_4_ULONG                4
+#define TX_TIMER_TICKS_PER_SECOND 100
+
+// Interrupt lockouts take the host port lock, which also guards every object below
+#define TX_INTERRUPT_SAVE_AREA
+#define TX_DISABLE                host_interrupt_disable();
+#define TX_RESTORE                host_interrupt_restore();
+
+typedef struct TX_THREAD_STRUCT
+{
+    CHAR *tx_thread_name;
+    VOID (*tx_thread_entry)(ULONG);
+    ULONG tx_thread_entry_parameter;
+    UINT tx_thread_priority;
+    UINT tx_thread_started;
+    pthread_t tx_thread_host;
+} TX_THREAD;
+
+typedef struct TX_MUTEX_STRUCT
+{
+    CHAR *tx_mutex_name;
+    pthread_mutex_t tx_mutex_host;
+} TX_MUTEX;
+
+typedef struct TX_SEMAPHORE_STRUCT
+{
+    CHAR *tx_semaphore_name;
+    ULONG tx_semaphore_count;
+    UINT tx_semaphore_suspended_count;
+} TX_SEMAPHORE;
+
+typedef struct TX_EVENT_FLAGS_GROUP_STRUCT
+{
+    ULONG tx_event_flags_group_id;
+    CHAR *tx_event_flags_group_name;
+    ULONG tx_event_flags_group_current;
+    UINT tx_event_flags_group_suspended_count;
+} TX_EVENT_FLAGS_GROUP;
+
+typedef struct TX_QUEUE_STRUCT
+{
+    CHAR *tx_queue_name;
+    UINT tx_queue_message_size;
+    ULONG *tx_queue_start;
+    ULONG tx_queue_capacity;
+    ULONG tx_queue_enqueued;
+    ULONG tx_queue_read;
+    UINT tx_queue_suspended_count;
+} TX_QUEUE;
+
+typedef struct TX_TIMER_STRUCT
+{
+    ULONG tx_timer_id;
+    CHAR *tx_timer_name;
+    VOID (*tx_timer_expiration_function)(ULONG);
+    ULONG tx_timer_expiration_input;
+    ULONG tx_timer_expires;
+    ULONG tx_timer_initial_ticks;
+    ULONG tx_timer_reschedule_ticks;
+    UINT tx_timer_active;
+    struct TX_TIMER_STRUCT *tx_timer_next;
+} TX_TIMER;
+
+UINT tx_thread_create(TX_THREAD *thread_ptr, CHAR *name_ptr, VOID (*entry_function)(ULONG), ULONG entry_input,
+                      VOID *stack_start, ULONG stack_size, UINT priority, UINT preempt_threshold,
+                      ULONG time_slice, UINT auto_start);
+UINT tx_thread_delete(TX_THREAD *thread_ptr);
+UINT tx_thread_resume(TX_THREAD *thread_ptr);
+UINT tx_thread_suspend(TX_THREAD *thread_ptr);
+UINT tx_thread_terminate(TX_THREAD *thread_ptr);
+UINT tx_thread_sleep(ULONG timer_ticks);
+VOID tx_thread_relinquish(VOID);
+TX_THREAD *tx_thread_identify(VOID);
+UINT tx_thread_priority_change(TX_THREAD *thread_ptr, UINT new_priority, UINT *old_priority);
+UINT tx_thread_info_get(TX_THREAD *thread_ptr, CHAR **name, UINT *state, ULONG *run_count,
+                        UINT *priority, UINT *preemption_threshold, ULONG *time_slice,
+                        TX_THREAD **next_thread, TX_THREAD **next_suspended_thread);
+
+UINT tx_mutex_create(TX_MUTEX *mutex_ptr, CHAR *name_ptr, UINT inherit);
+UINT tx_mutex_delete(TX_MUTEX *mutex_ptr);
+UINT tx_mutex_get(TX_MUTEX *mutex_ptr, ULONG wait_option);
+UINT tx_mutex_put(TX_MUTEX *mutex_ptr);
+
+UINT tx_semaphore_create(TX_SEMAPHORE *semaphore_ptr, CHAR *name_ptr, ULONG initial_count);
+UINT tx_semaphore_delete(TX_SEMAPHORE *semaphore_ptr);
+UINT tx_semaphore_get(TX_SEMAPHORE *semaphore_ptr, ULONG wait_option);
+UINT tx_semaphore_put(TX_SEMAPHORE *semaphore_ptr);
+UINT tx_semaphore_ceiling_put(TX_SEMAPHORE *semaphore_ptr, ULONG ceiling);
+
+UINT tx_event_flags_create(TX_EVENT_FLAGS_GROUP *group_ptr, CHAR *name_ptr);
+UINT tx_event_flags_delete(TX_EVENT_FLAGS_GROUP *group_ptr);
+UINT tx_event_flags_get(TX_EVENT_FLAGS_GROUP *group_ptr, ULONG requested_flags, UINT get_option,
+                        ULONG *actual_flags_ptr, ULONG wait_option);
+UINT tx_event_flags_set(TX_EVENT_FLAGS_GROUP *group_ptr, ULONG flags_to_set, UINT set_option);
+
+UINT tx_queue_create(TX_QUEUE *queue_ptr, CHAR *name_ptr, UINT message_size, VOID *queue_start, ULONG queue_size);
+UINT tx_queue_delete(TX_QUEUE *queue_ptr);
+UINT tx_queue_send(TX_QUEUE *queue_ptr, VOID *source_ptr, ULONG wait_option);
+UINT tx_queue_receive(TX_QUEUE *queue_ptr, VOID *destination_ptr, ULONG wait_option);
+
+UINT tx_timer_create(TX_TIMER *timer_ptr, CHAR *name_ptr, VOID (*expiration_function)(ULONG),
+                     ULONG expiration_input, ULONG initial_ticks, ULONG reschedule_ticks, UINT auto_activate);
+UINT tx_timer_delete(TX_TIMER *timer_ptr);
+UINT tx_timer_activate(TX_TIMER *timer_ptr);
+UINT tx_timer_deactivate(TX_TIMER *timer_ptr);
+UINT tx_timer_change(TX_TIMER *timer_ptr, ULONG initial_ticks, ULONG reschedule_ticks);
+
+ULONG tx_time_get(VOID);
+VOID tx_time_set(ULONG new_time);
+
+// Host port controls
+extern UINT host_thread_start_enable;
+
+// Called while threads are not started by tx_thread_sleep, and by an event flags
+// wait before it gives up, so a caller polling or waiting for work of another
+// thread can have the test do that work
+extern VOID (*host_idle_hook)(VOID);
+
+VOID host_interrupt_disable(VOID);
+VOID host_interrupt_restore(VOID);
+VOID host_time_advance(ULONG ticks);
+ULONG64 host_clock_ns(VOID);
+
+// A core cycle counter on the simulated clock, 32 bits wide as the Cortex-M DWT
+// one. host_cycles_advance runs the core for a number of cycles at
+// host_core_clock_hz, moving the tick count on as whole ticks pass.
+extern ULONG host_core_clock_hz;
+VOID host_cycles_reset(VOID);
+UINT host_cycles_get(VOID);
+VOID host_cycles_advance(ULONG64 cycles);
+
+#endif // TX_API_H
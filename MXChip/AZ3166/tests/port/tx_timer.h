@@ -0,0 +1,8 @@
+// Host port: the ThreadX timer internals are not modelled. See tx_api.h.
+
+#ifndef TX_TIMER_H
+#define TX_TIMER_H
+
+#include "tx_api.h"
+
+#endif // TX_TIMER_H
@@ -0,0 +1,43 @@
+// Assertions shared by the host tests. A test binary runs its cases in order
+// and exits non-zero if any assertion failed.
+
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+
+static int test_failures;
+
+#define TEST_ASSERT(condition)                                                     \
+    do                                                                             \
+    {                                                                              \
+        if (!(condition))                                                          \
+        {                                                                          \
+            printf("%s:%d: FAILED: %s\n", __FILE__, __LINE__, #condition);         \
+            test_failures++;                                                       \
+        }                                                                          \
+    } while (0)
+
+#define TEST_ASSERT_EQUAL(expected, actual)                                        \
+    do                                                                             \
+    {                                                                              \
+        unsigned long test_expected = (unsigned long)(expected);                   \
+        unsigned long test_actual = (unsigned long)(actual);                       \
+        if (test_expected != test_actual)                                          \
+        {                                                                          \
+            printf("%s:%d: FAILED: %s is %lu, expected %lu\n", __FILE__, __LINE__, \
+                   #actual, test_actual, test_expected);                           \
+            test_failures++;                                                       \
+        }                                                                          \
+    } while (0)
+
+#define TEST_RUN(test)              \
+    do                              \
+    {                               \
+        printf("-- %s\n", #test);   \
+        test();                     \
+    } while (0)
+
+#define TEST_RESULT() (test_failures ? (printf("%d failure(s)\n", test_failures), 1) : 0)
+
+#endif // TEST_H
@@ -0,0 +1,167 @@
+// Boot pipeline: each phase is an event flag set once it completes, and a
+// phase waits only for the flags it depends on, so MQTT to a broker without
+// TLS connects once it has an address, SNTP or not. The first run of each
+// phase is timed from its start, later runs are not, and the phase table is
+// printed once every phase is done. Runs without threads: the other phases
+// complete in the idle hook while a wait would block.
+
+#include <string.h>
+#include <unistd.h>
+
+#define BOOT_TRACE_HOST
+#include "boot.c"
+#include "mqtt_client.h"
+#include "test.h"
+
+#define BOOT_SECOND TX_TIMER_TICKS_PER_SECOND
+
+static CHAR boot_output[1024];
+
+// Phases the idle hook completes, in order, one tick apart, as the network thread would
+static ULONG boot_idle_phases[BOOT_PHASE_COUNT];
+static UINT boot_idle_count;
+
+static VOID boot_idle(VOID)
+{
+    UINT i;
+
+    for (i = 0; i < boot_idle_count; i++)
+    {
+        host_time_advance(1);
+        boot_phase_done(boot_idle_phases[i]);
+    }
+    boot_idle_count = 0;
+}
+
+// Start over from a fresh boot at tick 0
+static VOID boot_setup(VOID)
+{
+    tx_time_set(0);
+    memset(boot_phase_started, 0, sizeof(boot_phase_started));
+    TEST_ASSERT_EQUAL(TX_SUCCESS, boot_init());
+    boot_idle_count = 0;
+    host_idle_hook = boot_idle;
+}
+
+// Mark a phase done, capturing what it printed
+static VOID boot_done_capture(ULONG phase)
+{
+    FILE *file = tmpfile();
+    size_t length;
+    int saved;
+
+    fflush(stdout);
+    saved = dup(STDOUT_FILENO);
+    dup2(fileno(file), STDOUT_FILENO);
+    boot_phase_done(phase);
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+
+    rewind(file);
+    length = fread(boot_output, 1, sizeof(boot_output) - 1, file);
+    boot_output[length] = '\0';
+    fclose(file);
+}
+
+// MQTT waits for an address (and a DNS server for a broker by name), but not for SNTP or the peripherals
+static VOID test_mqtt_dependencies(VOID)
+{
+    boot_setup();
+    TEST_ASSERT_EQUAL(0, MQTT_BOOT_PHASES & (BOOT_TIME | BOOT_PERIPHERALS));
+    TEST_ASSERT(MQTT_BOOT_PHASES & BOOT_IP);
+    TEST_ASSERT_EQUAL(TX_NO_EVENTS, boot_phase_wait(MQTT_BOOT_PHASES, TX_NO_WAIT));
+
+    // The network thread joins and gets an address while MQTT waits
+    boot_idle_phases[boot_idle_count++] = BOOT_WIFI;
+    boot_idle_phases[boot_idle_count++] = BOOT_IP;
+    boot_idle_phases[boot_idle_count++] = BOOT_DNS;
+    TEST_ASSERT_EQUAL(TX_SUCCESS, boot_phase_wait(MQTT_BOOT_PHASES, TX_WAIT_FOREVER));
+    TEST_ASSERT(!boot_phase_is_done(BOOT_TIME));
+    TEST_ASSERT(!boot_phase_is_done(BOOT_PERIPHERALS));
+
+    // SNTP, in turn, waits for the DNS server, and the main thread for the peripherals alone
+    TEST_ASSERT_EQUAL(TX_SUCCESS, boot_phase_wait(BOOT_DNS, TX_NO_WAIT));
+    TEST_ASSERT_EQUAL(TX_NO_EVENTS, boot_phase_wait(BOOT_PERIPHERALS, TX_NO_WAIT));
+    boot_idle_phases[boot_idle_count++] = BOOT_PERIPHERALS;
+    TEST_ASSERT_EQUAL(TX_SUCCESS, boot_phase_wait(BOOT_PERIPHERALS, 10));
+    TEST_ASSERT(!boot_phase_is_done(BOOT_TIME));
+}
+
+// Each phase is timed from its first start to its completion; a phase run again, as a Wi-Fi rejoin
+// does, keeps its first times, and a phase never started takes no time
+static VOID test_phase_timing(VOID)
+{
+    UINT wifi = boot_phase_index(BOOT_WIFI);
+    UINT ip = boot_phase_index(BOOT_IP);
+
+    boot_setup();
+    host_time_advance(BOOT_SECOND);
+    boot_phase_start(BOOT_WIFI);
+    host_time_advance(BOOT_SECOND * 3 / 2);
+    boot_done_capture(BOOT_WIFI);
+    TEST_ASSERT_EQUAL(BOOT_SECOND, boot_phase_start_ticks[wifi]);
+    TEST_ASSERT_EQUAL(BOOT_SECOND * 5 / 2, boot_phase_done_ticks[wifi]);
+    TEST_ASSERT(strstr(boot_output, "BOOT: wifi done in 1500 ms, at 2500 ms") != NULL);
+
+    // The rejoin after a drop is not timed
+    host_time_advance(BOOT_SECOND);
+    boot_phase_start(BOOT_WIFI);
+    boot_done_capture(BOOT_WIFI);
+    TEST_ASSERT_EQUAL(0, strlen(boot_output));
+    TEST_ASSERT_EQUAL(BOOT_SECOND, boot_phase_start_ticks[wifi]);
+    TEST_ASSERT_EQUAL(BOOT_SECOND * 5 / 2, boot_phase_done_ticks[wifi]);
+
+    // A second start of a phase still running keeps the first
+    boot_phase_start(BOOT_IP);
+    host_time_advance(BOOT_SECOND / 2);
+    boot_phase_start(BOOT_IP);
+    host_time_advance(BOOT_SECOND / 2);
+    boot_done_capture(BOOT_IP);
+    TEST_ASSERT(strstr(boot_output, "BOOT: ip done in 1000 ms, at 4500 ms") != NULL);
+    TEST_ASSERT_EQUAL(boot_phase_done_ticks[ip] - BOOT_SECOND, boot_phase_start_ticks[ip]);
+
+    boot_done_capture(BOOT_PERIPHERALS);
+    TEST_ASSERT(strstr(boot_output, "BOOT: peripherals done in 0 ms, at 4500 ms") != NULL);
+}
+
+// The phase table is printed once the last phase is done, with the start, end and duration of each
+static VOID test_report(VOID)
+{
+    boot_setup();
+    boot_phase_start(BOOT_PERIPHERALS);
+    boot_phase_start(BOOT_WIFI);
+    host_time_advance(BOOT_SECOND);
+    boot_done_capture(BOOT_WIFI);
+    host_time_advance(BOOT_SECOND);
+    boot_phase_start(BOOT_IP);
+    boot_done_capture(BOOT_PERIPHERALS);
+    host_time_advance(BOOT_SECOND);
+    boot_done_capture(BOOT_IP);
+    boot_phase_start(BOOT_DNS);
+    boot_done_capture(BOOT_DNS);
+    boot_phase_start(BOOT_MQTT);
+    boot_phase_start(BOOT_TIME);
+    host_time_advance(BOOT_SECOND);
+    boot_done_capture(BOOT_MQTT);
+    TEST_ASSERT(strstr(boot_output, "BOOT: phase") == NULL);
+
+    host_time_advance(BOOT_SECOND);
+    boot_done_capture(BOOT_TIME);
+    TEST_ASSERT(strstr(boot_output, "BOOT: time done in 2000 ms, at 5000 ms") != NULL);
+    TEST_ASSERT(strstr(boot_output, "BOOT: phase        start      end duration") != NULL);
+    TEST_ASSERT(strstr(boot_output, "      peripherals      0     2000     2000") != NULL);
+    TEST_ASSERT(strstr(boot_output, "      wifi             0     1000     1000") != NULL);
+    TEST_ASSERT(strstr(boot_output, "      ip            2000     3000     1000") != NULL);
+    TEST_ASSERT(strstr(boot_output, "      dns           3000     3000        0") != NULL);
+    TEST_ASSERT(strstr(boot_output, "      time          3000     5000     2000") != NULL);
+    TEST_ASSERT(strstr(boot_output, "      mqtt          3000     4000     1000") != NULL);
+}
+
+int main(void)
+{
+    TEST_RUN(test_mqtt_dependencies);
+    TEST_RUN(test_phase_timing);
+    TEST_RUN(test_report);
+    return TEST_RESULT();
+}
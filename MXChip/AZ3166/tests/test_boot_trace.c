@@ -0,0 +1,148 @@
+// Boot trace: milestones on the cycle counter, converted at the core clock
+// each interval ran at, with the kernel ticks telling how often the 32-bit
+// counter wrapped. Runs on the simulated cycle counter of the host port.
+
+#include <string.h>
+
+#define BOOT_TRACE_HOST
+#include "boot.c"
+#include "test.h"
+
+#define BOOT_HSI_HZ 16000000
+#define BOOT_PLL_HZ 96000000
+
+static CHAR boot_json[512];
+
+// Start a trace at reset, on the internal oscillator
+static VOID boot_setup(ULONG clock_hz)
+{
+    tx_time_set(0);
+    host_core_clock_hz = clock_hz;
+    boot_trace_init();
+}
+
+// Run the core for a number of microseconds at its current clock
+static VOID boot_run_us(ULONG64 us)
+{
+    host_cycles_advance(us * (host_core_clock_hz / 1000000));
+}
+
+static VOID boot_expect_json(const CHAR *expected)
+{
+    TEST_ASSERT_EQUAL(strlen(expected), boot_trace_json(boot_json, sizeof(boot_json)));
+    if (strcmp(expected, boot_json))
+    {
+        printf("%s:%d: FAILED: trace is %s, expected %s\n", __FILE__, __LINE__, boot_json, expected);
+        test_failures++;
+    }
+}
+
+// board_init: the PLL takes over at the end of SystemClock_Config, just before the "clock" milestone
+static VOID test_milestones(VOID)
+{
+    boot_setup(BOOT_HSI_HZ);
+    boot_run_us(1000);
+    TEST_ASSERT(boot_trace("hal"));
+    boot_run_us(2000);
+    host_core_clock_hz = BOOT_PLL_HZ;
+    TEST_ASSERT(boot_trace("clock"));
+    boot_run_us(100);
+    TEST_ASSERT(boot_trace("console"));
+
+    // Only the first time a milestone is reached counts
+    boot_run_us(500);
+    TEST_ASSERT(!boot_trace("hal"));
+    TEST_ASSERT_EQUAL(4, boot_trace_count);
+
+    boot_expect_json("{\"reset\":0,\"hal\":1000,\"clock\":3000,\"console\":3100}");
+    boot_trace_dump();
+}
+
+// At 96 MHz the counter wraps every 44.7 s; Wi-Fi and DHCP can take longer than that
+static VOID test_wrap(VOID)
+{
+    boot_setup(BOOT_PLL_HZ);
+    boot_run_us(60000000);
+    TEST_ASSERT(boot_trace("wifi_joined"));
+    boot_run_us(100000000);
+    TEST_ASSERT(boot_trace("dhcp_bound"));
+    boot_run_us(1500);
+    TEST_ASSERT(boot_trace("dns_ready"));
+
+    boot_expect_json("{\"reset\":0,\"wifi_joined\":60000000,\"dhcp_bound\":160000000,\"dns_ready\":160001500}");
+}
+
+// The log is fixed; milestones past its size are dropped
+static VOID test_full(VOID)
+{
+    static CHAR names[BOOT_TRACE_SIZE][8];
+    UINT i;
+
+    boot_setup(BOOT_PLL_HZ);
+    for (i = 1; i < BOOT_TRACE_SIZE; i++)
+    {
+        snprintf(names[i], sizeof(names[i]), "m%u", i);
+        boot_run_us(10);
+        TEST_ASSERT(boot_trace(names[i]));
+    }
+    TEST_ASSERT(!boot_trace("puback"));
+    TEST_ASSERT_EQUAL(BOOT_TRACE_SIZE, boot_trace_count);
+}
+
+// The JSON is written whole or not at all
+static VOID test_json_size(VOID)
+{
+    const CHAR *expected = "{\"reset\":0,\"hal\":250}";
+    UINT length = (UINT)strlen(expected);
+
+    boot_setup(BOOT_HSI_HZ);
+    boot_run_us(250);
+    boot_trace("hal");
+    TEST_ASSERT_EQUAL(length, boot_trace_json(boot_json, length + 1));
+    TEST_ASSERT_EQUAL(0, strcmp(expected, boot_json));
+    TEST_ASSERT_EQUAL(0, boot_trace_json(boot_json, length));
+    TEST_ASSERT_EQUAL(0, boot_trace_json(boot_json, 8));
+}
+
+// Phases are timed in ticks, on their first run only
+static VOID test_phases(VOID)
+{
+    tx_time_set(0);
+    TEST_ASSERT_EQUAL(TX_SUCCESS, boot_init());
+
+    host_time_advance(10);
+    boot_phase_start(BOOT_WIFI);
+    host_time_advance(250);
+    boot_phase_done(BOOT_WIFI);
+    TEST_ASSERT_EQUAL(10, boot_phase_start_ticks[boot_phase_index(BOOT_WIFI)]);
+    TEST_ASSERT_EQUAL(260, boot_phase_done_ticks[boot_phase_index(BOOT_WIFI)]);
+    TEST_ASSERT_EQUAL(TX_SUCCESS, boot_phase_wait(BOOT_WIFI, TX_NO_WAIT));
+    TEST_ASSERT(boot_phase_wait(BOOT_WIFI | BOOT_IP, TX_NO_WAIT) != TX_SUCCESS);
+
+    // A rejoin after a Wi-Fi drop does not move the times
+    host_time_advance(1000);
+    boot_phase_start(BOOT_WIFI);
+    boot_phase_done(BOOT_WIFI);
+    TEST_ASSERT_EQUAL(10, boot_phase_start_ticks[boot_phase_index(BOOT_WIFI)]);
+    TEST_ASSERT_EQUAL(260, boot_phase_done_ticks[boot_phase_index(BOOT_WIFI)]);
+
+    // A phase done without a start is timed from its completion
+    boot_phase_done(BOOT_PERIPHERALS);
+    boot_phase_done(BOOT_IP);
+    boot_phase_done(BOOT_DNS);
+    boot_phase_done(BOOT_TIME);
+    boot_phase_done(BOOT_MQTT);
+    TEST_ASSERT_EQUAL(TX_SUCCESS, boot_phase_wait(BOOT_ALL, TX_NO_WAIT));
+    TEST_ASSERT_EQUAL(boot_phase_done_ticks[boot_phase_index(BOOT_MQTT)],
+                      boot_phase_start_ticks[boot_phase_index(BOOT_MQTT)]);
+}
+
+int main(void)
+{
+    TEST_RUN(test_milestones);
+    TEST_RUN(test_wrap);
+    TEST_RUN(test_full);
+    TEST_RUN(test_json_size);
+    TEST_RUN(test_phases);
+    return TEST_RESULT();
+}
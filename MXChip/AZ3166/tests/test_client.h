@@ -0,0 +1,60 @@
+// Set up an MQTT client for a host test, after the test includes nxd_mqtt_client.c.
+//
+// The client thread is not started: test_client_run does its work, processing
+// the events set so far on the caller's thread.
+
+#ifndef TEST_CLIENT_H
+#define TEST_CLIENT_H
+
+#include "test.h"
+
+#define TEST_PACKET_PAYLOAD 1536
+
+static NX_IP test_ip;
+static NX_PACKET_POOL test_pool;
+
+static inline VOID test_client_create(NXD_MQTT_CLIENT *client_ptr, UINT packet_count)
+{
+    test_ip.nx_ip_id = NX_IP_ID;
+    host_packet_pool_create(&test_pool, "test", TEST_PACKET_PAYLOAD, packet_count);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_create(client_ptr, "test", "host-test", 9, &test_ip,
+                                                                &test_pool, NX_NULL, 0, 1, NX_NULL, 0));
+}
+
+static inline VOID test_client_run(NXD_MQTT_CLIENT *client_ptr)
+{
+    ULONG events;
+
+    while (tx_event_flags_get(&client_ptr->nxd_mqtt_events, MQTT_ALL_EVENTS, TX_OR_CLEAR, &events, TX_NO_WAIT) == TX_SUCCESS)
+    {
+        _nxd_mqtt_client_event_process(client_ptr, NX_NULL, events);
+    }
+}
+
+#ifdef BROKER_H
+// Connect the client to the broker stand-in, blocking until the CONNACK
+static inline UINT test_client_connect(NXD_MQTT_CLIENT *client_ptr, BROKER *broker_ptr)
+{
+    NXD_ADDRESS server_ip;
+
+    server_ip.nxd_ip_version = NX_IP_VERSION_V4;
+    server_ip.nxd_ip_address.v4 = IP_ADDRESS(127, 0, 0, 1);
+    broker_attach(broker_ptr, &client_ptr->nxd_mqtt_client_socket);
+    return _nxd_mqtt_client_connect(client_ptr, &server_ip, 1883, 0, NX_TRUE, NX_IP_PERIODIC_RATE);
+}
+#endif // BROKER_H
+
+// Delete the client, checking that every packet went back to the pool
+static inline VOID test_client_delete(NXD_MQTT_CLIENT *client_ptr)
+{
+    tx_event_flags_set(&client_ptr->nxd_mqtt_events, MQTT_DELETE_EVENT, TX_OR);
+    test_client_run(client_ptr);
+    _nxd_mqtt_client_delete(client_ptr);
+    TEST_ASSERT_EQUAL(test_pool.nx_packet_pool_total, test_pool.nx_packet_pool_available);
+    if (test_pool.nx_packet_pool_total == test_pool.nx_packet_pool_available)
+    {
+        host_packet_pool_delete(&test_pool);
+    }
+}
+
+#endif // TEST_CLIENT_H
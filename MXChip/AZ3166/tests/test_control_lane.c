@@ -0,0 +1,145 @@
+// Control lane: PUBACK, PUBREC, PUBREL, PUBCOMP and PINGREQ. Each connection
+// sets NXD_MQTT_CONTROL_PACKET_RESERVE packets of the client pool aside for
+// them, taken once a publish burst has drained the pool; with the reserve
+// gone too the packet is dropped and counted, rather than blocking the MQTT
+// thread. Sent under the client mutex like any other packet, they join the
+// cork behind corked data, and the cork goes out with them at once.
+
+#include <string.h>
+
+#include "nxd_mqtt_client.c"
+#include "broker.h"
+#include "test_client.h"
+
+#define CONTROL_PACKETS 16
+
+static NXD_MQTT_CLIENT client;
+static BROKER broker;
+
+// Packets of the client pool taken by the test, as a publish burst would
+static NX_PACKET *control_drained[CONTROL_PACKETS];
+static UINT control_drained_count;
+
+static VOID control_setup(VOID)
+{
+    memset(&broker, 0, sizeof(broker));
+    control_drained_count = 0;
+    test_client_create(&client, CONTROL_PACKETS);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, test_client_connect(&client, &broker));
+}
+
+static VOID control_teardown(VOID)
+{
+    UCHAR topic[8];
+    UCHAR message[8];
+    UINT topic_length;
+    UINT message_length;
+
+    while (_nxd_mqtt_client_message_get(&client, topic, sizeof(topic), &topic_length,
+                                        message, sizeof(message), &message_length) == NXD_MQTT_SUCCESS)
+    {
+    }
+    TEST_ASSERT(client.nxd_mqtt_client_cork_packet == NX_NULL);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_disconnect(&client));
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(0, client.nxd_mqtt_client_control_reserve_count);
+    test_client_delete(&client);
+}
+
+// Take every free packet, including those the transport released after sending
+static VOID control_drain(VOID)
+{
+    while ((control_drained_count < CONTROL_PACKETS) &&
+           (nx_packet_allocate(&test_pool, &control_drained[control_drained_count], NX_IPv4_TCP_PACKET,
+                               NX_NO_WAIT) == NX_SUCCESS))
+    {
+        control_drained_count++;
+    }
+    TEST_ASSERT_EQUAL(0, test_pool.nx_packet_pool_available);
+}
+
+static VOID control_refill(VOID)
+{
+    while (control_drained_count)
+    {
+        nx_packet_release(control_drained[--control_drained_count]);
+    }
+}
+
+// The broker sends a QoS 1 message, and the client answers it
+static UINT control_puback(USHORT packet_id)
+{
+    UINT pubacks = broker_count(&broker, BROKER_PUBACK);
+
+    broker_publish(&broker, "in", (const UCHAR *)"x", 1, 1, packet_id, 0);
+    test_client_run(&client);
+    return broker_count(&broker, BROKER_PUBACK) - pubacks;
+}
+
+// With the pool drained, acknowledgements take the reserved packets; once those are gone they are
+// dropped and counted, and the reserve is topped up when the pool has packets again
+static VOID test_reserve(VOID)
+{
+    NXD_MQTT_METRICS metrics;
+    UINT i;
+
+    control_setup();
+    TEST_ASSERT_EQUAL(NXD_MQTT_CONTROL_PACKET_RESERVE, client.nxd_mqtt_client_control_reserve_count);
+
+    for (i = 0; i < NXD_MQTT_CONTROL_PACKET_RESERVE; i++)
+    {
+        control_drain();
+        TEST_ASSERT_EQUAL(1, control_puback((USHORT)(1 + i)));
+        TEST_ASSERT_EQUAL(NXD_MQTT_CONTROL_PACKET_RESERVE - 1 - i, client.nxd_mqtt_client_control_reserve_count);
+    }
+
+    control_drain();
+    TEST_ASSERT_EQUAL(0, control_puback(10));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_metrics_get(&client, &metrics));
+    TEST_ASSERT_EQUAL(1, metrics.nxd_mqtt_metrics_control_drops);
+
+    // The broker sends the message again, and it is answered from the pool
+    control_refill();
+    broker_publish(&broker, "in", (const UCHAR *)"x", 1, 1, 10, 1);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(10, broker_last(&broker, BROKER_PUBACK)->packet_id);
+    TEST_ASSERT_EQUAL(NXD_MQTT_CONTROL_PACKET_RESERVE, client.nxd_mqtt_client_control_reserve_count);
+
+    control_teardown();
+}
+
+// Behind corked data an acknowledgement joins the cork, which goes out with it at once, in one
+// segment and in the order sent; with nothing corked it goes out on its own
+static VOID test_cork(VOID)
+{
+    ULONG segments;
+
+    control_setup();
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_cork_set(&client, 1000));
+    segments = client.nxd_mqtt_client_socket.host_tcp_segments_sent;
+
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_publish(&client, "t/1", 3, "a", 1, 0, 0, NX_NO_WAIT));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_publish(&client, "t/1", 3, "b", 1, 0, 0, NX_NO_WAIT));
+    TEST_ASSERT_EQUAL(segments, client.nxd_mqtt_client_socket.host_tcp_segments_sent);
+
+    TEST_ASSERT_EQUAL(1, control_puback(7));
+    TEST_ASSERT_EQUAL(segments + 1, client.nxd_mqtt_client_socket.host_tcp_segments_sent);
+    TEST_ASSERT(client.nxd_mqtt_client_cork_packet == NX_NULL);
+    TEST_ASSERT_EQUAL(BROKER_PUBLISH, broker.log[1].type);
+    TEST_ASSERT_EQUAL(BROKER_PUBLISH, broker.log[2].type);
+    TEST_ASSERT_EQUAL(BROKER_PUBACK, broker.log[3].type);
+    TEST_ASSERT_EQUAL(7, broker.log[3].packet_id);
+
+    TEST_ASSERT_EQUAL(1, control_puback(8));
+    TEST_ASSERT_EQUAL(segments + 2, client.nxd_mqtt_client_socket.host_tcp_segments_sent);
+    TEST_ASSERT(client.nxd_mqtt_client_cork_packet == NX_NULL);
+
+    control_teardown();
+}
+
+int main(void)
+{
+    TEST_RUN(test_reserve);
+    TEST_RUN(test_cork);
+    return TEST_RESULT();
+}
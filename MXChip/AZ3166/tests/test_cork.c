@@ -0,0 +1,287 @@
+// Corking: small MQTT packets packed into one TCP segment up to the MSS, sent
+// when the next one would not fit, when the cork delay runs out, or on flush.
+// The benchmark reports messages per second and bytes on the wire against the
+// broker stand-in, corked and not.
+
+#include <string.h>
+
+#include "nxd_mqtt_client.c"
+#include "broker.h"
+#include "test_client.h"
+
+// A QoS 0 PUBLISH of a 16 byte payload to "t/1": 2 header, 5 topic, 16 payload
+#define CORK_PAYLOAD        16
+#define CORK_PUBLISH_LENGTH 23
+
+// IPv4 and TCP headers of each segment, without options
+#define CORK_SEGMENT_HEADER 40
+
+#define CORK_MESSAGES       2000
+
+static NXD_MQTT_CLIENT client;
+static BROKER broker;
+static ULONG cork_pool_available;
+static ULONG cork_segments;
+static ULONG cork_bytes;
+static UINT cork_received;
+
+static VOID cork_setup(UINT delay)
+{
+    memset(&broker, 0, sizeof(broker));
+    test_client_create(&client, 16);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, test_client_connect(&client, &broker));
+    if (delay)
+    {
+        TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_cork_set(&client, delay));
+    }
+    cork_pool_available = test_pool.nx_packet_pool_available;
+    cork_segments = client.nxd_mqtt_client_socket.host_tcp_segments_sent;
+    cork_bytes = client.nxd_mqtt_client_socket.host_tcp_bytes_sent;
+}
+
+static VOID cork_teardown(VOID)
+{
+    TEST_ASSERT(client.nxd_mqtt_client_cork_packet == NX_NULL);
+    TEST_ASSERT_EQUAL(host_network_pool.nx_packet_pool_total, host_network_pool.nx_packet_pool_available);
+    test_client_delete(&client);
+}
+
+// Segments and bytes sent since the last call
+static ULONG cork_segments_sent(VOID)
+{
+    ULONG segments = client.nxd_mqtt_client_socket.host_tcp_segments_sent - cork_segments;
+
+    cork_segments = client.nxd_mqtt_client_socket.host_tcp_segments_sent;
+    return segments;
+}
+
+static ULONG cork_bytes_sent(VOID)
+{
+    ULONG bytes = client.nxd_mqtt_client_socket.host_tcp_bytes_sent - cork_bytes;
+
+    cork_bytes = client.nxd_mqtt_client_socket.host_tcp_bytes_sent;
+    return bytes;
+}
+
+// Publish message number i at QoS 0, its number in the payload
+static UINT cork_publish(UINT i, UINT payload_length)
+{
+    CHAR payload[512];
+
+    memset(payload, '.', payload_length);
+    snprintf(payload, sizeof(payload), "%08u", i);
+    payload[8] = '.';
+    return _nxd_mqtt_client_publish(&client, "t/1", 3, payload, payload_length, 0, 0, NX_NO_WAIT);
+}
+
+// The PUBLISH packets the broker logged are messages first to first + count - 1, in order
+static VOID cork_expect(UINT log_index, UINT first, UINT count)
+{
+    CHAR number[9];
+    UINT i;
+
+    for (i = 0; i < count; i++)
+    {
+        snprintf(number, sizeof(number), "%08u", first + i);
+        TEST_ASSERT_EQUAL(BROKER_PUBLISH, broker.log[log_index + i].type);
+        TEST_ASSERT(memcmp(broker.log[log_index + i].payload, number, 8) == 0);
+    }
+}
+
+// Packets are held until the next would take the cork past the MSS
+static VOID test_size_flush(VOID)
+{
+    UINT per_segment = 1460 / CORK_PUBLISH_LENGTH;
+    UINT i;
+
+    cork_setup(1000);
+    TEST_ASSERT_EQUAL(1460, client.nxd_mqtt_client_socket.nx_tcp_socket_connect_mss);
+    for (i = 0; i < per_segment; i++)
+    {
+        TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, cork_publish(i, CORK_PAYLOAD));
+    }
+    TEST_ASSERT_EQUAL(0, cork_segments_sent());
+    TEST_ASSERT_EQUAL(0, broker_count(&broker, BROKER_PUBLISH));
+
+    // One more does not fit: the full cork goes, and this one starts the next
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, cork_publish(per_segment, CORK_PAYLOAD));
+    TEST_ASSERT_EQUAL(1, cork_segments_sent());
+    TEST_ASSERT_EQUAL(per_segment * CORK_PUBLISH_LENGTH, cork_bytes_sent());
+    TEST_ASSERT_EQUAL(per_segment, broker_count(&broker, BROKER_PUBLISH));
+    cork_expect(1, 0, per_segment);
+
+    // The packets corked while one was waiting use no more of the pool
+    TEST_ASSERT_EQUAL(cork_pool_available - 1, test_pool.nx_packet_pool_available);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_flush(&client));
+    TEST_ASSERT_EQUAL(1, cork_segments_sent());
+    TEST_ASSERT_EQUAL(CORK_PUBLISH_LENGTH, cork_bytes_sent());
+    cork_expect(1 + per_segment, per_segment, 1);
+    TEST_ASSERT_EQUAL(cork_pool_available, test_pool.nx_packet_pool_available);
+
+    // Flushing an empty cork sends nothing
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_flush(&client));
+    TEST_ASSERT_EQUAL(0, cork_segments_sent());
+    cork_teardown();
+}
+
+// The first packet of a cork starts the delay; the MQTT thread flushes when it runs out
+static VOID test_delay_flush(VOID)
+{
+    UINT i;
+
+    cork_setup(5);
+    for (i = 0; i < 3; i++)
+    {
+        TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, cork_publish(i, CORK_PAYLOAD));
+        host_time_advance(1);
+        test_client_run(&client);
+    }
+    TEST_ASSERT_EQUAL(0, cork_segments_sent());
+
+    host_time_advance(1);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(0, cork_segments_sent());
+    host_time_advance(1);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(1, cork_segments_sent());
+    TEST_ASSERT_EQUAL(3 * CORK_PUBLISH_LENGTH, cork_bytes_sent());
+    cork_expect(1, 0, 3);
+
+    // The next packet starts a new delay
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, cork_publish(3, CORK_PAYLOAD));
+    host_time_advance(4);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(0, cork_segments_sent());
+    host_time_advance(1);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(1, cork_segments_sent());
+    cork_expect(4, 3, 1);
+
+    // Turning corking off sends what is corked
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, cork_publish(4, CORK_PAYLOAD));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_cork_set(&client, 0));
+    TEST_ASSERT_EQUAL(1, cork_segments_sent());
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, cork_publish(5, CORK_PAYLOAD));
+    TEST_ASSERT_EQUAL(1, cork_segments_sent());
+    cork_expect(5, 4, 2);
+    cork_teardown();
+}
+
+// Acknowledgements are not held, but go out with the cork; packets too large to share a segment go after it
+static VOID test_bypass(VOID)
+{
+    UCHAR topic[8];
+    UCHAR message[8];
+    ULONG topic_length;
+    ULONG message_length;
+    BROKER_PACKET *puback_ptr;
+
+    cork_setup(1000);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, cork_publish(0, CORK_PAYLOAD));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, cork_publish(1, CORK_PAYLOAD));
+
+    // The PUBACK for an inbound QoS 1 message goes at once, in one segment behind the corked data
+    broker_publish(&broker, "in", (const UCHAR *)"x", 1, 1, 7, 0);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(1, cork_segments_sent());
+    puback_ptr = broker_last(&broker, BROKER_PUBACK);
+    TEST_ASSERT(puback_ptr == &broker.log[3]);
+    TEST_ASSERT_EQUAL(7, puback_ptr->packet_id);
+    cork_expect(1, 0, 2);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_message_get(&client, topic, sizeof(topic), (UINT *)&topic_length,
+                                                                     message, sizeof(message), (UINT *)&message_length));
+
+    // With a smaller MSS, a 300 byte message cannot be corked: the cork goes first, then the message
+    client.nxd_mqtt_client_socket.nx_tcp_socket_connect_mss = 256;
+    cork_bytes_sent();
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, cork_publish(2, CORK_PAYLOAD));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, cork_publish(3, CORK_PAYLOAD));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, cork_publish(4, 300));
+    TEST_ASSERT_EQUAL(2, cork_segments_sent());
+    TEST_ASSERT_EQUAL(2 * CORK_PUBLISH_LENGTH + 3 + 5 + 300, cork_bytes_sent());
+    TEST_ASSERT_EQUAL(5, broker_count(&broker, BROKER_PUBLISH));
+    cork_expect(4, 2, 3);
+    TEST_ASSERT_EQUAL(300, broker.log[6].payload_length);
+    cork_teardown();
+}
+
+// A connection that ends releases the packets still corked
+static VOID test_connection_lost(VOID)
+{
+    cork_setup(1000);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, cork_publish(0, CORK_PAYLOAD));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, cork_publish(1, CORK_PAYLOAD));
+    TEST_ASSERT(client.nxd_mqtt_client_cork_packet != NX_NULL);
+
+    broker_close(&broker);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(NXD_MQTT_CLIENT_STATE_IDLE, client.nxd_mqtt_client_state);
+    TEST_ASSERT(client.nxd_mqtt_client_cork_packet == NX_NULL);
+    TEST_ASSERT_EQUAL(0, cork_segments_sent());
+    TEST_ASSERT_EQUAL(0, broker_count(&broker, BROKER_PUBLISH));
+    cork_teardown();
+}
+
+static VOID cork_publish_notify(BROKER *broker_ptr, BROKER_PACKET *packet_ptr)
+{
+    (void)broker_ptr;
+    (void)packet_ptr;
+    cork_received++;
+}
+
+// Publish count messages of payload_length bytes, returning the nanoseconds taken
+static ULONG64 cork_run(UINT delay, UINT payload_length, UINT count)
+{
+    ULONG64 start;
+    ULONG64 end;
+    UINT i;
+
+    cork_setup(delay);
+    broker.log_wrap = NX_TRUE;
+    broker.publish_notify = cork_publish_notify;
+    cork_received = 0;
+    start = host_clock_ns();
+    for (i = 0; i < count; i++)
+    {
+        TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, cork_publish(i, payload_length));
+    }
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_flush(&client));
+    end = host_clock_ns();
+    TEST_ASSERT_EQUAL(count, cork_received);
+    return end - start;
+}
+
+static VOID bench_cork(VOID)
+{
+    static const UINT payloads[] = { 16, 64, 256 };
+    ULONG64 ns;
+    ULONG segments;
+    ULONG bytes;
+    UINT delay;
+    UINT i;
+
+    printf("payload  corked  messages/s  segments  MQTT bytes  wire bytes (+%u per segment)\n", CORK_SEGMENT_HEADER);
+    for (i = 0; i < sizeof(payloads) / sizeof(payloads[0]); i++)
+    {
+        for (delay = 0; delay <= 1000; delay += 1000)
+        {
+            ns = cork_run(delay, payloads[i], CORK_MESSAGES);
+            segments = cork_segments_sent();
+            bytes = cork_bytes_sent();
+            printf("%7u  %6s  %10llu  %8lu  %10lu  %10lu\n", payloads[i], delay ? "yes" : "no",
+                   (unsigned long long)(CORK_MESSAGES * 1000000000ULL / (ns ? ns : 1)), segments, bytes,
+                   bytes + segments * CORK_SEGMENT_HEADER);
+            cork_teardown();
+        }
+    }
+}
+
+int main(void)
+{
+    TEST_RUN(test_size_flush);
+    TEST_RUN(test_delay_flush);
+    TEST_RUN(test_bypass);
+    TEST_RUN(test_connection_lost);
+    TEST_RUN(bench_cork);
+    return TEST_RESULT();
+}
@@ -0,0 +1,222 @@
+// DHCP bind time against the server stand-in: Rapid Commit takes the Discover
+// and its Ack, a server ignoring it adds the Offer and Request round trip, and
+// with the concurrent ARP probe the address is usable from the Ack while the
+// probes run, and withdrawn and declined when another host answers for it.
+// The client thread is not run: the test advances the clock a tick at a time
+// and hands the client's events to the thread's event processing itself.
+
+#include <string.h>
+
+#include "nxd_dhcp_client.c"
+#include "test.h"
+#include "dhcp_server.h"
+
+// A round trip to the server of 50 ms
+#define DHCP_TEST_ROUND_TRIP   5
+#define DHCP_TEST_MAC_MSW      0x0011
+#define DHCP_TEST_MAC_LSW      0x22334455
+
+// The probe delays are random: bind times are reported over this many seeds
+#define DHCP_TEST_SEEDS        15
+
+static NX_PACKET_POOL dhcp_test_pool;
+static NX_IP dhcp_test_ip;
+static NX_DHCP dhcp_test_client;
+static DHCP_SERVER dhcp_test_server;
+
+// Ticks at which the address was last set, first withdrawn, and the client bound
+typedef struct DHCP_TEST_TIMES_STRUCT
+{
+    ULONG usable;
+    ULONG withdrawn;
+    ULONG bound;
+} DHCP_TEST_TIMES;
+
+// Seeding NX_RAND makes the probe delays, and so the bind time, repeatable
+static VOID dhcp_test_setup(UINT rapid_commit, ULONG conflict_address, UINT seed)
+{
+    tx_time_set(0);
+    srand(seed);
+    host_packet_pool_create(&dhcp_test_pool, "ip pool", 1536, 16);
+    nx_ip_create(&dhcp_test_ip, "ip", 0, 0, &dhcp_test_pool, host_network_driver, NX_NULL, 0, 1);
+    dhcp_test_ip.nx_ip_interface[0].nx_interface_physical_address_msw = DHCP_TEST_MAC_MSW;
+    dhcp_test_ip.nx_ip_interface[0].nx_interface_physical_address_lsw = DHCP_TEST_MAC_LSW;
+
+    TEST_ASSERT_EQUAL(NX_SUCCESS, _nx_dhcp_create(&dhcp_test_client, &dhcp_test_ip, "dhcp test"));
+    dhcp_server_attach(&dhcp_test_server, &dhcp_test_ip, &dhcp_test_client.nx_dhcp_socket, DHCP_TEST_ROUND_TRIP);
+    dhcp_test_server.rapid_commit = rapid_commit;
+    dhcp_test_server.conflict_address = conflict_address;
+    TEST_ASSERT_EQUAL(NX_SUCCESS, _nx_dhcp_start(&dhcp_test_client));
+}
+
+static VOID dhcp_test_teardown(VOID)
+{
+    TEST_ASSERT_EQUAL(NX_SUCCESS, _nx_dhcp_delete(&dhcp_test_client));
+    nx_ip_delete(&dhcp_test_ip);
+    host_packet_pool_delete(&dhcp_test_pool);
+}
+
+// Run the client for a number of ticks, as its thread would
+static VOID dhcp_test_run(ULONG ticks, DHCP_TEST_TIMES *times_ptr)
+{
+    NX_DHCP_INTERFACE_RECORD *record_ptr = &dhcp_test_client.nx_dhcp_interface_record[0];
+    ULONG address = dhcp_test_ip.nx_ip_interface[0].nx_interface_ip_address;
+    ULONG events;
+
+    while (ticks--)
+    {
+        host_time_advance(1);
+        dhcp_server_poll(&dhcp_test_server);
+        while (tx_event_flags_get(&dhcp_test_client.nx_dhcp_events, NX_DHCP_CLIENT_ALL_EVENTS, TX_OR_CLEAR,
+                                  &events, TX_NO_WAIT) == TX_SUCCESS)
+        {
+            tx_mutex_get(&dhcp_test_client.nx_dhcp_mutex, TX_WAIT_FOREVER);
+            _nx_dhcp_event_process(&dhcp_test_client, events);
+            tx_mutex_put(&dhcp_test_client.nx_dhcp_mutex);
+        }
+
+        if ((address == 0) && dhcp_test_ip.nx_ip_interface[0].nx_interface_ip_address)
+        {
+            times_ptr->usable = tx_time_get();
+        }
+        if (address && (dhcp_test_ip.nx_ip_interface[0].nx_interface_ip_address == 0) && !times_ptr->withdrawn)
+        {
+            times_ptr->withdrawn = tx_time_get();
+        }
+        if ((record_ptr->nx_dhcp_state == NX_DHCP_STATE_BOUND) && !times_ptr->bound)
+        {
+            times_ptr->bound = tx_time_get();
+        }
+        address = dhcp_test_ip.nx_ip_interface[0].nx_interface_ip_address;
+    }
+}
+
+// The Discover goes out on the first timer tick, and the Ack to it makes the address usable
+static VOID test_rapid_commit(VOID)
+{
+    DHCP_TEST_TIMES times = {0};
+
+    dhcp_test_setup(NX_TRUE, 0, 1);
+    dhcp_test_run(1000, &times);
+
+    TEST_ASSERT_EQUAL(1, dhcp_test_server.discovers);
+    TEST_ASSERT_EQUAL(1, dhcp_test_server.rapid_acks);
+    TEST_ASSERT_EQUAL(0, dhcp_test_server.offers);
+    TEST_ASSERT_EQUAL(0, dhcp_test_server.requests);
+    TEST_ASSERT_EQUAL(NX_DHCP_TIME_INTERVAL + DHCP_TEST_ROUND_TRIP, times.usable);
+    TEST_ASSERT_EQUAL(IP_ADDRESS(192, 168, 0, 100), dhcp_test_ip.nx_ip_interface[0].nx_interface_ip_address);
+    TEST_ASSERT_EQUAL(IP_ADDRESS(192, 168, 0, 1), dhcp_test_ip.nx_ip_gateway_address);
+
+    // Bound once the probes found no other host on the address; it was usable throughout
+    TEST_ASSERT_EQUAL(NX_DHCP_ARP_PROBE_NUM, dhcp_test_server.probes);
+    TEST_ASSERT(times.bound >= 4 * NX_DHCP_TIME_INTERVAL);
+    TEST_ASSERT(times.bound <= 6 * NX_DHCP_TIME_INTERVAL);
+    TEST_ASSERT_EQUAL(0, times.withdrawn);
+    dhcp_test_teardown();
+}
+
+// A server ignoring option 80 offers; the Request goes out on the Offer, not on the timer
+static VOID test_no_rapid_commit(VOID)
+{
+    DHCP_TEST_TIMES times = {0};
+
+    dhcp_test_setup(NX_FALSE, 0, 1);
+    dhcp_test_run(1000, &times);
+
+    TEST_ASSERT_EQUAL(1, dhcp_test_server.discovers);
+    TEST_ASSERT_EQUAL(0, dhcp_test_server.rapid_acks);
+    TEST_ASSERT_EQUAL(1, dhcp_test_server.offers);
+    TEST_ASSERT_EQUAL(1, dhcp_test_server.requests);
+    TEST_ASSERT_EQUAL(1, dhcp_test_server.acks);
+    TEST_ASSERT_EQUAL(NX_DHCP_TIME_INTERVAL + 2 * DHCP_TEST_ROUND_TRIP, times.usable);
+    TEST_ASSERT_EQUAL(IP_ADDRESS(192, 168, 0, 100), dhcp_test_ip.nx_ip_interface[0].nx_interface_ip_address);
+    TEST_ASSERT(times.bound >= 4 * NX_DHCP_TIME_INTERVAL);
+    TEST_ASSERT(times.bound <= 6 * NX_DHCP_TIME_INTERVAL);
+    dhcp_test_teardown();
+}
+
+// Another host answers the first probe: the address is withdrawn and declined, and
+// the next one is leased after the restart wait
+static VOID test_conflict(VOID)
+{
+    DHCP_TEST_TIMES times = {0};
+    DHCP_TEST_TIMES retry = {0};
+
+    dhcp_test_setup(NX_TRUE, IP_ADDRESS(192, 168, 0, 100), 1);
+    dhcp_test_run(2 * NX_DHCP_TIME_INTERVAL + DHCP_TEST_ROUND_TRIP, &times);
+
+    TEST_ASSERT_EQUAL(NX_DHCP_TIME_INTERVAL + DHCP_TEST_ROUND_TRIP, times.usable);
+    TEST_ASSERT_EQUAL(2 * NX_DHCP_TIME_INTERVAL + DHCP_TEST_ROUND_TRIP, times.withdrawn);
+    TEST_ASSERT_EQUAL(1, dhcp_test_server.conflicts);
+    TEST_ASSERT_EQUAL(1, dhcp_test_server.declines);
+    TEST_ASSERT_EQUAL(0, times.bound);
+
+    dhcp_test_run(2000, &retry);
+    TEST_ASSERT_EQUAL(2, dhcp_test_server.discovers);
+    TEST_ASSERT_EQUAL(2, dhcp_test_server.rapid_acks);
+    TEST_ASSERT_EQUAL(IP_ADDRESS(192, 168, 0, 101), dhcp_test_ip.nx_ip_interface[0].nx_interface_ip_address);
+    TEST_ASSERT(retry.usable >= times.withdrawn + NX_DHCP_RESTART_WAIT);
+    TEST_ASSERT(retry.usable <= times.withdrawn + NX_DHCP_RESTART_WAIT + NX_DHCP_TIME_INTERVAL + DHCP_TEST_ROUND_TRIP);
+    TEST_ASSERT(retry.bound > retry.usable);
+    TEST_ASSERT_EQUAL(1, dhcp_test_server.conflicts);
+    dhcp_test_teardown();
+}
+
+static int dhcp_test_compare(const VOID *a, const VOID *b)
+{
+    ULONG x = *(const ULONG *)a;
+    ULONG y = *(const ULONG *)b;
+
+    return (x > y) - (x < y);
+}
+
+// Time to a usable address and to the Bound state on the simulated clock: the median,
+// and the range, over the seeds of the probe delays
+static VOID test_bind_time(VOID)
+{
+    static const struct
+    {
+        const CHAR *name;
+        UINT rapid_commit;
+        ULONG conflict_address;
+    } cases[] = {
+        { "rapid commit", NX_TRUE, 0 },
+        { "offer/request", NX_FALSE, 0 },
+        { "arp conflict", NX_TRUE, IP_ADDRESS(192, 168, 0, 100) },
+    };
+    DHCP_TEST_TIMES times;
+    ULONG usable[DHCP_TEST_SEEDS];
+    ULONG bound[DHCP_TEST_SEEDS];
+    UINT i;
+    UINT seed;
+
+    printf("   round trip %u ms, %u seeds, median (min-max)\n",
+           DHCP_TEST_ROUND_TRIP * 1000 / TX_TIMER_TICKS_PER_SECOND, DHCP_TEST_SEEDS);
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        for (seed = 0; seed < DHCP_TEST_SEEDS; seed++)
+        {
+            memset(&times, 0, sizeof(times));
+            dhcp_test_setup(cases[i].rapid_commit, cases[i].conflict_address, seed + 1);
+            dhcp_test_run(3000, &times);
+            TEST_ASSERT(times.usable && times.bound);
+            usable[seed] = times.usable * 1000 / TX_TIMER_TICKS_PER_SECOND;
+            bound[seed] = times.bound * 1000 / TX_TIMER_TICKS_PER_SECOND;
+            dhcp_test_teardown();
+        }
+        qsort(usable, DHCP_TEST_SEEDS, sizeof(ULONG), dhcp_test_compare);
+        qsort(bound, DHCP_TEST_SEEDS, sizeof(ULONG), dhcp_test_compare);
+        printf("   %-13s: usable %5lu ms (%5lu-%5lu), bound %5lu ms (%5lu-%5lu)\n", cases[i].name,
+               usable[DHCP_TEST_SEEDS / 2], usable[0], usable[DHCP_TEST_SEEDS - 1],
+               bound[DHCP_TEST_SEEDS / 2], bound[0], bound[DHCP_TEST_SEEDS - 1]);
+    }
+}
+
+int main(void)
+{
+    TEST_RUN(test_rapid_commit);
+    TEST_RUN(test_no_rapid_commit);
+    TEST_RUN(test_conflict);
+    TEST_RUN(test_bind_time);
+    return TEST_RESULT();
+}
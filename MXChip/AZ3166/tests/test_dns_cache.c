@@ -0,0 +1,289 @@
+// DNS cache: records are chained by name hash through nx_dns_rr_hash_next,
+// a lookup answered by the server is reused for the answer's TTL, a name the
+// server does not know is remembered for NX_DNS_CACHE_NEGATIVE_TTL and a
+// server that does not answer for NX_DNS_CACHE_FAILURE_TTL, and while the
+// server does not answer an expired answer is served stale for up to
+// NX_DNS_CACHE_STALE_TIME. The lookups run against the server stand-in,
+// without threads: a query left unanswered waits out its timeout on the
+// simulated clock.
+
+#include <string.h>
+
+#include "nxd_dns.c"
+#include "test.h"
+#include "dns_server.h"
+
+#define DNS_TEST_SERVER    IP_ADDRESS(192, 168, 0, 1)
+#define DNS_TEST_ADDRESS   IP_ADDRESS(10, 0, 0, 1)
+#define DNS_TEST_OTHER     IP_ADDRESS(10, 0, 0, 2)
+#define DNS_TEST_TTL       30
+
+static NX_PACKET_POOL dns_test_pool;
+static NX_IP dns_test_ip;
+static NX_DNS dns_test_client;
+static DNS_SERVER dns_test_server;
+static ALIGN_TYPE dns_test_cache[2048 / sizeof(ALIGN_TYPE)];
+
+static VOID dns_test_setup(VOID)
+{
+    tx_time_set(0);
+    host_packet_pool_create(&dns_test_pool, "ip pool", 1536, 8);
+    nx_ip_create(&dns_test_ip, "ip", IP_ADDRESS(192, 168, 0, 100), 0xFFFFFF00, &dns_test_pool, host_network_driver,
+                 NX_NULL, 0, 1);
+    TEST_ASSERT_EQUAL(NX_SUCCESS, _nx_dns_create(&dns_test_client, &dns_test_ip, (UCHAR *)"dns test"));
+    TEST_ASSERT_EQUAL(NX_SUCCESS, _nx_dns_packet_pool_set(&dns_test_client, &dns_test_pool));
+    TEST_ASSERT_EQUAL(NX_SUCCESS, _nx_dns_server_add(&dns_test_client, DNS_TEST_SERVER));
+    TEST_ASSERT_EQUAL(NX_SUCCESS, _nx_dns_cache_initialize(&dns_test_client, dns_test_cache, sizeof(dns_test_cache)));
+    dns_server_attach(&dns_test_server, &dns_test_ip, &dns_test_client.nx_dns_socket);
+}
+
+static VOID dns_test_teardown(VOID)
+{
+    TEST_ASSERT_EQUAL(dns_test_pool.nx_packet_pool_total, dns_test_pool.nx_packet_pool_available);
+    TEST_ASSERT_EQUAL(host_network_pool.nx_packet_pool_total, host_network_pool.nx_packet_pool_available);
+    TEST_ASSERT_EQUAL(NX_SUCCESS, _nx_dns_delete(&dns_test_client));
+    nx_ip_delete(&dns_test_ip);
+    host_packet_pool_delete(&dns_test_pool);
+}
+
+static UINT dns_test_lookup(const CHAR *name, ULONG *address_ptr)
+{
+    *address_ptr = 0;
+    return _nx_dns_host_by_name_get(&dns_test_client, (UCHAR *)name, address_ptr, NX_IP_PERIODIC_RATE);
+}
+
+// Move the clock on by whole seconds; the client runs no timers, so it can jump
+static VOID dns_test_wait(ULONG seconds)
+{
+    tx_time_set(tx_time_get() + seconds * NX_IP_PERIODIC_RATE);
+}
+
+// The records of the name in its bucket, and the first of them
+static UINT dns_test_records(const CHAR *name, NX_DNS_RR **first_ptr)
+{
+    NX_DNS_RR *rr;
+    UINT count = 0;
+
+    if (first_ptr)
+    {
+        *first_ptr = NX_NULL;
+    }
+    for (rr = dns_test_client.nx_dns_cache_hash[_nx_dns_cache_name_hash((UCHAR *)name)]; rr;
+         rr = rr->nx_dns_rr_hash_next)
+    {
+        if (strcmp((CHAR *)rr->nx_dns_rr_name, name) == 0)
+        {
+            if (first_ptr && (count == 0))
+            {
+                *first_ptr = rr;
+            }
+            count++;
+        }
+    }
+    return count;
+}
+
+// Names sharing a bucket are chained in the order added; each is found in the chain, in any case,
+// and one unlinked from the middle leaves the others found
+static VOID test_bucket_chain(VOID)
+{
+    CHAR names[3][16];
+    UINT bucket = 0;
+    UINT found = 0;
+    UINT i;
+    NX_DNS_RR *rr;
+    ULONG address;
+
+    dns_test_setup();
+
+    // Find three names in the same bucket
+    for (i = 0; found < 3; i++)
+    {
+        snprintf(names[found], sizeof(names[found]), "host%u.test", i);
+        if (found == 0)
+        {
+            bucket = _nx_dns_cache_name_hash((UCHAR *)names[0]);
+            found++;
+        }
+        else if (_nx_dns_cache_name_hash((UCHAR *)names[found]) == bucket)
+        {
+            found++;
+        }
+    }
+    for (i = 0; i < 3; i++)
+    {
+        TEST_ASSERT_EQUAL(NX_SUCCESS, _nx_dns_cache_host_add(&dns_test_client, (UCHAR *)names[i],
+                                                             DNS_TEST_ADDRESS + i, DNS_TEST_TTL));
+    }
+    TEST_ASSERT_EQUAL(3, dns_test_client.nx_dns_rr_count);
+
+    rr = dns_test_client.nx_dns_cache_hash[bucket];
+    for (i = 0; i < 3; i++)
+    {
+        TEST_ASSERT(rr != NX_NULL);
+        if (rr == NX_NULL)
+        {
+            break;
+        }
+        TEST_ASSERT(strcmp((CHAR *)rr->nx_dns_rr_name, names[i]) == 0);
+        rr = rr->nx_dns_rr_hash_next;
+    }
+    TEST_ASSERT(rr == NX_NULL);
+
+    // Found without asking the server, and the letters hash as lowercase
+    for (i = 0; i < 3; i++)
+    {
+        TEST_ASSERT_EQUAL(NX_SUCCESS, dns_test_lookup(names[i], &address));
+        TEST_ASSERT_EQUAL(DNS_TEST_ADDRESS + i, address);
+    }
+    names[2][0] = 'H';
+    TEST_ASSERT_EQUAL(bucket, _nx_dns_cache_name_hash((UCHAR *)names[2]));
+    TEST_ASSERT_EQUAL(NX_SUCCESS, dns_test_lookup(names[2], &address));
+    TEST_ASSERT_EQUAL(DNS_TEST_ADDRESS + 2, address);
+    names[2][0] = 'h';
+    TEST_ASSERT_EQUAL(0, dns_test_server.queries);
+
+    // Unlink the middle one
+    dns_test_records(names[1], &rr);
+    _nx_dns_cache_delete_rr(&dns_test_client, dns_test_cache, sizeof(dns_test_cache), rr);
+    TEST_ASSERT_EQUAL(2, dns_test_client.nx_dns_rr_count);
+    TEST_ASSERT_EQUAL(0, dns_test_records(names[1], NX_NULL));
+    dns_test_records(names[0], &rr);
+    TEST_ASSERT(rr == dns_test_client.nx_dns_cache_hash[bucket]);
+    TEST_ASSERT(rr->nx_dns_rr_hash_next && (strcmp((CHAR *)rr->nx_dns_rr_hash_next->nx_dns_rr_name, names[2]) == 0));
+    TEST_ASSERT_EQUAL(NX_SUCCESS, dns_test_lookup(names[2], &address));
+    TEST_ASSERT_EQUAL(DNS_TEST_ADDRESS + 2, address);
+
+    // Past the TTL and the stale time, a lookup walking the bucket deletes them all, leaving its failure
+    dns_test_wait(DNS_TEST_TTL + NX_DNS_CACHE_STALE_TIME);
+    dns_test_server.down = NX_TRUE;
+    TEST_ASSERT_EQUAL(NX_DNS_QUERY_FAILED, dns_test_lookup(names[0], &address));
+    TEST_ASSERT_EQUAL(0, dns_test_records(names[2], NX_NULL));
+    TEST_ASSERT_EQUAL(1, dns_test_records(names[0], &rr));
+    TEST_ASSERT_EQUAL(NX_DNS_RR_CLASS_NEGATIVE, rr->nx_dns_rr_class);
+    TEST_ASSERT_EQUAL(1, dns_test_client.nx_dns_rr_count);
+
+    dns_test_teardown();
+}
+
+// NXDOMAIN is remembered for NX_DNS_CACHE_NEGATIVE_TTL, an unanswered query for
+// NX_DNS_CACHE_FAILURE_TTL; the server is not asked again until they expire
+static VOID test_negative(VOID)
+{
+    NX_DNS_RR *rr;
+    ULONG address;
+    UINT queries;
+
+    dns_test_setup();
+
+    TEST_ASSERT_EQUAL(NX_DNS_NAME_ERROR, dns_test_lookup("missing.test", &address));
+    TEST_ASSERT_EQUAL(1, dns_test_server.queries);
+    TEST_ASSERT_EQUAL(1, dns_test_server.name_errors);
+    TEST_ASSERT_EQUAL(1, dns_test_records("missing.test", &rr));
+    TEST_ASSERT_EQUAL(NX_DNS_RR_CLASS_NEGATIVE, rr->nx_dns_rr_class);
+    TEST_ASSERT_EQUAL(NX_DNS_NAME_ERROR, rr->nx_dns_rr_rdata.nx_dns_rr_rdata_status);
+    TEST_ASSERT_EQUAL(NX_DNS_CACHE_NEGATIVE_TTL, rr->nx_dns_rr_ttl);
+
+    dns_test_wait(NX_DNS_CACHE_NEGATIVE_TTL - 1);
+    TEST_ASSERT_EQUAL(NX_DNS_NAME_ERROR, dns_test_lookup("missing.test", &address));
+    TEST_ASSERT_EQUAL(1, dns_test_server.queries);
+
+    // Once it expires the server is asked again, and a name it now knows replaces the failure
+    dns_server_name_add(&dns_test_server, "missing.test", DNS_TEST_ADDRESS, DNS_TEST_TTL);
+    dns_test_wait(1);
+    TEST_ASSERT_EQUAL(NX_SUCCESS, dns_test_lookup("missing.test", &address));
+    TEST_ASSERT_EQUAL(DNS_TEST_ADDRESS, address);
+    TEST_ASSERT_EQUAL(2, dns_test_server.queries);
+    TEST_ASSERT_EQUAL(1, dns_test_records("missing.test", &rr));
+    TEST_ASSERT(rr->nx_dns_rr_class != NX_DNS_RR_CLASS_NEGATIVE);
+    TEST_ASSERT_EQUAL(DNS_TEST_TTL, rr->nx_dns_rr_ttl);
+
+    // Each retry waits out a doubled timeout before the failure is recorded
+    dns_test_server.down = NX_TRUE;
+    queries = dns_test_server.queries;
+    tx_time_set(0);
+    TEST_ASSERT_EQUAL(NX_DNS_QUERY_FAILED, dns_test_lookup("down.test", &address));
+    TEST_ASSERT_EQUAL(queries + NX_DNS_MAX_RETRIES, dns_test_server.queries);
+    TEST_ASSERT_EQUAL((1 + 2 + 4) * NX_IP_PERIODIC_RATE, tx_time_get());
+    TEST_ASSERT_EQUAL(1, dns_test_records("down.test", &rr));
+    TEST_ASSERT_EQUAL(NX_DNS_QUERY_FAILED, rr->nx_dns_rr_rdata.nx_dns_rr_rdata_status);
+    TEST_ASSERT_EQUAL(NX_DNS_CACHE_FAILURE_TTL, rr->nx_dns_rr_ttl);
+
+    TEST_ASSERT_EQUAL(NX_DNS_QUERY_FAILED, dns_test_lookup("down.test", &address));
+    TEST_ASSERT_EQUAL(queries + NX_DNS_MAX_RETRIES, dns_test_server.queries);
+    TEST_ASSERT_EQUAL((1 + 2 + 4) * NX_IP_PERIODIC_RATE, tx_time_get());
+
+    dns_test_wait(NX_DNS_CACHE_FAILURE_TTL);
+    TEST_ASSERT_EQUAL(NX_DNS_QUERY_FAILED, dns_test_lookup("down.test", &address));
+    TEST_ASSERT_EQUAL(queries + 2 * NX_DNS_MAX_RETRIES, dns_test_server.queries);
+    TEST_ASSERT_EQUAL(1, dns_test_records("down.test", NX_NULL));
+
+    dns_test_teardown();
+}
+
+// While the server does not answer, an expired answer is served stale for up to
+// NX_DNS_CACHE_STALE_TIME; a fresh answer replaces it, and NXDOMAIN is not masked by it
+static VOID test_stale(VOID)
+{
+    NX_DNS_RR *rr;
+    ULONG address;
+
+    dns_test_setup();
+    dns_server_name_add(&dns_test_server, "broker.test", DNS_TEST_ADDRESS, DNS_TEST_TTL);
+
+    TEST_ASSERT_EQUAL(NX_SUCCESS, dns_test_lookup("broker.test", &address));
+    TEST_ASSERT_EQUAL(DNS_TEST_ADDRESS, address);
+    TEST_ASSERT_EQUAL(1, dns_test_server.queries);
+
+    // Fresh, from the cache
+    dns_test_wait(DNS_TEST_TTL - 1);
+    TEST_ASSERT_EQUAL(NX_SUCCESS, dns_test_lookup("broker.test", &address));
+    TEST_ASSERT_EQUAL(1, dns_test_server.queries);
+
+    // Expired, with the server down: the server is asked, then the stale answer served
+    dns_test_wait(DNS_TEST_TTL);
+    dns_test_server.down = NX_TRUE;
+    TEST_ASSERT_EQUAL(NX_SUCCESS, dns_test_lookup("broker.test", &address));
+    TEST_ASSERT_EQUAL(DNS_TEST_ADDRESS, address);
+    TEST_ASSERT_EQUAL(1 + NX_DNS_MAX_RETRIES, dns_test_server.queries);
+
+    // Within the failure TTL it is served stale without asking
+    TEST_ASSERT_EQUAL(NX_SUCCESS, dns_test_lookup("broker.test", &address));
+    TEST_ASSERT_EQUAL(DNS_TEST_ADDRESS, address);
+    TEST_ASSERT_EQUAL(1 + NX_DNS_MAX_RETRIES, dns_test_server.queries);
+    TEST_ASSERT_EQUAL(2, dns_test_records("broker.test", NX_NULL));
+
+    // Back up with a new address, which replaces the stale one and the failure
+    dns_test_server.down = NX_FALSE;
+    dns_test_server.names[0].address = DNS_TEST_OTHER;
+    dns_test_wait(NX_DNS_CACHE_FAILURE_TTL);
+    TEST_ASSERT_EQUAL(NX_SUCCESS, dns_test_lookup("broker.test", &address));
+    TEST_ASSERT_EQUAL(DNS_TEST_OTHER, address);
+    TEST_ASSERT_EQUAL(2 + NX_DNS_MAX_RETRIES, dns_test_server.queries);
+    TEST_ASSERT_EQUAL(1, dns_test_records("broker.test", &rr));
+    TEST_ASSERT_EQUAL(DNS_TEST_OTHER, rr->nx_dns_rr_rdata.nx_dns_rr_rdata_a.nx_dns_rr_a_address);
+
+    // A server that no longer knows the name is believed over the stale answer
+    dns_test_wait(DNS_TEST_TTL);
+    dns_test_server.name_count = 0;
+    TEST_ASSERT_EQUAL(NX_DNS_NAME_ERROR, dns_test_lookup("broker.test", &address));
+    TEST_ASSERT_EQUAL(0, address);
+
+    // Past the stale time nothing is served, and the answer is gone
+    dns_test_server.down = NX_TRUE;
+    dns_test_wait(NX_DNS_CACHE_STALE_TIME);
+    TEST_ASSERT_EQUAL(NX_DNS_QUERY_FAILED, dns_test_lookup("broker.test", &address));
+    TEST_ASSERT_EQUAL(0, address);
+    TEST_ASSERT_EQUAL(1, dns_test_records("broker.test", &rr));
+    TEST_ASSERT_EQUAL(NX_DNS_RR_CLASS_NEGATIVE, rr->nx_dns_rr_class);
+
+    dns_test_teardown();
+}
+
+int main(void)
+{
+    TEST_RUN(test_bucket_chain);
+    TEST_RUN(test_negative);
+    TEST_RUN(test_stale);
+    return TEST_RESULT();
+}
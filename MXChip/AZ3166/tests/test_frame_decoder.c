@@ -0,0 +1,322 @@
+// Frame decoder: the fixed header of an incomplete MQTT packet decoded as it
+// arrives, so a packet split across segments is parsed once, when complete.
+// The benchmark reports the decoder's cost per frame, and the cost of
+// receiving the frame through the client, against frame size and segment
+// count.
+
+#include <string.h>
+
+#include "nxd_mqtt_client.c"
+#include "broker.h"
+#include "test_client.h"
+
+static NXD_MQTT_CLIENT client;
+static BROKER broker;
+static ULONG decoder_pool_available;
+
+static VOID decoder_setup(VOID)
+{
+    memset(&broker, 0, sizeof(broker));
+    test_client_create(&client, 16);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, test_client_connect(&client, &broker));
+    decoder_pool_available = test_pool.nx_packet_pool_available;
+}
+
+static VOID decoder_teardown(VOID)
+{
+    TEST_ASSERT(client.nxd_mqtt_client_processing_packet == NX_NULL);
+    TEST_ASSERT_EQUAL(host_network_pool.nx_packet_pool_total, host_network_pool.nx_packet_pool_available);
+    test_client_delete(&client);
+}
+
+static VOID decoder_reset(VOID)
+{
+    memset(&client.nxd_mqtt_client_frame_decoder, 0, sizeof(NXD_MQTT_FRAME_DECODER));
+}
+
+// Feed the bytes to the decoder one at a time, returning how many it took to complete the packet
+static ULONG decoder_feed(NX_PACKET *packet_ptr, const UCHAR *data, ULONG length)
+{
+    ULONG i;
+
+    for (i = 0; i < length; i++)
+    {
+        TEST_ASSERT_EQUAL(NX_SUCCESS, nx_packet_data_append(packet_ptr, (VOID *)(data + i), 1, &test_pool, NX_NO_WAIT));
+        if (_nxd_mqtt_frame_decode(&client, packet_ptr) == NXD_MQTT_SUCCESS)
+        {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+// Every remaining length encoding, from one to four bytes, decoded a byte at a time
+static VOID test_decode_lengths(VOID)
+{
+    static const ULONG lengths[] = { 0, 1, 127, 128, 300, 16383, 16384, 2097151, 2097152, 268435455 };
+    UCHAR data[600];
+    NX_PACKET *packet_ptr;
+    UINT header_length;
+    UINT i;
+
+    decoder_setup();
+    for (i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++)
+    {
+        decoder_reset();
+        TEST_ASSERT_EQUAL(NX_SUCCESS, nx_packet_allocate(&test_pool, &packet_ptr, NX_RECEIVE_PACKET, NX_NO_WAIT));
+        data[0] = BROKER_PUBLISH << 4;
+        header_length = 1 + broker_length_encode(data + 1, lengths[i]);
+        TEST_ASSERT_EQUAL((lengths[i] < 128) ? 2 : (lengths[i] < 16384) ? 3 : (lengths[i] < 2097152) ? 4 : 5, header_length);
+
+        if (lengths[i] + header_length <= sizeof(data))
+        {
+            // Complete exactly at the last byte of the body
+            memset(data + header_length, 0x5A, lengths[i]);
+            TEST_ASSERT_EQUAL(header_length + lengths[i], decoder_feed(packet_ptr, data, header_length + lengths[i]));
+        }
+        else
+        {
+            // Too long to deliver: the header alone leaves it waiting for the body
+            TEST_ASSERT_EQUAL(0, decoder_feed(packet_ptr, data, header_length));
+        }
+        TEST_ASSERT_EQUAL(header_length, client.nxd_mqtt_client_frame_decoder.nxd_mqtt_frame_decoder_offset);
+        TEST_ASSERT_EQUAL(lengths[i], client.nxd_mqtt_client_frame_decoder.nxd_mqtt_frame_decoder_remaining_length);
+        TEST_ASSERT_EQUAL(header_length + lengths[i], client.nxd_mqtt_client_frame_decoder.nxd_mqtt_frame_decoder_length);
+        nx_packet_release(packet_ptr);
+    }
+    decoder_reset();
+    decoder_teardown();
+}
+
+// A fifth length byte is not decoded: the packet goes to the parser, which rejects it
+static VOID test_decode_overlong(VOID)
+{
+    static const UCHAR overlong[] = { BROKER_PUBLISH << 4, 0x80, 0x80, 0x80, 0x80, 0x01, 0, 1, 'x' };
+    NX_PACKET *packet_ptr;
+
+    decoder_setup();
+    decoder_reset();
+    TEST_ASSERT_EQUAL(NX_SUCCESS, nx_packet_allocate(&test_pool, &packet_ptr, NX_RECEIVE_PACKET, NX_NO_WAIT));
+    TEST_ASSERT_EQUAL(6, decoder_feed(packet_ptr, overlong, sizeof(overlong)));
+    TEST_ASSERT_EQUAL(0, client.nxd_mqtt_client_frame_decoder.nxd_mqtt_frame_decoder_length);
+    nx_packet_release(packet_ptr);
+    decoder_reset();
+
+    // Through the client, split inside the length: dropped, nothing queued or held
+    TEST_ASSERT_EQUAL(NX_SUCCESS, host_tcp_deliver(&client.nxd_mqtt_client_socket, overlong, 3, 0));
+    test_client_run(&client);
+    TEST_ASSERT(client.nxd_mqtt_client_processing_packet != NX_NULL);
+    TEST_ASSERT_EQUAL(NX_SUCCESS, host_tcp_deliver(&client.nxd_mqtt_client_socket, overlong + 3, sizeof(overlong) - 3, 1));
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(0, client.message_receive_queue_depth);
+    TEST_ASSERT_EQUAL(decoder_pool_available, test_pool.nx_packet_pool_available);
+    decoder_teardown();
+}
+
+// Build a stream of packets, the PUBLISH packets with one and two byte remaining lengths
+static ULONG decoder_stream(UCHAR *data, UCHAR *payload, UINT payload_length)
+{
+    static const UCHAR pingresp[] = { BROKER_PINGRESP << 4, 0 };
+    ULONG length = 0;
+
+    length += broker_publish_encode(&broker, data + length, "long", payload, payload_length, 0, 0, 0);
+    memcpy(data + length, pingresp, sizeof(pingresp));
+    length += sizeof(pingresp);
+    length += broker_publish_encode(&broker, data + length, "s", (const UCHAR *)"1", 1, 0, 0, 0);
+    length += broker_publish_encode(&broker, data + length, "medium/topic", payload, 100, 0, 0, 0);
+    return length;
+}
+
+static VOID decoder_expect(const CHAR *topic, const UCHAR *payload, UINT payload_length)
+{
+    UCHAR topic_buffer[32];
+    UCHAR message_buffer[256];
+    ULONG topic_length = 0;
+    ULONG message_length = 0;
+
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_message_get(&client, topic_buffer, sizeof(topic_buffer),
+                                                                     (UINT *)&topic_length, message_buffer,
+                                                                     sizeof(message_buffer), (UINT *)&message_length));
+    TEST_ASSERT_EQUAL(strlen(topic), topic_length);
+    TEST_ASSERT(memcmp(topic_buffer, topic, topic_length) == 0);
+    TEST_ASSERT_EQUAL(payload_length, message_length);
+    TEST_ASSERT(memcmp(message_buffer, payload, payload_length) == 0);
+}
+
+// The same stream cut at every segment size, processed as each segment arrives
+// and with the segments queued before the client runs
+static VOID test_segmentations(VOID)
+{
+    UCHAR payload[200];
+    UCHAR data[400];
+    ULONG length;
+    ULONG segment_size;
+    ULONG offset;
+    ULONG size;
+    UINT i;
+
+    for (i = 0; i < sizeof(payload); i++)
+    {
+        payload[i] = (UCHAR)(i + 1);
+    }
+    decoder_setup();
+    length = decoder_stream(data, payload, sizeof(payload));
+    for (segment_size = 1; segment_size <= length; segment_size++)
+    {
+        for (offset = 0; offset < length; offset += size)
+        {
+            size = ((length - offset) < segment_size) ? (length - offset) : segment_size;
+            TEST_ASSERT_EQUAL(NX_SUCCESS, host_tcp_deliver(&client.nxd_mqtt_client_socket, data + offset, size, 0));
+            test_client_run(&client);
+        }
+        TEST_ASSERT_EQUAL(3, client.message_receive_queue_depth);
+        decoder_expect("long", payload, sizeof(payload));
+        decoder_expect("s", (const UCHAR *)"1", 1);
+        decoder_expect("medium/topic", payload, 100);
+        TEST_ASSERT(client.nxd_mqtt_client_processing_packet == NX_NULL);
+        TEST_ASSERT_EQUAL(host_network_pool.nx_packet_pool_total, host_network_pool.nx_packet_pool_available);
+        TEST_ASSERT_EQUAL(decoder_pool_available, test_pool.nx_packet_pool_available);
+
+        TEST_ASSERT_EQUAL(NX_SUCCESS, host_tcp_deliver(&client.nxd_mqtt_client_socket, data, length, segment_size));
+        test_client_run(&client);
+        TEST_ASSERT_EQUAL(3, client.message_receive_queue_depth);
+        decoder_expect("long", payload, sizeof(payload));
+        decoder_expect("s", (const UCHAR *)"1", 1);
+        decoder_expect("medium/topic", payload, 100);
+    }
+    decoder_teardown();
+}
+
+// A connection closed partway through a packet releases what was waiting for the rest
+static VOID test_truncated(VOID)
+{
+    static const ULONG cuts[] = { 1, 2, 3, 50 };
+    UCHAR payload[200];
+    UCHAR data[400];
+    UINT i;
+
+    memset(payload, 0xA5, sizeof(payload));
+    for (i = 0; i < sizeof(cuts) / sizeof(cuts[0]); i++)
+    {
+        decoder_setup();
+        decoder_stream(data, payload, sizeof(payload));
+        TEST_ASSERT_EQUAL(NX_SUCCESS, host_tcp_deliver(&client.nxd_mqtt_client_socket, data, cuts[i], 0));
+        test_client_run(&client);
+        TEST_ASSERT(client.nxd_mqtt_client_processing_packet != NX_NULL);
+        TEST_ASSERT_EQUAL(0, client.message_receive_queue_depth);
+
+        broker_close(&broker);
+        test_client_run(&client);
+        TEST_ASSERT_EQUAL(NXD_MQTT_CLIENT_STATE_IDLE, client.nxd_mqtt_client_state);
+        TEST_ASSERT(client.nxd_mqtt_client_processing_packet == NX_NULL);
+        TEST_ASSERT_EQUAL(0, client.message_receive_queue_depth);
+        decoder_teardown();
+    }
+}
+
+#define DECODER_BENCH_FRAMES 2000
+
+// Build a QoS 0 PUBLISH of frame_size bytes in all, to "bench"
+static ULONG decoder_bench_frame(UCHAR *data, ULONG frame_size)
+{
+    static UCHAR payload[8192];
+    ULONG payload_length = frame_size - 2 - (frame_size > 129) - 7;
+
+    memset(payload, 0x3C, sizeof(payload));
+    return broker_publish_encode(&broker, data, "bench", payload, (UINT)payload_length, 0, 0, 0);
+}
+
+// The decoder alone: the frame is chained once, and its arrival replayed segment by segment
+// through the packet length, as the receive path grows it. Returns nanoseconds per frame.
+static ULONG64 decoder_bench_decode(const UCHAR *data, ULONG length, ULONG segment_size)
+{
+    NX_PACKET *packet_ptr;
+    ULONG64 start;
+    ULONG64 end;
+    ULONG arrived;
+    UINT i;
+
+    TEST_ASSERT_EQUAL(NX_SUCCESS, nx_packet_allocate(&test_pool, &packet_ptr, NX_RECEIVE_PACKET, NX_NO_WAIT));
+    TEST_ASSERT_EQUAL(NX_SUCCESS, nx_packet_data_append(packet_ptr, (VOID *)data, length, &test_pool, NX_NO_WAIT));
+    start = host_clock_ns();
+    for (i = 0; i < DECODER_BENCH_FRAMES; i++)
+    {
+        decoder_reset();
+        for (arrived = segment_size; arrived < length; arrived += segment_size)
+        {
+            packet_ptr->nx_packet_length = arrived;
+            TEST_ASSERT_EQUAL(NXD_MQTT_PARTIAL_PACKET, _nxd_mqtt_frame_decode(&client, packet_ptr));
+        }
+        packet_ptr->nx_packet_length = length;
+        TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_frame_decode(&client, packet_ptr));
+    }
+    end = host_clock_ns();
+    decoder_reset();
+    nx_packet_release(packet_ptr);
+    return (end - start) / DECODER_BENCH_FRAMES;
+}
+
+// The frame received through the client, delivered in segments and read by the application.
+// Returns nanoseconds per frame.
+static ULONG64 decoder_bench_receive(const UCHAR *data, ULONG length, ULONG segment_size)
+{
+    static UCHAR message[8192];
+    UCHAR topic[8];
+    ULONG topic_length = 0;
+    ULONG message_length = 0;
+    ULONG64 start;
+    ULONG64 end;
+    UINT i;
+
+    start = host_clock_ns();
+    for (i = 0; i < DECODER_BENCH_FRAMES; i++)
+    {
+        TEST_ASSERT_EQUAL(NX_SUCCESS, host_tcp_deliver(&client.nxd_mqtt_client_socket, data, length, segment_size));
+        test_client_run(&client);
+        TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_message_get(&client, topic, sizeof(topic),
+                                                                         (UINT *)&topic_length, message, sizeof(message),
+                                                                         (UINT *)&message_length));
+    }
+    end = host_clock_ns();
+    TEST_ASSERT_EQUAL(5, topic_length);
+    return (end - start) / DECODER_BENCH_FRAMES;
+}
+
+static VOID bench_decode(VOID)
+{
+    static const ULONG frames[] = { 64, 1024, 8192 };
+    static const ULONG segments[] = { 1, 4, 16, 64 };
+    static UCHAR data[8192];
+    ULONG length;
+    ULONG segment_size;
+    UINT i;
+    UINT j;
+
+    decoder_setup();
+    printf("frame bytes  segments  decode ns/frame  receive ns/frame\n");
+    for (i = 0; i < sizeof(frames) / sizeof(frames[0]); i++)
+    {
+        length = decoder_bench_frame(data, frames[i]);
+        TEST_ASSERT_EQUAL(frames[i], length);
+        for (j = 0; j < sizeof(segments) / sizeof(segments[0]); j++)
+        {
+            segment_size = (length + segments[j] - 1) / segments[j];
+            printf("%11lu  %8lu  %15llu  %16llu\n", length, segments[j],
+                   (unsigned long long)decoder_bench_decode(data, length, segment_size),
+                   (unsigned long long)decoder_bench_receive(data, length, segment_size));
+        }
+    }
+    decoder_teardown();
+}
+
+int main(void)
+{
+    // A stream delivered a byte at a time is held a packet per byte until it is read
+    host_network_init(256, 1024);
+    TEST_RUN(test_decode_lengths);
+    TEST_RUN(test_decode_overlong);
+    TEST_RUN(test_segmentations);
+    TEST_RUN(test_truncated);
+    TEST_RUN(bench_decode);
+    return TEST_RESULT();
+}
@@ -0,0 +1,336 @@
+// In-flight table: the open-addressed index of stored QoS 1 and QoS 2 packets
+// by packet ID and type, with backward-shift deletion, and the transmit queue
+// it keeps in order for retransmission.
+
+#include <stdlib.h>
+
+#include "nxd_mqtt_client.c"
+#include "test_client.h"
+
+static NXD_MQTT_CLIENT client;
+
+// Store a packet as the client does once a PUBLISH or PUBREL is sent
+static NX_PACKET *inflight_store(USHORT packet_id, UCHAR packet_type)
+{
+    NX_PACKET *packet_ptr;
+    UCHAR header = (UCHAR)(packet_type << 4);
+
+    if (nx_packet_allocate(&test_pool, &packet_ptr, NX_IPv4_TCP_PACKET, NX_NO_WAIT))
+    {
+        return NX_NULL;
+    }
+    nx_packet_data_append(packet_ptr, &header, 1, &test_pool, NX_NO_WAIT);
+    MQTT_TRANSMIT_INFO(packet_ptr)->nxd_mqtt_transmit_packet_id = packet_id;
+    MQTT_TRANSMIT_INFO(packet_ptr)->nxd_mqtt_transmit_request = 0;
+    MQTT_TRANSMIT_INFO(packet_ptr)->nxd_mqtt_transmit_time = tx_time_get();
+    if (_nxd_mqtt_transmit_queue_append(&client, packet_ptr))
+    {
+        return NX_NULL;
+    }
+    return packet_ptr;
+}
+
+static UINT inflight_home(USHORT packet_id, UCHAR packet_type)
+{
+    return MQTT_INFLIGHT_HASH(packet_id, packet_type);
+}
+
+// Every entry must be reachable from its home slot without crossing an empty slot
+static VOID inflight_check_table(VOID)
+{
+    NXD_MQTT_INFLIGHT_ENTRY *table = client.nxd_mqtt_client_inflight_table;
+    UINT count = 0;
+    UINT index;
+    UINT probe;
+
+    for (index = 0; index < NXD_MQTT_INFLIGHT_TABLE_SIZE; index++)
+    {
+        if (table[index].nxd_mqtt_inflight_packet_ptr == NX_NULL)
+        {
+            continue;
+        }
+        count++;
+        probe = inflight_home(table[index].nxd_mqtt_inflight_packet_id, table[index].nxd_mqtt_inflight_packet_type);
+        while (probe != index)
+        {
+            TEST_ASSERT(table[probe].nxd_mqtt_inflight_packet_ptr != NX_NULL);
+            probe = (probe + 1) & (NXD_MQTT_INFLIGHT_TABLE_SIZE - 1);
+        }
+    }
+    TEST_ASSERT_EQUAL(client.nxd_mqtt_client_inflight_count, count);
+}
+
+// The transmit queue must hold exactly the expected packets, in order, with consistent back links
+static VOID inflight_check_queue(NX_PACKET **expected, UINT count)
+{
+    NX_PACKET *packet_ptr = client.message_transmit_queue_head;
+    NX_PACKET *previous_ptr = NX_NULL;
+    UINT index;
+
+    for (index = 0; index < count; index++)
+    {
+        TEST_ASSERT(packet_ptr == expected[index]);
+        if (packet_ptr == NX_NULL)
+        {
+            return;
+        }
+        TEST_ASSERT(MQTT_TRANSMIT_INFO(packet_ptr)->nxd_mqtt_transmit_previous_ptr == previous_ptr);
+        previous_ptr = packet_ptr;
+        packet_ptr = packet_ptr->nx_packet_queue_next;
+    }
+    TEST_ASSERT(packet_ptr == NX_NULL);
+    TEST_ASSERT(client.message_transmit_queue_tail == previous_ptr);
+}
+
+static VOID test_fill_and_overflow(VOID)
+{
+    NX_PACKET *packets[NXD_MQTT_INFLIGHT_TABLE_SIZE];
+    NX_PACKET *packet_ptr;
+    ULONG available;
+    UINT index;
+
+    test_client_create(&client, 64);
+    client.nxd_mqtt_client_window = NXD_MQTT_INFLIGHT_TABLE_SIZE;
+
+    for (index = 0; index < NXD_MQTT_INFLIGHT_TABLE_SIZE; index++)
+    {
+        packets[index] = inflight_store((USHORT)(index * 7 + 1), MQTT_CONTROL_PACKET_TYPE_PUBLISH);
+        TEST_ASSERT(packets[index] != NX_NULL);
+    }
+    TEST_ASSERT_EQUAL(NXD_MQTT_INFLIGHT_TABLE_SIZE, client.nxd_mqtt_client_inflight_count);
+    TEST_ASSERT_EQUAL(NXD_MQTT_INFLIGHT_TABLE_SIZE, client.nxd_mqtt_client_window_used);
+    inflight_check_table();
+    inflight_check_queue(packets, NXD_MQTT_INFLIGHT_TABLE_SIZE);
+
+    // A full table refuses the packet and releases it
+    nx_packet_allocate(&test_pool, &packet_ptr, NX_IPv4_TCP_PACKET, NX_NO_WAIT);
+    available = test_pool.nx_packet_pool_available;
+    TEST_ASSERT_EQUAL(NX_TX_QUEUE_DEPTH, _nxd_mqtt_transmit_queue_append(&client, packet_ptr));
+    TEST_ASSERT_EQUAL(available + 1, test_pool.nx_packet_pool_available);
+
+    for (index = 0; index < NXD_MQTT_INFLIGHT_TABLE_SIZE; index++)
+    {
+        TEST_ASSERT(_nxd_mqtt_inflight_find(&client, (USHORT)(index * 7 + 1), MQTT_CONTROL_PACKET_TYPE_PUBLISH) == packets[index]);
+    }
+
+    // With every slot taken, a miss must still end
+    TEST_ASSERT(_nxd_mqtt_inflight_find(&client, 9999, MQTT_CONTROL_PACKET_TYPE_PUBLISH) == NX_NULL);
+
+    test_client_delete(&client);
+}
+
+// Entries whose probe sequence runs off the end of the table wrap to slot 0,
+// and deleting from the middle of a cluster shifts the later entries back
+static VOID test_wrap_around_and_delete(VOID)
+{
+    const UINT last = NXD_MQTT_INFLIGHT_TABLE_SIZE - 1;
+    NX_PACKET *packets[5];
+    NX_PACKET *expected[5];
+    USHORT ids[5];
+    UINT index;
+
+    test_client_create(&client, 64);
+    client.nxd_mqtt_client_window = NXD_MQTT_INFLIGHT_TABLE_SIZE;
+
+    // Five IDs with the same home slot, the next to last, fill it, the last and slots 0 to 2
+    for (index = 0; index < 5; index++)
+    {
+        ids[index] = (USHORT)((last - 1) ^ (MQTT_CONTROL_PACKET_TYPE_PUBLISH << 4)) +
+                     (USHORT)(index * NXD_MQTT_INFLIGHT_TABLE_SIZE);
+        TEST_ASSERT_EQUAL(last - 1, inflight_home(ids[index], MQTT_CONTROL_PACKET_TYPE_PUBLISH));
+        packets[index] = inflight_store(ids[index], MQTT_CONTROL_PACKET_TYPE_PUBLISH);
+    }
+    TEST_ASSERT(client.nxd_mqtt_client_inflight_table[0].nxd_mqtt_inflight_packet_ptr == packets[2]);
+    TEST_ASSERT(client.nxd_mqtt_client_inflight_table[2].nxd_mqtt_inflight_packet_ptr == packets[4]);
+    inflight_check_table();
+
+    // Delete the entry in the last slot: the wrapped entries move back across the end
+    _nxd_mqtt_release_transmit_packet(&client, packets[1]);
+    TEST_ASSERT(client.nxd_mqtt_client_inflight_table[last].nxd_mqtt_inflight_packet_ptr == packets[2]);
+    TEST_ASSERT(client.nxd_mqtt_client_inflight_table[1].nxd_mqtt_inflight_packet_ptr == packets[4]);
+    TEST_ASSERT(client.nxd_mqtt_client_inflight_table[2].nxd_mqtt_inflight_packet_ptr == NX_NULL);
+    inflight_check_table();
+    TEST_ASSERT(_nxd_mqtt_inflight_find(&client, ids[1], MQTT_CONTROL_PACKET_TYPE_PUBLISH) == NX_NULL);
+    for (index = 0; index < 5; index++)
+    {
+        if (index != 1)
+        {
+            TEST_ASSERT(_nxd_mqtt_inflight_find(&client, ids[index], MQTT_CONTROL_PACKET_TYPE_PUBLISH) == packets[index]);
+        }
+    }
+    expected[0] = packets[0];
+    expected[1] = packets[2];
+    expected[2] = packets[3];
+    expected[3] = packets[4];
+    inflight_check_queue(expected, 4);
+
+    // An entry at home in slot 0 must not move back past the end of the table
+    packets[1] = inflight_store(MQTT_CONTROL_PACKET_TYPE_PUBLISH << 4, MQTT_CONTROL_PACKET_TYPE_PUBLISH);
+    TEST_ASSERT_EQUAL(0, inflight_home(MQTT_CONTROL_PACKET_TYPE_PUBLISH << 4, MQTT_CONTROL_PACKET_TYPE_PUBLISH));
+    inflight_check_table();
+    _nxd_mqtt_release_transmit_packet(&client, packets[2]);
+    inflight_check_table();
+    TEST_ASSERT(_nxd_mqtt_inflight_find(&client, MQTT_CONTROL_PACKET_TYPE_PUBLISH << 4,
+                                        MQTT_CONTROL_PACKET_TYPE_PUBLISH) == packets[1]);
+
+    // Delete the rest, tail first
+    _nxd_mqtt_release_transmit_packet(&client, packets[1]);
+    _nxd_mqtt_release_transmit_packet(&client, packets[4]);
+    _nxd_mqtt_release_transmit_packet(&client, packets[3]);
+    _nxd_mqtt_release_transmit_packet(&client, packets[0]);
+    TEST_ASSERT_EQUAL(0, client.nxd_mqtt_client_inflight_count);
+    TEST_ASSERT_EQUAL(0, client.nxd_mqtt_client_window_used);
+    TEST_ASSERT(client.message_transmit_queue_head == NX_NULL);
+    TEST_ASSERT(client.message_transmit_queue_tail == NX_NULL);
+    for (index = 0; index < NXD_MQTT_INFLIGHT_TABLE_SIZE; index++)
+    {
+        TEST_ASSERT(client.nxd_mqtt_client_inflight_table[index].nxd_mqtt_inflight_packet_ptr == NX_NULL);
+    }
+
+    test_client_delete(&client);
+}
+
+// A PUBLISH and the PUBREL of the same packet ID are distinct entries, and IDs
+// near the top of their range wrap to 1
+static VOID test_packet_id_wrap_and_type(VOID)
+{
+    NX_PACKET *publish_ptr;
+    NX_PACKET *pubrel_ptr;
+    NX_PACKET *high_ptr;
+    NX_PACKET *low_ptr;
+
+    test_client_create(&client, 64);
+
+    publish_ptr = inflight_store(0xFFFF, MQTT_CONTROL_PACKET_TYPE_PUBLISH);
+    pubrel_ptr = inflight_store(0xFFFF, MQTT_CONTROL_PACKET_TYPE_PUBREL);
+    high_ptr = inflight_store(0xFFFE, MQTT_CONTROL_PACKET_TYPE_PUBLISH);
+    low_ptr = inflight_store(1, MQTT_CONTROL_PACKET_TYPE_PUBLISH);
+
+    TEST_ASSERT(_nxd_mqtt_inflight_find(&client, 0xFFFF, MQTT_CONTROL_PACKET_TYPE_PUBLISH) == publish_ptr);
+    TEST_ASSERT(_nxd_mqtt_inflight_find(&client, 0xFFFF, MQTT_CONTROL_PACKET_TYPE_PUBREL) == pubrel_ptr);
+    TEST_ASSERT(_nxd_mqtt_inflight_find(&client, 0xFFFE, MQTT_CONTROL_PACKET_TYPE_PUBLISH) == high_ptr);
+    TEST_ASSERT(_nxd_mqtt_inflight_find(&client, 1, MQTT_CONTROL_PACKET_TYPE_PUBLISH) == low_ptr);
+    TEST_ASSERT(_nxd_mqtt_inflight_find(&client, 1, MQTT_CONTROL_PACKET_TYPE_PUBREL) == NX_NULL);
+
+    _nxd_mqtt_release_transmit_packet(&client, publish_ptr);
+    TEST_ASSERT(_nxd_mqtt_inflight_find(&client, 0xFFFF, MQTT_CONTROL_PACKET_TYPE_PUBLISH) == NX_NULL);
+    TEST_ASSERT(_nxd_mqtt_inflight_find(&client, 0xFFFF, MQTT_CONTROL_PACKET_TYPE_PUBREL) == pubrel_ptr);
+    inflight_check_table();
+
+    test_client_delete(&client);
+}
+
+// Random stores and releases against a reference list
+static VOID test_random_operations(VOID)
+{
+    NX_PACKET *stored[NXD_MQTT_INFLIGHT_TABLE_SIZE];
+    USHORT stored_ids[NXD_MQTT_INFLIGHT_TABLE_SIZE];
+    UINT count = 0;
+    USHORT next_id = 1;
+    UINT round;
+    UINT index;
+
+    srand(1);
+    test_client_create(&client, 64);
+    client.nxd_mqtt_client_window = NXD_MQTT_INFLIGHT_TABLE_SIZE;
+
+    for (round = 0; round < 20000; round++)
+    {
+        if ((count < NXD_MQTT_INFLIGHT_TABLE_SIZE) && ((count == 0) || (rand() & 1)))
+        {
+            // Packet IDs are handed out in turn, skipping 0, as the client does
+            stored_ids[count] = next_id;
+            stored[count] = inflight_store(next_id, MQTT_CONTROL_PACKET_TYPE_PUBLISH);
+            TEST_ASSERT(stored[count] != NX_NULL);
+            count++;
+            next_id = (USHORT)(next_id + 1 + (rand() % 3));
+            if (next_id == 0)
+            {
+                next_id = 1;
+            }
+        }
+        else
+        {
+            // Acknowledgements arrive in any order
+            index = (UINT)rand() % count;
+            TEST_ASSERT(_nxd_mqtt_inflight_find(&client, stored_ids[index], MQTT_CONTROL_PACKET_TYPE_PUBLISH) == stored[index]);
+            _nxd_mqtt_release_transmit_packet(&client, stored[index]);
+            TEST_ASSERT(_nxd_mqtt_inflight_find(&client, stored_ids[index], MQTT_CONTROL_PACKET_TYPE_PUBLISH) == NX_NULL);
+            count--;
+            memmove(&stored[index], &stored[index + 1], (count - index) * sizeof(stored[0]));
+            memmove(&stored_ids[index], &stored_ids[index + 1], (count - index) * sizeof(stored_ids[0]));
+        }
+        if ((round & 63) == 0)
+        {
+            inflight_check_table();
+            inflight_check_queue(stored, count);
+        }
+    }
+    inflight_check_table();
+    inflight_check_queue(stored, count);
+
+    test_client_delete(&client);
+}
+
+// Cost of finding and releasing the packet an acknowledgement names, by the number in flight
+static VOID bench_ack_cost(VOID)
+{
+    NX_PACKET *stored[NXD_MQTT_INFLIGHT_TABLE_SIZE];
+    USHORT stored_ids[NXD_MQTT_INFLIGHT_TABLE_SIZE];
+    const UINT rounds = 20000;
+    USHORT next_id = 1;
+    UINT depth;
+    UINT round;
+    UINT index;
+    ULONG64 start;
+    ULONG64 elapsed;
+
+    test_client_create(&client, 64);
+    client.nxd_mqtt_client_window = NXD_MQTT_INFLIGHT_TABLE_SIZE;
+
+    printf("   in flight   ns per ack\n");
+    for (depth = 1; depth <= NXD_MQTT_INFLIGHT_TABLE_SIZE; depth *= 2)
+    {
+        for (index = 0; index < depth; index++)
+        {
+            stored_ids[index] = next_id;
+            stored[index] = inflight_store(next_id++, MQTT_CONTROL_PACKET_TYPE_PUBLISH);
+        }
+
+        // Acknowledge the oldest and store a new one, keeping the depth
+        elapsed = 0;
+        for (round = 0; round < rounds; round++)
+        {
+            index = round % depth;
+            start = host_clock_ns();
+            _nxd_mqtt_release_transmit_packet(&client, _nxd_mqtt_inflight_find(&client, stored_ids[index],
+                                                                                MQTT_CONTROL_PACKET_TYPE_PUBLISH));
+            elapsed += host_clock_ns() - start;
+            if (next_id == 0)
+            {
+                next_id = 1;
+            }
+            stored_ids[index] = next_id;
+            stored[index] = inflight_store(next_id++, MQTT_CONTROL_PACKET_TYPE_PUBLISH);
+        }
+        printf("   %9u   %10.1f\n", depth, (double)elapsed / rounds);
+
+        for (index = 0; index < depth; index++)
+        {
+            _nxd_mqtt_release_transmit_packet(&client, stored[index]);
+        }
+        TEST_ASSERT_EQUAL(0, client.nxd_mqtt_client_inflight_count);
+    }
+
+    test_client_delete(&client);
+}
+
+int main(void)
+{
+    TEST_RUN(test_fill_and_overflow);
+    TEST_RUN(test_wrap_around_and_delete);
+    TEST_RUN(test_packet_id_wrap_and_type);
+    TEST_RUN(test_random_operations);
+    TEST_RUN(bench_ack_cost);
+    return TEST_RESULT();
+}
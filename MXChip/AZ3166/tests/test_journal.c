@@ -0,0 +1,356 @@
+// Offline journal: messages published during an outage kept in a ring of
+// records and sent in order once reconnected, the oldest evicted when the ring
+// is full, only the newest kept of a last-value topic, padding at the end of
+// the ring, and the drain held to its rate.
+
+#include <string.h>
+
+#include "nxd_mqtt_client.c"
+#include "broker.h"
+#include "test_client.h"
+
+#define JOURNAL_TABLE_SIZE (sizeof(NXD_MQTT_JOURNAL_TOPIC) * NXD_MQTT_JOURNAL_TOPIC_COUNT)
+#define JOURNAL_HEADER     sizeof(NXD_MQTT_JOURNAL_RECORD)
+
+static NXD_MQTT_CLIENT client;
+static BROKER broker;
+static ULONG journal_buffer[(JOURNAL_TABLE_SIZE + 4096) / sizeof(ULONG)];
+static CHAR journal_large_message[4096];
+static UINT journal_log_start;
+
+// Connect, then set a journal whose ring is ring_size bytes
+static VOID journal_setup(ULONG ring_size, UINT rate)
+{
+    memset(&broker, 0, sizeof(broker));
+    test_client_create(&client, 24);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, test_client_connect(&client, &broker));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_journal_set(&client, journal_buffer,
+                                                                     JOURNAL_TABLE_SIZE + ring_size, rate));
+    TEST_ASSERT_EQUAL(ring_size, client.nxd_mqtt_client_journal_size);
+}
+
+static VOID journal_teardown(VOID)
+{
+    test_client_delete(&client);
+}
+
+static UINT journal_publish(const CHAR *topic, const CHAR *message, UINT qos)
+{
+    return _nxd_mqtt_client_publish(&client, (CHAR *)topic, (UINT)strlen(topic), (CHAR *)message,
+                                    (UINT)strlen(message), 0, qos, NX_NO_WAIT);
+}
+
+// The broker goes away; what is published from now on is journaled
+static VOID journal_outage(VOID)
+{
+    broker_close(&broker);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(NXD_MQTT_CLIENT_STATE_IDLE, client.nxd_mqtt_client_state);
+    journal_log_start = broker.log_count;
+}
+
+// Wake the client, as any event does, to drain what the rate allows by now
+static VOID journal_wake(VOID)
+{
+    tx_event_flags_set(&client.nxd_mqtt_events, MQTT_TIMEOUT_EVENT, TX_OR);
+    test_client_run(&client);
+}
+
+static VOID journal_reconnect(VOID)
+{
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, test_client_connect(&client, &broker));
+    journal_wake();
+}
+
+// The messages the broker received since the outage, in order
+static VOID journal_expect(const CHAR *topic, const CHAR **messages, UINT count)
+{
+    BROKER_PACKET *packet_ptr;
+    UINT i;
+    UINT n = 0;
+
+    for (i = journal_log_start; i < broker.log_count; i++)
+    {
+        packet_ptr = &broker.log[i];
+        if (packet_ptr->type != BROKER_PUBLISH)
+        {
+            continue;
+        }
+        TEST_ASSERT(n < count);
+        if (n >= count)
+        {
+            return;
+        }
+        TEST_ASSERT_EQUAL(strlen(topic), packet_ptr->topic_length);
+        TEST_ASSERT(memcmp(packet_ptr->topic, topic, packet_ptr->topic_length) == 0);
+        TEST_ASSERT_EQUAL(strlen(messages[n]), packet_ptr->payload_length);
+        TEST_ASSERT(memcmp(packet_ptr->payload, messages[n], packet_ptr->payload_length) == 0);
+        n++;
+    }
+    TEST_ASSERT_EQUAL(count, n);
+}
+
+static UINT journal_published(VOID)
+{
+    UINT i;
+    UINT n = 0;
+
+    for (i = journal_log_start; i < broker.log_count; i++)
+    {
+        n += (broker.log[i].type == BROKER_PUBLISH);
+    }
+    return n;
+}
+
+static VOID journal_expect_empty(VOID)
+{
+    TEST_ASSERT_EQUAL(0, client.nxd_mqtt_client_journal_used);
+    TEST_ASSERT_EQUAL(0, client.nxd_mqtt_client_journal_head);
+    TEST_ASSERT_EQUAL(0, client.nxd_mqtt_client_journal_tail);
+    TEST_ASSERT_EQUAL(0, client.nxd_mqtt_client_journal_topics[0].nxd_mqtt_journal_topic_records);
+}
+
+// Published during an outage at QoS 0 and 1, sent in order on reconnect
+static VOID test_outage(VOID)
+{
+    static const CHAR *messages[] = { "m0", "m1", "m2", "m3", "m4" };
+    UINT i;
+
+    journal_setup(1024, 0);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, journal_publish("t/1", "live", 0));
+    TEST_ASSERT_EQUAL(1, broker_count(&broker, BROKER_PUBLISH));
+
+    journal_outage();
+    for (i = 0; i < 5; i++)
+    {
+        TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, journal_publish("t/1", messages[i], i & 1));
+    }
+    TEST_ASSERT_EQUAL(5 * (JOURNAL_HEADER + 4), client.nxd_mqtt_client_journal_used);
+    TEST_ASSERT_EQUAL(5, client.nxd_mqtt_client_journal_topics[0].nxd_mqtt_journal_topic_records);
+    TEST_ASSERT_EQUAL(0, journal_published());
+
+    journal_reconnect();
+    journal_expect("t/1", messages, 5);
+    for (i = 0; i < 5; i++)
+    {
+        TEST_ASSERT_EQUAL(i & 1, (broker.log[broker.log_count - 5 + i].flags >> 1) & 3);
+    }
+    TEST_ASSERT_EQUAL(0, client.nxd_mqtt_client_inflight_count);
+    TEST_ASSERT_EQUAL(0, client.nxd_mqtt_client_journal_dropped);
+    journal_expect_empty();
+
+    // Connected with nothing journaled, a publish goes straight out
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, journal_publish("t/1", "after", 0));
+    TEST_ASSERT_EQUAL(6, journal_published());
+    journal_expect_empty();
+    journal_teardown();
+}
+
+// A full ring evicts the oldest message of any topic, counting it as dropped
+static VOID test_drop_oldest(VOID)
+{
+    static const CHAR *messages[] = { "m2", "m3", "m4", "m5" };
+    CHAR message[4];
+    UINT i;
+
+    // Four records of a header and a four byte message
+    journal_setup(4 * (JOURNAL_HEADER + 4), 0);
+    journal_outage();
+    for (i = 0; i < 6; i++)
+    {
+        snprintf(message, sizeof(message), "m%u", i);
+        TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, journal_publish("t/1", message, 1));
+        TEST_ASSERT_EQUAL((i < 4) ? 0 : i - 3, client.nxd_mqtt_client_journal_dropped);
+    }
+    TEST_ASSERT_EQUAL(client.nxd_mqtt_client_journal_size, client.nxd_mqtt_client_journal_used);
+    TEST_ASSERT_EQUAL(4, client.nxd_mqtt_client_journal_topics[0].nxd_mqtt_journal_topic_records);
+
+    // A message larger than the ring is refused rather than emptying it
+    TEST_ASSERT_EQUAL(NXD_MQTT_INSUFFICIENT_BUFFER_SPACE,
+                      _nxd_mqtt_client_publish(&client, "t/1", 3, journal_large_message,
+                                               (UINT)client.nxd_mqtt_client_journal_size, 0, 1, NX_NO_WAIT));
+    TEST_ASSERT_EQUAL(2, client.nxd_mqtt_client_journal_dropped);
+
+    journal_reconnect();
+    journal_expect("t/1", messages, 4);
+    journal_expect_empty();
+    journal_teardown();
+}
+
+// Only the newest message of a last-value topic is sent; the others keep their order,
+// and a superseded message evicted is not counted as dropped
+static VOID test_last_value(VOID)
+{
+    static const CHAR *events[] = { "e1", "e2" };
+    BROKER_PACKET *packet_ptr;
+    UINT i;
+
+    journal_setup(1024, 0);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_journal_topic_set(&client, "state", 5, NXD_MQTT_JOURNAL_LAST_VALUE));
+    journal_outage();
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, journal_publish("state", "s1", 1));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, journal_publish("event", "e1", 1));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, journal_publish("state", "s2", 1));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, journal_publish("event", "e2", 1));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, journal_publish("state", "s3", 1));
+
+    journal_reconnect();
+    TEST_ASSERT_EQUAL(3, journal_published());
+    for (i = journal_log_start; (i < broker.log_count) && (broker.log[i].type != BROKER_PUBLISH); i++)
+    {
+    }
+    packet_ptr = &broker.log[i];
+    TEST_ASSERT(memcmp(packet_ptr->payload, "e1", 2) == 0);
+    packet_ptr = broker_last(&broker, BROKER_PUBLISH);
+    TEST_ASSERT(memcmp(packet_ptr->topic, "state", 5) == 0);
+    TEST_ASSERT(memcmp(packet_ptr->payload, "s3", 2) == 0);
+    journal_expect_empty();
+    TEST_ASSERT_EQUAL(0, client.nxd_mqtt_client_journal_dropped);
+
+    // In a ring of three records, the superseded s1 and s2 make room without a drop
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_journal_set(&client, journal_buffer,
+                                                                     JOURNAL_TABLE_SIZE + 3 * (JOURNAL_HEADER + 4), 0));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_journal_topic_set(&client, "state", 5, NXD_MQTT_JOURNAL_LAST_VALUE));
+    journal_outage();
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, journal_publish("state", "s1", 1));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, journal_publish("state", "s2", 1));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, journal_publish("event", "e1", 1));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, journal_publish("event", "e2", 1));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, journal_publish("state", "s3", 1));
+    TEST_ASSERT_EQUAL(0, client.nxd_mqtt_client_journal_dropped);
+
+    journal_reconnect();
+    TEST_ASSERT_EQUAL(3, journal_published());
+    packet_ptr = broker_last(&broker, BROKER_PUBLISH);
+    TEST_ASSERT(memcmp(packet_ptr->payload, "s3", 2) == 0);
+    TEST_ASSERT(memcmp(broker.log[broker.log_count - 3].payload, events[0], 2) == 0);
+    TEST_ASSERT(memcmp(broker.log[broker.log_count - 2].payload, events[1], 2) == 0);
+    journal_expect_empty();
+    journal_teardown();
+}
+
+// The end of the ring too short for a record header: the gap is counted in use, with no
+// padding record, and skipped by the head
+static VOID test_wrap_short_gap(VOID)
+{
+    static const CHAR *messages[] = { "12-bytes-b00", "12-bytes-c00", "d" };
+    static const CHAR *more[] = { "e", "f" };
+
+    // Three records of 20 bytes leave 4 at the end of a 64 byte ring
+    journal_setup(64, 0);
+    journal_outage();
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, journal_publish("t/1", "12-bytes-a00", 0));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, journal_publish("t/1", "12-bytes-b00", 0));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, journal_publish("t/1", "12-bytes-c00", 0));
+    TEST_ASSERT_EQUAL(60, client.nxd_mqtt_client_journal_tail);
+    TEST_ASSERT(client.nxd_mqtt_client_journal_size - client.nxd_mqtt_client_journal_tail < JOURNAL_HEADER);
+
+    // A 12 byte record does not fit in the 4: the oldest goes, and the record wraps to the front
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, journal_publish("t/1", "d", 0));
+    TEST_ASSERT_EQUAL(1, client.nxd_mqtt_client_journal_dropped);
+    TEST_ASSERT_EQUAL(20, client.nxd_mqtt_client_journal_head);
+    TEST_ASSERT_EQUAL(12, client.nxd_mqtt_client_journal_tail);
+    TEST_ASSERT_EQUAL(40 + 4 + 12, client.nxd_mqtt_client_journal_used);
+
+    journal_reconnect();
+    journal_expect("t/1", messages, 3);
+    journal_expect_empty();
+
+    // The ring starts over at the front once empty
+    journal_outage();
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, journal_publish("t/1", "e", 0));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, journal_publish("t/1", "f", 0));
+    TEST_ASSERT_EQUAL(24, client.nxd_mqtt_client_journal_tail);
+    journal_reconnect();
+    journal_expect("t/1", more, 2);
+    journal_expect_empty();
+    journal_teardown();
+}
+
+// Room for a header at the end of the ring: a padding record covers it
+static VOID test_wrap_padding_record(VOID)
+{
+    static const CHAR *messages[] = { "x-12-bytes-c", "d" };
+    NXD_MQTT_JOURNAL_RECORD *record_ptr;
+
+    // Two records of 24 bytes leave 16 at the end of a 64 byte ring
+    journal_setup(64, 0);
+    journal_outage();
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, journal_publish("t/1", "16-bytes-a000000", 0));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, journal_publish("t/1", "16-bytes-b000000", 0));
+    TEST_ASSERT_EQUAL(48, client.nxd_mqtt_client_journal_tail);
+
+    // A 20 byte record: the oldest goes to make room at the front
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, journal_publish("t/1", "x-12-bytes-c", 0));
+    TEST_ASSERT_EQUAL(1, client.nxd_mqtt_client_journal_dropped);
+    record_ptr = MQTT_JOURNAL_RECORD(&client, 48);
+    TEST_ASSERT_EQUAL(MQTT_JOURNAL_SKIP, record_ptr->nxd_mqtt_journal_record_topic);
+    TEST_ASSERT_EQUAL(16, record_ptr->nxd_mqtt_journal_record_length);
+    TEST_ASSERT_EQUAL(24, client.nxd_mqtt_client_journal_head);
+    TEST_ASSERT_EQUAL(20, client.nxd_mqtt_client_journal_tail);
+    TEST_ASSERT_EQUAL(24 + 16 + 20, client.nxd_mqtt_client_journal_used);
+
+    // Four bytes short of the head: the oldest goes, leaving the padding record as the head
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, journal_publish("t/1", "d", 0));
+    TEST_ASSERT_EQUAL(2, client.nxd_mqtt_client_journal_dropped);
+    TEST_ASSERT_EQUAL(48, client.nxd_mqtt_client_journal_head);
+    TEST_ASSERT_EQUAL(32, client.nxd_mqtt_client_journal_tail);
+    TEST_ASSERT_EQUAL(16 + 20 + 12, client.nxd_mqtt_client_journal_used);
+
+    journal_reconnect();
+    journal_expect("t/1", messages, 2);
+    journal_expect_empty();
+    journal_teardown();
+}
+
+// At a rate of five messages a second: a second's worth at once, then one per 200 ms,
+// with messages published meanwhile queued behind
+static VOID test_drain_rate(VOID)
+{
+    CHAR message[4];
+    UINT i;
+
+    journal_setup(1024, 5);
+    journal_outage();
+    for (i = 0; i < 10; i++)
+    {
+        snprintf(message, sizeof(message), "m%u", i);
+        TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, journal_publish("t/1", message, 0));
+    }
+
+    journal_reconnect();
+    TEST_ASSERT_EQUAL(5, journal_published());
+
+    // Connected with messages still journaled, a new one goes behind them
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, journal_publish("t/1", "m10", 0));
+    TEST_ASSERT_EQUAL(5, journal_published());
+
+    host_time_advance(NX_IP_PERIODIC_RATE / 10);
+    journal_wake();
+    TEST_ASSERT_EQUAL(5, journal_published());
+    host_time_advance(NX_IP_PERIODIC_RATE / 10);
+    journal_wake();
+    TEST_ASSERT_EQUAL(6, journal_published());
+    host_time_advance(NX_IP_PERIODIC_RATE / 5);
+    journal_wake();
+    TEST_ASSERT_EQUAL(7, journal_published());
+
+    // A long wait refills only a second's worth
+    host_time_advance(10 * NX_IP_PERIODIC_RATE);
+    journal_wake();
+    TEST_ASSERT_EQUAL(11, journal_published());
+    TEST_ASSERT(memcmp(broker_last(&broker, BROKER_PUBLISH)->payload, "m10", 3) == 0);
+    journal_expect_empty();
+    journal_teardown();
+}
+
+int main(void)
+{
+    TEST_RUN(test_outage);
+    TEST_RUN(test_drop_oldest);
+    TEST_RUN(test_last_value);
+    TEST_RUN(test_wrap_short_gap);
+    TEST_RUN(test_wrap_padding_record);
+    TEST_RUN(test_drain_rate);
+    return TEST_RESULT();
+}
@@ -0,0 +1,225 @@
+// Lease sector: leases and host addresses are appended as records to one
+// flash sector, the latest of each kind wins, and a record cut short by a
+// reset is skipped. A write leaving few erased slots wakes the lease thread,
+// which erases the sector and writes back the latest record of each kind; a
+// write finding the sector full does the same itself. Runs on the RAM sector
+// of the host port, linked in as _slease to _elease, where the lease thread
+// is not started and the tests compact in its place.
+
+#include <string.h>
+
+#include "dhcp_lease.c"
+#include "test.h"
+
+#define LEASE_HOST       "broker.test"
+#define LEASE_ADDRESS    IP_ADDRESS(10, 0, 0, 1)
+
+// Records the sector holds; it need not be a whole number of them
+#define LEASE_SLOTS      ((UINT)(HOST_FLASH_SECTOR_SIZE / sizeof(DHCP_LEASE_RECORD)))
+
+static VOID lease_setup(VOID)
+{
+    host_flash_reset();
+    dhcp_lease_compact_semaphore.tx_semaphore_count = 0;
+}
+
+static DHCP_LEASE lease_make(ULONG host)
+{
+    DHCP_LEASE lease;
+
+    memset(&lease, 0, sizeof(lease));
+    lease.ip_address = IP_ADDRESS(192, 168, 0, host);
+    lease.network_mask = 0xFFFFFF00;
+    lease.gateway_address = IP_ADDRESS(192, 168, 0, 1);
+    lease.server_ip = IP_ADDRESS(192, 168, 0, 1);
+    return lease;
+}
+
+static VOID lease_expect(ULONG host)
+{
+    DHCP_LEASE expected = lease_make(host);
+    DHCP_LEASE lease;
+
+    TEST_ASSERT_EQUAL(NX_SUCCESS, dhcp_lease_load(&lease));
+    TEST_ASSERT(memcmp(&lease, &expected, sizeof(lease)) == 0);
+}
+
+static VOID lease_expect_host(ULONG expected)
+{
+    ULONG address = 0;
+
+    TEST_ASSERT_EQUAL(NX_SUCCESS, dns_host_load(LEASE_HOST, &address));
+    TEST_ASSERT_EQUAL(expected, address);
+}
+
+// An erased sector has neither kind; each loads as saved, and saving the same data again writes nothing
+static VOID test_save_load(VOID)
+{
+    DHCP_LEASE lease = lease_make(100);
+    ULONG address;
+    UINT programs;
+
+    lease_setup();
+    TEST_ASSERT(LEASE_SLOTS >= 4);
+    TEST_ASSERT_EQUAL(NX_NOT_FOUND, dhcp_lease_load(&lease));
+    TEST_ASSERT_EQUAL(NX_NOT_FOUND, dns_host_load(LEASE_HOST, &address));
+
+    lease = lease_make(100);
+    TEST_ASSERT_EQUAL(NX_SUCCESS, dhcp_lease_save(&lease));
+    TEST_ASSERT_EQUAL(NX_SUCCESS, dns_host_save(LEASE_HOST, LEASE_ADDRESS));
+    lease_expect(100);
+    lease_expect_host(LEASE_ADDRESS);
+    TEST_ASSERT_EQUAL(NX_NOT_FOUND, dns_host_load("other.test", &address));
+
+    programs = host_flash_programs;
+    TEST_ASSERT_EQUAL(NX_SUCCESS, dhcp_lease_save(&lease));
+    TEST_ASSERT_EQUAL(NX_SUCCESS, dns_host_save(LEASE_HOST, LEASE_ADDRESS));
+    TEST_ASSERT_EQUAL(programs, host_flash_programs);
+
+    // A new lease is appended, and wins
+    lease = lease_make(101);
+    TEST_ASSERT_EQUAL(NX_SUCCESS, dhcp_lease_save(&lease));
+    TEST_ASSERT(host_flash_programs > programs);
+    lease_expect(101);
+    lease_expect_host(LEASE_ADDRESS);
+    TEST_ASSERT_EQUAL(0, host_flash_erases);
+}
+
+// A record whose magic was never programmed is skipped, and the next one goes after it
+static VOID test_torn_record(VOID)
+{
+    DHCP_LEASE lease = lease_make(100);
+
+    lease_setup();
+    TEST_ASSERT_EQUAL(NX_SUCCESS, dhcp_lease_save(&lease));
+
+    // A reset cut the second save short, after its first word
+    HAL_FLASH_Unlock();
+    TEST_ASSERT_EQUAL(HAL_OK, HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, (uint32_t)(uintptr_t)&_slease[1], 0));
+    HAL_FLASH_Lock();
+    lease_expect(100);
+
+    lease = lease_make(102);
+    TEST_ASSERT_EQUAL(NX_SUCCESS, dhcp_lease_save(&lease));
+    TEST_ASSERT_EQUAL(DHCP_LEASE_MAGIC, _slease[2].magic);
+    lease_expect(102);
+}
+
+// A write leaving fewer than DHCP_LEASE_SPARE erased slots wakes the lease thread, and the
+// compaction keeps the latest record of each kind, so saving goes on without an erase
+static VOID test_compact(VOID)
+{
+    DHCP_LEASE lease;
+    UINT i;
+
+    lease_setup();
+    TEST_ASSERT(LEASE_SLOTS > DHCP_LEASE_SPARE + 2);
+    TEST_ASSERT_EQUAL(NX_SUCCESS, dns_host_save(LEASE_HOST, LEASE_ADDRESS));
+    for (i = 1; i < LEASE_SLOTS - DHCP_LEASE_SPARE; i++)
+    {
+        lease = lease_make(100 + i);
+        TEST_ASSERT_EQUAL(NX_SUCCESS, dhcp_lease_save(&lease));
+    }
+    TEST_ASSERT_EQUAL(0, dhcp_lease_compact_semaphore.tx_semaphore_count);
+
+    lease = lease_make(200);
+    TEST_ASSERT_EQUAL(NX_SUCCESS, dhcp_lease_save(&lease));
+    TEST_ASSERT_EQUAL(1, dhcp_lease_compact_semaphore.tx_semaphore_count);
+    TEST_ASSERT_EQUAL(0, host_flash_erases);
+
+    // Woken again before it ran, the thread still compacts once
+    lease = lease_make(201);
+    TEST_ASSERT_EQUAL(NX_SUCCESS, dhcp_lease_save(&lease));
+    TEST_ASSERT_EQUAL(1, dhcp_lease_compact_semaphore.tx_semaphore_count);
+
+    TEST_ASSERT_EQUAL(TX_SUCCESS, tx_semaphore_get(&dhcp_lease_compact_semaphore, TX_NO_WAIT));
+    TEST_ASSERT_EQUAL(NX_SUCCESS, dhcp_lease_compact());
+    TEST_ASSERT_EQUAL(1, host_flash_erases);
+    TEST_ASSERT_EQUAL(DHCP_LEASE_MAGIC, _slease[0].magic);
+    TEST_ASSERT_EQUAL(DNS_HOST_MAGIC, _slease[1].magic);
+    TEST_ASSERT(dhcp_lease_is_erased(&_slease[2]));
+    lease_expect(201);
+    lease_expect_host(LEASE_ADDRESS);
+
+    lease = lease_make(202);
+    TEST_ASSERT_EQUAL(NX_SUCCESS, dhcp_lease_save(&lease));
+    TEST_ASSERT_EQUAL(NX_SUCCESS, dns_host_save(LEASE_HOST, LEASE_ADDRESS + 1));
+    TEST_ASSERT_EQUAL(1, host_flash_erases);
+    TEST_ASSERT_EQUAL(0, dhcp_lease_compact_semaphore.tx_semaphore_count);
+    lease_expect(202);
+    lease_expect_host(LEASE_ADDRESS + 1);
+}
+
+// When the thread has not caught up, the write finding the sector full erases it itself, and the
+// latest records of both kinds are written back ahead of the new one
+static VOID test_sector_full(VOID)
+{
+    DHCP_LEASE lease;
+    UINT i;
+
+    lease_setup();
+    TEST_ASSERT_EQUAL(NX_SUCCESS, dns_host_save(LEASE_HOST, LEASE_ADDRESS));
+    for (i = 1; i < LEASE_SLOTS; i++)
+    {
+        lease = lease_make(100 + i);
+        TEST_ASSERT_EQUAL(NX_SUCCESS, dhcp_lease_save(&lease));
+    }
+    TEST_ASSERT_EQUAL(0, host_flash_erases);
+    TEST_ASSERT_EQUAL(DHCP_LEASE_MAGIC, _slease[LEASE_SLOTS - 1].magic);
+
+    lease = lease_make(200);
+    TEST_ASSERT_EQUAL(NX_SUCCESS, dhcp_lease_save(&lease));
+    TEST_ASSERT_EQUAL(1, host_flash_erases);
+    TEST_ASSERT_EQUAL(DHCP_LEASE_MAGIC, _slease[0].magic);
+    TEST_ASSERT_EQUAL(DNS_HOST_MAGIC, _slease[1].magic);
+    TEST_ASSERT_EQUAL(DHCP_LEASE_MAGIC, _slease[2].magic);
+    TEST_ASSERT(dhcp_lease_is_erased(&_slease[3]));
+    lease_expect(200);
+    lease_expect_host(LEASE_ADDRESS);
+
+    // The other way around: host addresses fill it, and the lease is carried over
+    for (i = 3; i < LEASE_SLOTS; i++)
+    {
+        TEST_ASSERT_EQUAL(NX_SUCCESS, dns_host_save(LEASE_HOST, LEASE_ADDRESS + i));
+    }
+    TEST_ASSERT_EQUAL(1, host_flash_erases);
+    TEST_ASSERT_EQUAL(NX_SUCCESS, dns_host_save(LEASE_HOST, LEASE_ADDRESS + 100));
+    TEST_ASSERT_EQUAL(2, host_flash_erases);
+    TEST_ASSERT_EQUAL(DHCP_LEASE_MAGIC, _slease[0].magic);
+    TEST_ASSERT_EQUAL(DNS_HOST_MAGIC, _slease[1].magic);
+    TEST_ASSERT_EQUAL(DNS_HOST_MAGIC, _slease[2].magic);
+    lease_expect(200);
+    lease_expect_host(LEASE_ADDRESS + 100);
+}
+
+// A sector full of one kind alone has only that kind to carry over
+static VOID test_sector_full_alone(VOID)
+{
+    DHCP_LEASE lease;
+    ULONG address;
+    UINT i;
+
+    lease_setup();
+    for (i = 0; i <= LEASE_SLOTS; i++)
+    {
+        lease = lease_make(100 + i);
+        TEST_ASSERT_EQUAL(NX_SUCCESS, dhcp_lease_save(&lease));
+    }
+    TEST_ASSERT_EQUAL(1, host_flash_erases);
+    TEST_ASSERT_EQUAL(DHCP_LEASE_MAGIC, _slease[0].magic);
+    TEST_ASSERT_EQUAL(DHCP_LEASE_MAGIC, _slease[1].magic);
+    TEST_ASSERT(dhcp_lease_is_erased(&_slease[2]));
+    lease_expect(100 + LEASE_SLOTS);
+    TEST_ASSERT_EQUAL(NX_NOT_FOUND, dns_host_load(LEASE_HOST, &address));
+}
+
+int main(void)
+{
+    TEST_ASSERT_EQUAL(TX_SUCCESS, dhcp_lease_init());
+    TEST_RUN(test_save_load);
+    TEST_RUN(test_torn_record);
+    TEST_RUN(test_compact);
+    TEST_RUN(test_sector_full);
+    TEST_RUN(test_sector_full_alone);
+    return TEST_RESULT();
+}
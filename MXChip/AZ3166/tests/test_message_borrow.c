@@ -0,0 +1,218 @@
+// Borrowed messages: the topic and payload of a queued message read in place
+// with message_span_get, as one span when the part lies in one packet of the
+// chain and span by span when it does not, until message_release returns the
+// segment. No buffer caps what can be borrowed.
+
+#include <string.h>
+
+#include "nxd_mqtt_client.c"
+#include "broker.h"
+#include "test_client.h"
+
+static NXD_MQTT_CLIENT client;
+static BROKER broker;
+
+static VOID borrow_setup(VOID)
+{
+    memset(&broker, 0, sizeof(broker));
+    test_client_create(&client, 16);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, test_client_connect(&client, &broker));
+}
+
+static VOID borrow_teardown(VOID)
+{
+    TEST_ASSERT_EQUAL(0, client.message_receive_queue_depth);
+    TEST_ASSERT_EQUAL(host_network_pool.nx_packet_pool_total, host_network_pool.nx_packet_pool_available);
+    test_client_delete(&client);
+}
+
+// Gather a part of a borrowed message span by span, returning the number of spans
+static UINT borrow_read(NXD_MQTT_MESSAGE *message_ptr, UINT part, UCHAR *buffer, ULONG size, ULONG *length_ptr)
+{
+    UCHAR *span;
+    ULONG span_length;
+    UINT spans = 0;
+
+    *length_ptr = 0;
+    for (;;)
+    {
+        TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_message_span_get(message_ptr, part, *length_ptr,
+                                                                              &span, &span_length));
+        if (span_length == 0)
+        {
+            TEST_ASSERT(span == NX_NULL);
+            return spans;
+        }
+        TEST_ASSERT(*length_ptr + span_length <= size);
+        if (*length_ptr + span_length > size)
+        {
+            return spans;
+        }
+        memcpy(buffer + *length_ptr, span, span_length);
+        *length_ptr += span_length;
+        spans++;
+    }
+}
+
+// A message too large for the caller's buffers stays queued for message_get, and is borrowed whole,
+// each part in one span
+static VOID test_beyond_buffers(VOID)
+{
+    CHAR topic[300];
+    UCHAR payload[1000];
+    UCHAR topic_buffer[16];
+    UCHAR message_buffer[16];
+    UCHAR copy[1000];
+    ULONG topic_length;
+    ULONG message_length;
+    ULONG length;
+    NXD_MQTT_MESSAGE message;
+    UINT i;
+
+    borrow_setup();
+    memset(topic, 't', sizeof(topic) - 1);
+    topic[sizeof(topic) - 1] = 0;
+    for (i = 0; i < sizeof(payload); i++)
+    {
+        payload[i] = (UCHAR)(i * 13);
+    }
+    broker_publish(&broker, topic, payload, sizeof(payload), 0, 0, 0);
+    test_client_run(&client);
+
+    // The lengths are written as ULONG, which is the size of a UINT on the target
+    TEST_ASSERT_EQUAL(NXD_MQTT_INSUFFICIENT_BUFFER_SPACE,
+                      _nxd_mqtt_client_message_get(&client, topic_buffer, sizeof(topic_buffer), (UINT *)&topic_length,
+                                                   message_buffer, sizeof(message_buffer), (UINT *)&message_length));
+    TEST_ASSERT_EQUAL(1, client.message_receive_queue_depth);
+
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_message_borrow(&client, &message));
+    TEST_ASSERT_EQUAL(0, client.message_receive_queue_depth);
+    TEST_ASSERT_EQUAL(1, borrow_read(&message, NXD_MQTT_MESSAGE_TOPIC, copy, sizeof(copy), &length));
+    TEST_ASSERT_EQUAL(strlen(topic), length);
+    TEST_ASSERT(memcmp(copy, topic, length) == 0);
+    TEST_ASSERT_EQUAL(1, borrow_read(&message, NXD_MQTT_MESSAGE_PAYLOAD, copy, sizeof(copy), &length));
+    TEST_ASSERT_EQUAL(sizeof(payload), length);
+    TEST_ASSERT(memcmp(copy, payload, length) == 0);
+
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_message_release(&client, &message));
+    borrow_teardown();
+}
+
+// Topic and payload spread over the packets of a chain are read in one span per packet, and an
+// empty payload ends at once
+static VOID test_split_parts(VOID)
+{
+    CHAR topic[100];
+    UCHAR copy[100];
+    ULONG length;
+    NXD_MQTT_MESSAGE message;
+    UCHAR *span;
+    ULONG span_length;
+    UINT i;
+
+    borrow_setup();
+    for (i = 0; i < sizeof(topic) - 1; i++)
+    {
+        topic[i] = (CHAR)('a' + i % 26);
+    }
+    topic[sizeof(topic) - 1] = 0;
+    broker.segment_size = 16;
+    broker_publish(&broker, topic, (const UCHAR *)"0123456789abcdefghijklmnopqrstuvwxyz", 36, 0, 0, 0);
+    broker_publish(&broker, "empty", (const UCHAR *)"", 0, 0, 0, 0);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(2, client.message_receive_queue_depth);
+
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_message_borrow(&client, &message));
+    TEST_ASSERT(borrow_read(&message, NXD_MQTT_MESSAGE_TOPIC, copy, sizeof(copy), &length) >= (sizeof(topic) - 1) / 16);
+    TEST_ASSERT_EQUAL(strlen(topic), length);
+    TEST_ASSERT(memcmp(copy, topic, length) == 0);
+    TEST_ASSERT(borrow_read(&message, NXD_MQTT_MESSAGE_PAYLOAD, copy, sizeof(copy), &length) >= 36 / 16);
+    TEST_ASSERT_EQUAL(36, length);
+    TEST_ASSERT(memcmp(copy, "0123456789abcdefghijklmnopqrstuvwxyz", 36) == 0);
+
+    // Read from the middle of a part, the span stops at the end of its packet
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_message_span_get(&message, NXD_MQTT_MESSAGE_PAYLOAD, 20,
+                                                                          &span, &span_length));
+    TEST_ASSERT((span_length > 0) && (span_length <= 16));
+    TEST_ASSERT(memcmp(span, "klmnopqrstuvwxyz", span_length) == 0);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_message_release(&client, &message));
+
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_message_borrow(&client, &message));
+    TEST_ASSERT_EQUAL(0, borrow_read(&message, NXD_MQTT_MESSAGE_PAYLOAD, copy, sizeof(copy), &length));
+    TEST_ASSERT_EQUAL(0, length);
+    TEST_ASSERT_EQUAL(1, borrow_read(&message, NXD_MQTT_MESSAGE_TOPIC, copy, sizeof(copy), &length));
+    TEST_ASSERT(memcmp(copy, "empty", 5) == 0);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_message_release(&client, &message));
+    borrow_teardown();
+}
+
+// A borrowed message stays readable while later messages arrive, are queued and are taken out,
+// and keeps only its own segment
+static VOID test_outlives_receives(VOID)
+{
+    NXD_MQTT_MESSAGE message;
+    UCHAR topic_buffer[16];
+    UCHAR message_buffer[16];
+    ULONG topic_length;
+    ULONG message_length;
+    UCHAR copy[16];
+    ULONG length;
+    UINT i;
+
+    borrow_setup();
+    broker_publish(&broker, "kept", (const UCHAR *)"first", 5, 0, 0, 0);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_message_borrow(&client, &message));
+
+    for (i = 0; i < 4; i++)
+    {
+        broker_publish(&broker, "later", (const UCHAR *)"next", 4, 0, 0, 0);
+        test_client_run(&client);
+        TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS,
+                          _nxd_mqtt_client_message_get(&client, topic_buffer, sizeof(topic_buffer), (UINT *)&topic_length,
+                                                       message_buffer, sizeof(message_buffer), (UINT *)&message_length));
+    }
+    TEST_ASSERT_EQUAL(1, host_network_pool.nx_packet_pool_total - host_network_pool.nx_packet_pool_available);
+
+    borrow_read(&message, NXD_MQTT_MESSAGE_PAYLOAD, copy, sizeof(copy), &length);
+    TEST_ASSERT_EQUAL(5, length);
+    TEST_ASSERT(memcmp(copy, "first", 5) == 0);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_message_release(&client, &message));
+    borrow_teardown();
+}
+
+// The checked calls refuse a message that is not borrowed, and a part that does not exist
+static VOID test_error_checks(VOID)
+{
+    NXD_MQTT_MESSAGE message;
+    UCHAR *span;
+    ULONG span_length;
+
+    borrow_setup();
+    TEST_ASSERT_EQUAL(NX_PTR_ERROR, _nxde_mqtt_client_message_borrow(&client, NX_NULL));
+    TEST_ASSERT_EQUAL(NXD_MQTT_NO_MESSAGE, _nxde_mqtt_client_message_borrow(&client, &message));
+
+    broker_publish(&broker, "t", (const UCHAR *)"x", 1, 0, 0, 0);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxde_mqtt_client_message_borrow(&client, &message));
+    TEST_ASSERT_EQUAL(NXD_MQTT_INVALID_PARAMETER, _nxde_mqtt_client_message_span_get(&message, 7, 0, &span, &span_length));
+    TEST_ASSERT_EQUAL(NX_PTR_ERROR, _nxde_mqtt_client_message_span_get(&message, NXD_MQTT_MESSAGE_TOPIC, 0,
+                                                                       NX_NULL, &span_length));
+    TEST_ASSERT_EQUAL(NXD_MQTT_INVALID_PARAMETER, _nxde_mqtt_client_message_span_get(&message, NXD_MQTT_MESSAGE_TOPIC, 2,
+                                                                                     &span, &span_length));
+
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxde_mqtt_client_message_release(&client, &message));
+    TEST_ASSERT_EQUAL(NX_PTR_ERROR, _nxde_mqtt_client_message_span_get(&message, NXD_MQTT_MESSAGE_TOPIC, 0,
+                                                                       &span, &span_length));
+    TEST_ASSERT_EQUAL(NX_PTR_ERROR, _nxde_mqtt_client_message_release(&client, &message));
+    borrow_teardown();
+}
+
+int main(void)
+{
+    TEST_RUN(test_beyond_buffers);
+    TEST_RUN(test_split_parts);
+    TEST_RUN(test_outlives_receives);
+    TEST_RUN(test_error_checks);
+    return TEST_RESULT();
+}
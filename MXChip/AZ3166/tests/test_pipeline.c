@@ -0,0 +1,157 @@
+// Pipelined connect: with pipelining on, a non-blocking connect sends the
+// submitted subscribe requests right behind CONNECT, in the same pass of the
+// MQTT thread, without waiting for CONNACK. An accepted CONNACK lets their
+// SUBACKs complete them; a refused one completes them with
+// NXD_MQTT_NOT_CONNECTED and ends the connection, leaving the client ready to
+// connect again without pipelining.
+
+#include <string.h>
+
+#include "nxd_mqtt_client.c"
+#include "broker.h"
+#include "test_client.h"
+
+#define PIPELINE_SUBSCRIBES 2
+
+static NXD_MQTT_CLIENT client;
+static BROKER broker;
+static UINT pipeline_handles[PIPELINE_SUBSCRIBES];
+static UINT pipeline_statuses[PIPELINE_SUBSCRIBES];
+static UINT pipeline_completed;
+static UINT pipeline_connect_status;
+
+static VOID pipeline_complete(NXD_MQTT_CLIENT *client_ptr, UINT handle, UINT status, VOID *context)
+{
+    UINT i;
+
+    (void)client_ptr;
+    (void)context;
+    for (i = 0; i < PIPELINE_SUBSCRIBES; i++)
+    {
+        if (pipeline_handles[i] == handle)
+        {
+            pipeline_statuses[i] = status;
+            pipeline_completed++;
+        }
+    }
+}
+
+static VOID pipeline_connect_notify(NXD_MQTT_CLIENT *client_ptr, UINT status, VOID *context)
+{
+    (void)client_ptr;
+    (void)context;
+    pipeline_connect_status = status;
+}
+
+// Submit the subscribes and start a non-blocking connect, then run the one pass of the MQTT
+// thread that sends CONNECT, which the broker answers at once
+static VOID pipeline_start(UCHAR connack_return_code)
+{
+    static CHAR *topics[PIPELINE_SUBSCRIBES] = { "cmd/1", "cmd/2" };
+    NXD_ADDRESS server_ip;
+    ULONG events;
+    UINT i;
+
+    memset(&broker, 0, sizeof(broker));
+    broker.connack_return_code = connack_return_code;
+    pipeline_completed = 0;
+    pipeline_connect_status = NXD_MQTT_INTERNAL_ERROR;
+    test_client_create(&client, 16);
+    client.nxd_mqtt_connect_notify = pipeline_connect_notify;
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_pipeline_set(&client, NX_TRUE));
+
+    for (i = 0; i < PIPELINE_SUBSCRIBES; i++)
+    {
+        pipeline_statuses[i] = NXD_MQTT_INTERNAL_ERROR;
+        TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_subscribe_async(&client, topics[i], strlen(topics[i]), 1,
+                                                                             pipeline_complete, NX_NULL,
+                                                                             &pipeline_handles[i]));
+    }
+
+    server_ip.nxd_ip_version = NX_IP_VERSION_V4;
+    server_ip.nxd_ip_address.v4 = IP_ADDRESS(127, 0, 0, 1);
+    broker_attach(&broker, &client.nxd_mqtt_client_socket);
+    TEST_ASSERT_EQUAL(NX_IN_PROGRESS, _nxd_mqtt_client_connect(&client, &server_ip, 1883, 0, NX_TRUE, NX_NO_WAIT));
+
+    TEST_ASSERT_EQUAL(TX_SUCCESS, tx_event_flags_get(&client.nxd_mqtt_events, MQTT_ALL_EVENTS, TX_OR_CLEAR, &events,
+                                                     TX_NO_WAIT));
+    TEST_ASSERT(events & MQTT_TCP_ESTABLISH_EVENT);
+    _nxd_mqtt_client_event_process(&client, NX_NULL, events);
+
+    // The subscribes went out behind CONNECT, ahead of the CONNACK waiting in the socket
+    TEST_ASSERT_EQUAL(NX_TRUE, client.nxd_mqtt_client_pipelining);
+    TEST_ASSERT(client.nxd_mqtt_client_state != NXD_MQTT_CLIENT_STATE_CONNECTED);
+    TEST_ASSERT_EQUAL(1 + PIPELINE_SUBSCRIBES, broker.log_count);
+    TEST_ASSERT_EQUAL(BROKER_CONNECT, broker.log[0].type);
+    for (i = 0; i < PIPELINE_SUBSCRIBES; i++)
+    {
+        TEST_ASSERT_EQUAL(BROKER_SUBSCRIBE, broker.log[1 + i].type);
+    }
+    TEST_ASSERT_EQUAL(NXD_MQTT_INITIAL_PACKET_ID_VALUE ? NXD_MQTT_INITIAL_PACKET_ID_VALUE : 1, broker.log[1].packet_id);
+    TEST_ASSERT_EQUAL(0, pipeline_completed);
+}
+
+// An accepted CONNACK connects the client, and the SUBACKs complete the subscribes
+static VOID test_accepted(VOID)
+{
+    UINT i;
+
+    pipeline_start(0);
+    test_client_run(&client);
+
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, pipeline_connect_status);
+    TEST_ASSERT_EQUAL(NXD_MQTT_CLIENT_STATE_CONNECTED, client.nxd_mqtt_client_state);
+    TEST_ASSERT_EQUAL(NX_FALSE, client.nxd_mqtt_client_pipelining);
+    TEST_ASSERT_EQUAL(PIPELINE_SUBSCRIBES, pipeline_completed);
+    for (i = 0; i < PIPELINE_SUBSCRIBES; i++)
+    {
+        TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, pipeline_statuses[i]);
+    }
+    TEST_ASSERT(client.message_transmit_queue_head == NX_NULL);
+
+    // Nothing was sent twice
+    TEST_ASSERT_EQUAL(1, broker_count(&broker, BROKER_CONNECT));
+    TEST_ASSERT_EQUAL(PIPELINE_SUBSCRIBES, broker_count(&broker, BROKER_SUBSCRIBE));
+
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_disconnect(&client));
+    test_client_run(&client);
+    test_client_delete(&client);
+}
+
+// A refused CONNACK completes the pipelined subscribes with an error, and ends the connection
+// with pipelining reset, so a later connect does not send ahead of its CONNACK
+static VOID test_refused(VOID)
+{
+    UINT i;
+
+    pipeline_start(5);
+    test_client_run(&client);
+
+    TEST_ASSERT_EQUAL(NXD_MQTT_ERROR_CONNECT_RETURN_CODE + 5, pipeline_connect_status);
+    TEST_ASSERT_EQUAL(NXD_MQTT_CLIENT_STATE_IDLE, client.nxd_mqtt_client_state);
+    TEST_ASSERT_EQUAL(NX_FALSE, client.nxd_mqtt_client_pipelining);
+    TEST_ASSERT_EQUAL(PIPELINE_SUBSCRIBES, pipeline_completed);
+    for (i = 0; i < PIPELINE_SUBSCRIBES; i++)
+    {
+        TEST_ASSERT_EQUAL(NXD_MQTT_NOT_CONNECTED, pipeline_statuses[i]);
+    }
+    TEST_ASSERT(client.message_transmit_queue_head == NX_NULL);
+    TEST_ASSERT_EQUAL(0, client.nxd_mqtt_client_inflight_count);
+
+    // A blocking connect waits for its CONNACK
+    broker.connack_return_code = 0;
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, test_client_connect(&client, &broker));
+    TEST_ASSERT_EQUAL(NX_FALSE, client.nxd_mqtt_client_pipelining);
+    TEST_ASSERT_EQUAL(PIPELINE_SUBSCRIBES, broker_count(&broker, BROKER_SUBSCRIBE));
+
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_disconnect(&client));
+    test_client_run(&client);
+    test_client_delete(&client);
+}
+
+int main(void)
+{
+    TEST_RUN(test_accepted);
+    TEST_RUN(test_refused);
+    return TEST_RESULT();
+}
@@ -0,0 +1,165 @@
+// Asynchronous publish: a message queued without blocking, built and sent by
+// the MQTT thread, and completed through its callback once the client is done
+// with it: QoS 0 on hand-off to the socket, QoS 1 on PUBACK, QoS 2 on PUBCOMP,
+// and with NXD_MQTT_NOT_CONNECTED when it is dropped undelivered. A request
+// the pool has no packet for waits on the ring for the next event.
+
+#include <string.h>
+
+#include "nxd_mqtt_client.c"
+#include "broker.h"
+#include "test_client.h"
+
+#define ASYNC_PACKETS 16
+
+static NXD_MQTT_CLIENT client;
+static BROKER broker;
+
+// Completions, by the context given with each request
+static UINT async_statuses[3];
+static UINT async_handles[3];
+static UINT async_completed;
+
+static VOID async_complete(NXD_MQTT_CLIENT *client_ptr, UINT handle, UINT status, VOID *context)
+{
+    UINT index = (UINT)(size_t)context;
+
+    TEST_ASSERT(client_ptr == &client);
+    TEST_ASSERT_EQUAL(async_handles[index], handle);
+    async_statuses[index] = status;
+    async_completed++;
+}
+
+static VOID async_setup(VOID)
+{
+    UINT i;
+
+    memset(&broker, 0, sizeof(broker));
+    for (i = 0; i < 3; i++)
+    {
+        async_statuses[i] = NXD_MQTT_INTERNAL_ERROR;
+    }
+    async_completed = 0;
+    test_client_create(&client, ASYNC_PACKETS);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, test_client_connect(&client, &broker));
+    broker.hold = NX_TRUE;
+}
+
+static UINT async_publish(UINT index, UINT QoS)
+{
+    static CHAR message[] = "on";
+
+    return _nxd_mqtt_client_publish_async(&client, "a/1", 3, message, 2, NX_FALSE, QoS, async_complete,
+                                          (VOID *)(size_t)index, &async_handles[index]);
+}
+
+// Each QoS completes at its own point of the exchange
+static VOID test_completion_points(VOID)
+{
+    USHORT qos1_id;
+    USHORT qos2_id;
+
+    async_setup();
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, async_publish(0, 0));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, async_publish(1, 1));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, async_publish(2, 2));
+    TEST_ASSERT(async_handles[0] && async_handles[1] && async_handles[2]);
+
+    // Nothing is sent until the MQTT thread runs
+    TEST_ASSERT_EQUAL(0, broker_count(&broker, BROKER_PUBLISH));
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(3, broker_count(&broker, BROKER_PUBLISH));
+    TEST_ASSERT_EQUAL(1, async_completed);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, async_statuses[0]);
+    qos1_id = broker.log[2].packet_id;
+    qos2_id = broker.log[3].packet_id;
+
+    broker_ack(&broker, BROKER_PUBACK, qos1_id);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(2, async_completed);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, async_statuses[1]);
+
+    // PUBREC is not the end of a QoS 2 exchange
+    broker_ack(&broker, BROKER_PUBREC, qos2_id);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(1, broker_count(&broker, BROKER_PUBREL));
+    TEST_ASSERT_EQUAL(2, async_completed);
+    broker_ack(&broker, BROKER_PUBCOMP, qos2_id);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(3, async_completed);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, async_statuses[2]);
+
+    test_client_delete(&client);
+}
+
+// With the pool drained the publish still returns at once, and the request waits on the ring
+// until an event after packets are back
+static VOID test_out_of_packets(VOID)
+{
+    NX_PACKET *drained[ASYNC_PACKETS];
+    UINT drained_count = 0;
+
+    async_setup();
+    while ((drained_count < ASYNC_PACKETS) &&
+           (nx_packet_allocate(&test_pool, &drained[drained_count], NX_IPv4_TCP_PACKET, NX_NO_WAIT) == NX_SUCCESS))
+    {
+        drained_count++;
+    }
+
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, async_publish(0, 0));
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(0, broker_count(&broker, BROKER_PUBLISH));
+    TEST_ASSERT_EQUAL(0, async_completed);
+    TEST_ASSERT(MQTT_REQUEST_PENDING(&client));
+
+    while (drained_count)
+    {
+        nx_packet_release(drained[--drained_count]);
+    }
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(0, broker_count(&broker, BROKER_PUBLISH));
+
+    // A timer tick retries it
+    tx_event_flags_set(&client.nxd_mqtt_events, MQTT_TIMEOUT_EVENT, TX_OR);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(1, broker_count(&broker, BROKER_PUBLISH));
+    TEST_ASSERT_EQUAL(1, async_completed);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, async_statuses[0]);
+    TEST_ASSERT(!MQTT_REQUEST_PENDING(&client));
+
+    test_client_delete(&client);
+}
+
+// A QoS 1 message sent but not acknowledged outlives a disconnect, and is dropped by the next
+// connect with a clean session, completing as undelivered
+static VOID test_dropped_undelivered(VOID)
+{
+    async_setup();
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, async_publish(1, 1));
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(1, broker_count(&broker, BROKER_PUBLISH));
+    TEST_ASSERT_EQUAL(0, async_completed);
+
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_disconnect(&client));
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(0, async_completed);
+
+    broker.hold = NX_FALSE;
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, test_client_connect(&client, &broker));
+    TEST_ASSERT_EQUAL(1, async_completed);
+    TEST_ASSERT_EQUAL(NXD_MQTT_NOT_CONNECTED, async_statuses[1]);
+    TEST_ASSERT_EQUAL(1, broker_count(&broker, BROKER_PUBLISH));
+
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_disconnect(&client));
+    test_client_run(&client);
+
+    test_client_delete(&client);
+}
+
+int main(void)
+{
+    TEST_RUN(test_completion_points);
+    TEST_RUN(test_out_of_packets);
+    TEST_RUN(test_dropped_undelivered);
+    return TEST_RESULT();
+}
@@ -0,0 +1,278 @@
+// QoS 2: the PUBLISH, PUBREC, PUBREL, PUBCOMP exchange in both directions
+// against the broker stand-in, the in-flight entries it moves through, and
+// the set of received packet IDs awaiting PUBREL.
+
+#include <string.h>
+
+#include "nxd_mqtt_client.c"
+#include "broker.h"
+#include "test_client.h"
+
+static NXD_MQTT_CLIENT client;
+static BROKER broker;
+static ULONG qos2_pool_available;
+
+// Acknowledgements the client reported, in order
+static UINT qos2_acks[16];
+static USHORT qos2_ack_ids[16];
+static UINT qos2_ack_count;
+
+static VOID qos2_ack_notify(NXD_MQTT_CLIENT *client_ptr, UINT type, USHORT packet_id, NX_PACKET *transmit_packet_ptr,
+                            VOID *context)
+{
+    (void)client_ptr;
+    (void)transmit_packet_ptr;
+    (void)context;
+    if (qos2_ack_count < 16)
+    {
+        qos2_acks[qos2_ack_count] = type;
+        qos2_ack_ids[qos2_ack_count++] = packet_id;
+    }
+}
+
+static VOID qos2_setup(UINT hold)
+{
+    memset(&broker, 0, sizeof(broker));
+    qos2_ack_count = 0;
+    test_client_create(&client, 24);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, test_client_connect(&client, &broker));
+    client.nxd_mqtt_ack_receive_notify = qos2_ack_notify;
+    broker.hold = hold;
+    qos2_pool_available = test_pool.nx_packet_pool_available;
+}
+
+static VOID qos2_teardown(VOID)
+{
+    TEST_ASSERT_EQUAL(host_network_pool.nx_packet_pool_total, host_network_pool.nx_packet_pool_available);
+    test_client_delete(&client);
+}
+
+static UINT qos2_publish(const CHAR *topic, const CHAR *message)
+{
+    return _nxd_mqtt_client_publish(&client, (CHAR *)topic, (UINT)strlen(topic), (CHAR *)message, (UINT)strlen(message),
+                                    0, 2, NX_NO_WAIT);
+}
+
+static VOID qos2_get(const CHAR *payload)
+{
+    UCHAR topic[32];
+    UCHAR message[32];
+    ULONG topic_length;
+    ULONG message_length;
+
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_message_get(&client, topic, sizeof(topic), (UINT *)&topic_length,
+                                                                     message, sizeof(message), (UINT *)&message_length));
+    TEST_ASSERT_EQUAL(strlen(payload), message_length);
+    TEST_ASSERT(memcmp(message, payload, message_length) == 0);
+}
+
+// The exchange one step at a time: PUBLISH stored, replaced by PUBREL on PUBREC, released on PUBCOMP
+static VOID test_outbound_exchange(VOID)
+{
+    BROKER_PACKET *publish_ptr;
+    USHORT packet_id;
+
+    qos2_setup(NX_TRUE);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, qos2_publish("socket/1", "on"));
+    publish_ptr = broker_last(&broker, BROKER_PUBLISH);
+    TEST_ASSERT(publish_ptr != NX_NULL);
+    packet_id = publish_ptr->packet_id;
+    TEST_ASSERT_EQUAL(0x04, publish_ptr->flags & 0x06);
+    TEST_ASSERT(packet_id != 0);
+    TEST_ASSERT(_nxd_mqtt_inflight_find(&client, packet_id, MQTT_CONTROL_PACKET_TYPE_PUBLISH) != NX_NULL);
+    TEST_ASSERT_EQUAL(1, client.nxd_mqtt_client_inflight_count);
+
+    // PUBACK does not complete a QoS 2 message
+    broker_ack(&broker, BROKER_PUBACK, packet_id);
+    test_client_run(&client);
+    TEST_ASSERT(_nxd_mqtt_inflight_find(&client, packet_id, MQTT_CONTROL_PACKET_TYPE_PUBLISH) != NX_NULL);
+
+    broker_ack(&broker, BROKER_PUBREC, packet_id);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(1, broker_count(&broker, BROKER_PUBREL));
+    TEST_ASSERT_EQUAL(packet_id, broker_last(&broker, BROKER_PUBREL)->packet_id);
+    TEST_ASSERT_EQUAL(0x02, broker_last(&broker, BROKER_PUBREL)->flags);
+    TEST_ASSERT(_nxd_mqtt_inflight_find(&client, packet_id, MQTT_CONTROL_PACKET_TYPE_PUBLISH) == NX_NULL);
+    TEST_ASSERT(_nxd_mqtt_inflight_find(&client, packet_id, MQTT_CONTROL_PACKET_TYPE_PUBREL) != NX_NULL);
+    TEST_ASSERT_EQUAL(1, client.nxd_mqtt_client_inflight_count);
+
+    // A repeated PUBREC is answered with the same PUBREL
+    broker_ack(&broker, BROKER_PUBREC, packet_id);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(2, broker_count(&broker, BROKER_PUBREL));
+    TEST_ASSERT_EQUAL(1, client.nxd_mqtt_client_inflight_count);
+
+    broker_ack(&broker, BROKER_PUBCOMP, packet_id);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(0, client.nxd_mqtt_client_inflight_count);
+    TEST_ASSERT(client.message_transmit_queue_head == NX_NULL);
+    TEST_ASSERT_EQUAL(qos2_pool_available, test_pool.nx_packet_pool_available);
+
+    // A late PUBREC or PUBCOMP for a completed exchange is ignored
+    broker_ack(&broker, BROKER_PUBREC, packet_id);
+    broker_ack(&broker, BROKER_PUBCOMP, packet_id);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(2, broker_count(&broker, BROKER_PUBREL));
+
+    // The application hears of each stored packet's acknowledgement once
+    TEST_ASSERT_EQUAL(2, qos2_ack_count);
+    TEST_ASSERT_EQUAL(MQTT_CONTROL_PACKET_TYPE_PUBREC, qos2_acks[0]);
+    TEST_ASSERT_EQUAL(MQTT_CONTROL_PACKET_TYPE_PUBCOMP, qos2_acks[1]);
+    TEST_ASSERT_EQUAL(packet_id, qos2_ack_ids[1]);
+    qos2_teardown();
+}
+
+// With the broker answering, each exchange completes and its packet ID can be used again
+static VOID test_packet_id_reuse(VOID)
+{
+    USHORT first_id;
+    UINT i;
+
+    qos2_setup(NX_FALSE);
+
+    // Across the wrap, skipping zero
+    client.nxd_mqtt_client_packet_identifier = 0xFFFE;
+    for (i = 0; i < 3; i++)
+    {
+        TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, qos2_publish("socket/1", "toggle"));
+        test_client_run(&client);
+    }
+    TEST_ASSERT_EQUAL(3, broker_count(&broker, BROKER_PUBLISH));
+    TEST_ASSERT_EQUAL(3, broker_count(&broker, BROKER_PUBREL));
+    TEST_ASSERT_EQUAL(0xFFFE, broker.log[1].packet_id);
+    TEST_ASSERT_EQUAL(1, broker_last(&broker, BROKER_PUBLISH)->packet_id);
+    TEST_ASSERT_EQUAL(0, client.nxd_mqtt_client_inflight_count);
+
+    // The same ID again, once PUBCOMP has freed it
+    first_id = broker.log[1].packet_id;
+    client.nxd_mqtt_client_packet_identifier = first_id;
+    broker.hold = NX_TRUE;
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, qos2_publish("socket/1", "again"));
+    TEST_ASSERT_EQUAL(first_id, broker_last(&broker, BROKER_PUBLISH)->packet_id);
+    TEST_ASSERT(_nxd_mqtt_inflight_find(&client, first_id, MQTT_CONTROL_PACKET_TYPE_PUBLISH) != NX_NULL);
+    broker_ack(&broker, BROKER_PUBREC, first_id);
+    test_client_run(&client);
+    broker_ack(&broker, BROKER_PUBCOMP, first_id);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(0, client.nxd_mqtt_client_inflight_count);
+
+    // Many exchanges in a row leave nothing behind
+    broker.hold = NX_FALSE;
+    for (i = 0; i < 60; i++)
+    {
+        TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, qos2_publish("socket/1", "x"));
+        test_client_run(&client);
+    }
+    TEST_ASSERT_EQUAL(0, client.nxd_mqtt_client_inflight_count);
+    TEST_ASSERT_EQUAL(qos2_pool_available, test_pool.nx_packet_pool_available);
+    qos2_teardown();
+}
+
+// A received QoS 2 message is delivered once, however often the broker sends it before PUBREL
+static VOID test_inbound_duplicates(VOID)
+{
+    qos2_setup(NX_TRUE);
+    broker_publish(&broker, "cmd", (const UCHAR *)"first", 5, 2, 7, 0);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(1, client.message_receive_queue_depth);
+    TEST_ASSERT_EQUAL(1, broker_count(&broker, BROKER_PUBREC));
+    TEST_ASSERT_EQUAL(7, broker_last(&broker, BROKER_PUBREC)->packet_id);
+    TEST_ASSERT_EQUAL(1, client.nxd_mqtt_client_qos2_receive_count);
+
+    // Retransmissions are acknowledged again but not delivered
+    broker_publish(&broker, "cmd", (const UCHAR *)"first", 5, 2, 7, 1);
+    broker_publish(&broker, "cmd", (const UCHAR *)"first", 5, 2, 7, 1);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(1, client.message_receive_queue_depth);
+    TEST_ASSERT_EQUAL(3, broker_count(&broker, BROKER_PUBREC));
+
+    // Another ID is another message
+    broker_publish(&broker, "cmd", (const UCHAR *)"second", 6, 2, 8, 0);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(2, client.message_receive_queue_depth);
+    TEST_ASSERT_EQUAL(2, client.nxd_mqtt_client_qos2_receive_count);
+
+    // PUBREL forgets the ID and is answered with PUBCOMP
+    broker_ack(&broker, BROKER_PUBREL, 7);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(1, broker_count(&broker, BROKER_PUBCOMP));
+    TEST_ASSERT_EQUAL(7, broker_last(&broker, BROKER_PUBCOMP)->packet_id);
+    TEST_ASSERT_EQUAL(1, client.nxd_mqtt_client_qos2_receive_count);
+    TEST_ASSERT(_nxd_mqtt_qos2_receive_find(&client, 7) == NXD_MQTT_QOS2_RECEIVE_SET_SIZE);
+    TEST_ASSERT(_nxd_mqtt_qos2_receive_find(&client, 8) != NXD_MQTT_QOS2_RECEIVE_SET_SIZE);
+
+    // The ID is free for a new message after PUBCOMP
+    broker_publish(&broker, "cmd", (const UCHAR *)"third", 5, 2, 7, 0);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(3, client.message_receive_queue_depth);
+
+    // A PUBREL for an unknown ID is still completed. MQTT-4.3.3-2
+    broker_ack(&broker, BROKER_PUBREL, 99);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(2, broker_count(&broker, BROKER_PUBCOMP));
+    TEST_ASSERT_EQUAL(99, broker_last(&broker, BROKER_PUBCOMP)->packet_id);
+
+    qos2_get("first");
+    qos2_get("second");
+    qos2_get("third");
+    broker_ack(&broker, BROKER_PUBREL, 8);
+    broker_ack(&broker, BROKER_PUBREL, 7);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(0, client.nxd_mqtt_client_qos2_receive_count);
+    TEST_ASSERT_EQUAL(qos2_pool_available, test_pool.nx_packet_pool_available);
+    qos2_teardown();
+}
+
+// With every slot of the set awaiting PUBREL, a new message is left unacknowledged for redelivery
+static VOID test_inbound_set_full(VOID)
+{
+    CHAR payload[8];
+    UINT i;
+
+    qos2_setup(NX_TRUE);
+    for (i = 1; i <= NXD_MQTT_QOS2_RECEIVE_SET_SIZE; i++)
+    {
+        sprintf(payload, "%u", i);
+        broker_publish(&broker, "cmd", (const UCHAR *)payload, (UINT)strlen(payload), 2, (USHORT)(i * 4096 + 1), 0);
+        test_client_run(&client);
+        qos2_get(payload);
+    }
+    TEST_ASSERT_EQUAL(NXD_MQTT_QOS2_RECEIVE_SET_SIZE, client.nxd_mqtt_client_qos2_receive_count);
+    TEST_ASSERT_EQUAL(NXD_MQTT_QOS2_RECEIVE_SET_SIZE, broker_count(&broker, BROKER_PUBREC));
+
+    broker_publish(&broker, "cmd", (const UCHAR *)"late", 4, 2, 3, 0);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(0, client.message_receive_queue_depth);
+    TEST_ASSERT_EQUAL(NXD_MQTT_QOS2_RECEIVE_SET_SIZE, broker_count(&broker, BROKER_PUBREC));
+
+    // Duplicates of the tracked messages are still recognised
+    broker_publish(&broker, "cmd", (const UCHAR *)"1", 1, 2, 4097, 1);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(0, client.message_receive_queue_depth);
+    TEST_ASSERT_EQUAL(NXD_MQTT_QOS2_RECEIVE_SET_SIZE + 1, broker_count(&broker, BROKER_PUBREC));
+
+    // One PUBREL makes room, and the redelivered message goes through
+    broker_ack(&broker, BROKER_PUBREL, 4097);
+    broker_publish(&broker, "cmd", (const UCHAR *)"late", 4, 2, 3, 1);
+    test_client_run(&client);
+    qos2_get("late");
+    TEST_ASSERT_EQUAL(3, broker_last(&broker, BROKER_PUBREC)->packet_id);
+
+    for (i = 2; i <= NXD_MQTT_QOS2_RECEIVE_SET_SIZE; i++)
+    {
+        broker_ack(&broker, BROKER_PUBREL, (USHORT)(i * 4096 + 1));
+    }
+    broker_ack(&broker, BROKER_PUBREL, 3);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(0, client.nxd_mqtt_client_qos2_receive_count);
+    qos2_teardown();
+}
+
+int main(void)
+{
+    TEST_RUN(test_outbound_exchange);
+    TEST_RUN(test_packet_id_reuse);
+    TEST_RUN(test_inbound_duplicates);
+    TEST_RUN(test_inbound_set_full);
+    return TEST_RESULT();
+}
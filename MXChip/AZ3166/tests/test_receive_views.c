@@ -0,0 +1,297 @@
+// Receive views: PUBLISH packets queued in place in the segment they arrived
+// in, the reference counted segment records they share, and the split of a
+// partial MQTT packet at the end of a segment.
+
+#include <string.h>
+
+#include "nxd_mqtt_client.c"
+#include "broker.h"
+#include "test_client.h"
+
+static NXD_MQTT_CLIENT client;
+static BROKER broker;
+
+// Packets of the client's pool free once connected, less the control packets it keeps in reserve
+static ULONG views_pool_available;
+
+static VOID views_setup(VOID)
+{
+    memset(&broker, 0, sizeof(broker));
+    test_client_create(&client, 16);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, test_client_connect(&client, &broker));
+    views_pool_available = test_pool.nx_packet_pool_available;
+}
+
+// Delete the client once the network packets are all back in the driver's pool
+static VOID views_teardown(VOID)
+{
+    TEST_ASSERT_EQUAL(host_network_pool.nx_packet_pool_total, host_network_pool.nx_packet_pool_available);
+    test_client_delete(&client);
+}
+
+static ULONG views_encode(UCHAR *buffer, const CHAR *topic, const CHAR *payload)
+{
+    return broker_publish_encode(&broker, buffer, topic, (const UCHAR *)payload, (UINT)strlen(payload), 0, 0, 0);
+}
+
+static VOID views_deliver(const UCHAR *data, ULONG length, ULONG segment_size)
+{
+    TEST_ASSERT_EQUAL(NX_SUCCESS, host_tcp_deliver(&client.nxd_mqtt_client_socket, data, length, segment_size));
+    test_client_run(&client);
+}
+
+static ULONG views_held(VOID)
+{
+    return host_network_pool.nx_packet_pool_total - host_network_pool.nx_packet_pool_available;
+}
+
+// Check the next message with message_get. The lengths are written as ULONG,
+// which is the size of a UINT on the target, so they are given ULONG storage.
+static VOID views_get(const CHAR *topic, const CHAR *payload)
+{
+    UCHAR topic_buffer[64];
+    UCHAR message_buffer[64];
+    ULONG topic_length;
+    ULONG message_length;
+
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_message_get(&client, topic_buffer, sizeof(topic_buffer),
+                                                                     (UINT *)&topic_length, message_buffer,
+                                                                     sizeof(message_buffer), (UINT *)&message_length));
+    TEST_ASSERT_EQUAL(strlen(topic), topic_length);
+    TEST_ASSERT(memcmp(topic_buffer, topic, strlen(topic)) == 0);
+    TEST_ASSERT_EQUAL(strlen(payload), message_length);
+    TEST_ASSERT(memcmp(message_buffer, payload, strlen(payload)) == 0);
+}
+
+// Several PUBLISH packets in one segment share it, and it is released by the last message out
+static VOID test_shared_segment(VOID)
+{
+    UCHAR data[256];
+    ULONG length = 0;
+    NXD_MQTT_MESSAGE message[3];
+    NXD_MQTT_RECEIVE_SEGMENT *segment_ptr;
+    UCHAR *span;
+    ULONG span_length;
+
+    views_setup();
+    length += views_encode(data + length, "a", "one");
+    length += views_encode(data + length, "b/c", "two");
+    length += views_encode(data + length, "d", "three");
+    views_deliver(data, length, 0);
+
+    TEST_ASSERT_EQUAL(3, client.message_receive_queue_depth);
+    TEST_ASSERT_EQUAL(1, views_held());
+    segment_ptr = client.message_receive_queue_head->nxd_mqtt_receive_view_segment_ptr;
+    TEST_ASSERT(segment_ptr != NX_NULL);
+    TEST_ASSERT(client.message_receive_queue_tail->nxd_mqtt_receive_view_segment_ptr == segment_ptr);
+
+    // The parser's reference is gone: one per queued message
+    TEST_ASSERT_EQUAL(3, segment_ptr->nxd_mqtt_receive_segment_reference_count);
+
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_message_borrow(&client, &message[0]));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_message_borrow(&client, &message[1]));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_message_borrow(&client, &message[2]));
+    TEST_ASSERT_EQUAL(NXD_MQTT_NO_MESSAGE, _nxd_mqtt_client_message_borrow(&client, &message[0]));
+    TEST_ASSERT_EQUAL(0, client.message_receive_queue_depth);
+    TEST_ASSERT(client.message_receive_queue_head == NX_NULL);
+    TEST_ASSERT(client.message_receive_queue_tail == NX_NULL);
+
+    // Read in place, from the delivered segment
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_message_span_get(&message[1], NXD_MQTT_MESSAGE_TOPIC, 0,
+                                                                          &span, &span_length));
+    TEST_ASSERT_EQUAL(3, span_length);
+    TEST_ASSERT(memcmp(span, "b/c", 3) == 0);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_message_span_get(&message[2], NXD_MQTT_MESSAGE_PAYLOAD, 2,
+                                                                          &span, &span_length));
+    TEST_ASSERT_EQUAL(3, span_length);
+    TEST_ASSERT(memcmp(span, "ree", 3) == 0);
+
+    // Released out of order, the segment goes back with the last
+    _nxd_mqtt_client_message_release(&client, &message[1]);
+    TEST_ASSERT_EQUAL(2, segment_ptr->nxd_mqtt_receive_segment_reference_count);
+    _nxd_mqtt_client_message_release(&client, &message[0]);
+    TEST_ASSERT_EQUAL(1, views_held());
+    _nxd_mqtt_client_message_release(&client, &message[2]);
+    TEST_ASSERT_EQUAL(0, views_held());
+    TEST_ASSERT(segment_ptr->nxd_mqtt_receive_segment_packet_ptr == NX_NULL);
+    views_teardown();
+}
+
+// message_get copies each message out and drops its reference
+static VOID test_message_get(VOID)
+{
+    UCHAR data[256];
+    ULONG length = 0;
+    UCHAR buffer[4];
+    ULONG topic_length;
+    ULONG message_length;
+
+    views_setup();
+    length += views_encode(data + length, "sensor/1", "21.5");
+    length += views_encode(data + length, "sensor/2", "a longer payload");
+    views_deliver(data, length, 0);
+    TEST_ASSERT_EQUAL(2, client.message_receive_queue_depth);
+
+    views_get("sensor/1", "21.5");
+    TEST_ASSERT_EQUAL(1, client.message_receive_queue_depth);
+    TEST_ASSERT_EQUAL(1, views_held());
+
+    // Too small a buffer leaves the message queued
+    TEST_ASSERT_EQUAL(NXD_MQTT_INSUFFICIENT_BUFFER_SPACE,
+                      _nxd_mqtt_client_message_get(&client, buffer, sizeof(buffer), (UINT *)&topic_length,
+                                                   buffer, sizeof(buffer), (UINT *)&message_length));
+    TEST_ASSERT_EQUAL(1, client.message_receive_queue_depth);
+
+    views_get("sensor/2", "a longer payload");
+    TEST_ASSERT_EQUAL(0, views_held());
+    TEST_ASSERT_EQUAL(NXD_MQTT_NO_MESSAGE,
+                      _nxd_mqtt_client_message_get(&client, buffer, sizeof(buffer), (UINT *)&topic_length,
+                                                   buffer, sizeof(buffer), (UINT *)&message_length));
+    views_teardown();
+}
+
+// A partial packet after a queued message is copied out, so the segment stays as the message sees it
+static VOID test_split_with_views(VOID)
+{
+    UCHAR data[256];
+    ULONG first;
+    ULONG length;
+
+    views_setup();
+    first = views_encode(data, "first", "complete");
+    length = first + views_encode(data + first, "second", "split across segments");
+
+    views_deliver(data, first + 5, 0);
+    TEST_ASSERT_EQUAL(1, client.message_receive_queue_depth);
+    TEST_ASSERT(client.nxd_mqtt_client_processing_packet != NX_NULL);
+    TEST_ASSERT(client.nxd_mqtt_client_processing_packet->nx_packet_pool_owner == &test_pool);
+    TEST_ASSERT_EQUAL(5, client.nxd_mqtt_client_processing_packet->nx_packet_length);
+    TEST_ASSERT_EQUAL(views_pool_available - 1, test_pool.nx_packet_pool_available);
+    TEST_ASSERT_EQUAL(1, client.message_receive_queue_head->nxd_mqtt_receive_view_segment_ptr->nxd_mqtt_receive_segment_reference_count);
+
+    views_deliver(data + first + 5, length - first - 5, 0);
+    TEST_ASSERT(client.nxd_mqtt_client_processing_packet == NX_NULL);
+    TEST_ASSERT_EQUAL(2, client.message_receive_queue_depth);
+    views_get("first", "complete");
+    views_get("second", "split across segments");
+    TEST_ASSERT_EQUAL(views_pool_available, test_pool.nx_packet_pool_available);
+    views_teardown();
+}
+
+// With nothing queued from the segment, the partial packet is resumed in place
+static VOID test_split_without_views(VOID)
+{
+    static const UCHAR pingresp[] = { BROKER_PINGRESP << 4, 0 };
+    UCHAR data[256];
+    ULONG length;
+
+    views_setup();
+    memcpy(data, pingresp, sizeof(pingresp));
+    length = sizeof(pingresp) + views_encode(data + sizeof(pingresp), "in/place", "resumed");
+
+    views_deliver(data, sizeof(pingresp) + 3, 0);
+    TEST_ASSERT_EQUAL(0, client.message_receive_queue_depth);
+    TEST_ASSERT(client.nxd_mqtt_client_processing_packet != NX_NULL);
+    TEST_ASSERT(client.nxd_mqtt_client_processing_packet->nx_packet_pool_owner == &host_network_pool);
+    TEST_ASSERT_EQUAL(3, client.nxd_mqtt_client_processing_packet->nx_packet_length);
+    TEST_ASSERT_EQUAL(views_pool_available, test_pool.nx_packet_pool_available);
+
+    // The rest arrives a byte at a time, chained on the partial packet
+    views_deliver(data + sizeof(pingresp) + 3, length - sizeof(pingresp) - 3, 1);
+    TEST_ASSERT_EQUAL(1, client.message_receive_queue_depth);
+    views_get("in/place", "resumed");
+    views_teardown();
+}
+
+// Messages beyond the views are dropped until the application takes some out
+static VOID test_view_exhaustion(VOID)
+{
+    UCHAR data[64];
+    CHAR payload[8];
+    ULONG length;
+    UINT i;
+
+    views_setup();
+    for (i = 0; i < NXD_MQTT_RECEIVE_VIEW_COUNT + 2; i++)
+    {
+        sprintf(payload, "%u", i);
+        length = views_encode(data, "x", payload);
+        views_deliver(data, length, 0);
+    }
+    TEST_ASSERT_EQUAL(NXD_MQTT_RECEIVE_VIEW_COUNT, client.message_receive_queue_depth);
+    TEST_ASSERT_EQUAL(NXD_MQTT_RECEIVE_VIEW_COUNT, views_held());
+
+    // A view taken out makes room for the next message
+    views_get("x", "0");
+    length = views_encode(data, "x", "late");
+    views_deliver(data, length, 0);
+    TEST_ASSERT_EQUAL(NXD_MQTT_RECEIVE_VIEW_COUNT, client.message_receive_queue_depth);
+
+    for (i = 1; i < NXD_MQTT_RECEIVE_VIEW_COUNT; i++)
+    {
+        sprintf(payload, "%u", i);
+        views_get("x", payload);
+    }
+    views_get("x", "late");
+    TEST_ASSERT_EQUAL(0, views_held());
+    views_teardown();
+}
+
+// A message longer than a segment is read span by span along the chain
+static VOID test_chained_spans(VOID)
+{
+    UCHAR payload[3000];
+    UCHAR copy[3000];
+    UCHAR data[3100];
+    NXD_MQTT_MESSAGE message;
+    UCHAR *span;
+    ULONG span_length;
+    ULONG offset = 0;
+    UINT spans = 0;
+    UINT i;
+
+    views_setup();
+    for (i = 0; i < sizeof(payload); i++)
+    {
+        payload[i] = (UCHAR)(i * 7);
+    }
+    views_deliver(data, broker_publish_encode(&broker, data, "big", payload, sizeof(payload), 0, 0, 0), 500);
+    TEST_ASSERT_EQUAL(1, client.message_receive_queue_depth);
+    TEST_ASSERT(views_held() > 1);
+
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_message_borrow(&client, &message));
+    TEST_ASSERT_EQUAL(sizeof(payload), message.nxd_mqtt_message_payload_length);
+    for (;;)
+    {
+        TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_message_span_get(&message, NXD_MQTT_MESSAGE_PAYLOAD, offset,
+                                                                              &span, &span_length));
+        if (span_length == 0)
+        {
+            break;
+        }
+        TEST_ASSERT(offset + span_length <= sizeof(copy));
+        memcpy(copy + offset, span, span_length);
+        offset += span_length;
+        spans++;
+    }
+    TEST_ASSERT_EQUAL(sizeof(payload), offset);
+    TEST_ASSERT(spans > 1);
+    TEST_ASSERT(memcmp(copy, payload, sizeof(payload)) == 0);
+    TEST_ASSERT_EQUAL(NXD_MQTT_INVALID_PARAMETER, _nxd_mqtt_client_message_span_get(&message, NXD_MQTT_MESSAGE_PAYLOAD,
+                                                                                    sizeof(payload) + 1, &span, &span_length));
+
+    _nxd_mqtt_client_message_release(&client, &message);
+    TEST_ASSERT_EQUAL(0, views_held());
+    views_teardown();
+}
+
+int main(void)
+{
+    TEST_RUN(test_shared_segment);
+    TEST_RUN(test_message_get);
+    TEST_RUN(test_split_with_views);
+    TEST_RUN(test_split_without_views);
+    TEST_RUN(test_view_exhaustion);
+    TEST_RUN(test_chained_spans);
+    return TEST_RESULT();
+}
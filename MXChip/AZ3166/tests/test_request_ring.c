@@ -0,0 +1,450 @@
+// Request ring: asynchronous requests carried to the MQTT thread without the
+// client mutex, and the blocking calls that still take it, timed with several
+// producer threads against a broker stand-in that acknowledges as it receives.
+
+#include <string.h>
+
+#include "nxd_mqtt_client.c"
+#include "broker.h"
+#include "test_client.h"
+
+#define RING_PRODUCERS_MAX  4
+#define RING_MESSAGES       2000
+
+static NXD_MQTT_CLIENT client;
+static BROKER broker;
+static ULONG ring_pool_available;
+
+// Completions reported to ring_complete
+static UINT ring_complete_count;
+static UINT ring_complete_failures;
+static UINT ring_complete_handles[64];
+
+static VOID ring_complete(NXD_MQTT_CLIENT *client_ptr, UINT handle, UINT status, VOID *context)
+{
+    (void)client_ptr;
+    (void)context;
+    if (status != NXD_MQTT_SUCCESS)
+    {
+        __atomic_fetch_add(&ring_complete_failures, 1, __ATOMIC_RELAXED);
+    }
+    if (ring_complete_count < sizeof(ring_complete_handles) / sizeof(ring_complete_handles[0]))
+    {
+        ring_complete_handles[ring_complete_count] = handle;
+    }
+    __atomic_fetch_add(&ring_complete_count, 1, __ATOMIC_RELEASE);
+}
+
+static VOID ring_setup(VOID)
+{
+    memset(&broker, 0, sizeof(broker));
+    ring_complete_count = 0;
+    ring_complete_failures = 0;
+    test_client_create(&client, 64);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, test_client_connect(&client, &broker));
+    ring_pool_available = test_pool.nx_packet_pool_available;
+}
+
+// Requests are sent in the order they were submitted, and each completes once
+static VOID test_submit_order(VOID)
+{
+    static CHAR message[] = "m";
+    CHAR topics[NXD_MQTT_REQUEST_QUEUE_DEPTH][8];
+    UINT handles[NXD_MQTT_REQUEST_QUEUE_DEPTH];
+    UINT handle;
+    UINT status;
+    UINT i;
+
+    ring_setup();
+    for (i = 0; i < NXD_MQTT_REQUEST_QUEUE_DEPTH; i++)
+    {
+        sprintf(topics[i], "t/%u", i);
+        if (i == 3)
+        {
+            TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_subscribe_async(&client, topics[i], strlen(topics[i]), 1,
+                                                                                 NX_NULL, NX_NULL, &handles[i]));
+        }
+        else
+        {
+            TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_publish_async(&client, topics[i], strlen(topics[i]),
+                                                                               message, 1, NX_FALSE, i & 1,
+                                                                               NX_NULL, NX_NULL, &handles[i]));
+        }
+    }
+
+    // Every request is outstanding
+    TEST_ASSERT_EQUAL(NXD_MQTT_REQUEST_QUEUE_FULL, _nxd_mqtt_client_publish_async(&client, "x", 1, message, 1, NX_FALSE, 0,
+                                                                                  NX_NULL, NX_NULL, &handle));
+    TEST_ASSERT_EQUAL(NXD_MQTT_NO_MESSAGE, _nxd_mqtt_client_request_complete_get(&client, &handle, &status));
+    TEST_ASSERT_EQUAL(0, broker.log_count - 1);
+
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(NXD_MQTT_REQUEST_QUEUE_DEPTH, broker.log_count - 1);
+    for (i = 0; i < NXD_MQTT_REQUEST_QUEUE_DEPTH; i++)
+    {
+        TEST_ASSERT_EQUAL((i == 3) ? BROKER_SUBSCRIBE : BROKER_PUBLISH, broker.log[i + 1].type);
+        TEST_ASSERT_EQUAL(strlen(topics[i]), broker.log[i + 1].topic_length);
+        TEST_ASSERT(memcmp(broker.log[i + 1].topic, topics[i], strlen(topics[i])) == 0);
+    }
+
+    // All acknowledged, so every request has its completion waiting
+    for (i = 0; i < NXD_MQTT_REQUEST_QUEUE_DEPTH; i++)
+    {
+        TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_request_complete_get(&client, &handle, &status));
+        TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, status);
+        TEST_ASSERT(handle != 0);
+    }
+    TEST_ASSERT_EQUAL(NXD_MQTT_NO_MESSAGE, _nxd_mqtt_client_request_complete_get(&client, &handle, &status));
+    TEST_ASSERT_EQUAL(ring_pool_available, test_pool.nx_packet_pool_available);
+    test_client_delete(&client);
+}
+
+// Ring positions and handles keep going round, the completion ring with them
+static VOID test_wrap_around(VOID)
+{
+    static CHAR message[] = "wrap";
+    UINT handle;
+    UINT status;
+    UINT round;
+    UINT i;
+
+    ring_setup();
+    for (round = 0; round < 5; round++)
+    {
+        for (i = 0; i < NXD_MQTT_REQUEST_QUEUE_DEPTH - 1; i++)
+        {
+            TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_publish_async(&client, "w", 1, message, 4, NX_FALSE, 1,
+                                                                               NX_NULL, NX_NULL, &handle));
+        }
+        test_client_run(&client);
+        for (i = 0; i < NXD_MQTT_REQUEST_QUEUE_DEPTH - 1; i++)
+        {
+            TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_request_complete_get(&client, &handle, &status));
+            TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, status);
+        }
+        TEST_ASSERT_EQUAL(NXD_MQTT_NO_MESSAGE, _nxd_mqtt_client_request_complete_get(&client, &handle, &status));
+    }
+    TEST_ASSERT_EQUAL(5 * (NXD_MQTT_REQUEST_QUEUE_DEPTH - 1), client.nxd_mqtt_client_submit_tail);
+    TEST_ASSERT_EQUAL(client.nxd_mqtt_client_submit_tail, client.nxd_mqtt_client_submit_head);
+    TEST_ASSERT_EQUAL(5 * (NXD_MQTT_REQUEST_QUEUE_DEPTH - 1), broker_count(&broker, BROKER_PUBLISH));
+    TEST_ASSERT_EQUAL(ring_pool_available, test_pool.nx_packet_pool_available);
+    test_client_delete(&client);
+}
+
+// A QoS 1 message without a window credit stays at the head, and the requests behind it wait
+static VOID test_head_waits_for_window(VOID)
+{
+    static CHAR message[] = "held";
+    UINT handle;
+
+    ring_setup();
+    broker.hold = NX_TRUE;
+    client.nxd_mqtt_client_window = 1;
+    client.nxd_mqtt_client_window_maximum = 1;
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_publish_async(&client, "a", 1, message, 4, NX_FALSE, 1,
+                                                                       ring_complete, NX_NULL, &handle));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_publish_async(&client, "b", 1, message, 4, NX_FALSE, 1,
+                                                                       ring_complete, NX_NULL, &handle));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_publish_async(&client, "c", 1, message, 4, NX_FALSE, 0,
+                                                                       ring_complete, NX_NULL, &handle));
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(1, broker_count(&broker, BROKER_PUBLISH));
+    TEST_ASSERT_EQUAL(0, ring_complete_count);
+
+    // The acknowledgement lets the next QoS 1 message out, and the QoS 0 one behind it
+    broker_ack(&broker, BROKER_PUBACK, broker.log[1].packet_id);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(3, broker_count(&broker, BROKER_PUBLISH));
+    TEST_ASSERT_EQUAL('b', broker.log[2].topic[0]);
+    TEST_ASSERT_EQUAL('c', broker.log[3].topic[0]);
+    TEST_ASSERT_EQUAL(2, ring_complete_count);
+    TEST_ASSERT_EQUAL(handle, ring_complete_handles[1]);
+
+    broker_ack(&broker, BROKER_PUBACK, broker.log[2].packet_id);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(3, ring_complete_count);
+    TEST_ASSERT_EQUAL(0, ring_complete_failures);
+    TEST_ASSERT_EQUAL(ring_pool_available, test_pool.nx_packet_pool_available);
+    test_client_delete(&client);
+}
+
+// Requests still on the ring when the client is deleted complete as not connected
+static VOID test_delete_pending(VOID)
+{
+    static CHAR message[] = "late";
+    UINT handle;
+
+    ring_setup();
+    broker.hold = NX_TRUE;
+    client.nxd_mqtt_client_window = 1;
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_publish_async(&client, "a", 1, message, 4, NX_FALSE, 1,
+                                                                       ring_complete, NX_NULL, &handle));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_publish_async(&client, "b", 1, message, 4, NX_FALSE, 1,
+                                                                       ring_complete, NX_NULL, &handle));
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(0, ring_complete_count);
+    test_client_delete(&client);
+    TEST_ASSERT_EQUAL(2, ring_complete_count);
+    TEST_ASSERT_EQUAL(2, ring_complete_failures);
+}
+
+// Threaded runs: the MQTT thread and the producers are host threads
+
+typedef struct RING_RUN_STRUCT
+{
+    UINT producers;
+    UINT QoS;
+    UINT use_ring;
+    UINT messages;
+    TX_SEMAPHORE done;
+    UINT sequence[RING_PRODUCERS_MAX];
+    UINT out_of_order;
+    UINT retries;
+} RING_RUN;
+
+static RING_RUN ring_run;
+static TX_THREAD ring_threads[RING_PRODUCERS_MAX];
+static CHAR ring_topics[RING_PRODUCERS_MAX][4] = { "p/0", "p/1", "p/2", "p/3" };
+
+// Each producer's messages arrive in the order it sent them
+static VOID ring_publish_notify(BROKER *broker_ptr, BROKER_PACKET *packet_ptr)
+{
+    UINT producer = packet_ptr->topic[2] - '0';
+    UINT sequence;
+
+    (void)broker_ptr;
+    memcpy(&sequence, packet_ptr->payload, sizeof(sequence));
+    if (sequence != ring_run.sequence[producer])
+    {
+        ring_run.out_of_order++;
+    }
+    ring_run.sequence[producer] = sequence + 1;
+}
+
+static VOID ring_producer(ULONG input)
+{
+    UINT sequences[RING_MESSAGES];
+    UINT handle;
+    UINT status;
+    UINT i;
+
+    for (i = 0; i < ring_run.messages; i++)
+    {
+        sequences[i] = i;
+        if (ring_run.use_ring)
+        {
+            // The topic and message must stay valid until the request completes
+            while ((status = _nxd_mqtt_client_publish_async(&client, ring_topics[input], 3, (CHAR *)&sequences[i],
+                                                            sizeof(UINT), NX_FALSE, ring_run.QoS, ring_complete,
+                                                            NX_NULL, &handle)) == NXD_MQTT_REQUEST_QUEUE_FULL)
+            {
+                __atomic_fetch_add(&ring_run.retries, 1, __ATOMIC_RELAXED);
+                tx_thread_sleep(0);
+            }
+        }
+        else
+        {
+            status = _nxd_mqtt_client_publish(&client, ring_topics[input], 3, (CHAR *)&sequences[i], sizeof(UINT),
+                                              NX_FALSE, ring_run.QoS, NX_WAIT_FOREVER);
+            __atomic_fetch_add(&ring_complete_count, 1, __ATOMIC_RELEASE);
+        }
+        TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, status);
+    }
+
+    // Wait for the last completions before the sequences go out of scope
+    while (__atomic_load_n(&ring_complete_count, __ATOMIC_ACQUIRE) < ring_run.producers * ring_run.messages)
+    {
+        tx_thread_sleep(0);
+    }
+    tx_semaphore_put(&ring_run.done);
+}
+
+// Run the producers against a threaded client, returning the nanoseconds to complete every message
+static ULONG64 ring_threaded(UINT producers, UINT QoS, UINT use_ring, UINT messages)
+{
+    ULONG64 start;
+    ULONG64 elapsed;
+    UINT i;
+
+    memset(&ring_run, 0, sizeof(ring_run));
+    ring_run.producers = producers;
+    ring_run.QoS = QoS;
+    ring_run.use_ring = use_ring;
+    ring_run.messages = messages;
+    tx_semaphore_create(&ring_run.done, "done", 0);
+
+    ring_setup();
+    broker.log_wrap = NX_TRUE;
+    broker.publish_notify = ring_publish_notify;
+
+    // From here on the MQTT thread runs on its own
+    host_thread_start_enable = NX_TRUE;
+    tx_thread_resume(&client.nxd_mqtt_thread);
+
+    start = host_clock_ns();
+    for (i = 0; i < producers; i++)
+    {
+        tx_thread_create(&ring_threads[i], "producer", ring_producer, i, NX_NULL, 0, 5, 5, 0, TX_AUTO_START);
+    }
+    for (i = 0; i < producers; i++)
+    {
+        tx_semaphore_get(&ring_run.done, TX_WAIT_FOREVER);
+    }
+    elapsed = host_clock_ns() - start;
+
+    for (i = 0; i < producers; i++)
+    {
+        tx_thread_delete(&ring_threads[i]);
+        TEST_ASSERT_EQUAL(messages, ring_run.sequence[i]);
+    }
+    TEST_ASSERT_EQUAL(0, ring_run.out_of_order);
+    TEST_ASSERT_EQUAL(0, ring_complete_failures);
+    TEST_ASSERT_EQUAL(producers * messages, ring_complete_count);
+
+    _nxd_mqtt_client_delete(&client);
+    host_thread_start_enable = NX_FALSE;
+    TEST_ASSERT_EQUAL(test_pool.nx_packet_pool_total, test_pool.nx_packet_pool_available);
+    host_packet_pool_delete(&test_pool);
+    tx_semaphore_delete(&ring_run.done);
+    return elapsed;
+}
+
+// Several producers at once lose nothing and keep their own order, at both QoS levels
+static VOID test_producers(VOID)
+{
+    ring_threaded(RING_PRODUCERS_MAX, 0, NX_TRUE, 500);
+    ring_threaded(RING_PRODUCERS_MAX, 1, NX_TRUE, 500);
+}
+
+// Messages the application reads while the MQTT thread queues more
+static VOID test_reader(VOID)
+{
+    UCHAR topic[16];
+    UCHAR payload[16];
+    ULONG topic_length;
+    ULONG payload_length;
+    UINT expected = 0;
+    UINT sent;
+    UINT status;
+
+    ring_setup();
+    host_thread_start_enable = NX_TRUE;
+    tx_thread_resume(&client.nxd_mqtt_thread);
+
+    for (sent = 0; sent < RING_MESSAGES; sent++)
+    {
+        // Keep fewer messages outstanding than there are views, so none is dropped for want of one
+        while (sent - expected >= NXD_MQTT_RECEIVE_VIEW_COUNT / 2)
+        {
+            status = _nxd_mqtt_client_message_get(&client, topic, sizeof(topic), (UINT *)&topic_length,
+                                                  payload, sizeof(payload), (UINT *)&payload_length);
+            if (status == NXD_MQTT_SUCCESS)
+            {
+                TEST_ASSERT_EQUAL(sizeof(UINT), payload_length);
+                TEST_ASSERT(memcmp(payload, &expected, sizeof(UINT)) == 0);
+                expected++;
+            }
+        }
+        broker_publish(&broker, "in", (UCHAR *)&sent, sizeof(UINT), 0, 0, 0);
+    }
+    while (expected < RING_MESSAGES)
+    {
+        status = _nxd_mqtt_client_message_get(&client, topic, sizeof(topic), (UINT *)&topic_length,
+                                              payload, sizeof(payload), (UINT *)&payload_length);
+        if (status == NXD_MQTT_SUCCESS)
+        {
+            TEST_ASSERT(memcmp(payload, &expected, sizeof(UINT)) == 0);
+            expected++;
+        }
+        else
+        {
+            tx_thread_sleep(0);
+        }
+    }
+
+    _nxd_mqtt_client_delete(&client);
+    host_thread_start_enable = NX_FALSE;
+    TEST_ASSERT_EQUAL(test_pool.nx_packet_pool_total, test_pool.nx_packet_pool_available);
+    TEST_ASSERT_EQUAL(host_network_pool.nx_packet_pool_total, host_network_pool.nx_packet_pool_available);
+    host_packet_pool_delete(&test_pool);
+}
+
+// Blocking publish against the request ring, by producer count. QoS 0 blocking
+// publishes take no lock; QoS 1 ones take the client mutex to store the message,
+// while the MQTT thread holds it to process each PUBACK. The ring costs a
+// handoff to the MQTT thread per batch of requests, not per request.
+static VOID bench_producers(VOID)
+{
+    static const UINT counts[] = { 1, 2, 4 };
+    ULONG64 ns[4];
+    UINT total;
+    UINT i;
+
+    printf("producers  messages  blocking QoS 0  ring QoS 0  blocking QoS 1  ring QoS 1  (ns per message)\n");
+    for (i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+    {
+        total = counts[i] * RING_MESSAGES;
+        ns[0] = ring_threaded(counts[i], 0, NX_FALSE, RING_MESSAGES);
+        ns[1] = ring_threaded(counts[i], 0, NX_TRUE, RING_MESSAGES);
+        ns[2] = ring_threaded(counts[i], 1, NX_FALSE, RING_MESSAGES);
+        ns[3] = ring_threaded(counts[i], 1, NX_TRUE, RING_MESSAGES);
+        printf("%9u  %8u  %14llu  %10llu  %14llu  %10llu\n", counts[i], total,
+               (unsigned long long)(ns[0] / total), (unsigned long long)(ns[1] / total),
+               (unsigned long long)(ns[2] / total), (unsigned long long)(ns[3] / total));
+    }
+}
+
+// What the client mutex costs a blocking QoS 1 publisher, on one thread: the
+// publish itself, which holds the mutex only to take a window credit and queue
+// its stored copy, and the MQTT thread's pass over a window of PUBACKs, which
+// holds it throughout and so bounds how long a publisher can wait for it.
+static VOID bench_mutex_hold(VOID)
+{
+    static CHAR message[] = "hold";
+    ULONG64 publish_ns = 0;
+    ULONG64 pass_ns = 0;
+    ULONG64 start;
+    UINT window;
+    UINT round;
+    UINT i;
+
+    ring_setup();
+    broker.log_wrap = NX_TRUE;
+    window = client.nxd_mqtt_client_window;
+    client.nxd_mqtt_client_window_minimum = window;
+    client.nxd_mqtt_client_window_maximum = window;
+    for (round = 0; round < RING_MESSAGES / window; round++)
+    {
+        start = host_clock_ns();
+        for (i = 0; i < window; i++)
+        {
+            TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_publish(&client, "a", 1, message, 4, NX_FALSE, 1,
+                                                                         NX_NO_WAIT));
+        }
+        publish_ns += host_clock_ns() - start;
+
+        // The broker acknowledged each as it arrived: one pass takes the window of PUBACKs
+        start = host_clock_ns();
+        test_client_run(&client);
+        pass_ns += host_clock_ns() - start;
+        TEST_ASSERT_EQUAL(0, client.nxd_mqtt_client_window_used);
+    }
+
+    printf("window %u: QoS 1 publish %llu ns, event pass %llu ns per PUBACK, %llu ns per pass\n", window,
+           (unsigned long long)(publish_ns / (round * window)), (unsigned long long)(pass_ns / (round * window)),
+           (unsigned long long)(pass_ns / round));
+    test_client_delete(&client);
+}
+
+int main(void)
+{
+    TEST_RUN(test_submit_order);
+    TEST_RUN(test_wrap_around);
+    TEST_RUN(test_head_waits_for_window);
+    TEST_RUN(test_delete_pending);
+    TEST_RUN(test_producers);
+    TEST_RUN(test_reader);
+    TEST_RUN(bench_producers);
+    TEST_RUN(bench_mutex_hold);
+    return TEST_RESULT();
+}
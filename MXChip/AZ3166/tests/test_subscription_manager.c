@@ -0,0 +1,190 @@
+// Subscription manager: mqtt_subscribe keeps each topic filter once, sends it
+// at once while connected and otherwise with the next connect, and every
+// connect queues SUBSCRIBE for all of them right behind CONNECT. Matching
+// messages are copied into the application's slots, whose indexes pass
+// through two bounded queues: a message with no free slot is dropped rather
+// than blocking the MQTT thread. Runs without threads like test_supervisor.c.
+
+#include <string.h>
+
+#define BOOT_TRACE_HOST
+#include "boot.c"
+#include "mqtt_client.c"
+#include "broker.h"
+#include "client_thread.h"
+#include "test.h"
+
+#define MANAGER_PACKETS 16
+
+NX_PACKET_POOL nx_pool[2];
+NX_IP nx_ip;
+NX_DNS nx_dns_client;
+
+static BROKER broker;
+
+UINT wwd_network_connect()
+{
+    return NX_SUCCESS;
+}
+
+UINT wwd_network_is_connected()
+{
+    return NX_TRUE;
+}
+
+static VOID manager_idle(VOID)
+{
+    client_thread_run(&mqtt_client);
+}
+
+// Let the cork delay pass, so what the client corked goes out and is answered
+static VOID manager_flush(VOID)
+{
+    host_time_advance(MQTT_CORK_DELAY);
+    client_thread_run(&mqtt_client);
+}
+
+// Count the SUBSCRIBE packets for a filter logged since a position of the broker log
+static UINT manager_subscribes(UINT since, const char *topic)
+{
+    UINT count = 0;
+    UINT i;
+
+    for (i = since; i < broker.log_count; i++)
+    {
+        if ((broker.log[i].type == BROKER_SUBSCRIBE) && (broker.log[i].topic_length == strlen(topic)) &&
+            (memcmp(broker.log[i].topic, topic, strlen(topic)) == 0))
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+// Filters given while disconnected are sent once with the connect, and a filter given again is
+// not sent again; while connected a new filter goes out at once, until the table is full
+static VOID test_once_per_filter(VOID)
+{
+    UINT log_count;
+
+    TEST_ASSERT(!mqtt_is_connected());
+    TEST_ASSERT_EQUAL(NX_SUCCESS, mqtt_subscribe("cmd/a", 1));
+    TEST_ASSERT_EQUAL(NX_SUCCESS, mqtt_subscribe("cmd/a", 1));
+    TEST_ASSERT_EQUAL(0, broker.log_count);
+
+    broker_attach(&broker, &mqtt_client.nxd_mqtt_client_socket);
+    mqtt_reconnect();
+    TEST_ASSERT(mqtt_is_connected());
+    manager_flush();
+    TEST_ASSERT_EQUAL(BROKER_CONNECT, broker.log[0].type);
+    TEST_ASSERT_EQUAL(1, manager_subscribes(0, "cmd/a"));
+    TEST_ASSERT_EQUAL(1, broker_count(&broker, BROKER_SUBSCRIBE));
+    TEST_ASSERT(!mqtt_subscriptions[0].pending);
+
+    log_count = broker.log_count;
+    TEST_ASSERT_EQUAL(NX_SUCCESS, mqtt_subscribe("cmd/b", 0));
+    TEST_ASSERT_EQUAL(NX_SUCCESS, mqtt_subscribe("cmd/b", 0));
+    TEST_ASSERT_EQUAL(NX_SUCCESS, mqtt_subscribe("cmd/a", 1));
+    manager_flush();
+    TEST_ASSERT_EQUAL(1, manager_subscribes(log_count, "cmd/b"));
+    TEST_ASSERT_EQUAL(2, broker_count(&broker, BROKER_SUBSCRIBE));
+
+    TEST_ASSERT_EQUAL(NX_SUCCESS, mqtt_subscribe("cmd/c", 0));
+    TEST_ASSERT_EQUAL(NX_SUCCESS, mqtt_subscribe("cmd/d", 0));
+    TEST_ASSERT_EQUAL(NXD_MQTT_INSUFFICIENT_BUFFER_SPACE, mqtt_subscribe("cmd/e", 0));
+    manager_flush();
+    TEST_ASSERT_EQUAL(MQTT_SUBSCRIPTION_MAX, broker_count(&broker, BROKER_SUBSCRIBE));
+}
+
+// After the connection is lost, the reconnect subscribes to every filter again, behind its CONNECT
+static VOID test_resubscribe(VOID)
+{
+    UINT log_count;
+    UINT index;
+
+    broker_close(&broker);
+    client_thread_run(&mqtt_client);
+    TEST_ASSERT(!mqtt_is_connected());
+
+    log_count = broker.log_count;
+    mqtt_reconnect();
+    TEST_ASSERT(mqtt_is_connected());
+    manager_flush();
+    TEST_ASSERT_EQUAL(BROKER_CONNECT, broker.log[log_count].type);
+    for (index = 0; index < MQTT_SUBSCRIPTION_MAX; index++)
+    {
+        TEST_ASSERT_EQUAL(1, manager_subscribes(log_count, mqtt_subscriptions[index].topic));
+        TEST_ASSERT(!mqtt_subscriptions[index].pending);
+    }
+    TEST_ASSERT_EQUAL(log_count + 1 + MQTT_SUBSCRIPTION_MAX, broker.log_count);
+}
+
+// Messages fill the slots in the order received, a message with every slot taken is dropped,
+// and a released slot takes the next one; a long payload is cut to its slot
+static VOID test_delivery(VOID)
+{
+    MQTT_RECEIVED_MESSAGE *messages[MQTT_MESSAGE_SLOTS];
+    MQTT_RECEIVED_MESSAGE *message;
+    static UCHAR payload[MQTT_PAYLOAD_SIZE + 16];
+    UCHAR text[2];
+    UINT i;
+
+    // cmd/a was queued without a handler, and reaches the slots through mqtt_callback;
+    // cmd/b has its handler
+    for (i = 0; i < MQTT_MESSAGE_SLOTS + 1; i++)
+    {
+        text[0] = (UCHAR)('0' + i);
+        broker_publish(&broker, (i % 2) ? "cmd/b" : "cmd/a", text, 1, 0, 0, 0);
+    }
+    client_thread_run(&mqtt_client);
+    TEST_ASSERT_EQUAL(1, mqtt_messages_dropped);
+
+    for (i = 0; i < MQTT_MESSAGE_SLOTS; i++)
+    {
+        TEST_ASSERT_EQUAL(TX_SUCCESS, mqtt_message_receive(&messages[i], TX_NO_WAIT));
+        TEST_ASSERT_EQUAL(1, messages[i]->payload_length);
+        TEST_ASSERT_EQUAL('0' + i, messages[i]->payload[0]);
+        TEST_ASSERT(strcmp(messages[i]->topic, (i % 2) ? "cmd/b" : "cmd/a") == 0);
+    }
+    TEST_ASSERT_EQUAL(TX_QUEUE_EMPTY, mqtt_message_receive(&message, TX_NO_WAIT));
+
+    mqtt_message_release(messages[2]);
+    memset(payload, 'p', sizeof(payload));
+    broker_publish(&broker, "cmd/b", payload, sizeof(payload), 0, 0, 0);
+    client_thread_run(&mqtt_client);
+    TEST_ASSERT_EQUAL(TX_SUCCESS, mqtt_message_receive(&message, TX_NO_WAIT));
+    TEST_ASSERT(message == messages[2]);
+    TEST_ASSERT_EQUAL(MQTT_PAYLOAD_SIZE - 1, message->payload_length);
+    TEST_ASSERT_EQUAL(0, message->payload[MQTT_PAYLOAD_SIZE - 1]);
+    TEST_ASSERT_EQUAL(1, mqtt_messages_dropped);
+
+    mqtt_message_release(message);
+    for (i = 0; i < MQTT_MESSAGE_SLOTS; i++)
+    {
+        if (i != 2)
+        {
+            mqtt_message_release(messages[i]);
+        }
+    }
+    TEST_ASSERT_EQUAL(MQTT_MESSAGE_SLOTS, mqtt_free_queue.tx_queue_enqueued);
+}
+
+int main(void)
+{
+    srand(1);
+    nx_ip.nx_ip_id = NX_IP_ID;
+    host_packet_pool_create(&nx_pool[0], "tx", 1536, MANAGER_PACKETS);
+    boot_init();
+    boot_phase_done(MQTT_BOOT_PHASES);
+
+    // No broker is attached yet, so the first attempt fails and the test connects with mqtt_reconnect
+    mqtt_init();
+    mqtt_connect();
+    host_idle_hook = manager_idle;
+
+    TEST_RUN(test_once_per_filter);
+    TEST_RUN(test_resubscribe);
+    TEST_RUN(test_delivery);
+    return TEST_RESULT();
+}
@@ -0,0 +1,623 @@
+// Subscription trie: topic filters registered with handlers, one node per
+// level, matched against received topics with the + and # wildcards. The
+// handlers of a received message are gathered under the client mutex and
+// called once it is released.
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Room for the benchmark's hundreds of filters, and a handler for each filter of the random test
+#define NXD_MQTT_SUBSCRIPTION_NODE_COUNT  2048
+#define NXD_MQTT_SUBSCRIPTION_MATCH_COUNT 64
+
+#include "nxd_mqtt_client.c"
+#include "broker.h"
+#include "test_client.h"
+
+#define TRIE_FILTER_COUNT 600
+#define TRIE_FILTER_SIZE  48
+
+static NXD_MQTT_CLIENT client;
+
+// The filters, overwritten as soon as they are removed
+static CHAR trie_filters[TRIE_FILTER_COUNT][TRIE_FILTER_SIZE];
+static UINT trie_registered[TRIE_FILTER_COUNT];
+
+// Handlers called by the last match, by context
+static UINT trie_matched[TRIE_FILTER_COUNT];
+static UINT trie_match_count;
+
+static VOID trie_handler(NXD_MQTT_CLIENT *client_ptr, NXD_MQTT_MESSAGE *message_ptr, VOID *context)
+{
+    (void)client_ptr;
+    (void)message_ptr;
+    trie_matched[trie_match_count++] = (UINT)(size_t)context;
+}
+
+static UINT trie_insert(UINT index, const CHAR *filter)
+{
+    UINT status;
+
+    strcpy(trie_filters[index], filter);
+    status = _nxd_mqtt_subscription_insert(&client, (UCHAR *)trie_filters[index], (UINT)strlen(filter),
+                                           trie_handler, (VOID *)(size_t)index);
+    if (status == NXD_MQTT_SUCCESS)
+    {
+        trie_registered[index] = NX_TRUE;
+    }
+    return status;
+}
+
+static VOID trie_remove(UINT index)
+{
+    _nxd_mqtt_subscription_remove(&client.nxd_mqtt_client_subscription_root, (UCHAR *)trie_filters[index],
+                                  (UINT)strlen(trie_filters[index]));
+    trie_registered[index] = NX_FALSE;
+}
+
+// Match and call the handlers as the dispatcher does: wildcards do not match topics beginning with '$'
+static UINT trie_match(const CHAR *topic)
+{
+    NXD_MQTT_SUBSCRIPTION_MATCH matches[NXD_MQTT_SUBSCRIPTION_MATCH_COUNT];
+    UINT length = (UINT)strlen(topic);
+    UINT matched;
+    UINT i;
+
+    trie_match_count = 0;
+    matched = _nxd_mqtt_subscription_match(client.nxd_mqtt_client_subscription_root, (const UCHAR *)topic, length,
+                                           (length == 0) || (topic[0] != '$'), matches, 0);
+    TEST_ASSERT(matched <= NXD_MQTT_SUBSCRIPTION_MATCH_COUNT);
+    for (i = 0; i < matched; i++)
+    {
+        matches[i].nxd_mqtt_subscription_match_handler(&client, NX_NULL, matches[i].nxd_mqtt_subscription_match_context);
+    }
+    return matched;
+}
+
+static UINT trie_was_matched(UINT index)
+{
+    UINT i;
+
+    for (i = 0; i < trie_match_count; i++)
+    {
+        if (trie_matched[i] == index)
+        {
+            return NX_TRUE;
+        }
+    }
+    return NX_FALSE;
+}
+
+// The MQTT matching rules, one filter at a time
+static UINT reference_match(const CHAR *filter, const CHAR *topic)
+{
+    if ((topic[0] == '$') && ((filter[0] == '+') || (filter[0] == '#')))
+    {
+        return NX_FALSE;
+    }
+    for (;;)
+    {
+        if ((filter[0] == '#') && (filter[1] == 0))
+        {
+            return NX_TRUE;
+        }
+        if ((filter[0] == '+') && ((filter[1] == '/') || (filter[1] == 0)))
+        {
+            filter++;
+            while (*topic && (*topic != '/'))
+            {
+                topic++;
+            }
+        }
+        else
+        {
+            while (*filter && (*filter != '/') && (*filter == *topic))
+            {
+                filter++;
+                topic++;
+            }
+            if (((*filter != '/') && (*filter != 0)) || ((*topic != '/') && (*topic != 0)))
+            {
+                return NX_FALSE;
+            }
+        }
+        if ((*filter == 0) && (*topic == 0))
+        {
+            return NX_TRUE;
+        }
+        if (*filter == 0)
+        {
+            return NX_FALSE;
+        }
+        if (*topic == 0)
+        {
+            // "a/#" matches "a"
+            return (strcmp(filter, "/#") == 0);
+        }
+        filter++;
+        topic++;
+    }
+}
+
+static UINT trie_nodes_used(VOID)
+{
+    UINT used = 0;
+    UINT i;
+
+    for (i = 0; i < NXD_MQTT_SUBSCRIPTION_NODE_COUNT; i++)
+    {
+        if (client.nxd_mqtt_client_subscription_nodes[i].nxd_mqtt_subscription_node_in_use)
+        {
+            used++;
+        }
+    }
+    return used;
+}
+
+static VOID trie_setup(VOID)
+{
+    memset(trie_registered, 0, sizeof(trie_registered));
+    test_client_create(&client, 8);
+}
+
+static VOID trie_teardown(VOID)
+{
+    UINT i;
+
+    for (i = 0; i < TRIE_FILTER_COUNT; i++)
+    {
+        if (trie_registered[i])
+        {
+            trie_remove(i);
+        }
+    }
+    TEST_ASSERT(client.nxd_mqtt_client_subscription_root == NX_NULL);
+    TEST_ASSERT_EQUAL(0, trie_nodes_used());
+    test_client_delete(&client);
+}
+
+static VOID test_exact_and_wildcards(VOID)
+{
+    trie_setup();
+    trie_insert(0, "home/kitchen/temp");
+    trie_insert(1, "home/+/temp");
+    trie_insert(2, "home/#");
+    trie_insert(3, "#");
+    trie_insert(4, "+/+/humidity");
+    trie_insert(5, "home/kitchen");
+    trie_insert(6, "$SYS/broker/load");
+    trie_insert(7, "+");
+
+    // Shared leading levels share nodes: home, kitchen, temp, +, temp, #, #, +, +, humidity, $SYS, broker, load
+    TEST_ASSERT_EQUAL(13, trie_nodes_used());
+
+    TEST_ASSERT_EQUAL(4, trie_match("home/kitchen/temp"));
+    TEST_ASSERT(trie_was_matched(0) && trie_was_matched(1) && trie_was_matched(2) && trie_was_matched(3));
+
+    TEST_ASSERT_EQUAL(3, trie_match("home/hall/temp"));
+    TEST_ASSERT(trie_was_matched(1) && trie_was_matched(2) && trie_was_matched(3));
+
+    TEST_ASSERT_EQUAL(3, trie_match("home/hall/humidity"));
+    TEST_ASSERT(trie_was_matched(4));
+    TEST_ASSERT(!trie_was_matched(1));
+
+    // "home/#" matches its parent level, and + matches exactly one level
+    TEST_ASSERT_EQUAL(3, trie_match("home"));
+    TEST_ASSERT(trie_was_matched(2) && trie_was_matched(3) && trie_was_matched(7));
+    TEST_ASSERT_EQUAL(3, trie_match("home/kitchen"));
+    TEST_ASSERT(trie_was_matched(5));
+    TEST_ASSERT_EQUAL(2, trie_match("office/desk/humidity"));
+    TEST_ASSERT_EQUAL(1, trie_match("office/desk/temp/extra"));
+
+    // Empty levels are levels
+    TEST_ASSERT_EQUAL(2, trie_match("home/"));
+    TEST_ASSERT(trie_was_matched(2) && trie_was_matched(3));
+
+    // Wildcards at the first level do not match '$' topics
+    TEST_ASSERT_EQUAL(1, trie_match("$SYS/broker/load"));
+    TEST_ASSERT(trie_was_matched(6));
+    TEST_ASSERT_EQUAL(0, trie_match("$SYS/broker/uptime"));
+    trie_teardown();
+}
+
+static VOID test_remove(VOID)
+{
+    UINT nodes;
+
+    trie_setup();
+    trie_insert(0, "a/b/c");
+    trie_insert(1, "a/b");
+    trie_insert(2, "a/b/d");
+    trie_insert(3, "a/+/c");
+    nodes = trie_nodes_used();
+    TEST_ASSERT_EQUAL(6, nodes);
+
+    // A node with children stays, without its handler
+    trie_remove(1);
+    TEST_ASSERT_EQUAL(nodes, trie_nodes_used());
+    TEST_ASSERT_EQUAL(0, trie_match("a/b"));
+    TEST_ASSERT_EQUAL(2, trie_match("a/b/c"));
+
+    // A leaf goes, and its parents with it once they have nothing left
+    trie_remove(0);
+    TEST_ASSERT_EQUAL(nodes - 1, trie_nodes_used());
+    TEST_ASSERT_EQUAL(1, trie_match("a/b/c"));
+    TEST_ASSERT(trie_was_matched(3));
+    trie_remove(2);
+    TEST_ASSERT_EQUAL(3, trie_nodes_used());
+
+    // Removing a filter never registered, or a prefix of one, changes nothing
+    _nxd_mqtt_subscription_remove(&client.nxd_mqtt_client_subscription_root, (UCHAR *)"a/x", 3);
+    _nxd_mqtt_subscription_remove(&client.nxd_mqtt_client_subscription_root, (UCHAR *)"a/+/c/d", 7);
+    _nxd_mqtt_subscription_remove(&client.nxd_mqtt_client_subscription_root, (UCHAR *)"a", 1);
+    TEST_ASSERT_EQUAL(3, trie_nodes_used());
+    TEST_ASSERT_EQUAL(1, trie_match("a/z/c"));
+
+    // Registering again replaces the handler's context
+    trie_insert(3, "a/+/c");
+    TEST_ASSERT_EQUAL(3, trie_nodes_used());
+
+    // Levels are copied: the text of a removed filter may be reused while others share its nodes
+    trie_insert(4, "x/y/one");
+    trie_insert(5, "x/y/two");
+    trie_remove(4);
+    memset(trie_filters[4], '?', 7);
+    TEST_ASSERT_EQUAL(1, trie_match("x/y/two"));
+    TEST_ASSERT(trie_was_matched(5));
+
+    // A level longer than a node holds is refused, and nothing is linked
+    TEST_ASSERT_EQUAL(NXD_MQTT_INSUFFICIENT_BUFFER_SPACE, trie_insert(6, "x/z/abcdefghijklmnopq"));
+    TEST_ASSERT_EQUAL(6, trie_nodes_used());
+    trie_teardown();
+}
+
+// A filter that does not fit in the free nodes is refused whole
+static VOID test_capacity(VOID)
+{
+    static CHAR long_filter[2 * NXD_MQTT_SUBSCRIPTION_NODE_COUNT];
+    CHAR filter[TRIE_FILTER_SIZE];
+    UINT length = 0;
+    UINT levels;
+    UINT i;
+
+    trie_setup();
+    for (i = 0; i < TRIE_FILTER_COUNT; i++)
+    {
+        sprintf(filter, "f%u/x", i);
+        TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, trie_insert(i, filter));
+    }
+    TEST_ASSERT_EQUAL(2 * TRIE_FILTER_COUNT, trie_nodes_used());
+
+    // Fill all but two nodes with one long filter
+    levels = NXD_MQTT_SUBSCRIPTION_NODE_COUNT - trie_nodes_used() - 2;
+    for (i = 0; i < levels; i++)
+    {
+        long_filter[length++] = 'l';
+        long_filter[length++] = '/';
+    }
+    length--;
+    long_filter[length] = 0;
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_subscription_insert(&client, (UCHAR *)long_filter, length,
+                                                                      trie_handler, NX_NULL));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUBSCRIPTION_NODE_COUNT - 2, trie_nodes_used());
+
+    // Three new levels do not fit in two nodes, and nothing is linked
+    TEST_ASSERT_EQUAL(NXD_MQTT_INSUFFICIENT_BUFFER_SPACE,
+                      _nxd_mqtt_subscription_insert(&client, (UCHAR *)"n/e/w", 5, trie_handler, NX_NULL));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUBSCRIPTION_NODE_COUNT - 2, trie_nodes_used());
+    TEST_ASSERT_EQUAL(0, trie_match("n/e/w"));
+
+    // Two new levels under an existing one do
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_subscription_insert(&client, (UCHAR *)"f0/y/z", 6,
+                                                                      trie_handler, NX_NULL));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUBSCRIPTION_NODE_COUNT, trie_nodes_used());
+    TEST_ASSERT_EQUAL(1, trie_match("f0/y/z"));
+
+    _nxd_mqtt_subscription_remove(&client.nxd_mqtt_client_subscription_root, (UCHAR *)"f0/y/z", 6);
+    _nxd_mqtt_subscription_remove(&client.nxd_mqtt_client_subscription_root, (UCHAR *)long_filter, length);
+    trie_teardown();
+}
+
+static const CHAR *trie_words[] = { "a", "b", "site", "floor", "7", "temp", "+", "#", "$SYS", "" };
+
+static VOID trie_random_name(CHAR *buffer, UINT filter)
+{
+    UINT levels = 1 + (UINT)(rand() % 4);
+    UINT word;
+    UINT i;
+
+    buffer[0] = 0;
+    for (i = 0; i < levels; i++)
+    {
+        do
+        {
+            word = (UINT)(rand() % (sizeof(trie_words) / sizeof(trie_words[0])));
+        } while ((!filter && (trie_words[word][0] == '+' || trie_words[word][0] == '#')) ||
+                 ((trie_words[word][0] == '#') && (i != levels - 1)) ||
+                 ((trie_words[word][0] == '$') && (i != 0)));
+        if (i)
+        {
+            strcat(buffer, "/");
+        }
+        strcat(buffer, trie_words[word]);
+    }
+}
+
+// Random filters added and removed, every match checked against the rules filter by filter
+static VOID test_random_against_reference(VOID)
+{
+    CHAR name[TRIE_FILTER_SIZE];
+    UINT expected;
+    UINT round;
+    UINT index;
+    UINT i;
+    UINT j;
+
+    srand(6);
+    trie_setup();
+    for (round = 0; round < 4000; round++)
+    {
+        index = (UINT)(rand() % 64);
+        if (trie_registered[index])
+        {
+            trie_remove(index);
+        }
+        else
+        {
+            trie_random_name(name, NX_TRUE);
+            for (j = 0; j < 64; j++)
+            {
+                // One handler per filter: the same filter twice would replace it
+                if (trie_registered[j] && (strcmp(trie_filters[j], name) == 0))
+                {
+                    break;
+                }
+            }
+            if (j == 64)
+            {
+                TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, trie_insert(index, name));
+            }
+        }
+
+        trie_random_name(name, NX_FALSE);
+        trie_match(name);
+        expected = 0;
+        for (i = 0; i < 64; i++)
+        {
+            if (trie_registered[i] && reference_match(trie_filters[i], name))
+            {
+                expected++;
+                if (!trie_was_matched(i))
+                {
+                    printf("\"%s\" does not match \"%s\"\n", trie_filters[i], name);
+                    test_failures++;
+                }
+            }
+        }
+        TEST_ASSERT_EQUAL(expected, trie_match_count);
+    }
+    trie_teardown();
+}
+
+// Topics dispatched from received PUBLISH packets, the topic split across a chain or not
+static VOID test_dispatch(VOID)
+{
+    BROKER broker;
+    CHAR topic[100];
+
+    memset(&broker, 0, sizeof(broker));
+    trie_setup();
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, test_client_connect(&client, &broker));
+    trie_insert(0, "dev/+/cmd");
+
+    trie_match_count = 0;
+    broker_publish(&broker, "dev/42/cmd", (const UCHAR *)"on", 2, 0, 0, 0);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(1, trie_match_count);
+    TEST_ASSERT_EQUAL(0, client.message_receive_queue_depth);
+
+    // Split across the packets of the chain, the topic is gathered before matching
+    memset(topic, 'x', sizeof(topic));
+    memcpy(topic, "dev/", 4);
+    strcpy(topic + 80, "/cmd");
+    trie_match_count = 0;
+    broker.segment_size = 16;
+    broker_publish(&broker, topic, (const UCHAR *)"off", 3, 0, 0, 0);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(1, trie_match_count);
+
+    // Unmatched messages are queued
+    broker_publish(&broker, "dev/42/state", (const UCHAR *)"?", 1, 0, 0, 0);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(1, trie_match_count);
+    TEST_ASSERT_EQUAL(1, client.message_receive_queue_depth);
+    trie_teardown();
+}
+
+// Whether another thread can take the client mutex
+static VOID *trie_mutex_probe(VOID *free_ptr)
+{
+    if (pthread_mutex_trylock(&client.nxd_mqtt_client_mutex_ptr->tx_mutex_host) == 0)
+    {
+        pthread_mutex_unlock(&client.nxd_mqtt_client_mutex_ptr->tx_mutex_host);
+        *(UINT *)free_ptr = NX_TRUE;
+    }
+    return NX_NULL;
+}
+
+static UINT trie_mutex_free;
+
+// Called without the client mutex, it uses the client: it answers, and moves its subscription
+static VOID trie_moving_handler(NXD_MQTT_CLIENT *client_ptr, NXD_MQTT_MESSAGE *message_ptr, VOID *context)
+{
+    pthread_t probe;
+
+    (void)message_ptr;
+    trie_mutex_free = NX_FALSE;
+    pthread_create(&probe, NX_NULL, trie_mutex_probe, &trie_mutex_free);
+    pthread_join(probe, NX_NULL);
+
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_publish(client_ptr, "dev/ack", 7, "ok", 2, 0, 0, NX_NO_WAIT));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_unsubscribe(client_ptr, "dev/+/cmd", 9));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_subscription_add(client_ptr, "dev/+/next", 10, 0,
+                                                                          trie_handler, context));
+}
+
+// Handlers may use the client, and add and remove subscriptions, since the mutex is released around them
+static VOID test_dispatch_unlocked(VOID)
+{
+    BROKER broker;
+
+    memset(&broker, 0, sizeof(broker));
+    trie_setup();
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, test_client_connect(&client, &broker));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_subscription_add(&client, "dev/+/cmd", 9, 0,
+                                                                          trie_moving_handler, (VOID *)1));
+    test_client_run(&client);
+
+    broker_publish(&broker, "dev/42/cmd", (const UCHAR *)"on", 2, 0, 0, 0);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(NX_TRUE, trie_mutex_free);
+    TEST_ASSERT_EQUAL(1, broker_count(&broker, BROKER_PUBLISH));
+    TEST_ASSERT_EQUAL(1, broker_count(&broker, BROKER_UNSUBSCRIBE));
+    TEST_ASSERT_EQUAL(2, broker_count(&broker, BROKER_SUBSCRIBE));
+
+    // The moved subscription is matched, and the old one no longer
+    trie_match_count = 0;
+    broker_publish(&broker, "dev/42/next", (const UCHAR *)"on", 2, 0, 0, 0);
+    broker_publish(&broker, "dev/42/cmd", (const UCHAR *)"on", 2, 0, 0, 0);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(1, trie_match_count);
+    TEST_ASSERT_EQUAL(1, trie_matched[0]);
+    TEST_ASSERT_EQUAL(1, client.message_receive_queue_depth);
+
+    _nxd_mqtt_subscription_remove(&client.nxd_mqtt_client_subscription_root, (UCHAR *)"dev/+/next", 10);
+    trie_teardown();
+}
+
+// Split topics longer than the gathering buffer are queued, and handlers past the match list are not
+// called; both are counted
+static VOID test_dispatch_limits(VOID)
+{
+    static const CHAR *levels[] = { "a", "b", "c", "d", "e", "f" };
+    BROKER broker;
+    NXD_MQTT_METRICS metrics;
+    CHAR topic[NXD_MQTT_SUBSCRIPTION_TOPIC_BUFFER_SIZE + 8];
+    CHAR filter[TRIE_FILTER_SIZE];
+    UINT combination;
+    UINT i;
+
+    memset(&broker, 0, sizeof(broker));
+    trie_setup();
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, test_client_connect(&client, &broker));
+
+    // Each level of a/b/c/d/e/f exact or +, and #, match that topic
+    for (combination = 0; combination < (1u << 6); combination++)
+    {
+        filter[0] = 0;
+        for (i = 0; i < 6; i++)
+        {
+            strcat(filter, i ? "/" : "");
+            strcat(filter, (combination & (1u << i)) ? "+" : levels[i]);
+        }
+        TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, trie_insert(combination, filter));
+    }
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, trie_insert(combination, "#"));
+
+    trie_match_count = 0;
+    broker_publish(&broker, "a/b/c/d/e/f", (const UCHAR *)"on", 2, 0, 0, 0);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUBSCRIPTION_MATCH_COUNT, trie_match_count);
+    TEST_ASSERT_EQUAL(0, client.message_receive_queue_depth);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_metrics_get(&client, &metrics));
+    TEST_ASSERT_EQUAL(65 - NXD_MQTT_SUBSCRIPTION_MATCH_COUNT, metrics.nxd_mqtt_metrics_dispatch_overflows);
+    TEST_ASSERT_EQUAL(0, metrics.nxd_mqtt_metrics_dispatch_long_topics);
+
+    // Split across the chain and one byte too long to gather, the topic matches "#" but is queued
+    memset(topic, 'x', sizeof(topic));
+    topic[NXD_MQTT_SUBSCRIPTION_TOPIC_BUFFER_SIZE + 1] = 0;
+    trie_match_count = 0;
+    broker.segment_size = 16;
+    broker_publish(&broker, topic, (const UCHAR *)"on", 2, 0, 0, 0);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(0, trie_match_count);
+    TEST_ASSERT_EQUAL(1, client.message_receive_queue_depth);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_metrics_get(&client, &metrics));
+    TEST_ASSERT_EQUAL(1, metrics.nxd_mqtt_metrics_dispatch_long_topics);
+    trie_teardown();
+}
+
+// Matching cost with hundreds of filters registered, against a scan of every filter
+static VOID bench_match(VOID)
+{
+    static const CHAR *topics[] = { "site/3/floor/7/room/12/temp", "site/9/floor/1/room/4/humidity",
+                                    "site/3/alarm", "other/topic/not/registered" };
+    CHAR filter[TRIE_FILTER_SIZE];
+    ULONG64 start;
+    ULONG64 trie_ns;
+    ULONG64 scan_ns;
+    UINT iterations = 20000;
+    UINT matched = 0;
+    UINT count = 0;
+    UINT site;
+    UINT floor;
+    UINT i;
+    UINT j;
+
+    trie_setup();
+    for (site = 0; site < 10; site++)
+    {
+        for (floor = 0; floor < 8; floor++)
+        {
+            sprintf(filter, "site/%u/floor/%u/room/+/temp", site, floor);
+            trie_insert(count++, filter);
+            sprintf(filter, "site/%u/floor/%u/room/+/humidity", site, floor);
+            trie_insert(count++, filter);
+            sprintf(filter, "site/%u/floor/%u/#", site, floor);
+            trie_insert(count++, filter);
+            for (i = 0; i < 4; i++)
+            {
+                sprintf(filter, "site/%u/floor/%u/room/%u/light", site, floor, i);
+                trie_insert(count++, filter);
+            }
+        }
+        sprintf(filter, "site/%u/alarm", site);
+        trie_insert(count++, filter);
+    }
+
+    start = host_clock_ns();
+    for (i = 0; i < iterations; i++)
+    {
+        matched += trie_match(topics[i % 4]);
+    }
+    trie_ns = host_clock_ns() - start;
+
+    start = host_clock_ns();
+    for (i = 0; i < iterations; i++)
+    {
+        for (j = 0; j < count; j++)
+        {
+            matched -= reference_match(trie_filters[j], topics[i % 4]);
+        }
+    }
+    scan_ns = host_clock_ns() - start;
+
+    TEST_ASSERT_EQUAL(0, matched);
+    printf("%u filters in %u nodes: trie %llu ns per topic, scan %llu ns per topic\n", count, trie_nodes_used(),
+           (unsigned long long)(trie_ns / iterations), (unsigned long long)(scan_ns / iterations));
+    trie_teardown();
+}
+
+int main(void)
+{
+    TEST_RUN(test_exact_and_wildcards);
+    TEST_RUN(test_remove);
+    TEST_RUN(test_capacity);
+    TEST_RUN(test_random_against_reference);
+    TEST_RUN(test_dispatch);
+    TEST_RUN(test_dispatch_unlocked);
+    TEST_RUN(test_dispatch_limits);
+    TEST_RUN(bench_match);
+    return TEST_RESULT();
+}
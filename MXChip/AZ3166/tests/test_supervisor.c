@@ -0,0 +1,176 @@
+// Supervisor: once the connection is lost, mqtt_reconnect retries with capped
+// exponential backoff, each delay drawn between half and all of the backoff,
+// rejoins the Wi-Fi first while the link is down, and records the time from
+// the loss to the next CONNACK. Runs without threads on the simulated clock:
+// the client is built in client_thread.c, and the supervisor's wait for its
+// CONNACK runs the MQTT thread in its place.
+
+#include <string.h>
+
+#define BOOT_TRACE_HOST
+#include "boot.c"
+#include "mqtt_client.c"
+#include "broker.h"
+#include "client_thread.h"
+#include "test.h"
+
+#define SUPERVISOR_PACKETS   16
+#define SUPERVISOR_REFUSALS  10    // Attempts refused by a broker that is down, enough to reach the cap
+#define SUPERVISOR_CHECKS    (SUPERVISOR_REFUSALS + 1)
+
+NX_PACKET_POOL nx_pool[2];
+NX_IP nx_ip;
+NX_DNS nx_dns_client;
+
+static BROKER broker;
+
+// The Wi-Fi link, and the joins that fail before it is up
+static UINT supervisor_link_up;
+static UINT supervisor_link_failures;
+static UINT supervisor_link_joins;
+
+// Times the supervisor checked the link, once per attempt while it is up
+static ULONG supervisor_check_times[SUPERVISOR_CHECKS];
+static UINT supervisor_checks;
+
+// Attempts the broker refuses before it is back
+static UINT supervisor_refusals;
+
+UINT wwd_network_connect()
+{
+    supervisor_link_joins++;
+    if (supervisor_link_failures)
+    {
+        supervisor_link_failures--;
+        return NX_NOT_CONNECTED;
+    }
+    supervisor_link_up = NX_TRUE;
+    return NX_SUCCESS;
+}
+
+UINT wwd_network_is_connected()
+{
+    if (supervisor_link_up && (supervisor_checks < SUPERVISOR_CHECKS))
+    {
+        supervisor_check_times[supervisor_checks++] = tx_time_get();
+    }
+    broker.refuse_connection = (supervisor_checks <= supervisor_refusals);
+    return supervisor_link_up;
+}
+
+static VOID supervisor_idle(VOID)
+{
+    client_thread_run(&mqtt_client);
+}
+
+// The broker ends the connection; the disconnect notify asks the supervisor to reconnect
+static VOID supervisor_drop(VOID)
+{
+    ULONG events;
+
+    TEST_ASSERT(mqtt_is_connected());
+    broker_close(&broker);
+    client_thread_run(&mqtt_client);
+    TEST_ASSERT(!mqtt_is_connected());
+    TEST_ASSERT_EQUAL(tx_time_get(), mqtt_outage_start);
+    TEST_ASSERT_EQUAL(TX_SUCCESS, tx_event_flags_get(&mqtt_supervisor_events, MQTT_RECONNECT_EVENT, TX_OR_CLEAR,
+                                                     &events, TX_NO_WAIT));
+    supervisor_checks = 0;
+}
+
+// The broker was not reachable at boot: the first retry comes after half to all of the first backoff
+static VOID test_first_connect(VOID)
+{
+    ULONG events;
+
+    TEST_ASSERT(!mqtt_is_connected());
+    TEST_ASSERT_EQUAL(TX_SUCCESS, tx_event_flags_get(&mqtt_supervisor_events, MQTT_RECONNECT_EVENT, TX_OR_CLEAR,
+                                                     &events, TX_NO_WAIT));
+    broker_attach(&broker, &mqtt_client.nxd_mqtt_client_socket);
+
+    mqtt_reconnect();
+    TEST_ASSERT(mqtt_is_connected());
+    TEST_ASSERT_EQUAL(1, supervisor_checks);
+    TEST_ASSERT(supervisor_check_times[0] - mqtt_outage_start >= MQTT_RECONNECT_DELAY_MIN / 2);
+    TEST_ASSERT(supervisor_check_times[0] - mqtt_outage_start <= MQTT_RECONNECT_DELAY_MIN);
+    TEST_ASSERT_EQUAL(1, mqtt_recover_count);
+    TEST_ASSERT_EQUAL(supervisor_check_times[0] - mqtt_outage_start, mqtt_recover_time_last);
+    TEST_ASSERT_EQUAL(1, broker_count(&broker, BROKER_CONNECT));
+    TEST_ASSERT_EQUAL(0, supervisor_link_joins);
+}
+
+// While the broker is down, the backoff doubles from attempt to attempt up to the cap, each delay
+// within half of it; the attempt after the broker is back recovers, and the recovery is timed
+static VOID test_backoff(VOID)
+{
+    ULONG backoff = MQTT_RECONNECT_DELAY_MIN;
+    ULONG last = tx_time_get();
+    ULONG delay;
+    UINT i;
+
+    supervisor_drop();
+    supervisor_refusals = SUPERVISOR_REFUSALS;
+    mqtt_reconnect();
+    supervisor_refusals = 0;
+
+    TEST_ASSERT(mqtt_is_connected());
+    TEST_ASSERT_EQUAL(SUPERVISOR_CHECKS, supervisor_checks);
+    for (i = 0; i < supervisor_checks; i++)
+    {
+        delay = supervisor_check_times[i] - last;
+        last = supervisor_check_times[i];
+        TEST_ASSERT(delay >= backoff / 2);
+        TEST_ASSERT(delay <= backoff);
+        backoff = (backoff * 2 < MQTT_RECONNECT_DELAY_MAX) ? backoff * 2 : MQTT_RECONNECT_DELAY_MAX;
+    }
+    TEST_ASSERT_EQUAL(MQTT_RECONNECT_DELAY_MAX, backoff);
+
+    // The refused attempts never reached MQTT
+    TEST_ASSERT_EQUAL(2, broker_count(&broker, BROKER_CONNECT));
+    TEST_ASSERT_EQUAL(2, mqtt_recover_count);
+    TEST_ASSERT_EQUAL(last - mqtt_outage_start, mqtt_recover_time_last);
+    TEST_ASSERT_EQUAL(mqtt_recover_time_last, mqtt_recover_time_max);
+    TEST_ASSERT(mqtt_recover_time_last >= (ULONG)SUPERVISOR_CHECKS * MQTT_RECONNECT_DELAY_MIN / 2);
+}
+
+// A dropped link is joined again before each attempt, and the attempts go on until it is up;
+// a shorter outage leaves the longest recovery as it was
+static VOID test_link_down(VOID)
+{
+    ULONG recover_time_max = mqtt_recover_time_max;
+
+    supervisor_drop();
+    supervisor_link_up = NX_FALSE;
+    supervisor_link_failures = 2;
+    supervisor_link_joins = 0;
+    mqtt_reconnect();
+
+    TEST_ASSERT(mqtt_is_connected());
+    TEST_ASSERT_EQUAL(3, supervisor_link_joins);
+    TEST_ASSERT_EQUAL(1, supervisor_checks);
+    TEST_ASSERT_EQUAL(3, broker_count(&broker, BROKER_CONNECT));
+    TEST_ASSERT_EQUAL(3, mqtt_recover_count);
+    TEST_ASSERT_EQUAL(supervisor_check_times[0] - mqtt_outage_start, mqtt_recover_time_last);
+    TEST_ASSERT(mqtt_recover_time_last < recover_time_max);
+    TEST_ASSERT_EQUAL(recover_time_max, mqtt_recover_time_max);
+}
+
+int main(void)
+{
+    srand(1);
+    nx_ip.nx_ip_id = NX_IP_ID;
+    host_packet_pool_create(&nx_pool[0], "tx", 1536, SUPERVISOR_PACKETS);
+    boot_init();
+    boot_phase_done(MQTT_BOOT_PHASES);
+    supervisor_link_up = NX_TRUE;
+
+    // No broker is attached yet, so the first attempt fails and leaves retrying to the supervisor
+    mqtt_init();
+    mqtt_connect();
+    host_idle_hook = supervisor_idle;
+
+    TEST_RUN(test_first_connect);
+    TEST_RUN(test_backoff);
+    TEST_RUN(test_link_down);
+    return TEST_RESULT();
+}
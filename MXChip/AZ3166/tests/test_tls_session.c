@@ -0,0 +1,225 @@
+// TLS session cache: with the cache on, the session of a completed handshake
+// is reset rather than deleted when its connection ends, and reused by the
+// next secure connect without calling the TLS setup callback again. The
+// handshake itself is always full, as the NetX Secure client does not resume
+// sessions, and nothing of the old session's keys is kept. Timings are in
+// ticks of the simulated clock, from the network model of the TLS server
+// stand-in.
+
+#include <string.h>
+
+#include "nxd_mqtt_client.c"
+#include "tls_server.h"
+#include "test_client.h"
+
+// A 50 ms round trip, and 300 ms of certificate checking and key exchange
+#define SESSION_ROUND_TRIP   5
+#define SESSION_KEY_EXCHANGE 30
+#define SESSION_HANDSHAKE    (2 * SESSION_ROUND_TRIP + SESSION_KEY_EXCHANGE)
+
+static NXD_MQTT_CLIENT client;
+static BROKER broker;
+static TLS_SERVER server;
+static UINT session_setups;
+static UINT session_connected;
+
+static UINT session_tls_setup(NXD_MQTT_CLIENT *client_ptr, NX_SECURE_TLS_SESSION *session_ptr,
+                              NX_SECURE_X509_CERT *certificate_ptr, NX_SECURE_X509_CERT *trusted_certificate_ptr)
+{
+    (void)client_ptr;
+    (void)certificate_ptr;
+    (void)trusted_certificate_ptr;
+    session_setups++;
+    return nx_secure_tls_session_create(session_ptr);
+}
+
+static VOID session_connect_notify(NXD_MQTT_CLIENT *client_ptr, UINT status, VOID *context)
+{
+    (void)client_ptr;
+    (void)context;
+    if (status == NXD_MQTT_SUCCESS)
+    {
+        session_connected++;
+    }
+}
+
+static VOID session_setup(UINT cache)
+{
+    memset(&broker, 0, sizeof(broker));
+    memset(&server, 0, sizeof(server));
+    session_setups = 0;
+    session_connected = 0;
+    test_client_create(&client, 16);
+    client.nxd_mqtt_connect_notify = session_connect_notify;
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_tls_cache_set(&client, cache));
+    broker_attach(&broker, &client.nxd_mqtt_client_socket);
+    tls_server_attach(&server, &broker, SESSION_ROUND_TRIP, SESSION_KEY_EXCHANGE);
+}
+
+static VOID session_teardown(VOID)
+{
+    test_client_delete(&client);
+    TEST_ASSERT_EQUAL(host_network_pool.nx_packet_pool_total, host_network_pool.nx_packet_pool_available);
+}
+
+static UINT session_connect(ULONG wait_option)
+{
+    NXD_ADDRESS server_ip;
+    UINT status;
+
+    server_ip.nxd_ip_version = NX_IP_VERSION_V4;
+    server_ip.nxd_ip_address.v4 = IP_ADDRESS(127, 0, 0, 1);
+    status = _nxd_mqtt_client_secure_connect(&client, &server_ip, 8883, session_tls_setup, 0, NX_TRUE, wait_option);
+    test_client_run(&client);
+    return status;
+}
+
+static VOID session_disconnect(VOID)
+{
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_disconnect(&client));
+    test_client_run(&client);
+}
+
+// A kept session holds no session ID or keys of the connection that ended
+static VOID session_expect_wiped(VOID)
+{
+    static const UCHAR zero[NX_SECURE_TLS_MASTER_SIZE];
+
+    TEST_ASSERT_EQUAL(0, client.nxd_mqtt_tls_session.nx_secure_tls_session_id_length);
+    TEST_ASSERT(memcmp(client.nxd_mqtt_tls_session.nx_secure_tls_key_material.nx_secure_tls_master_secret, zero,
+                       sizeof(zero)) == 0);
+}
+
+// The second connection reuses the session of the first, without setting it up again
+static VOID test_reuse(VOID)
+{
+    NXD_MQTT_TLS_STATISTICS statistics;
+
+    session_setup(NX_TRUE);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, session_connect(NX_IP_PERIODIC_RATE));
+    TEST_ASSERT_EQUAL(NX_TRUE, client.nxd_mqtt_tls_session_cached);
+    session_disconnect();
+    TEST_ASSERT_EQUAL(NX_TRUE, client.nxd_mqtt_tls_session_cached);
+    session_expect_wiped();
+
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, session_connect(NX_IP_PERIODIC_RATE));
+    TEST_ASSERT_EQUAL(1, session_setups);
+    TEST_ASSERT_EQUAL(2, server.handshakes);
+    TEST_ASSERT_EQUAL(0, server.offered);
+    TEST_ASSERT_EQUAL(2, broker_count(&broker, BROKER_CONNECT));
+
+    _nxd_mqtt_client_tls_statistics_get(&client, &statistics);
+    TEST_ASSERT_EQUAL(2, statistics.nxd_mqtt_tls_statistics_handshakes);
+    TEST_ASSERT_EQUAL(1, statistics.nxd_mqtt_tls_statistics_reused);
+    TEST_ASSERT_EQUAL(0, statistics.nxd_mqtt_tls_statistics_failures);
+    TEST_ASSERT_EQUAL(SESSION_HANDSHAKE, statistics.nxd_mqtt_tls_statistics_last);
+    TEST_ASSERT_EQUAL(SESSION_HANDSHAKE, statistics.nxd_mqtt_tls_statistics_minimum);
+    TEST_ASSERT_EQUAL(SESSION_HANDSHAKE, statistics.nxd_mqtt_tls_statistics_maximum);
+
+    session_disconnect();
+    session_teardown();
+}
+
+// Without the cache, each connection sets up a new session; turning the cache off deletes a kept one
+static VOID test_no_cache(VOID)
+{
+    NXD_MQTT_TLS_STATISTICS statistics;
+
+    session_setup(NX_FALSE);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, session_connect(NX_IP_PERIODIC_RATE));
+    session_disconnect();
+    TEST_ASSERT_EQUAL(NX_FALSE, client.nxd_mqtt_tls_session_cached);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, session_connect(NX_IP_PERIODIC_RATE));
+    TEST_ASSERT_EQUAL(2, session_setups);
+
+    _nxd_mqtt_client_tls_statistics_get(&client, &statistics);
+    TEST_ASSERT_EQUAL(2, statistics.nxd_mqtt_tls_statistics_handshakes);
+    TEST_ASSERT_EQUAL(0, statistics.nxd_mqtt_tls_statistics_reused);
+    session_disconnect();
+
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_tls_cache_set(&client, NX_TRUE));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, session_connect(NX_IP_PERIODIC_RATE));
+    session_disconnect();
+    TEST_ASSERT_EQUAL(NX_TRUE, client.nxd_mqtt_tls_session_cached);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_tls_cache_set(&client, NX_FALSE));
+    TEST_ASSERT_EQUAL(NX_FALSE, client.nxd_mqtt_tls_session_cached);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, session_connect(NX_IP_PERIODIC_RATE));
+    TEST_ASSERT_EQUAL(4, session_setups);
+
+    session_disconnect();
+    session_teardown();
+}
+
+// A handshake failing on a kept session drops it; the next connect sets up a new one
+static VOID test_failure(VOID)
+{
+    NXD_MQTT_TLS_STATISTICS statistics;
+
+    session_setup(NX_TRUE);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, session_connect(NX_IP_PERIODIC_RATE));
+    session_disconnect();
+
+    server.fail_handshake = NX_TRUE;
+    TEST_ASSERT(session_connect(NX_IP_PERIODIC_RATE) != NXD_MQTT_SUCCESS);
+    TEST_ASSERT_EQUAL(1, server.alerts);
+    TEST_ASSERT_EQUAL(NX_FALSE, client.nxd_mqtt_tls_session_cached);
+    TEST_ASSERT(client.nxd_mqtt_client_state != NXD_MQTT_CLIENT_STATE_CONNECTED);
+
+    server.fail_handshake = NX_FALSE;
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, session_connect(NX_IP_PERIODIC_RATE));
+    TEST_ASSERT_EQUAL(2, session_setups);
+
+    _nxd_mqtt_client_tls_statistics_get(&client, &statistics);
+    TEST_ASSERT_EQUAL(1, statistics.nxd_mqtt_tls_statistics_failures);
+    TEST_ASSERT_EQUAL(2, statistics.nxd_mqtt_tls_statistics_handshakes);
+    TEST_ASSERT_EQUAL(0, statistics.nxd_mqtt_tls_statistics_reused);
+
+    session_disconnect();
+    session_teardown();
+}
+
+// Without waiting, the handshake runs from the client's events and the session is kept the same way
+static VOID test_async(VOID)
+{
+    NXD_MQTT_TLS_STATISTICS statistics;
+
+    session_setup(NX_TRUE);
+    TEST_ASSERT_EQUAL(NX_IN_PROGRESS, session_connect(NX_NO_WAIT));
+    TEST_ASSERT_EQUAL(1, session_connected);
+    session_disconnect();
+    session_expect_wiped();
+
+    TEST_ASSERT_EQUAL(NX_IN_PROGRESS, session_connect(NX_NO_WAIT));
+    TEST_ASSERT_EQUAL(2, session_connected);
+    TEST_ASSERT_EQUAL(1, session_setups);
+
+    _nxd_mqtt_client_tls_statistics_get(&client, &statistics);
+    TEST_ASSERT_EQUAL(2, statistics.nxd_mqtt_tls_statistics_handshakes);
+    TEST_ASSERT_EQUAL(1, statistics.nxd_mqtt_tls_statistics_reused);
+    TEST_ASSERT_EQUAL(SESSION_HANDSHAKE, statistics.nxd_mqtt_tls_statistics_last);
+    session_disconnect();
+
+    // A failed handshake is reported, and the session dropped
+    server.fail_handshake = NX_TRUE;
+    TEST_ASSERT_EQUAL(NX_IN_PROGRESS, session_connect(NX_NO_WAIT));
+    TEST_ASSERT_EQUAL(2, session_connected);
+    TEST_ASSERT_EQUAL(1, server.alerts);
+    TEST_ASSERT_EQUAL(NX_FALSE, client.nxd_mqtt_tls_session_cached);
+
+    server.fail_handshake = NX_FALSE;
+    TEST_ASSERT_EQUAL(NX_IN_PROGRESS, session_connect(NX_NO_WAIT));
+    TEST_ASSERT_EQUAL(3, session_connected);
+    TEST_ASSERT_EQUAL(2, session_setups);
+
+    session_disconnect();
+    session_teardown();
+}
+
+int main(void)
+{
+    TEST_RUN(test_reuse);
+    TEST_RUN(test_no_cache);
+    TEST_RUN(test_failure);
+    TEST_RUN(test_async);
+    return TEST_RESULT();
+}
@@ -0,0 +1,193 @@
+// Prepared topics: topic_prepare encodes a topic name once, and topic_publish
+// writes the fixed header in place in front of it. The packet on the wire is
+// the one publish would build for the same topic, byte for byte, whatever the
+// QoS, retain flag and length of its remaining-length field; QoS 1 and 2
+// messages take packet IDs from the same sequence and are kept until
+// acknowledged like any other.
+
+#include <string.h>
+
+#include "nxd_mqtt_client.c"
+#include "broker.h"
+#include "test_client.h"
+
+#define PREPARED_PACKETS 16
+#define PREPARED_SENT_SIZE 512
+
+static NXD_MQTT_CLIENT client;
+static BROKER broker;
+
+// Bytes the client sent since the last publish, tapped off before the broker parses them
+static UCHAR prepared_sent[PREPARED_SENT_SIZE];
+static ULONG prepared_sent_length;
+static VOID (*prepared_broker_receive)(HOST_TCP_PEER *peer_ptr, NX_TCP_SOCKET *socket_ptr, const UCHAR *data, ULONG length);
+
+static VOID prepared_tap(HOST_TCP_PEER *peer_ptr, NX_TCP_SOCKET *socket_ptr, const UCHAR *data, ULONG length)
+{
+    TEST_ASSERT(prepared_sent_length + length <= PREPARED_SENT_SIZE);
+    if (prepared_sent_length + length <= PREPARED_SENT_SIZE)
+    {
+        memcpy(prepared_sent + prepared_sent_length, data, length);
+        prepared_sent_length += length;
+    }
+    prepared_broker_receive(peer_ptr, socket_ptr, data, length);
+}
+
+static VOID prepared_setup(VOID)
+{
+    memset(&broker, 0, sizeof(broker));
+    test_client_create(&client, PREPARED_PACKETS);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, test_client_connect(&client, &broker));
+    prepared_broker_receive = broker.peer.host_tcp_peer_receive;
+    broker.peer.host_tcp_peer_receive = prepared_tap;
+}
+
+static VOID prepared_teardown(VOID)
+{
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_disconnect(&client));
+    test_client_run(&client);
+    test_client_delete(&client);
+}
+
+// Publish the same message both ways from the same packet ID, and compare what was sent
+static VOID prepared_compare(const CHAR *topic_name, UINT message_length, UINT retain, UINT QoS)
+{
+    static CHAR message[PREPARED_SENT_SIZE];
+    UCHAR expected[PREPARED_SENT_SIZE];
+    ULONG expected_length;
+    NXD_MQTT_TOPIC topic;
+    UINT packet_id = client.nxd_mqtt_client_packet_identifier;
+    UINT i;
+
+    for (i = 0; i < message_length; i++)
+    {
+        message[i] = (CHAR)('a' + i % 26);
+    }
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxde_mqtt_client_topic_prepare(&topic, (CHAR *)topic_name, strlen(topic_name)));
+
+    prepared_sent_length = 0;
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_publish(&client, (CHAR *)topic_name, strlen(topic_name),
+                                                                 message_length ? message : NX_NULL, message_length,
+                                                                 retain, QoS, NX_NO_WAIT));
+    test_client_run(&client);
+    memcpy(expected, prepared_sent, prepared_sent_length);
+    expected_length = prepared_sent_length;
+
+    client.nxd_mqtt_client_packet_identifier = packet_id;
+    prepared_sent_length = 0;
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxde_mqtt_client_topic_publish(&client, &topic,
+                                                                        message_length ? message : NX_NULL,
+                                                                        message_length, retain, QoS, NX_NO_WAIT));
+    test_client_run(&client);
+
+    // The publish was answered and the exchange completed, so the sent bytes begin with it
+    TEST_ASSERT(prepared_sent_length >= expected_length);
+    TEST_ASSERT(memcmp(prepared_sent, expected, expected_length) == 0);
+    TEST_ASSERT_EQUAL(0, client.nxd_mqtt_client_inflight_count);
+}
+
+// Byte for byte the packet of a normal publish, for each QoS, with and without retain and message
+static VOID test_same_bytes(VOID)
+{
+    UINT QoS;
+
+    prepared_setup();
+    for (QoS = 0; QoS <= 2; QoS++)
+    {
+        prepared_compare("office/smart_extension", 2, NX_FALSE, QoS);
+        prepared_compare("office/smart_extension", 2, NX_TRUE, QoS);
+        prepared_compare("o", 0, NX_FALSE, QoS);
+        prepared_compare("office/smart_extension", 300, NX_FALSE, QoS);
+    }
+    TEST_ASSERT_EQUAL(3 * 4 * 2, broker_count(&broker, BROKER_PUBLISH));
+    prepared_teardown();
+}
+
+// A remaining length of 127 takes one byte, and 128 takes two; both match a normal publish
+static VOID test_length_boundary(VOID)
+{
+    const CHAR *topic_name = "t/1";
+    UINT QoS;
+    UINT fixed;
+
+    prepared_setup();
+    for (QoS = 0; QoS <= 1; QoS++)
+    {
+        // Topic length field, topic, and the packet ID of QoS 1
+        fixed = 2 + strlen(topic_name) + (QoS ? 2 : 0);
+
+        prepared_compare(topic_name, 127 - fixed, NX_FALSE, QoS);
+        TEST_ASSERT_EQUAL(0x7F, prepared_sent[1]);
+        TEST_ASSERT_EQUAL(topic_name[0], prepared_sent[4]);
+        TEST_ASSERT_EQUAL(2 + 127, broker_last(&broker, BROKER_PUBLISH)->length);
+
+        prepared_compare(topic_name, 128 - fixed, NX_FALSE, QoS);
+        TEST_ASSERT_EQUAL(0x80, prepared_sent[1]);
+        TEST_ASSERT_EQUAL(0x01, prepared_sent[2]);
+        TEST_ASSERT_EQUAL(topic_name[0], prepared_sent[5]);
+        TEST_ASSERT_EQUAL(3 + 128, broker_last(&broker, BROKER_PUBLISH)->length);
+    }
+    prepared_teardown();
+}
+
+// Prepared QoS 1 messages take the next packet IDs, and are kept in flight until their PUBACK
+static VOID test_retained(VOID)
+{
+    NXD_MQTT_TOPIC topic;
+    USHORT first_id;
+
+    prepared_setup();
+    broker.hold = NX_TRUE;
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxde_mqtt_client_topic_prepare(&topic, "t/1", 3));
+
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_publish(&client, "t/1", 3, "a", 1, NX_FALSE, 1, NX_NO_WAIT));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxde_mqtt_client_topic_publish(&client, &topic, "b", 1, NX_FALSE, 1, NX_NO_WAIT));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxde_mqtt_client_topic_publish(&client, &topic, "c", 1, NX_FALSE, 1, NX_NO_WAIT));
+    test_client_run(&client);
+
+    TEST_ASSERT_EQUAL(3, broker_count(&broker, BROKER_PUBLISH));
+    first_id = broker.log[1].packet_id;
+    TEST_ASSERT_EQUAL(first_id + 1, broker.log[2].packet_id);
+    TEST_ASSERT_EQUAL(first_id + 2, broker.log[3].packet_id);
+    TEST_ASSERT_EQUAL(3, client.nxd_mqtt_client_inflight_count);
+
+    broker_ack(&broker, BROKER_PUBACK, first_id + 1);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(2, client.nxd_mqtt_client_inflight_count);
+    broker_ack(&broker, BROKER_PUBACK, first_id);
+    broker_ack(&broker, BROKER_PUBACK, first_id + 2);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(0, client.nxd_mqtt_client_inflight_count);
+    TEST_ASSERT(client.message_transmit_queue_head == NX_NULL);
+
+    prepared_teardown();
+}
+
+// The checked calls refuse an empty or oversized topic, and a topic that was never prepared
+static VOID test_error_checks(VOID)
+{
+    static CHAR long_name[NXD_MQTT_TOPIC_PREPARED_SIZE + 1];
+    NXD_MQTT_TOPIC topic;
+
+    prepared_setup();
+    memset(long_name, 'x', sizeof(long_name));
+    TEST_ASSERT_EQUAL(NX_PTR_ERROR, _nxde_mqtt_client_topic_prepare(NX_NULL, "t", 1));
+    TEST_ASSERT_EQUAL(NXD_MQTT_INVALID_PARAMETER, _nxde_mqtt_client_topic_prepare(&topic, "t", 0));
+    TEST_ASSERT_EQUAL(NXD_MQTT_INVALID_PARAMETER, _nxde_mqtt_client_topic_prepare(&topic, long_name, sizeof(long_name)));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxde_mqtt_client_topic_prepare(&topic, long_name, sizeof(long_name) - 1));
+
+    memset(&topic, 0, sizeof(topic));
+    TEST_ASSERT_EQUAL(NXD_MQTT_INVALID_PARAMETER, _nxde_mqtt_client_topic_publish(&client, &topic, "a", 1, NX_FALSE, 0,
+                                                                                  NX_NO_WAIT));
+    TEST_ASSERT_EQUAL(0, broker_count(&broker, BROKER_PUBLISH));
+    prepared_teardown();
+}
+
+int main(void)
+{
+    TEST_RUN(test_same_bytes);
+    TEST_RUN(test_length_boundary);
+    TEST_RUN(test_retained);
+    TEST_RUN(test_error_checks);
+    return TEST_RESULT();
+}
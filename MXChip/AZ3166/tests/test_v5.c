@@ -0,0 +1,366 @@
+// MQTT 5 against the broker stand-in: property blocks in CONNACK and PUBLISH,
+// inbound topic aliases, the client's Receive Maximum for QoS 2, and the
+// reason codes of a DISCONNECT in both directions.
+
+#include <string.h>
+
+#include "nxd_mqtt_client.c"
+#include "broker.h"
+#include "test_client.h"
+
+#define V5_RECEIVE_MAXIMUM 2
+
+static NXD_MQTT_CLIENT client;
+static BROKER broker;
+static ULONG v5_pool_available;
+static UINT v5_disconnects;
+
+static VOID v5_disconnect_notify(NXD_MQTT_CLIENT *client_ptr)
+{
+    (void)client_ptr;
+    v5_disconnects++;
+}
+
+static UINT v5_connect(ULONG maximum_packet_size, const UCHAR *connack_properties, UINT connack_properties_length)
+{
+    memset(&broker, 0, sizeof(broker));
+    v5_disconnects = 0;
+    memcpy(broker.connack_properties, connack_properties, connack_properties_length);
+    broker.connack_properties_length = connack_properties_length;
+    test_client_create(&client, 24);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_v5_set(&client, V5_RECEIVE_MAXIMUM, maximum_packet_size));
+    client.nxd_mqtt_disconnect_notify = v5_disconnect_notify;
+    return test_client_connect(&client, &broker);
+}
+
+static VOID v5_setup(ULONG maximum_packet_size)
+{
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, v5_connect(maximum_packet_size, NX_NULL, 0));
+    TEST_ASSERT_EQUAL(5, broker.protocol_level);
+    broker.hold = NX_TRUE;
+    v5_pool_available = test_pool.nx_packet_pool_available;
+}
+
+static VOID v5_teardown(VOID)
+{
+    TEST_ASSERT_EQUAL(host_network_pool.nx_packet_pool_total, host_network_pool.nx_packet_pool_available);
+    test_client_delete(&client);
+}
+
+// Send a PUBLISH with the property block given, its length included
+static VOID v5_publish(const CHAR *topic, UINT qos, USHORT packet_id, const UCHAR *properties, UINT properties_length,
+                       const CHAR *payload)
+{
+    UCHAR packet[256];
+    UINT topic_length = (UINT)strlen(topic);
+    UINT payload_length = (UINT)strlen(payload);
+    ULONG length;
+
+    packet[0] = (UCHAR)((BROKER_PUBLISH << 4) | (qos << 1));
+    length = 1 + broker_length_encode(packet + 1, 2 + topic_length + (qos ? 2 : 0) + properties_length + payload_length);
+    packet[length++] = (UCHAR)(topic_length >> 8);
+    packet[length++] = (UCHAR)topic_length;
+    memcpy(packet + length, topic, topic_length);
+    length += topic_length;
+    if (qos)
+    {
+        packet[length++] = (UCHAR)(packet_id >> 8);
+        packet[length++] = (UCHAR)packet_id;
+    }
+    memcpy(packet + length, properties, properties_length);
+    length += properties_length;
+    memcpy(packet + length, payload, payload_length);
+    broker_send(&broker, packet, length + payload_length);
+}
+
+static VOID v5_get(const CHAR *topic, const CHAR *payload)
+{
+    UCHAR topic_buffer[32];
+    UCHAR message[32];
+    ULONG topic_length;
+    ULONG message_length;
+
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_message_get(&client, topic_buffer, sizeof(topic_buffer),
+                                                                     (UINT *)&topic_length, message, sizeof(message),
+                                                                     (UINT *)&message_length));
+    TEST_ASSERT_EQUAL(strlen(topic), topic_length);
+    TEST_ASSERT(memcmp(topic_buffer, topic, topic_length) == 0);
+    TEST_ASSERT_EQUAL(strlen(payload), message_length);
+    TEST_ASSERT(memcmp(message, payload, message_length) == 0);
+}
+
+// The client closed the connection with a DISCONNECT carrying the reason code
+static VOID v5_expect_disconnect(UCHAR reason_code)
+{
+    BROKER_PACKET *disconnect_ptr;
+
+    test_client_run(&client);
+    disconnect_ptr = broker_last(&broker, BROKER_DISCONNECT);
+    TEST_ASSERT(disconnect_ptr != NX_NULL);
+    if (disconnect_ptr)
+    {
+        TEST_ASSERT_EQUAL(3, disconnect_ptr->length);
+        TEST_ASSERT_EQUAL(reason_code, disconnect_ptr->reason_code);
+    }
+    TEST_ASSERT_EQUAL(reason_code, client.nxd_mqtt_client_reason_code);
+    TEST_ASSERT_EQUAL(NXD_MQTT_CLIENT_STATE_IDLE, client.nxd_mqtt_client_state);
+    TEST_ASSERT_EQUAL(1, v5_disconnects);
+    TEST_ASSERT_EQUAL(0, client.message_receive_queue_depth);
+}
+
+// The broker's limits from CONNACK, and CONNACK property blocks that fail the connection
+static VOID test_connack_properties(VOID)
+{
+    static const UCHAR limits[] = { 8, MQTT_PROPERTY_RECEIVE_MAXIMUM, 0, 3, MQTT_PROPERTY_TOPIC_ALIAS_MAXIMUM, 0, 2,
+                                    0x24, 1 };
+    static const struct
+    {
+        UCHAR properties[8];
+        UINT length;
+    } malformed[] = {
+        { { 9, MQTT_PROPERTY_RECEIVE_MAXIMUM, 0, 3 }, 4 },                   // Longer than the packet
+        { { 3, 0x7F, 0, 3 }, 4 },                                            // Unknown property
+        { { 2, MQTT_PROPERTY_RECEIVE_MAXIMUM, 0 }, 3 },                      // Integer cut short by the block
+        { { 4, 0x1F, 0, 9, 'x' }, 5 },                                       // String past the block
+        { { 3, MQTT_PROPERTY_RECEIVE_MAXIMUM, 0, 0 }, 4 },                   // Receive Maximum of zero
+        { { 0x80, 0x80, 0x80, 0x80, 0x01 }, 5 },                             // Length of five bytes
+    };
+    UINT i;
+
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, v5_connect(0, limits, sizeof(limits)));
+    TEST_ASSERT_EQUAL(3, client.nxd_mqtt_client_send_maximum);
+    TEST_ASSERT(client.nxd_mqtt_client_window <= 3);
+    TEST_ASSERT_EQUAL(2, client.nxd_mqtt_client_send_alias_maximum);
+    v5_teardown();
+
+    for (i = 0; i < sizeof(malformed) / sizeof(malformed[0]); i++)
+    {
+        TEST_ASSERT_EQUAL(NXD_MQTT_SERVER_MESSAGE_FAILURE, v5_connect(0, malformed[i].properties, malformed[i].length));
+        TEST_ASSERT(client.nxd_mqtt_client_state != NXD_MQTT_CLIENT_STATE_CONNECTED);
+        v5_teardown();
+    }
+}
+
+// CONNACK reason codes map onto the connect errors, or are returned as they are
+static VOID test_connack_reason_codes(VOID)
+{
+    static const struct
+    {
+        UCHAR reason_code;
+        UINT status;
+    } codes[] = {
+        { 0x84, NXD_MQTT_ERROR_UNACCEPTABLE_PROTOCOL },
+        { 0x85, NXD_MQTT_ERROR_IDENTIFYIER_REJECTED },
+        { 0x86, NXD_MQTT_ERROR_BAD_USERNAME_PASSWORD },
+        { 0x87, NXD_MQTT_ERROR_NOT_AUTHORIZED },
+        { 0x88, NXD_MQTT_ERROR_SERVER_UNAVAILABLE },
+        { 0x9F, NXD_MQTT_ERROR_REASON_CODE + 0x9F },
+    };
+    UINT i;
+
+    for (i = 0; i < sizeof(codes) / sizeof(codes[0]); i++)
+    {
+        memset(&broker, 0, sizeof(broker));
+        broker.connack_return_code = codes[i].reason_code;
+        test_client_create(&client, 24);
+        TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_v5_set(&client, V5_RECEIVE_MAXIMUM, 0));
+        TEST_ASSERT_EQUAL(codes[i].status, test_client_connect(&client, &broker));
+        TEST_ASSERT_EQUAL(codes[i].reason_code, client.nxd_mqtt_client_reason_code);
+        v5_teardown();
+    }
+}
+
+// A PUBLISH whose property block cannot be walked closes the connection with Protocol Error
+static VOID test_malformed_publish_properties(VOID)
+{
+    static const struct
+    {
+        UCHAR properties[8];
+        UINT length;
+    } malformed[] = {
+        { { 40 }, 1 },                                                       // Longer than the packet
+        { { 2, 0x7F, 0 }, 3 },                                               // Unknown property
+        { { 2, MQTT_PROPERTY_TOPIC_ALIAS, 0 }, 3 },                          // Integer cut short by the block
+        { { 3, 0x26, 0, 1 }, 4 },                                            // User Property missing its value
+        { { 4, 0x03, 0, 20, 'x' }, 5 },                                      // String past the block
+    };
+    UINT i;
+
+    for (i = 0; i < sizeof(malformed) / sizeof(malformed[0]); i++)
+    {
+        v5_setup(0);
+        v5_publish("a/b", 1, 5, malformed[i].properties, malformed[i].length, "x");
+        v5_expect_disconnect(MQTT_REASON_CODE_PROTOCOL_ERROR);
+        TEST_ASSERT_EQUAL(0, broker_count(&broker, BROKER_PUBACK));
+        v5_teardown();
+    }
+
+    // Properties the client does not act on are skipped
+    v5_setup(0);
+    {
+        static const UCHAR known[] = { 14, 0x01, 1, 0x03, 0, 4, 't', 'e', 'x', 't', 0x26, 0, 0, 0, 0 };
+
+        v5_publish("a/b", 0, 0, known, sizeof(known), "kept");
+        test_client_run(&client);
+        TEST_ASSERT_EQUAL(NXD_MQTT_CLIENT_STATE_CONNECTED, client.nxd_mqtt_client_state);
+        v5_get("a/b", "kept");
+    }
+    v5_teardown();
+}
+
+// Aliases the broker set are resolved; an alias it never set, or out of range, closes the connection
+static VOID test_topic_aliases(VOID)
+{
+    static const UCHAR alias_1[] = { 3, MQTT_PROPERTY_TOPIC_ALIAS, 0, 1 };
+    static const UCHAR alias_2[] = { 3, MQTT_PROPERTY_TOPIC_ALIAS, 0, 2 };
+    static const UCHAR alias_large[] = { 3, MQTT_PROPERTY_TOPIC_ALIAS, 0, NXD_MQTT_V5_TOPIC_ALIAS_COUNT + 1 };
+    static const UCHAR none[] = { 0 };
+
+    v5_setup(0);
+    v5_publish("room/1/temp", 0, 0, alias_1, sizeof(alias_1), "21");
+    v5_publish("", 0, 0, alias_1, sizeof(alias_1), "22");
+    v5_publish("", 1, 9, alias_1, sizeof(alias_1), "23");
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(3, client.message_receive_queue_depth);
+    TEST_ASSERT_EQUAL(9, broker_last(&broker, BROKER_PUBACK)->packet_id);
+    v5_get("room/1/temp", "21");
+    v5_get("room/1/temp", "22");
+    v5_get("room/1/temp", "23");
+
+    // A topic sent with an alias set already replaces it
+    v5_publish("room/2/temp", 0, 0, alias_1, sizeof(alias_1), "18");
+    v5_publish("", 0, 0, alias_1, sizeof(alias_1), "19");
+    test_client_run(&client);
+    v5_get("room/2/temp", "18");
+    v5_get("room/2/temp", "19");
+    TEST_ASSERT_EQUAL(v5_pool_available, test_pool.nx_packet_pool_available);
+
+    // Alias 2 was never set
+    v5_publish("", 1, 10, alias_2, sizeof(alias_2), "x");
+    v5_expect_disconnect(MQTT_REASON_CODE_TOPIC_ALIAS_INVALID);
+    TEST_ASSERT_EQUAL(10 - 9, broker_count(&broker, BROKER_PUBACK));
+    v5_teardown();
+
+    // Out of the range the client accepts
+    v5_setup(0);
+    v5_publish("a", 0, 0, alias_large, sizeof(alias_large), "x");
+    v5_expect_disconnect(MQTT_REASON_CODE_TOPIC_ALIAS_INVALID);
+    v5_teardown();
+
+    // No topic and no alias
+    v5_setup(0);
+    v5_publish("", 0, 0, none, sizeof(none), "x");
+    v5_expect_disconnect(MQTT_REASON_CODE_PROTOCOL_ERROR);
+    v5_teardown();
+
+    // Aliases do not outlive the connection
+    v5_setup(0);
+    v5_publish("room/1/temp", 0, 0, alias_1, sizeof(alias_1), "21");
+    test_client_run(&client);
+    v5_get("room/1/temp", "21");
+    broker_close(&broker);
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(NX_SUCCESS, test_client_connect(&client, &broker));
+    v5_disconnects = 0;
+    v5_publish("", 0, 0, alias_1, sizeof(alias_1), "22");
+    v5_expect_disconnect(MQTT_REASON_CODE_TOPIC_ALIAS_INVALID);
+    v5_teardown();
+}
+
+// More QoS 2 messages awaiting PUBREL than the client's Receive Maximum close the connection
+static VOID test_receive_maximum(VOID)
+{
+    static const UCHAR none[] = { 0 };
+
+    v5_setup(0);
+    v5_publish("cmd", 2, 1, none, sizeof(none), "one");
+    v5_publish("cmd", 2, 2, none, sizeof(none), "two");
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(V5_RECEIVE_MAXIMUM, client.nxd_mqtt_client_qos2_receive_count);
+    TEST_ASSERT_EQUAL(2, broker_count(&broker, BROKER_PUBREC));
+
+    // A retransmission of one already held is not another message
+    v5_publish("cmd", 2, 1, none, sizeof(none), "one");
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(NXD_MQTT_CLIENT_STATE_CONNECTED, client.nxd_mqtt_client_state);
+    TEST_ASSERT_EQUAL(3, broker_count(&broker, BROKER_PUBREC));
+
+    // PUBREL makes room for the next one
+    broker_ack(&broker, BROKER_PUBREL, 1);
+    v5_publish("cmd", 2, 3, none, sizeof(none), "three");
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(NXD_MQTT_CLIENT_STATE_CONNECTED, client.nxd_mqtt_client_state);
+    TEST_ASSERT_EQUAL(3, client.message_receive_queue_depth);
+    v5_get("cmd", "one");
+    v5_get("cmd", "two");
+    v5_get("cmd", "three");
+
+    // QoS 1 messages are not counted
+    v5_publish("cmd", 1, 4, none, sizeof(none), "four");
+    test_client_run(&client);
+    v5_get("cmd", "four");
+
+    // One over
+    v5_publish("cmd", 2, 5, none, sizeof(none), "five");
+    v5_expect_disconnect(MQTT_REASON_CODE_RECEIVE_MAXIMUM_EXCEEDED);
+    TEST_ASSERT_EQUAL(4, broker_count(&broker, BROKER_PUBREC));
+    v5_teardown();
+}
+
+// A PUBLISH over the client's Maximum Packet Size closes the connection
+static VOID test_packet_too_large(VOID)
+{
+    static const UCHAR none[] = { 0 };
+
+    v5_setup(32);
+    v5_publish("t", 0, 0, none, sizeof(none), "fits in 32 bytes");
+    test_client_run(&client);
+    v5_get("t", "fits in 32 bytes");
+    v5_publish("t", 0, 0, none, sizeof(none), "one that does not fit in 32 bytes");
+    v5_expect_disconnect(MQTT_REASON_CODE_PACKET_TOO_LARGE);
+    v5_teardown();
+}
+
+// The reason code of a broker's DISCONNECT is kept, and the client's own DISCONNECT is normal
+static VOID test_disconnect_reason_codes(VOID)
+{
+    static const UCHAR shutting_down[] = { BROKER_DISCONNECT << 4, 2, 0x8B, 0 };
+    static const UCHAR normal[] = { BROKER_DISCONNECT << 4, 0 };
+
+    v5_setup(0);
+    broker_send(&broker, shutting_down, sizeof(shutting_down));
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(0x8B, client.nxd_mqtt_client_reason_code);
+    TEST_ASSERT_EQUAL(NXD_MQTT_CLIENT_STATE_IDLE, client.nxd_mqtt_client_state);
+    TEST_ASSERT_EQUAL(1, v5_disconnects);
+    TEST_ASSERT_EQUAL(0, broker_count(&broker, BROKER_DISCONNECT));
+
+    // A new connection starts with no reason code
+    TEST_ASSERT_EQUAL(NX_SUCCESS, test_client_connect(&client, &broker));
+    TEST_ASSERT_EQUAL(0, client.nxd_mqtt_client_reason_code);
+    broker_send(&broker, normal, sizeof(normal));
+    test_client_run(&client);
+    TEST_ASSERT_EQUAL(0, client.nxd_mqtt_client_reason_code);
+    TEST_ASSERT_EQUAL(NXD_MQTT_CLIENT_STATE_IDLE, client.nxd_mqtt_client_state);
+    TEST_ASSERT_EQUAL(2, v5_disconnects);
+
+    // Normal disconnection: no reason code, and so no remaining length
+    TEST_ASSERT_EQUAL(NX_SUCCESS, test_client_connect(&client, &broker));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_disconnect(&client));
+    TEST_ASSERT_EQUAL(1, broker_count(&broker, BROKER_DISCONNECT));
+    TEST_ASSERT_EQUAL(2, broker_last(&broker, BROKER_DISCONNECT)->length);
+    TEST_ASSERT_EQUAL(0, broker_last(&broker, BROKER_DISCONNECT)->reason_code);
+    v5_teardown();
+}
+
+int main(void)
+{
+    TEST_RUN(test_connack_properties);
+    TEST_RUN(test_connack_reason_codes);
+    TEST_RUN(test_malformed_publish_properties);
+    TEST_RUN(test_topic_aliases);
+    TEST_RUN(test_receive_maximum);
+    TEST_RUN(test_packet_too_large);
+    TEST_RUN(test_disconnect_reason_codes);
+    return TEST_RESULT();
+}
@@ -0,0 +1,248 @@
+// In-flight window: the number of stored QoS 1 messages awaiting a PUBACK.
+// It grows by one per window of acknowledgements while publishers find it
+// full, shrinks when the acknowledgement latency rises, and is fitted to the
+// messages in flight when the retention pool runs out first. A publisher that
+// finds it full gets NXD_MQTT_WINDOW_FULL, at once or after its wait, or
+// waits for the credits the PUBACKs return, passing the wakeup on to the next
+// waiting publisher while credits remain.
+
+#include <string.h>
+
+#include "nxd_mqtt_client.c"
+#include "broker.h"
+#include "test_client.h"
+
+#define WINDOW_PUBLISHERS 3
+#define WINDOW_ROUNDS     10
+
+// A stored copy for each message of the largest window, and the packets being built
+#define WINDOW_PACKETS    (NXD_MQTT_WINDOW_MAXIMUM + 8)
+
+static NXD_MQTT_CLIENT client;
+static BROKER broker;
+static NX_PACKET_POOL window_retention_pool;
+
+// PUBLISH packets of the broker log acknowledged so far
+static UINT window_acked;
+
+static TX_THREAD window_threads[WINDOW_PUBLISHERS];
+static TX_SEMAPHORE window_done;
+static UINT window_status[WINDOW_PUBLISHERS];
+
+static VOID window_setup(VOID)
+{
+    memset(&broker, 0, sizeof(broker));
+    window_acked = 0;
+    test_client_create(&client, WINDOW_PACKETS);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, test_client_connect(&client, &broker));
+    broker.hold = NX_TRUE;
+    TEST_ASSERT_EQUAL(NXD_MQTT_WINDOW_INITIAL, client.nxd_mqtt_client_window);
+}
+
+static VOID window_teardown(VOID)
+{
+    test_client_delete(&client);
+    TEST_ASSERT_EQUAL(host_network_pool.nx_packet_pool_total, host_network_pool.nx_packet_pool_available);
+}
+
+static UINT window_publish(ULONG wait_option)
+{
+    return _nxd_mqtt_client_publish(&client, "t/1", 3, "on", 2, 0, 1, wait_option);
+}
+
+// Acknowledge the next count messages the broker received, and let the client process the PUBACKs
+static VOID window_ack(UINT count)
+{
+    UINT published = 0;
+    UINT i;
+
+    for (i = 0; (i < broker.log_count) && (count > 0); i++)
+    {
+        if ((broker.log[i].type == BROKER_PUBLISH) && (published++ >= window_acked))
+        {
+            broker_ack(&broker, BROKER_PUBACK, broker.log[i].packet_id);
+            window_acked++;
+            count--;
+        }
+    }
+    TEST_ASSERT_EQUAL(0, count);
+    test_client_run(&client);
+}
+
+// Fill the window, which leaves it limited
+static VOID window_fill(VOID)
+{
+    UINT i;
+
+    for (i = client.nxd_mqtt_client_window_used; i < client.nxd_mqtt_client_window; i++)
+    {
+        TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, window_publish(NX_NO_WAIT));
+    }
+    TEST_ASSERT_EQUAL(client.nxd_mqtt_client_window, client.nxd_mqtt_client_window_used);
+}
+
+// A full window fails the publish at once without a wait, and after the wait without a credit
+static VOID test_full(VOID)
+{
+    UINT published;
+
+    window_setup();
+    window_fill();
+    published = broker_count(&broker, BROKER_PUBLISH);
+
+    TEST_ASSERT_EQUAL(NXD_MQTT_WINDOW_FULL, window_publish(NX_NO_WAIT));
+    TEST_ASSERT_EQUAL(NX_TRUE, client.nxd_mqtt_client_window_limited);
+    TEST_ASSERT_EQUAL(NXD_MQTT_WINDOW_FULL, window_publish(NX_IP_PERIODIC_RATE));
+    TEST_ASSERT_EQUAL(published, broker_count(&broker, BROKER_PUBLISH));
+    TEST_ASSERT_EQUAL(NXD_MQTT_WINDOW_INITIAL, client.nxd_mqtt_client_window_used);
+
+    // A returned credit lets the next one through
+    window_ack(1);
+    TEST_ASSERT_EQUAL(NXD_MQTT_WINDOW_INITIAL - 1, client.nxd_mqtt_client_window_used);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, window_publish(NX_NO_WAIT));
+    TEST_ASSERT_EQUAL(published + 1, broker_count(&broker, BROKER_PUBLISH));
+
+    window_ack(NXD_MQTT_WINDOW_INITIAL);
+    window_teardown();
+}
+
+// A window of prompt acknowledgements grows it by one while it was limited, and not otherwise;
+// rising latency shrinks it by one
+static VOID test_growth(VOID)
+{
+    UINT window;
+
+    window_setup();
+
+    // Not limited: no growth
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, window_publish(NX_NO_WAIT));
+    window_ack(1);
+    for (window = 0; window < NXD_MQTT_WINDOW_INITIAL; window++)
+    {
+        TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, window_publish(NX_NO_WAIT));
+    }
+    window_ack(NXD_MQTT_WINDOW_INITIAL);
+    TEST_ASSERT_EQUAL(NXD_MQTT_WINDOW_INITIAL, client.nxd_mqtt_client_window);
+
+    // Limited, one step per window up to the maximum
+    for (window = NXD_MQTT_WINDOW_INITIAL; window < NXD_MQTT_WINDOW_MAXIMUM; window++)
+    {
+        window_fill();
+        TEST_ASSERT_EQUAL(NXD_MQTT_WINDOW_FULL, window_publish(NX_NO_WAIT));
+        window_ack(window);
+        TEST_ASSERT_EQUAL(window + 1, client.nxd_mqtt_client_window);
+        TEST_ASSERT_EQUAL(NX_FALSE, client.nxd_mqtt_client_window_limited);
+    }
+    window_fill();
+    TEST_ASSERT_EQUAL(NXD_MQTT_WINDOW_FULL, window_publish(NX_NO_WAIT));
+    window_ack(NXD_MQTT_WINDOW_MAXIMUM);
+    TEST_ASSERT_EQUAL(NXD_MQTT_WINDOW_MAXIMUM, client.nxd_mqtt_client_window);
+
+    // Acknowledgements half a second late, against none before: the path is queueing
+    window_fill();
+    host_time_advance(NX_IP_PERIODIC_RATE / 2);
+    window_ack(NXD_MQTT_WINDOW_MAXIMUM);
+    TEST_ASSERT_EQUAL(NXD_MQTT_WINDOW_MAXIMUM - 1, client.nxd_mqtt_client_window);
+
+    window_teardown();
+}
+
+// The retention pool running out before the window fits the window to the messages it holds
+static VOID test_pool_shrink(VOID)
+{
+    window_setup();
+    host_packet_pool_create(&window_retention_pool, "retention", TEST_PACKET_PAYLOAD, 2);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, _nxd_mqtt_client_retention_pool_set(&client, &window_retention_pool));
+
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, window_publish(NX_NO_WAIT));
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, window_publish(NX_NO_WAIT));
+    TEST_ASSERT_EQUAL(0, window_retention_pool.nx_packet_pool_available);
+
+    TEST_ASSERT_EQUAL(NXD_MQTT_WINDOW_FULL, window_publish(NX_NO_WAIT));
+    TEST_ASSERT_EQUAL(2, client.nxd_mqtt_client_window);
+    TEST_ASSERT_EQUAL(2, client.nxd_mqtt_client_window_used);
+    TEST_ASSERT_EQUAL(NX_TRUE, client.nxd_mqtt_client_window_limited);
+    TEST_ASSERT_EQUAL(2, broker_count(&broker, BROKER_PUBLISH));
+
+    // The PUBACK returns a packet with the credit
+    window_ack(1);
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, window_publish(NX_NO_WAIT));
+    window_ack(2);
+
+    test_client_delete(&client);
+    TEST_ASSERT_EQUAL(window_retention_pool.nx_packet_pool_total, window_retention_pool.nx_packet_pool_available);
+    host_packet_pool_delete(&window_retention_pool);
+}
+
+static VOID window_publisher(ULONG index)
+{
+    window_status[index] = window_publish(TX_WAIT_FOREVER);
+    tx_semaphore_put(&window_done);
+}
+
+// Publishers blocked on a full window: each returned credit lets one through, and credits
+// returned together wake as many publishers, passed on from one to the next. Whether a woken
+// publisher takes its wakeup before the next credit is returned varies, so this runs a few rounds
+static VOID test_blocked_publishers(VOID)
+{
+    UINT published;
+    UINT round;
+    UINT i;
+
+    // Held at its size, so credits come back only from PUBACKs
+    window_setup();
+    TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS,
+                      _nxd_mqtt_client_window_set(&client, NXD_MQTT_WINDOW_INITIAL, NXD_MQTT_WINDOW_INITIAL));
+    tx_semaphore_create(&window_done, "done", 0);
+    host_thread_start_enable = NX_TRUE;
+
+    for (round = 0; round < WINDOW_ROUNDS; round++)
+    {
+        window_fill();
+        published = broker_count(&broker, BROKER_PUBLISH);
+        for (i = 0; i < WINDOW_PUBLISHERS; i++)
+        {
+            window_status[i] = NXD_MQTT_INTERNAL_ERROR;
+            tx_thread_create(&window_threads[i], "publisher", window_publisher, i, NX_NULL, 0, 5, 5, 0, TX_AUTO_START);
+        }
+        while (client.nxd_mqtt_client_window_semaphore.tx_semaphore_suspended_count < WINDOW_PUBLISHERS)
+        {
+            tx_thread_sleep(1);
+        }
+
+        // All but one credit at once
+        window_ack(WINDOW_PUBLISHERS - 1);
+        for (i = 0; i < WINDOW_PUBLISHERS - 1; i++)
+        {
+            TEST_ASSERT_EQUAL(TX_SUCCESS, tx_semaphore_get(&window_done, 10 * NX_IP_PERIODIC_RATE));
+        }
+        TEST_ASSERT_EQUAL(TX_NO_INSTANCE, tx_semaphore_get(&window_done, NX_IP_PERIODIC_RATE / 10));
+        TEST_ASSERT_EQUAL(published + WINDOW_PUBLISHERS - 1, broker_count(&broker, BROKER_PUBLISH));
+
+        // The last one waits for the next credit
+        window_ack(1);
+        TEST_ASSERT_EQUAL(TX_SUCCESS, tx_semaphore_get(&window_done, 10 * NX_IP_PERIODIC_RATE));
+        TEST_ASSERT_EQUAL(published + WINDOW_PUBLISHERS, broker_count(&broker, BROKER_PUBLISH));
+
+        for (i = 0; i < WINDOW_PUBLISHERS; i++)
+        {
+            tx_thread_delete(&window_threads[i]);
+            TEST_ASSERT_EQUAL(NXD_MQTT_SUCCESS, window_status[i]);
+        }
+    }
+
+    host_thread_start_enable = NX_FALSE;
+    tx_semaphore_delete(&window_done);
+
+    window_ack(client.nxd_mqtt_client_window_used);
+    window_teardown();
+}
+
+int main(void)
+{
+    TEST_RUN(test_full);
+    TEST_RUN(test_growth);
+    TEST_RUN(test_pool_shrink);
+    TEST_RUN(test_blocked_publishers);
+    return TEST_RESULT();
+}
@@ -0,0 +1,207 @@
+// A TLS server stand-in for the host tests. See tls_server.h.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tls_server.h"
+
+// Handshake steps of a connection
+#define TLS_SERVER_WAIT_HELLO             0
+#define TLS_SERVER_WAIT_KEY_EXCHANGE      1
+#define TLS_SERVER_WAIT_FINISHED          2
+#define TLS_SERVER_ESTABLISHED            3
+
+#define TLS_SERVER_ALERT_HANDSHAKE_FAILURE 40
+
+static VOID tls_server_send(TLS_SERVER *server_ptr, const UCHAR *data, ULONG length)
+{
+    if (host_tcp_deliver(server_ptr->broker_ptr->socket_ptr, data, length, 0) != NX_SUCCESS)
+    {
+        fprintf(stderr, "tls server: send without a connection\n");
+        abort();
+    }
+}
+
+static VOID tls_server_alert(TLS_SERVER *server_ptr)
+{
+    UCHAR record[8];
+
+    server_ptr->alerts++;
+    server_ptr->state = TLS_SERVER_WAIT_HELLO;
+    tls_server_send(server_ptr, record,
+                    host_tls_record_encode(record, HOST_TLS_CONTENT_ALERT, TLS_SERVER_ALERT_HANDSHAKE_FAILURE, NX_NULL, 0));
+}
+
+// Answer a ClientHello with a new session
+static VOID tls_server_hello(TLS_SERVER *server_ptr, const UCHAR *body, ULONG length)
+{
+    UCHAR hello[1 + NX_SECURE_TLS_SESSION_ID_SIZE + 2];
+    UCHAR flight[64];
+    ULONG flight_length;
+
+    if ((length < 1) || (body[0] > NX_SECURE_TLS_SESSION_ID_SIZE) || (length != 1u + body[0]))
+    {
+        tls_server_alert(server_ptr);
+        return;
+    }
+    if (body[0])
+    {
+        server_ptr->offered++;
+    }
+
+    // The ClientHello and the server's first flight make one round trip
+    host_time_advance(server_ptr->round_trip_ticks);
+
+    if (server_ptr->fail_handshake)
+    {
+        tls_server_alert(server_ptr);
+        return;
+    }
+
+    server_ptr->next_session++;
+    hello[0] = NX_SECURE_TLS_SESSION_ID_SIZE;
+    memset(hello + 1, server_ptr->next_session, NX_SECURE_TLS_SESSION_ID_SIZE);
+    hello[1 + NX_SECURE_TLS_SESSION_ID_SIZE] = 0xC0;
+    hello[2 + NX_SECURE_TLS_SESSION_ID_SIZE] = 0x2F;
+    flight_length = host_tls_record_encode(flight, HOST_TLS_CONTENT_HANDSHAKE, HOST_TLS_SERVER_HELLO, hello, sizeof(hello));
+    flight_length += host_tls_record_encode(flight + flight_length, HOST_TLS_CONTENT_HANDSHAKE, HOST_TLS_CERTIFICATE,
+                                            NX_NULL, 0);
+    server_ptr->state = TLS_SERVER_WAIT_KEY_EXCHANGE;
+    tls_server_send(server_ptr, flight, flight_length);
+}
+
+// Check the client's Finished, and answer with the server's
+static VOID tls_server_finished(TLS_SERVER *server_ptr, const UCHAR *body, ULONG length)
+{
+    UCHAR verify_data[HOST_TLS_VERIFY_DATA_SIZE];
+    UCHAR record[6 + HOST_TLS_VERIFY_DATA_SIZE];
+
+    host_tls_verify_data(server_ptr->master_secret, 'c', verify_data);
+    if ((length != sizeof(verify_data)) || memcmp(body, verify_data, sizeof(verify_data)))
+    {
+        tls_server_alert(server_ptr);
+        return;
+    }
+
+    // The client's second flight and the server's Finished make the second round trip
+    host_time_advance(server_ptr->round_trip_ticks);
+    host_tls_verify_data(server_ptr->master_secret, 's', verify_data);
+    tls_server_send(server_ptr, record,
+                    host_tls_record_encode(record, HOST_TLS_CONTENT_HANDSHAKE, HOST_TLS_FINISHED,
+                                           verify_data, sizeof(verify_data)));
+    server_ptr->handshakes++;
+    server_ptr->state = TLS_SERVER_ESTABLISHED;
+}
+
+static VOID tls_server_record(TLS_SERVER *server_ptr, const UCHAR *record, ULONG length)
+{
+    const UCHAR *body = record + 6;
+    ULONG body_length = length - 6;
+
+    if ((record[0] != HOST_TLS_CONTENT_HANDSHAKE) || (length < 6))
+    {
+        tls_server_alert(server_ptr);
+        return;
+    }
+
+    switch (server_ptr->state)
+    {
+    case TLS_SERVER_WAIT_HELLO:
+        if (record[5] != HOST_TLS_CLIENT_HELLO)
+        {
+            tls_server_alert(server_ptr);
+            return;
+        }
+        tls_server_hello(server_ptr, body, body_length);
+        return;
+
+    case TLS_SERVER_WAIT_KEY_EXCHANGE:
+        if ((record[5] != HOST_TLS_CLIENT_KEY_EXCHANGE) || (body_length != NX_SECURE_TLS_MASTER_SIZE))
+        {
+            tls_server_alert(server_ptr);
+            return;
+        }
+        memcpy(server_ptr->master_secret, body, NX_SECURE_TLS_MASTER_SIZE);
+        host_time_advance(server_ptr->key_exchange_ticks);
+        server_ptr->state = TLS_SERVER_WAIT_FINISHED;
+        return;
+
+    default:
+        if (record[5] != HOST_TLS_FINISHED)
+        {
+            tls_server_alert(server_ptr);
+            return;
+        }
+        tls_server_finished(server_ptr, body, body_length);
+        return;
+    }
+}
+
+static UINT tls_server_connect(HOST_TCP_PEER *peer_ptr, NX_TCP_SOCKET *socket_ptr)
+{
+    TLS_SERVER *server_ptr = (TLS_SERVER *)peer_ptr;
+
+    server_ptr->state = TLS_SERVER_WAIT_HELLO;
+    server_ptr->stream_length = 0;
+    return server_ptr->broker_ptr->peer.host_tcp_peer_connect(&server_ptr->broker_ptr->peer, socket_ptr);
+}
+
+static VOID tls_server_receive(HOST_TCP_PEER *peer_ptr, NX_TCP_SOCKET *socket_ptr, const UCHAR *data, ULONG length)
+{
+    TLS_SERVER *server_ptr = (TLS_SERVER *)peer_ptr;
+    ULONG record_length;
+
+    if (server_ptr->state == TLS_SERVER_ESTABLISHED)
+    {
+        server_ptr->broker_ptr->peer.host_tcp_peer_receive(&server_ptr->broker_ptr->peer, socket_ptr, data, length);
+        return;
+    }
+
+    if (server_ptr->stream_length + length > sizeof(server_ptr->stream))
+    {
+        fprintf(stderr, "tls server: handshake buffer full\n");
+        abort();
+    }
+    memcpy(server_ptr->stream + server_ptr->stream_length, data, length);
+    server_ptr->stream_length += length;
+
+    while ((server_ptr->state != TLS_SERVER_ESTABLISHED) &&
+           (server_ptr->stream_length >= NX_SECURE_TLS_RECORD_HEADER_SIZE) &&
+           (server_ptr->stream_length >=
+            (record_length = NX_SECURE_TLS_RECORD_HEADER_SIZE +
+                             (ULONG)((server_ptr->stream[3] << 8) | server_ptr->stream[4]))))
+    {
+        tls_server_record(server_ptr, server_ptr->stream, record_length);
+        server_ptr->stream_length -= record_length;
+        memmove(server_ptr->stream, server_ptr->stream + record_length, server_ptr->stream_length);
+    }
+
+    // Application data behind the client's Finished
+    if ((server_ptr->state == TLS_SERVER_ESTABLISHED) && server_ptr->stream_length)
+    {
+        server_ptr->broker_ptr->peer.host_tcp_peer_receive(&server_ptr->broker_ptr->peer, socket_ptr,
+                                                           server_ptr->stream, server_ptr->stream_length);
+        server_ptr->stream_length = 0;
+    }
+}
+
+static VOID tls_server_disconnect(HOST_TCP_PEER *peer_ptr, NX_TCP_SOCKET *socket_ptr)
+{
+    TLS_SERVER *server_ptr = (TLS_SERVER *)peer_ptr;
+
+    server_ptr->state = TLS_SERVER_WAIT_HELLO;
+    server_ptr->stream_length = 0;
+    server_ptr->broker_ptr->peer.host_tcp_peer_disconnect(&server_ptr->broker_ptr->peer, socket_ptr);
+}
+
+VOID tls_server_attach(TLS_SERVER *server_ptr, BROKER *broker_ptr, ULONG round_trip_ticks, ULONG key_exchange_ticks)
+{
+    server_ptr->peer.host_tcp_peer_connect = tls_server_connect;
+    server_ptr->peer.host_tcp_peer_receive = tls_server_receive;
+    server_ptr->peer.host_tcp_peer_disconnect = tls_server_disconnect;
+    server_ptr->broker_ptr = broker_ptr;
+    server_ptr->round_trip_ticks = round_trip_ticks;
+    server_ptr->key_exchange_ticks = key_exchange_ticks;
+    broker_ptr->socket_ptr->host_tcp_peer = &server_ptr->peer;
+}
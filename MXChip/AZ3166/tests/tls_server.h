@@ -0,0 +1,42 @@
+// A TLS server stand-in for the host tests, in front of the broker stand-in.
+//
+// It runs the server side of the host port's stand-in handshake (see
+// nx_secure_tls_api.h), giving each handshake a new session ID. Once the
+// handshake completes, what the client sends goes on to the broker. The
+// network is modelled in ticks of the simulated clock: each round trip costs
+// round_trip_ticks, and the key exchange key_exchange_ticks more, so a
+// handshake takes two round trips and the key exchange.
+
+#ifndef TLS_SERVER_H
+#define TLS_SERVER_H
+
+#include "broker.h"
+#include "nx_secure_tls_api.h"
+
+typedef struct TLS_SERVER_STRUCT
+{
+    HOST_TCP_PEER peer;
+    BROKER *broker_ptr;
+
+    // With fail_handshake, answer the ClientHello with an alert
+    UINT fail_handshake;
+    ULONG round_trip_ticks;
+    ULONG key_exchange_ticks;
+    UCHAR next_session;
+
+    // The handshake of the connection, and records not yet processed
+    UINT state;
+    UCHAR master_secret[NX_SECURE_TLS_MASTER_SIZE];
+    UCHAR stream[256];
+    ULONG stream_length;
+
+    // Handshakes completed, ClientHellos offering a session ID, and alerts sent
+    UINT handshakes;
+    UINT offered;
+    UINT alerts;
+} TLS_SERVER;
+
+// Put the server in front of the broker, after broker_attach
+VOID tls_server_attach(TLS_SERVER *server_ptr, BROKER *broker_ptr, ULONG round_trip_ticks, ULONG key_exchange_ticks);
+
+#endif // TLS_SERVER_H